@@ -301,6 +301,11 @@ public:
 	/// The navigation mesh initialization params.
 	const dtNavMeshParams* getParams() const;
 
+	/// The revision of the navigation mesh. It changes every time a tile is added or removed,
+	/// or the state of a polygon is changed through the navigation mesh. (See: #setPolyFlags, #setPolyArea)
+	/// @return The revision of the navigation mesh.
+	unsigned int getRevision() const { return m_revision; }
+
 	/// Adds a tile to the navigation mesh.
 	///  @param[in]		data		Data for the new tile mesh. (See: #dtCreateNavMeshData)
 	///  @param[in]		dataSize	Data size of the new tile mesh.
@@ -579,6 +584,8 @@ private:
 	unsigned int m_saltBits;			///< Number of salt bits in the tile ID.
 	unsigned int m_tileBits;			///< Number of tile bits in the tile ID.
 	unsigned int m_polyBits;			///< Number of poly bits in the tile ID.
+
+	unsigned int m_revision;			///< Incremented by every change of the tiles or the polygon states.
 };
 
 /// Allocates a navigation mesh object using the Detour allocator.
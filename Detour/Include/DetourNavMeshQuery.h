@@ -115,6 +115,25 @@ public:
 
 };
 
+/// A ray cast by dtNavMeshQuery::raycastBatch.
+/// @ingroup detour
+struct dtRaycastRequest
+{
+	dtPolyRef startRef;		///< The reference id of the start polygon.
+	float startPos[3];		///< A position within the start polygon representing the start of the ray. [(x, y, z)]
+	float endPos[3];		///< The position to cast the ray toward. [(x, y, z)]
+};
+
+/// The result of a ray cast by dtNavMeshQuery::raycastBatch.
+/// @ingroup detour
+struct dtRaycastHit
+{
+	dtStatus status;		///< The status flags of the ray.
+	float t;				///< The hit parameter. (FLT_MAX if no wall hit.)
+	float hitNormal[3];		///< The normal of the nearest wall hit. [(x, y, z)]
+	int pathCount;			///< The number of visited polygons.
+};
+
 /// Provides the ability to perform pathfinding related queries against
 /// a navigation mesh.
 /// @ingroup detour
@@ -324,6 +343,19 @@ public:
 					 const dtQueryFilter* filter,
 					 float* t, float* hitNormal, dtPolyRef* path, int* pathCount, const int maxPath) const;
 	
+	/// Casts several 'walkability' rays. (See: #raycast)
+	///  @param[in]		rays		The rays to cast. [(ray) * @p nrays]
+	///  @param[in]		nrays		The number of rays.
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[out]	hits		The result of each ray. [(hit) * @p nrays]
+	///  @param[out]	paths		The reference ids of the polygons visited by each ray,
+	///  							@p maxPath entries per ray. [opt] [(polyRef) * @p maxPath * @p nrays]
+	///  @param[in]		maxPath		The maximum number of polygons stored for each ray.
+	/// @returns The status flags for the query. (Failure only if the parameters are invalid, see
+	/// the status of each ray for the rest.)
+	dtStatus raycastBatch(const dtRaycastRequest* rays, const int nrays, const dtQueryFilter* filter,
+						  dtRaycastHit* hits, dtPolyRef* paths, const int maxPath) const;
+	
 	/// Finds the distance from the specified position to the nearest polygon wall.
 	///  @param[in]		startRef		The reference id of the polygon containing @p centerPos.
 	///  @param[in]		centerPos		The center of the search circle. [(x, y, z)]
@@ -436,6 +468,11 @@ private:
 	/// Returns closest point on polygon.
 	void closestPointOnPolyInTile(const dtMeshTile* tile, const dtPoly* poly, const float* pos, float* closest) const;
 	
+	/// Casts a ray from an already validated start polygon.
+	dtStatus raycastFrom(dtPolyRef startRef, const dtMeshTile* startTile, const dtPoly* startPoly,
+						 const float* startPos, const float* endPos, const dtQueryFilter* filter,
+						 float* t, float* hitNormal, dtPolyRef* path, int* pathCount, const int maxPath) const;
+	
 	/// Returns portal points between two polygons.
 	dtStatus getPortalPoints(dtPolyRef from, dtPolyRef to, float* left, float* right,
 							 unsigned char& fromType, unsigned char& toType) const;
@@ -0,0 +1,164 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURNAVMESHSET_H
+#define DETOURNAVMESHSET_H
+
+#include "DetourNavMesh.h"
+
+/// @{
+/// @name Navigation Mesh Set Constants
+
+/// A magic number used to detect compatibility of navigation mesh set data.
+static const int DT_NAVMESHSET_MAGIC = 'M'<<24 | 'S'<<16 | 'E'<<8 | 'T';
+
+/// A version number used to detect compatibility of navigation mesh set data.
+static const int DT_NAVMESHSET_VERSION = 2;
+
+/// The default alignment of the tile blobs within a navigation mesh set. (Matches the common page size.)
+static const int DT_NAVMESHSET_DEFAULT_ALIGN = 4096;
+
+/// @}
+
+/// The header of a navigation mesh set.
+/// @ingroup detour
+struct dtNavMeshSetHeader
+{
+	int magic;					///< Set magic number. (Used to identify the data format.)
+	int version;				///< Set data format version number.
+	int dataSize;				///< The total size of the set, header included.
+	int tileAlign;				///< The alignment of the tile blobs within the set. [Limit: power of two, >= 4]
+	int tileCount;				///< The number of tiles in the set.
+	dtNavMeshParams params;		///< The parameters used to initialize the navigation mesh.
+};
+
+/// An entry of the navigation mesh set table of contents.
+/// @ingroup detour
+struct dtNavMeshSetTile
+{
+	int x;						///< The x-position of the tile within the dtNavMesh tile grid. (x, y, layer)
+	int y;						///< The y-position of the tile within the dtNavMesh tile grid. (x, y, layer)
+	int layer;					///< The layer of the tile within the dtNavMesh tile grid. (x, y, layer)
+	dtTileRef tileRef;			///< The tile reference at the time the set was stored.
+	int dataOffset;				///< The offset of the tile data from the start of the set. [Limit: multiple of tileAlign]
+	int dataSize;				///< The size of the tile data.
+};
+
+/// A read-write, copy-on-write mapping of a navigation mesh set file.
+/// @see dtMapNavMeshSet, dtUnmapNavMeshSet
+/// @ingroup detour
+struct dtNavMeshSetMapping
+{
+	unsigned char* data;		///< The start of the mapped set, or null if nothing is mapped.
+	int dataSize;				///< The size of the mapped set.
+};
+
+/// Gets the size of the buffer required by #dtStoreNavMeshSet to store the specified navigation mesh.
+///  @param[in]	mesh		The navigation mesh.
+///  @param[in]	tileAlign	The alignment of the tile blobs. [Limit: power of two, >= 4]
+/// @return The size of the buffer required to store the set, or zero if the parameters are invalid.
+///  @ingroup detour
+int dtGetNavMeshSetSize(const dtNavMesh* mesh, const int tileAlign = DT_NAVMESHSET_DEFAULT_ALIGN);
+
+/// Stores all the tiles of the navigation mesh in the specified buffer.
+///  @param[in]		mesh			The navigation mesh.
+///  @param[out]	data			The buffer to store the set in.
+///  @param[in]		maxDataSize		The size of the data buffer. [Limit: >= #dtGetNavMeshSetSize]
+///  @param[in]		tileAlign		The alignment of the tile blobs. [Limit: power of two, >= 4]
+/// @return The status flags for the operation.
+///  @ingroup detour
+dtStatus dtStoreNavMeshSet(const dtNavMesh* mesh, unsigned char* data, const int maxDataSize,
+						   const int tileAlign = DT_NAVMESHSET_DEFAULT_ALIGN);
+
+/// Checks that the specified buffer holds a valid navigation mesh set.
+/// The tile blobs must be stored after the table of contents, in its order, and must not overlap.
+///  @param[in]	data		The navigation mesh set.
+///  @param[in]	dataSize	The size of the data buffer.
+/// @return The status flags for the operation.
+///  @ingroup detour
+dtStatus dtValidateNavMeshSet(const unsigned char* data, const int dataSize);
+
+/// Checks the header and the table of contents of a navigation mesh set whose tile data is not loaded.
+/// Performs the same checks as #dtValidateNavMeshSet, against the size of the whole set.
+///  @param[in]	toc			The header and the table of contents of the set.
+///  @param[in]	tocSize		The size of the toc buffer.
+///  @param[in]	setSize		The size of the whole set, e.g. the size of the file holding it.
+/// @return The status flags for the operation.
+///  @ingroup detour
+dtStatus dtValidateNavMeshSetToc(const unsigned char* toc, const int tocSize, const int setSize);
+
+/// Finds the table of contents entry of a tile within a navigation mesh set.
+///  @param[in]	data	A valid navigation mesh set. (See: #dtValidateNavMeshSet)
+///  @param[in]	x		The tile's x-location. (x, y, layer)
+///  @param[in]	y		The tile's y-location. (x, y, layer)
+///  @param[in]	layer	The tile's layer. (x, y, layer)
+/// @return The entry of the tile, or null if the set does not contain the tile.
+///  @ingroup detour
+const dtNavMeshSetTile* dtFindNavMeshSetTile(const unsigned char* data, const int x, const int y, const int layer);
+
+/// Finds the table of contents entries of all the tiles at a grid location within a navigation mesh set. (All layers.)
+///  @param[in]	data	A valid navigation mesh set. (See: #dtValidateNavMeshSet)
+///  @param[in]	x		The tile's x-location. (x, y)
+///  @param[in]	y		The tile's y-location. (x, y)
+///  @param[out]	first	The first entry of the tiles, sorted by layer. [opt]
+/// @return The number of tiles at the location. (The entries are contiguous.)
+///  @ingroup detour
+int dtFindNavMeshSetTilesAt(const unsigned char* data, const int x, const int y, const dtNavMeshSetTile** first);
+
+/// Initializes the navigation mesh with the tiles of a navigation mesh set, without copying them.
+///  @param[in]	mesh		The navigation mesh to initialize.
+///  @param[in]	data		The navigation mesh set.
+///  @param[in]	dataSize	The size of the data buffer.
+/// @return The status flags for the operation.
+///  @ingroup detour
+dtStatus dtInitNavMeshFromSet(dtNavMesh* mesh, unsigned char* data, const int dataSize);
+
+/// Maps a navigation mesh set file in memory.
+///  @param[in]		path		The path of the file.
+///  @param[out]	mapping		The resulting mapping.
+/// @return The status flags for the operation.
+///  @ingroup detour
+dtStatus dtMapNavMeshSet(const char* path, dtNavMeshSetMapping* mapping);
+
+/// Unmaps a navigation mesh set file mapped using #dtMapNavMeshSet.
+///  @param[in]	mapping		The mapping to release.
+///  @ingroup detour
+void dtUnmapNavMeshSet(dtNavMeshSetMapping* mapping);
+
+#endif // DETOURNAVMESHSET_H
+
+///////////////////////////////////////////////////////////////////////////
+
+// This section contains detailed documentation for members that don't have
+// a source file. It reduces clutter in the main section of the header.
+
+/**
+
+@struct dtNavMeshSetHeader
+@par
+
+A navigation mesh set is laid out as follows:
+
+- The dtNavMeshSetHeader.
+- The table of contents, one dtNavMeshSetTile per tile, sorted by (x, y, layer).
+- The tile data, each blob starting at a multiple of dtNavMeshSetHeader::tileAlign.
+
+Since the tile blobs are aligned on page boundaries by default, a set that
+is mapped in memory can be handed directly to dtNavMesh::addTile().
+
+*/
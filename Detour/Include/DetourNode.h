@@ -30,6 +30,20 @@ enum dtNodeFlags
 typedef unsigned short dtNodeIndex;
 static const dtNodeIndex DT_NULL_IDX = (dtNodeIndex)~0;
 
+/// Hashes a polygon reference, for the hash tables indexed by polygon. (See: #dtNodePool)
+///  @param[in]		a		The polygon reference.
+/// @return The hash of the reference.
+inline unsigned int dtHashRef(dtPolyRef a)
+{
+	a += ~(a<<15);
+	a ^=  (a>>10);
+	a +=  (a<<3);
+	a ^=  (a>>6);
+	a += ~(a<<11);
+	a ^=  (a>>16);
+	return (unsigned int)a;
+}
+
 struct dtNode
 {
 	float pos[3];				///< Position of the node.
@@ -0,0 +1,193 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURSHAREDNAVMESH_H
+#define DETOURSHAREDNAVMESH_H
+
+#include "DetourNavMesh.h"
+#include "DetourThread.h"
+
+/// A navigation mesh modified by one thread while others query it.
+///
+/// The mesh is double-buffered: the readers use the published buffer, while
+/// the changes are applied to the pending one and become visible atomically
+/// on #publish. (See the class documentation below.)
+/// @ingroup detour
+class dtSharedNavMesh
+{
+public:
+	dtSharedNavMesh();
+	~dtSharedNavMesh();
+
+	/// Initializes the navigation mesh for tiled use.
+	///  @param[in]	params		Initialization parameters.
+	/// @return The status flags for the operation.
+	dtStatus init(const dtNavMeshParams* params);
+
+	/// @name Reader Functions
+	/// These functions can be called from any thread.
+	/// @{
+
+	/// Starts reading the published navigation mesh.
+	/// The navigation mesh is not modified until the matching call to #endRead.
+	///  @param[out]	token	The token to pass to #endRead.
+	/// @return The published navigation mesh.
+	const dtNavMesh* beginRead(int* token);
+
+	/// Stops reading a navigation mesh obtained from #beginRead.
+	///  @param[in]	token	The token returned by #beginRead.
+	void endRead(const int token);
+
+	/// The number of times changes were published.
+	int getVersion();
+
+	/// @}
+	/// @name Writer Functions
+	/// These functions are serialized, but are meant to be called by a single thread.
+	/// @{
+
+	/// Adds a tile to the pending navigation mesh.
+	///  @param[in]		data		Data for the new tile mesh. (See: #dtCreateNavMeshData)
+	///  @param[in]		dataSize	Data size of the new tile mesh.
+	///  @param[in]		lastRef		The desired reference for the tile. (When reloading a tile.) [opt] [Default: 0]
+	///  @param[out]	result		The tile reference. (If the tile was succesfully added.) [opt]
+	/// @return The status flags for the operation.
+	/// The shared navigation mesh always takes the ownership of the data. (See: #DT_TILE_FREE_DATA)
+	dtStatus addTile(unsigned char* data, int dataSize, dtTileRef lastRef, dtTileRef* result);
+
+	/// Removes a tile from the pending navigation mesh.
+	///  @param[in]	ref		The reference of the tile to remove.
+	/// @return The status flags for the operation.
+	dtStatus removeTile(dtTileRef ref);
+
+	/// Sets the user defined flags of a polygon of the pending navigation mesh.
+	///  @param[in]	ref		The polygon reference.
+	///  @param[in]	flags	The new flags for the polygon.
+	/// @return The status flags for the operation.
+	dtStatus setPolyFlags(dtPolyRef ref, unsigned short flags);
+
+	/// Sets the user defined area of a polygon of the pending navigation mesh.
+	///  @param[in]	ref		The polygon reference.
+	///  @param[in]	area	The new area id for the polygon. [Limit: < #DT_MAX_AREAS]
+	/// @return The status flags for the operation.
+	dtStatus setPolyArea(dtPolyRef ref, unsigned char area);
+
+	/// The pending navigation mesh, holding all the changes made so far.
+	/// Only the writer thread may use it, and only until the next change.
+	const dtNavMesh* getPendingNavMesh() const { return &m_meshes[m_pending]; }
+
+	/// Makes the pending changes visible to the readers.
+	/// Waits until the readers have stopped using the previously published mesh,
+	/// then brings it up to date so that it can receive the next changes.
+	/// @return The status flags for the operation.
+	dtStatus publish();
+
+	/// @}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtSharedNavMesh(const dtSharedNavMesh&);
+	dtSharedNavMesh& operator=(const dtSharedNavMesh&);
+
+	enum ChangeType
+	{
+		CHANGE_ADD_TILE,
+		CHANGE_REMOVE_TILE,
+		CHANGE_POLY_FLAGS,
+		CHANGE_POLY_AREA,
+	};
+
+	/// A change to replay on the other buffer.
+	struct Change
+	{
+		unsigned char type;
+		unsigned char area;
+		unsigned short flags;
+		dtTileRef ref;				///< The tile or polygon reference.
+		unsigned char* data;		///< A copy of the tile data. (CHANGE_ADD_TILE only.)
+		int dataSize;
+	};
+
+	dtStatus appendChange(const Change& change);
+	void clearChanges();
+
+	dtNavMesh m_meshes[2];
+	int m_pending;					///< The index of the buffer receiving the changes.
+	volatile int m_published;		///< The index of the buffer used by the readers.
+	volatile int m_readers[2];		///< The number of readers of each buffer.
+	volatile int m_version;
+
+	Change* m_changes;
+	int m_nchanges;
+	int m_maxChanges;
+
+	dtMutex m_writeLock;
+};
+
+/// Reads the published navigation mesh of a dtSharedNavMesh for the lifetime of the object.
+/// @ingroup detour
+class dtSharedNavMeshReadScope
+{
+public:
+	explicit dtSharedNavMeshReadScope(dtSharedNavMesh& mesh) : m_mesh(mesh) { m_nav = m_mesh.beginRead(&m_token); }
+	~dtSharedNavMeshReadScope() { m_mesh.endRead(m_token); }
+
+	/// The navigation mesh to query.
+	const dtNavMesh* get() const { return m_nav; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtSharedNavMeshReadScope(const dtSharedNavMeshReadScope&);
+	dtSharedNavMeshReadScope& operator=(const dtSharedNavMeshReadScope&);
+
+	dtSharedNavMesh& m_mesh;
+	const dtNavMesh* m_nav;
+	int m_token;
+};
+
+#endif // DETOURSHAREDNAVMESH_H
+
+///////////////////////////////////////////////////////////////////////////
+
+// This section contains detailed documentation for members that don't have
+// a source file. It reduces clutter in the main section of the header.
+
+/**
+
+@class dtSharedNavMesh
+@par
+
+Both buffers are full dtNavMesh objects holding their own copy of the tiles,
+since adding or removing a tile rewrites the links of its neighbours. Each
+change is applied to the pending buffer right away and recorded. On #publish,
+the pending buffer becomes the published one, and once the last reader of the
+former published buffer has left it, the recorded changes are replayed there.
+The tiles removed by the changes are only freed at that point, so a reader
+never sees a tile disappear while it holds the mesh.
+
+The replay reuses the tile references of the pending buffer, so a reference
+obtained from either buffer is valid in both once the change is published.
+
+A dtNavMeshQuery can be pointed at the mesh returned by #beginRead using
+dtNavMeshQuery::init(), which keeps its node pools when their size is unchanged.
+
+The readers never block, but #publish waits for the readers of the previous
+version: the read sections should be short, and a thread must not publish
+while it is reading.
+
+*/
@@ -0,0 +1,217 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURTHREAD_H
+#define DETOURTHREAD_H
+
+// Note: This header wraps the few platform primitives used by the Detour
+// background services (tile streaming, parallel tile cache updates, etc.)
+// The core navigation mesh and query classes do not use them.
+
+#ifdef _MSC_VER
+typedef __int64 dtTimeVal;
+#else
+#include <stdint.h>
+typedef int64_t dtTimeVal;
+#endif
+
+/// Gets the current value of the high resolution timer.
+/// @return The current time.
+///  @see dtGetPerfDeltaTimeUsec
+dtTimeVal dtGetPerfTime();
+
+/// Gets the elapsed time between two timer values.
+///  @param[in]	start	The start time. (See: #dtGetPerfTime)
+///  @param[in]	end		The end time. (See: #dtGetPerfTime)
+/// @return The elapsed time. [Unit: microseconds]
+int dtGetPerfDeltaTimeUsec(const dtTimeVal start, const dtTimeVal end);
+
+/// Atomically adds a value to an integer. (Acts as a full memory barrier.)
+///  @param[in,out]	value	The integer to modify.
+///  @param[in]		delta	The value to add.
+/// @return The new value of the integer.
+int dtAtomicAdd(volatile int* value, const int delta);
+
+/// Atomically reads an integer. (Acts as a full memory barrier.)
+///  @param[in]	value	The integer to read.
+/// @return The value of the integer.
+int dtAtomicLoad(volatile int* value);
+
+/// Atomically writes an integer. (Acts as a full memory barrier.)
+///  @param[out]	value	The integer to write.
+///  @param[in]		v		The new value of the integer.
+void dtAtomicStore(volatile int* value, const int v);
+
+/// Gives up the remainder of the calling thread's time slice.
+void dtThreadYield();
+
+/// A mutual exclusion lock.
+class dtMutex
+{
+public:
+	dtMutex();
+	~dtMutex();
+
+	void lock();
+	void unlock();
+
+private:
+	friend class dtCondition;
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtMutex(const dtMutex&);
+	dtMutex& operator=(const dtMutex&);
+
+	void* m_impl;
+};
+
+/// Locks a mutex for the lifetime of the object.
+class dtScopedLock
+{
+public:
+	explicit dtScopedLock(dtMutex& mutex) : m_mutex(mutex) { m_mutex.lock(); }
+	~dtScopedLock() { m_mutex.unlock(); }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtScopedLock(const dtScopedLock&);
+	dtScopedLock& operator=(const dtScopedLock&);
+
+	dtMutex& m_mutex;
+};
+
+/// A condition variable, used together with a dtMutex.
+class dtCondition
+{
+public:
+	dtCondition();
+	~dtCondition();
+
+	/// Atomically unlocks the mutex and waits until the condition is signaled.
+	///  @param[in]	mutex	The mutex, locked by the calling thread.
+	void wait(dtMutex& mutex);
+
+	/// Wakes up one waiting thread.
+	void signal();
+
+	/// Wakes up all the waiting threads.
+	void broadcast();
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtCondition(const dtCondition&);
+	dtCondition& operator=(const dtCondition&);
+
+	void* m_impl;
+};
+
+/// The entry point of a thread.
+///  @param[in]	arg		The user argument given to dtThread::start().
+typedef void (dtThreadFunc)(void* arg);
+
+/// A thread of execution.
+class dtThread
+{
+public:
+	dtThread();
+	~dtThread();
+
+	/// Starts the thread.
+	///  @param[in]	func	The entry point of the thread.
+	///  @param[in]	arg		The argument passed to the entry point.
+	/// @return True if the thread was started.
+	bool start(dtThreadFunc* func, void* arg);
+
+	/// Waits for the thread to finish.
+	void join();
+
+	/// Whether the thread was started and not joined yet.
+	bool isRunning() const { return m_impl != 0; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtThread(const dtThread&);
+	dtThread& operator=(const dtThread&);
+
+	void* m_impl;
+};
+
+/// The body of a parallel loop.
+///  @param[in]	arg		The user argument given to dtThreadPool::parallelFor().
+///  @param[in]	index	The loop index. [Limit: 0 <= value < count]
+///  @param[in]	worker	The worker running the iteration. [Limit: 0 <= value < dtThreadPool::getWorkerCount()]
+typedef void (dtParallelForFunc)(void* arg, const int index, const int worker);
+
+/// A fixed set of threads running parallel loops.
+/// The calling thread takes part in the loops as worker zero.
+class dtThreadPool
+{
+public:
+	dtThreadPool();
+	~dtThreadPool();
+
+	/// Starts the threads of the pool.
+	///  @param[in]	workerCount		The number of workers, the calling thread included. [Limit: > 0]
+	/// @return True if all the threads were started.
+	bool init(const int workerCount);
+
+	/// Stops the threads of the pool.
+	void destroy();
+
+	/// The number of workers running the loops, the calling thread included.
+	int getWorkerCount() const { return m_nthreads+1; }
+
+	/// Runs the loop body for each index in [0, @\p count) and returns once all the iterations are done.
+	/// The iterations run in no particular order. The method must not be called concurrently.
+	///  @param[in]	func	The loop body.
+	///  @param[in]	arg		The user argument passed to the loop body.
+	///  @param[in]	count	The number of iterations.
+	void parallelFor(dtParallelForFunc* func, void* arg, const int count);
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtThreadPool(const dtThreadPool&);
+	dtThreadPool& operator=(const dtThreadPool&);
+
+	struct Worker
+	{
+		dtThreadPool* pool;
+		int index;
+	};
+
+	static void threadMain(void* arg);
+	void work(const int worker);
+
+	dtThread* m_threads;
+	Worker* m_workers;
+	int m_nthreads;
+
+	dtMutex m_mutex;
+	dtCondition m_start;
+	dtCondition m_done;
+	int m_generation;			///< Incremented for each loop.
+	int m_active;				///< The number of threads still running the current loop.
+	bool m_stop;
+
+	dtParallelForFunc* m_func;
+	void* m_arg;
+	int m_count;
+	volatile int m_next;		///< The next iteration to run.
+};
+
+#endif // DETOURTHREAD_H
@@ -0,0 +1,224 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURTILESTREAMER_H
+#define DETOURTILESTREAMER_H
+
+#include <stdio.h>
+#include "DetourNavMesh.h"
+#include "DetourThread.h"
+
+/// The maximum number of layers of a tile column handled by the streamer.
+/// @ingroup detour
+static const int DT_TILESTREAM_MAX_LAYERS = 32;
+
+/// The data of a streamed navigation mesh tile.
+/// @ingroup detour
+struct dtTileStreamData
+{
+	unsigned char* data;		///< The tile data, allocated using #dtAlloc. (See: #dtCreateNavMeshData)
+	int dataSize;				///< The size of the tile data.
+};
+
+/// Provides the tile data to a dtTileStreamer.
+/// @ingroup detour
+class dtTileStreamSource
+{
+public:
+	virtual ~dtTileStreamSource() {}
+
+	/// Loads all the layers of the tile column at the specified grid location.
+	/// This method is called from the streaming thread when background I/O is enabled.
+	///  @param[in]		tx			The tile's x-location. (x, y)
+	///  @param[in]		ty			The tile's y-location. (x, y)
+	///  @param[out]	tiles		The loaded tiles. The navigation mesh takes ownership of the data.
+	///  @param[in]		maxTiles	The maximum number of tiles the tiles parameter can hold.
+	/// @return The number of tiles loaded. (Zero if the column is empty.)
+	virtual int loadTiles(const int tx, const int ty, dtTileStreamData* tiles, const int maxTiles) = 0;
+};
+
+/// A tile source reading the tiles of a navigation mesh set file. (See: #dtStoreNavMeshSet)
+/// @ingroup detour
+class dtNavMeshSetStreamSource : public dtTileStreamSource
+{
+public:
+	dtNavMeshSetStreamSource();
+	virtual ~dtNavMeshSetStreamSource();
+
+	/// Opens the set and reads its table of contents.
+	///  @param[in]	path	The path of the navigation mesh set file.
+	/// @return The status flags for the operation.
+	dtStatus init(const char* path);
+
+	/// The parameters to initialize the streamed navigation mesh with.
+	const dtNavMeshParams* getParams() const;
+
+	virtual int loadTiles(const int tx, const int ty, dtTileStreamData* tiles, const int maxTiles);
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtNavMeshSetStreamSource(const dtNavMeshSetStreamSource&);
+	dtNavMeshSetStreamSource& operator=(const dtNavMeshSetStreamSource&);
+
+	dtStatus readToc();
+
+	FILE* m_fp;
+	unsigned char* m_toc;		///< The set header and table of contents.
+};
+
+/// Configuration parameters of a dtTileStreamer.
+/// @ingroup detour
+struct dtTileStreamerParams
+{
+	float loadRadius;			///< The tiles closer than this distance to a focus point are loaded. [Limit: > 0] [Unit: wu]
+	float evictRadius;			///< The tiles farther than this distance from every focus point are evicted. [Limit: >= #loadRadius] [Unit: wu]
+	int maxColumns;				///< The maximum number of tile columns tracked at once. [Limit: > 0]
+	int maxFocusPoints;			///< The maximum number of focus points. [Limit: > 0]
+	bool backgroundIO;			///< Loads the tiles on a background thread. (Otherwise the loading is done by #dtTileStreamer::update.)
+};
+
+/// Statistics about the work done by a dtTileStreamer.
+/// @ingroup detour
+struct dtTileStreamerStats
+{
+	int queuedColumns;			///< The number of columns waiting to be loaded.
+	int loadedColumns;			///< The number of columns loaded and waiting to be added to the navigation mesh.
+	int committedColumns;		///< The number of non-empty columns added to the navigation mesh.
+	int addedTiles;				///< The number of tiles added during the last update.
+	int removedTiles;			///< The number of tiles removed during the last update.
+	int updateTimeUsec;			///< The time spent in the last update. [Unit: microseconds]
+};
+
+/// Streams the tiles of a navigation mesh around a set of focus points.
+///
+/// The tile data is loaded from a dtTileStreamSource, optionally on a background
+/// thread, and added to the navigation mesh by #update within a time budget.
+/// @ingroup detour
+class dtTileStreamer
+{
+public:
+	dtTileStreamer();
+	~dtTileStreamer();
+
+	/// Initializes the streamer.
+	///  @param[in]	params		The streamer parameters.
+	///  @param[in]	navmesh		The navigation mesh to stream the tiles in.
+	///  @param[in]	source		The source of the tile data.
+	/// @return The status flags for the operation.
+	dtStatus init(const dtTileStreamerParams* params, dtNavMesh* navmesh, dtTileStreamSource* source);
+
+	/// Sets the positions around which the tiles are streamed.
+	///  @param[in]	pos		The focus points. [(x, y, z) * @p count]
+	///  @param[in]	count	The number of focus points. [Limit: <= dtTileStreamerParams::maxFocusPoints]
+	/// @return The status flags for the operation.
+	dtStatus setFocusPoints(const float* pos, const int count);
+
+	/// Requests the missing tiles, evicts the distant ones and adds the loaded ones
+	/// to the navigation mesh, nearest first.
+	/// When more columns are in range than dtTileStreamerParams::maxColumns, the nearest ones
+	/// are requested and the status has the #DT_BUFFER_TOO_SMALL detail.
+	///  @param[in]	budgetUsec	The time allowed for the navigation mesh changes. At least one change is made per call. [Unit: microseconds]
+	/// @return The status flags for the operation.
+	dtStatus update(const int budgetUsec);
+
+	/// Gets the statistics of the streamer.
+	const dtTileStreamerStats& getStats() const { return m_stats; }
+
+	const dtTileStreamerParams* getParams() const { return &m_params; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtTileStreamer(const dtTileStreamer&);
+	dtTileStreamer& operator=(const dtTileStreamer&);
+
+	enum ColumnState
+	{
+		COLUMN_EMPTY,
+		COLUMN_QUEUED,			///< Waiting in the load queue.
+		COLUMN_LOADING,			///< Owned by the loader.
+		COLUMN_LOADED,			///< Loaded, not yet seen by #update.
+		COLUMN_READY,			///< Loaded, waiting to be committed.
+		COLUMN_COMMITTED,		///< All the tiles are in the navigation mesh.
+	};
+
+	struct Column
+	{
+		int tx, ty;
+		float dist;				///< Distance to the nearest focus point.
+		unsigned char state;
+		unsigned char ntiles;
+		unsigned char ncommitted;
+		dtTileStreamData tiles[DT_TILESTREAM_MAX_LAYERS];
+		dtTileRef refs[DT_TILESTREAM_MAX_LAYERS];
+		Column* next;
+	};
+
+	static void ioThreadMain(void* arg);
+	Column* loadNext();
+
+	Column* findColumn(const int tx, const int ty);
+	Column* allocColumn(const int tx, const int ty);
+	void freeColumn(Column* col);
+	void dequeue(Column* col);
+	float getFocusDistance(const int tx, const int ty) const;
+	void releaseTiles(Column* col);
+
+	dtTileStreamerParams m_params;
+	dtNavMesh* m_navmesh;
+	dtTileStreamSource* m_source;
+
+	float* m_focus;
+	int m_nfocus;
+
+	int m_lutMask;
+	Column** m_posLookup;
+	Column* m_columns;
+	Column* m_nextFree;
+
+	int* m_queue;				///< Indices of the columns waiting to be loaded.
+	int m_nqueue;
+	int* m_owned;				///< Indices of the loaded and committed columns, which only #update accesses.
+	int m_nowned;
+
+	dtMutex m_mutex;
+	dtCondition m_wakeup;
+	dtThread m_thread;
+	bool m_stop;
+
+	dtTileStreamerStats m_stats;
+};
+
+#endif // DETOURTILESTREAMER_H
+
+///////////////////////////////////////////////////////////////////////////
+
+// This section contains detailed documentation for members that don't have
+// a source file. It reduces clutter in the main section of the header.
+
+/**
+
+@class dtTileStreamer
+@par
+
+Adding a tile links it with its neighbours, and these links can only be built
+against the tiles currently in the navigation mesh. So the background thread
+only performs the I/O and the validation of the tile data, and the linking
+happens in #update, which is the only method modifying the navigation mesh.
+Queries using the navigation mesh must not run concurrently with #update.
+
+*/
@@ -196,7 +196,8 @@ dtNavMesh::dtNavMesh() :
 	m_tiles(0),
 	m_saltBits(0),
 	m_tileBits(0),
-	m_polyBits(0)
+	m_polyBits(0),
+	m_revision(0)
 {
 	memset(&m_params, 0, sizeof(dtNavMeshParams));
 	m_orig[0] = 0;
@@ -942,6 +943,8 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	if (result)
 		*result = getTileRef(tile);
 	
+	m_revision++;
+	
 	return DT_SUCCESS;
 }
 
@@ -1217,6 +1220,8 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	tile->next = m_nextFree;
 	m_nextFree = tile;
 
+	m_revision++;
+
 	return DT_SUCCESS;
 }
 
@@ -1334,6 +1339,8 @@ dtStatus dtNavMesh::restoreTileState(dtMeshTile* tile, const unsigned char* data
 		p->setArea(s->area);
 	}
 	
+	m_revision++;
+	
 	return DT_SUCCESS;
 }
 
@@ -1425,6 +1432,7 @@ dtStatus dtNavMesh::setPolyFlags(dtPolyRef ref, unsigned short flags)
 	
 	// Change flags.
 	poly->flags = flags;
+	m_revision++;
 	
 	return DT_SUCCESS;
 }
@@ -1457,6 +1465,7 @@ dtStatus dtNavMesh::setPolyArea(dtPolyRef ref, unsigned char area)
 	dtPoly* poly = &tile->polys[ip];
 	
 	poly->setArea(area);
+	m_revision++;
 	
 	return DT_SUCCESS;
 }
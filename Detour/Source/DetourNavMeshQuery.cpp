@@ -2255,7 +2255,88 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 	if (!startRef || !m_nav->isValidPolyRef(startRef))
 		return DT_FAILURE | DT_INVALID_PARAM;
 	
+	const dtMeshTile* startTile = 0;
+	const dtPoly* startPoly = 0;
+	m_nav->getTileAndPolyByRefUnsafe(startRef, &startTile, &startPoly);
+	
+	return raycastFrom(startRef, startTile, startPoly, startPos, endPos, filter, t, hitNormal, path, pathCount, maxPath);
+}
+
+static bool isSameRay(const dtRaycastRequest& a, const dtRaycastRequest& b)
+{
+	return a.startRef == b.startRef &&
+		a.startPos[0] == b.startPos[0] && a.startPos[1] == b.startPos[1] && a.startPos[2] == b.startPos[2] &&
+		a.endPos[0] == b.endPos[0] && a.endPos[1] == b.endPos[1] && a.endPos[2] == b.endPos[2];
+}
+
+/// @par
+///
+/// Each ray is cast as by #raycast. The start polygon of a ray is only looked
+/// up and validated once for a run of consecutive rays starting from it, so
+/// the rays should be sorted by start polygon. A ray identical to the previous
+/// one is not cast again and gets a copy of its result.
+///
+/// @see raycast
+dtStatus dtNavMeshQuery::raycastBatch(const dtRaycastRequest* rays, const int nrays, const dtQueryFilter* filter,
+									  dtRaycastHit* hits, dtPolyRef* paths, const int maxPath) const
+{
+	dtAssert(m_nav);
+	
+	if (nrays < 0 || (nrays > 0 && (!rays || !hits)) || maxPath < 0 || (maxPath > 0 && !paths))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	const dtPolyRef* startRef = 0;
+	const dtMeshTile* startTile = 0;
+	const dtPoly* startPoly = 0;
+	bool startValid = false;
+	
+	for (int i = 0; i < nrays; ++i)
+	{
+		const dtRaycastRequest& ray = rays[i];
+		dtRaycastHit& hit = hits[i];
+		dtPolyRef* path = maxPath > 0 ? &paths[i*maxPath] : 0;
+		
+		if (i > 0 && isSameRay(ray, rays[i-1]))
+		{
+			hit = hits[i-1];
+			for (int j = 0; j < hit.pathCount; ++j)
+				path[j] = path[j-maxPath];
+			continue;
+		}
+		
+		if (!startRef || *startRef != ray.startRef)
+		{
+			startRef = &ray.startRef;
+			startValid = ray.startRef && m_nav->isValidPolyRef(ray.startRef);
+			if (startValid)
+				m_nav->getTileAndPolyByRefUnsafe(ray.startRef, &startTile, &startPoly);
+		}
+		
+		if (!startValid)
+		{
+			memset(&hit, 0, sizeof(hit));
+			hit.status = DT_FAILURE | DT_INVALID_PARAM;
+			continue;
+		}
+		
+		hit.status = raycastFrom(ray.startRef, startTile, startPoly, ray.startPos, ray.endPos, filter,
+								 &hit.t, hit.hitNormal, path, &hit.pathCount, maxPath);
+	}
+	
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshQuery::raycastFrom(dtPolyRef startRef, const dtMeshTile* startTile, const dtPoly* startPoly,
+									 const float* startPos, const float* endPos, const dtQueryFilter* filter,
+									 float* t, float* hitNormal, dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	*t = 0;
+	if (pathCount)
+		*pathCount = 0;
+	
 	dtPolyRef curRef = startRef;
+	const dtMeshTile* tile = startTile;
+	const dtPoly* poly = startPoly;
 	float verts[DT_VERTS_PER_POLYGON*3];	
 	int n = 0;
 	
@@ -2269,11 +2350,6 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 	{
 		// Cast ray against current polygon.
 		
-		// The API input has been cheked already, skip checking internal data.
-		const dtMeshTile* tile = 0;
-		const dtPoly* poly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(curRef, &tile, &poly);
-		
 		// Collect vertices.
 		int nv = 0;
 		for (int i = 0; i < (int)poly->vertCount; ++i)
@@ -2312,6 +2388,8 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 		
 		// Follow neighbours.
 		dtPolyRef nextRef = 0;
+		const dtMeshTile* nextTile = 0;
+		const dtPoly* nextPoly = 0;
 		
 		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
 		{
@@ -2322,8 +2400,7 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 				continue;
 			
 			// Get pointer to the next polygon.
-			const dtMeshTile* nextTile = 0;
-			const dtPoly* nextPoly = 0;
+			// The API input has been cheked already, skip checking internal data.
 			m_nav->getTileAndPolyByRefUnsafe(link->ref, &nextTile, &nextPoly);
 			
 			// Skip off-mesh connections.
@@ -2414,6 +2491,8 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 		
 		// No hit, advance to neighbour polygon.
 		curRef = nextRef;
+		tile = nextTile;
+		poly = nextPoly;
 	}
 	
 	if (pathCount)
@@ -0,0 +1,352 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "DetourNavMeshSet.h"
+#include "DetourCommon.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+inline bool isValidTileAlign(const int align)
+{
+	return align >= 4 && (align & (align-1)) == 0;
+}
+
+inline int alignTo(const int x, const int align)
+{
+	return (x + align-1) & ~(align-1);
+}
+
+inline int compareTileLoc(const int ax, const int ay, const int alayer,
+						  const int bx, const int by, const int blayer)
+{
+	if (ax != bx) return ax < bx ? -1 : 1;
+	if (ay != by) return ay < by ? -1 : 1;
+	if (alayer != blayer) return alayer < blayer ? -1 : 1;
+	return 0;
+}
+
+static int compareSetTiles(const void* va, const void* vb)
+{
+	const dtNavMeshSetTile* a = (const dtNavMeshSetTile*)va;
+	const dtNavMeshSetTile* b = (const dtNavMeshSetTile*)vb;
+	return compareTileLoc(a->x, a->y, a->layer, b->x, b->y, b->layer);
+}
+
+inline bool isStoredTile(const dtMeshTile* tile)
+{
+	return tile && tile->header && tile->dataSize;
+}
+
+static int getTocSize(const int tileCount, const int tileAlign)
+{
+	const int headerSize = dtAlign4(sizeof(dtNavMeshSetHeader));
+	const int entriesSize = dtAlign4(sizeof(dtNavMeshSetTile)*tileCount);
+	return alignTo(headerSize + entriesSize, tileAlign);
+}
+
+int dtGetNavMeshSetSize(const dtNavMesh* mesh, const int tileAlign)
+{
+	if (!mesh || !isValidTileAlign(tileAlign))
+		return 0;
+
+	int tileCount = 0;
+	int tilesSize = 0;
+	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh->getTile(i);
+		if (!isStoredTile(tile)) continue;
+		tileCount++;
+		tilesSize += alignTo(tile->dataSize, tileAlign);
+	}
+
+	return getTocSize(tileCount, tileAlign) + tilesSize;
+}
+
+/// @par
+///
+/// The tiles are stored in (x, y, layer) order so that tiles which are close
+/// in the tile grid are also close in the set.
+///
+/// @see #dtGetNavMeshSetSize, #dtInitNavMeshFromSet
+dtStatus dtStoreNavMeshSet(const dtNavMesh* mesh, unsigned char* data, const int maxDataSize,
+						   const int tileAlign)
+{
+	if (!mesh || !data || !isValidTileAlign(tileAlign))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const int sizeReq = dtGetNavMeshSetSize(mesh, tileAlign);
+	if (maxDataSize < sizeReq)
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+
+	memset(data, 0, sizeReq);
+
+	dtNavMeshSetHeader* header = (dtNavMeshSetHeader*)data;
+	dtNavMeshSetTile* toc = (dtNavMeshSetTile*)(data + dtAlign4(sizeof(dtNavMeshSetHeader)));
+
+	// Build the table of contents.
+	int tileCount = 0;
+	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh->getTile(i);
+		if (!isStoredTile(tile)) continue;
+		dtNavMeshSetTile* entry = &toc[tileCount++];
+		entry->x = tile->header->x;
+		entry->y = tile->header->y;
+		entry->layer = tile->header->layer;
+		entry->tileRef = mesh->getTileRef(tile);
+		entry->dataSize = tile->dataSize;
+	}
+	qsort(toc, tileCount, sizeof(dtNavMeshSetTile), compareSetTiles);
+
+	// Store the tile data.
+	int offset = getTocSize(tileCount, tileAlign);
+	for (int i = 0; i < tileCount; ++i)
+	{
+		dtNavMeshSetTile* entry = &toc[i];
+		const dtMeshTile* tile = mesh->getTileByRef(entry->tileRef);
+		memcpy(data + offset, tile->data, tile->dataSize);
+		entry->dataOffset = offset;
+		offset += alignTo(tile->dataSize, tileAlign);
+	}
+
+	header->magic = DT_NAVMESHSET_MAGIC;
+	header->version = DT_NAVMESHSET_VERSION;
+	header->dataSize = sizeReq;
+	header->tileAlign = tileAlign;
+	header->tileCount = tileCount;
+	memcpy(&header->params, mesh->getParams(), sizeof(dtNavMeshParams));
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtValidateNavMeshSet(const unsigned char* data, const int dataSize)
+{
+	return dtValidateNavMeshSetToc(data, dataSize, dataSize);
+}
+
+dtStatus dtValidateNavMeshSetToc(const unsigned char* data, const int tocSize, const int setSize)
+{
+	if (!data || tocSize < (int)sizeof(dtNavMeshSetHeader))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtNavMeshSetHeader* header = (const dtNavMeshSetHeader*)data;
+	if (header->magic != DT_NAVMESHSET_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (header->version != DT_NAVMESHSET_VERSION)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (header->dataSize > setSize || header->tileCount < 0 || !isValidTileAlign(header->tileAlign))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (header->tileCount > header->dataSize / (int)sizeof(dtNavMeshSetTile))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (getTocSize(header->tileCount, header->tileAlign) > header->dataSize)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	const int entriesEnd = dtAlign4(sizeof(dtNavMeshSetHeader)) + (int)sizeof(dtNavMeshSetTile)*header->tileCount;
+	if (entriesEnd > tocSize)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	// The tile blobs follow the table of contents, in its order, without overlapping.
+	const dtNavMeshSetTile* toc = (const dtNavMeshSetTile*)(data + dtAlign4(sizeof(dtNavMeshSetHeader)));
+	int dataEnd = getTocSize(header->tileCount, header->tileAlign);
+	for (int i = 0; i < header->tileCount; ++i)
+	{
+		const dtNavMeshSetTile* entry = &toc[i];
+		if (entry->dataOffset < dataEnd || (entry->dataOffset & (header->tileAlign-1)) != 0)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		if (entry->dataSize <= 0 || entry->dataSize > header->dataSize - entry->dataOffset)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		if (i > 0 && compareSetTiles(&toc[i-1], entry) >= 0)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		dataEnd = entry->dataOffset + entry->dataSize;
+	}
+
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// The table of contents is sorted, so the lookup is a binary search.
+const dtNavMeshSetTile* dtFindNavMeshSetTile(const unsigned char* data, const int x, const int y, const int layer)
+{
+	const dtNavMeshSetHeader* header = (const dtNavMeshSetHeader*)data;
+	const dtNavMeshSetTile* toc = (const dtNavMeshSetTile*)(data + dtAlign4(sizeof(dtNavMeshSetHeader)));
+
+	int lo = 0;
+	int hi = header->tileCount-1;
+	while (lo <= hi)
+	{
+		const int mid = (lo + hi) / 2;
+		const dtNavMeshSetTile* entry = &toc[mid];
+		const int cmp = compareTileLoc(x, y, layer, entry->x, entry->y, entry->layer);
+		if (cmp == 0)
+			return entry;
+		if (cmp < 0)
+			hi = mid-1;
+		else
+			lo = mid+1;
+	}
+	return 0;
+}
+
+int dtFindNavMeshSetTilesAt(const unsigned char* data, const int x, const int y, const dtNavMeshSetTile** first)
+{
+	const dtNavMeshSetHeader* header = (const dtNavMeshSetHeader*)data;
+	const dtNavMeshSetTile* toc = (const dtNavMeshSetTile*)(data + dtAlign4(sizeof(dtNavMeshSetHeader)));
+
+	// Find the first entry at the location.
+	int lo = 0;
+	int hi = header->tileCount;
+	while (lo < hi)
+	{
+		const int mid = (lo + hi) / 2;
+		const dtNavMeshSetTile* entry = &toc[mid];
+		if (entry->x < x || (entry->x == x && entry->y < y))
+			lo = mid+1;
+		else
+			hi = mid;
+	}
+
+	int n = 0;
+	while (lo+n < header->tileCount && toc[lo+n].x == x && toc[lo+n].y == y)
+		n++;
+
+	if (first)
+		*first = n ? &toc[lo] : 0;
+	return n;
+}
+
+/// @par
+///
+/// The tiles are added without the #DT_TILE_FREE_DATA flag and keep their
+/// original references. The data must stay valid, and writable, for as long
+/// as the navigation mesh uses it. Only the polygons and links of a tile are
+/// modified when it is added, so when the set is mapped using #dtMapNavMeshSet
+/// the other pages of the tiles remain shared with the file.
+///
+/// @see #dtStoreNavMeshSet, #dtMapNavMeshSet
+dtStatus dtInitNavMeshFromSet(dtNavMesh* mesh, unsigned char* data, const int dataSize)
+{
+	if (!mesh)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtStatus status = dtValidateNavMeshSet(data, dataSize);
+	if (dtStatusFailed(status))
+		return status;
+
+	const dtNavMeshSetHeader* header = (const dtNavMeshSetHeader*)data;
+	status = mesh->init(&header->params);
+	if (dtStatusFailed(status))
+		return status;
+
+	const dtNavMeshSetTile* toc = (const dtNavMeshSetTile*)(data + dtAlign4(sizeof(dtNavMeshSetHeader)));
+	for (int i = 0; i < header->tileCount; ++i)
+	{
+		const dtNavMeshSetTile* entry = &toc[i];
+		status = mesh->addTile(data + entry->dataOffset, entry->dataSize, 0, entry->tileRef, 0);
+		if (dtStatusFailed(status))
+			return status;
+	}
+
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// The file is mapped copy-on-write: the pages modified by dtNavMesh::addTile()
+/// are private to the process, while the untouched ones are shared with every
+/// other process mapping the same file.
+///
+/// @see #dtUnmapNavMeshSet, #dtInitNavMeshFromSet
+dtStatus dtMapNavMeshSet(const char* path, dtNavMeshSetMapping* mapping)
+{
+	if (!path || !mapping)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	mapping->data = 0;
+	mapping->dataSize = 0;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0 || size.QuadPart > 0x7fffffff)
+	{
+		CloseHandle(file);
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	HANDLE fileMapping = CreateFileMappingA(file, 0, PAGE_WRITECOPY, 0, 0, 0);
+	CloseHandle(file);
+	if (!fileMapping)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	void* view = MapViewOfFile(fileMapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(fileMapping);
+	if (!view)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	const int dataSize = (int)size.QuadPart;
+#else
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0 || st.st_size > 0x7fffffff)
+	{
+		close(fd);
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	void* view = mmap(0, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	const int dataSize = (int)st.st_size;
+#endif
+
+	mapping->data = (unsigned char*)view;
+	mapping->dataSize = dataSize;
+
+	const dtStatus status = dtValidateNavMeshSet(mapping->data, mapping->dataSize);
+	if (dtStatusFailed(status))
+		dtUnmapNavMeshSet(mapping);
+	return status;
+}
+
+/// @par
+///
+/// The navigation meshes initialized from the mapping must be freed first.
+void dtUnmapNavMeshSet(dtNavMeshSetMapping* mapping)
+{
+	if (!mapping || !mapping->data)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(mapping->data);
+#else
+	munmap(mapping->data, (size_t)mapping->dataSize);
+#endif
+	mapping->data = 0;
+	mapping->dataSize = 0;
+}
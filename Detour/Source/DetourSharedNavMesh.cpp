@@ -0,0 +1,256 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include "DetourSharedNavMesh.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+
+
+dtSharedNavMesh::dtSharedNavMesh() :
+	m_pending(1),
+	m_published(0),
+	m_version(0),
+	m_changes(0),
+	m_nchanges(0),
+	m_maxChanges(0)
+{
+	m_readers[0] = 0;
+	m_readers[1] = 0;
+}
+
+dtSharedNavMesh::~dtSharedNavMesh()
+{
+	clearChanges();
+	dtFree(m_changes);
+	m_changes = 0;
+}
+
+dtStatus dtSharedNavMesh::init(const dtNavMeshParams* params)
+{
+	dtStatus status = m_meshes[0].init(params);
+	if (dtStatusFailed(status))
+		return status;
+	return m_meshes[1].init(params);
+}
+
+/// @par
+///
+/// The calls can be nested, and several threads can read at the same time.
+const dtNavMesh* dtSharedNavMesh::beginRead(int* token)
+{
+	for (;;)
+	{
+		const int idx = dtAtomicLoad(&m_published);
+		dtAtomicAdd(&m_readers[idx], 1);
+		// The buffer may have been replaced while registering; it is then
+		// about to be modified, so retry with the new one.
+		if (dtAtomicLoad(&m_published) == idx)
+		{
+			*token = idx;
+			return &m_meshes[idx];
+		}
+		dtAtomicAdd(&m_readers[idx], -1);
+	}
+}
+
+void dtSharedNavMesh::endRead(const int token)
+{
+	dtAssert(token == 0 || token == 1);
+	dtAtomicAdd(&m_readers[token], -1);
+}
+
+int dtSharedNavMesh::getVersion()
+{
+	return dtAtomicLoad(&m_version);
+}
+
+dtStatus dtSharedNavMesh::appendChange(const Change& change)
+{
+	if (m_nchanges >= m_maxChanges)
+	{
+		const int maxChanges = m_maxChanges ? m_maxChanges*2 : 32;
+		Change* changes = (Change*)dtAlloc(sizeof(Change)*maxChanges, DT_ALLOC_PERM);
+		if (!changes)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		if (m_nchanges)
+			memcpy(changes, m_changes, sizeof(Change)*m_nchanges);
+		dtFree(m_changes);
+		m_changes = changes;
+		m_maxChanges = maxChanges;
+	}
+	m_changes[m_nchanges++] = change;
+	return DT_SUCCESS;
+}
+
+void dtSharedNavMesh::clearChanges()
+{
+	for (int i = 0; i < m_nchanges; ++i)
+		dtFree(m_changes[i].data);
+	m_nchanges = 0;
+}
+
+/// @par
+///
+/// The data is copied before being added, because adding a tile writes the
+/// links into its data and the replay needs the original.
+dtStatus dtSharedNavMesh::addTile(unsigned char* data, int dataSize, dtTileRef lastRef, dtTileRef* result)
+{
+	dtScopedLock lock(m_writeLock);
+
+	Change change;
+	memset(&change, 0, sizeof(change));
+	change.type = CHANGE_ADD_TILE;
+	change.data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_PERM);
+	if (!change.data)
+	{
+		dtFree(data);
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memcpy(change.data, data, dataSize);
+	change.dataSize = dataSize;
+
+	dtTileRef ref = 0;
+	dtStatus status = m_meshes[m_pending].addTile(data, dataSize, DT_TILE_FREE_DATA, lastRef, &ref);
+	if (dtStatusFailed(status))
+	{
+		dtFree(data);
+		dtFree(change.data);
+		return status;
+	}
+
+	change.ref = ref;
+	status = appendChange(change);
+	if (dtStatusFailed(status))
+	{
+		// Keep both buffers identical.
+		m_meshes[m_pending].removeTile(ref, 0, 0);
+		dtFree(change.data);
+		return status;
+	}
+
+	if (result)
+		*result = ref;
+	return DT_SUCCESS;
+}
+
+dtStatus dtSharedNavMesh::removeTile(dtTileRef ref)
+{
+	dtScopedLock lock(m_writeLock);
+
+	Change change;
+	memset(&change, 0, sizeof(change));
+	change.type = CHANGE_REMOVE_TILE;
+	change.ref = ref;
+	// Reserve the change first, the removal cannot be undone.
+	dtStatus status = appendChange(change);
+	if (dtStatusFailed(status))
+		return status;
+
+	status = m_meshes[m_pending].removeTile(ref, 0, 0);
+	if (dtStatusFailed(status))
+		m_nchanges--;
+	return status;
+}
+
+dtStatus dtSharedNavMesh::setPolyFlags(dtPolyRef ref, unsigned short flags)
+{
+	dtScopedLock lock(m_writeLock);
+
+	Change change;
+	memset(&change, 0, sizeof(change));
+	change.type = CHANGE_POLY_FLAGS;
+	change.ref = ref;
+	change.flags = flags;
+	dtStatus status = appendChange(change);
+	if (dtStatusFailed(status))
+		return status;
+
+	status = m_meshes[m_pending].setPolyFlags(ref, flags);
+	if (dtStatusFailed(status))
+		m_nchanges--;
+	return status;
+}
+
+dtStatus dtSharedNavMesh::setPolyArea(dtPolyRef ref, unsigned char area)
+{
+	dtScopedLock lock(m_writeLock);
+
+	Change change;
+	memset(&change, 0, sizeof(change));
+	change.type = CHANGE_POLY_AREA;
+	change.ref = ref;
+	change.area = area;
+	dtStatus status = appendChange(change);
+	if (dtStatusFailed(status))
+		return status;
+
+	status = m_meshes[m_pending].setPolyArea(ref, area);
+	if (dtStatusFailed(status))
+		m_nchanges--;
+	return status;
+}
+
+dtStatus dtSharedNavMesh::publish()
+{
+	dtScopedLock lock(m_writeLock);
+
+	if (!m_nchanges)
+		return DT_SUCCESS;
+
+	const int previous = 1 - m_pending;
+	dtAtomicStore(&m_published, m_pending);
+	dtAtomicAdd(&m_version, 1);
+	m_pending = previous;
+
+	// Wait for the readers of the previous version to leave it.
+	while (dtAtomicLoad(&m_readers[previous]) != 0)
+		dtThreadYield();
+
+	// Bring the previous version up to date.
+	dtNavMesh& mesh = m_meshes[previous];
+	dtStatus status = DT_SUCCESS;
+	for (int i = 0; i < m_nchanges; ++i)
+	{
+		Change& change = m_changes[i];
+		dtStatus changeStatus = DT_SUCCESS;
+		switch (change.type)
+		{
+		case CHANGE_ADD_TILE:
+			changeStatus = mesh.addTile(change.data, change.dataSize, DT_TILE_FREE_DATA, change.ref, 0);
+			if (dtStatusSucceed(changeStatus))
+				change.data = 0;
+			break;
+		case CHANGE_REMOVE_TILE:
+			changeStatus = mesh.removeTile(change.ref, 0, 0);
+			break;
+		case CHANGE_POLY_FLAGS:
+			changeStatus = mesh.setPolyFlags(change.ref, change.flags);
+			break;
+		case CHANGE_POLY_AREA:
+			changeStatus = mesh.setPolyArea(change.ref, change.area);
+			break;
+		}
+		status |= changeStatus;
+	}
+	clearChanges();
+
+	// Both buffers received the same changes, a failure here means they diverged.
+	dtAssert(!dtStatusFailed(status));
+	return status;
+}
@@ -0,0 +1,472 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourThread.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#endif
+
+
+struct dtThreadImpl
+{
+	dtThreadFunc* func;
+	void* arg;
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+};
+
+#ifdef _WIN32
+
+dtTimeVal dtGetPerfTime()
+{
+	__int64 count;
+	QueryPerformanceCounter((LARGE_INTEGER*)&count);
+	return count;
+}
+
+int dtGetPerfDeltaTimeUsec(const dtTimeVal start, const dtTimeVal end)
+{
+	static __int64 freq = 0;
+	if (freq == 0)
+		QueryPerformanceFrequency((LARGE_INTEGER*)&freq);
+	__int64 elapsed = end - start;
+	return (int)(elapsed*1000000 / freq);
+}
+
+int dtAtomicAdd(volatile int* value, const int delta)
+{
+	return (int)InterlockedExchangeAdd((volatile LONG*)value, (LONG)delta) + delta;
+}
+
+int dtAtomicLoad(volatile int* value)
+{
+	return (int)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+void dtAtomicStore(volatile int* value, const int v)
+{
+	InterlockedExchange((volatile LONG*)value, (LONG)v);
+}
+
+void dtThreadYield()
+{
+	SwitchToThread();
+}
+
+dtMutex::dtMutex()
+{
+	CRITICAL_SECTION* cs = (CRITICAL_SECTION*)dtAlloc(sizeof(CRITICAL_SECTION), DT_ALLOC_PERM);
+	dtAssert(cs);
+	InitializeCriticalSection(cs);
+	m_impl = cs;
+}
+
+dtMutex::~dtMutex()
+{
+	DeleteCriticalSection((CRITICAL_SECTION*)m_impl);
+	dtFree(m_impl);
+}
+
+void dtMutex::lock()
+{
+	EnterCriticalSection((CRITICAL_SECTION*)m_impl);
+}
+
+void dtMutex::unlock()
+{
+	LeaveCriticalSection((CRITICAL_SECTION*)m_impl);
+}
+
+dtCondition::dtCondition()
+{
+	CONDITION_VARIABLE* cv = (CONDITION_VARIABLE*)dtAlloc(sizeof(CONDITION_VARIABLE), DT_ALLOC_PERM);
+	dtAssert(cv);
+	InitializeConditionVariable(cv);
+	m_impl = cv;
+}
+
+dtCondition::~dtCondition()
+{
+	dtFree(m_impl);
+}
+
+void dtCondition::wait(dtMutex& mutex)
+{
+	SleepConditionVariableCS((CONDITION_VARIABLE*)m_impl, (CRITICAL_SECTION*)mutex.m_impl, INFINITE);
+}
+
+void dtCondition::signal()
+{
+	WakeConditionVariable((CONDITION_VARIABLE*)m_impl);
+}
+
+void dtCondition::broadcast()
+{
+	WakeAllConditionVariable((CONDITION_VARIABLE*)m_impl);
+}
+
+static DWORD WINAPI threadEntry(LPVOID param)
+{
+	dtThreadImpl* impl = (dtThreadImpl*)param;
+	impl->func(impl->arg);
+	return 0;
+}
+
+bool dtThread::start(dtThreadFunc* func, void* arg)
+{
+	if (m_impl)
+		return false;
+	dtThreadImpl* impl = (dtThreadImpl*)dtAlloc(sizeof(dtThreadImpl), DT_ALLOC_PERM);
+	if (!impl)
+		return false;
+	impl->func = func;
+	impl->arg = arg;
+	impl->handle = CreateThread(0, 0, threadEntry, impl, 0, 0);
+	if (!impl->handle)
+	{
+		dtFree(impl);
+		return false;
+	}
+	m_impl = impl;
+	return true;
+}
+
+void dtThread::join()
+{
+	if (!m_impl)
+		return;
+	dtThreadImpl* impl = (dtThreadImpl*)m_impl;
+	WaitForSingleObject(impl->handle, INFINITE);
+	CloseHandle(impl->handle);
+	dtFree(impl);
+	m_impl = 0;
+}
+
+#else
+
+// Linux, BSD, OSX
+
+dtTimeVal dtGetPerfTime()
+{
+	timeval now;
+	gettimeofday(&now, 0);
+	return (dtTimeVal)now.tv_sec*1000000L + (dtTimeVal)now.tv_usec;
+}
+
+int dtGetPerfDeltaTimeUsec(const dtTimeVal start, const dtTimeVal end)
+{
+	return (int)(end - start);
+}
+
+int dtAtomicAdd(volatile int* value, const int delta)
+{
+	return __sync_add_and_fetch(value, delta);
+}
+
+// The loads and stores must be atomic operations, not plain accesses between
+// fences, so that they are sequentially consistent with dtAtomicAdd.
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+
+int dtAtomicLoad(volatile int* value)
+{
+	return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+void dtAtomicStore(volatile int* value, const int v)
+{
+	__atomic_store_n(value, v, __ATOMIC_SEQ_CST);
+}
+
+#else
+
+int dtAtomicLoad(volatile int* value)
+{
+	return __sync_fetch_and_add(value, 0);
+}
+
+void dtAtomicStore(volatile int* value, const int v)
+{
+	// The exchange is only an acquire barrier.
+	__sync_synchronize();
+	__sync_lock_test_and_set(value, v);
+	__sync_synchronize();
+}
+
+#endif
+
+void dtThreadYield()
+{
+	sched_yield();
+}
+
+dtMutex::dtMutex()
+{
+	pthread_mutex_t* mutex = (pthread_mutex_t*)dtAlloc(sizeof(pthread_mutex_t), DT_ALLOC_PERM);
+	dtAssert(mutex);
+	pthread_mutex_init(mutex, 0);
+	m_impl = mutex;
+}
+
+dtMutex::~dtMutex()
+{
+	pthread_mutex_destroy((pthread_mutex_t*)m_impl);
+	dtFree(m_impl);
+}
+
+void dtMutex::lock()
+{
+	pthread_mutex_lock((pthread_mutex_t*)m_impl);
+}
+
+void dtMutex::unlock()
+{
+	pthread_mutex_unlock((pthread_mutex_t*)m_impl);
+}
+
+dtCondition::dtCondition()
+{
+	pthread_cond_t* cond = (pthread_cond_t*)dtAlloc(sizeof(pthread_cond_t), DT_ALLOC_PERM);
+	dtAssert(cond);
+	pthread_cond_init(cond, 0);
+	m_impl = cond;
+}
+
+dtCondition::~dtCondition()
+{
+	pthread_cond_destroy((pthread_cond_t*)m_impl);
+	dtFree(m_impl);
+}
+
+void dtCondition::wait(dtMutex& mutex)
+{
+	pthread_cond_wait((pthread_cond_t*)m_impl, (pthread_mutex_t*)mutex.m_impl);
+}
+
+void dtCondition::signal()
+{
+	pthread_cond_signal((pthread_cond_t*)m_impl);
+}
+
+void dtCondition::broadcast()
+{
+	pthread_cond_broadcast((pthread_cond_t*)m_impl);
+}
+
+static void* threadEntry(void* param)
+{
+	dtThreadImpl* impl = (dtThreadImpl*)param;
+	impl->func(impl->arg);
+	return 0;
+}
+
+bool dtThread::start(dtThreadFunc* func, void* arg)
+{
+	if (m_impl)
+		return false;
+	dtThreadImpl* impl = (dtThreadImpl*)dtAlloc(sizeof(dtThreadImpl), DT_ALLOC_PERM);
+	if (!impl)
+		return false;
+	impl->func = func;
+	impl->arg = arg;
+	if (pthread_create(&impl->handle, 0, threadEntry, impl) != 0)
+	{
+		dtFree(impl);
+		return false;
+	}
+	m_impl = impl;
+	return true;
+}
+
+void dtThread::join()
+{
+	if (!m_impl)
+		return;
+	dtThreadImpl* impl = (dtThreadImpl*)m_impl;
+	pthread_join(impl->handle, 0);
+	dtFree(impl);
+	m_impl = 0;
+}
+
+#endif
+
+dtThread::dtThread() :
+	m_impl(0)
+{
+}
+
+dtThread::~dtThread()
+{
+	join();
+}
+
+dtThreadPool::dtThreadPool() :
+	m_threads(0),
+	m_workers(0),
+	m_nthreads(0),
+	m_generation(0),
+	m_active(0),
+	m_stop(false),
+	m_func(0),
+	m_arg(0),
+	m_count(0),
+	m_next(0)
+{
+}
+
+dtThreadPool::~dtThreadPool()
+{
+	destroy();
+}
+
+bool dtThreadPool::init(const int workerCount)
+{
+	destroy();
+
+	const int nthreads = workerCount-1;
+	if (nthreads <= 0)
+		return nthreads == 0;
+
+	m_threads = (dtThread*)dtAlloc(sizeof(dtThread)*nthreads, DT_ALLOC_PERM);
+	m_workers = (Worker*)dtAlloc(sizeof(Worker)*nthreads, DT_ALLOC_PERM);
+	if (!m_threads || !m_workers)
+	{
+		dtFree(m_threads);
+		dtFree(m_workers);
+		m_threads = 0;
+		m_workers = 0;
+		return false;
+	}
+
+	m_stop = false;
+	for (m_nthreads = 0; m_nthreads < nthreads; ++m_nthreads)
+	{
+		Worker* worker = &m_workers[m_nthreads];
+		worker->pool = this;
+		worker->index = m_nthreads+1;
+		dtThread* thread = new(&m_threads[m_nthreads]) dtThread;
+		if (!thread->start(threadMain, worker))
+		{
+			thread->~dtThread();
+			break;
+		}
+	}
+
+	return m_nthreads == nthreads;
+}
+
+void dtThreadPool::destroy()
+{
+	if (!m_threads)
+		return;
+
+	m_mutex.lock();
+	m_stop = true;
+	m_start.broadcast();
+	m_mutex.unlock();
+
+	for (int i = 0; i < m_nthreads; ++i)
+		m_threads[i].~dtThread();
+
+	dtFree(m_threads);
+	dtFree(m_workers);
+	m_threads = 0;
+	m_workers = 0;
+	m_nthreads = 0;
+}
+
+void dtThreadPool::threadMain(void* arg)
+{
+	Worker* worker = (Worker*)arg;
+	dtThreadPool* pool = worker->pool;
+	int generation = 0;
+
+	pool->m_mutex.lock();
+	for (;;)
+	{
+		while (!pool->m_stop && pool->m_generation == generation)
+			pool->m_start.wait(pool->m_mutex);
+		if (pool->m_stop)
+			break;
+		generation = pool->m_generation;
+
+		pool->m_mutex.unlock();
+		pool->work(worker->index);
+		pool->m_mutex.lock();
+
+		if (--pool->m_active == 0)
+			pool->m_done.signal();
+	}
+	pool->m_mutex.unlock();
+}
+
+void dtThreadPool::work(const int worker)
+{
+	for (;;)
+	{
+		const int i = dtAtomicAdd(&m_next, 1) - 1;
+		if (i >= m_count)
+			break;
+		m_func(m_arg, i, worker);
+	}
+}
+
+/// @par
+///
+/// Every thread of the pool takes part in each loop, so a loop can only start
+/// once the previous one is completely done.
+void dtThreadPool::parallelFor(dtParallelForFunc* func, void* arg, const int count)
+{
+	if (count <= 0)
+		return;
+
+	if (m_nthreads == 0 || count == 1)
+	{
+		for (int i = 0; i < count; ++i)
+			func(arg, i, 0);
+		return;
+	}
+
+	m_mutex.lock();
+	m_func = func;
+	m_arg = arg;
+	m_count = count;
+	dtAtomicStore(&m_next, 0);
+	m_active = m_nthreads;
+	m_generation++;
+	m_start.broadcast();
+	m_mutex.unlock();
+
+	work(0);
+
+	m_mutex.lock();
+	while (m_active > 0)
+		m_done.wait(m_mutex);
+	m_mutex.unlock();
+}
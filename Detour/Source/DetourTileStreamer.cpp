@@ -0,0 +1,613 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "DetourTileStreamer.h"
+#include "DetourNavMeshSet.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+
+
+inline int computeTileHash(int x, int y, const int mask)
+{
+	const unsigned int h1 = 0x8da6b343; // Large multiplicative constants;
+	const unsigned int h2 = 0xd8163841; // here arbitrarily chosen primes
+	unsigned int n = h1 * x + h2 * y;
+	return (int)(n & mask);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+dtNavMeshSetStreamSource::dtNavMeshSetStreamSource() :
+	m_fp(0),
+	m_toc(0)
+{
+}
+
+dtNavMeshSetStreamSource::~dtNavMeshSetStreamSource()
+{
+	if (m_fp)
+		fclose(m_fp);
+	dtFree(m_toc);
+}
+
+dtStatus dtNavMeshSetStreamSource::init(const char* path)
+{
+	if (m_fp)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_fp = fopen(path, "rb");
+	if (!m_fp)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtStatus status = readToc();
+	if (dtStatusFailed(status))
+	{
+		fclose(m_fp);
+		m_fp = 0;
+		dtFree(m_toc);
+		m_toc = 0;
+	}
+	return status;
+}
+
+dtStatus dtNavMeshSetStreamSource::readToc()
+{
+	dtNavMeshSetHeader header;
+	if (fread(&header, sizeof(header), 1, m_fp) != 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (header.magic != DT_NAVMESHSET_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (header.version != DT_NAVMESHSET_VERSION)
+		return DT_FAILURE | DT_WRONG_VERSION;
+
+	// The table of contents must fit in the file.
+	if (fseek(m_fp, 0, SEEK_END) != 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	const long fileSize = ftell(m_fp);
+	const long headerSize = dtAlign4(sizeof(dtNavMeshSetHeader));
+	if (fileSize < headerSize || header.tileCount < 0 ||
+		header.tileCount > (fileSize - headerSize) / (long)sizeof(dtNavMeshSetTile))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	// Keep the header and the table of contents in memory, the tiles are read on demand.
+	const int tocSize = (int)headerSize + dtAlign4(sizeof(dtNavMeshSetTile)*header.tileCount);
+	m_toc = (unsigned char*)dtAlloc(tocSize, DT_ALLOC_PERM);
+	if (!m_toc)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	if (fseek(m_fp, 0, SEEK_SET) != 0 || fread(m_toc, tocSize, 1, m_fp) != 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	// The entries are used to allocate and read the tiles, and must be sorted for the lookups.
+	const int setSize = fileSize > 0x7fffffffL ? 0x7fffffff : (int)fileSize;
+	return dtValidateNavMeshSetToc(m_toc, tocSize, setSize);
+}
+
+const dtNavMeshParams* dtNavMeshSetStreamSource::getParams() const
+{
+	if (!m_toc)
+		return 0;
+	return &((const dtNavMeshSetHeader*)m_toc)->params;
+}
+
+int dtNavMeshSetStreamSource::loadTiles(const int tx, const int ty, dtTileStreamData* tiles, const int maxTiles)
+{
+	if (!m_toc)
+		return 0;
+
+	const dtNavMeshSetTile* entries = 0;
+	const int nentries = dtFindNavMeshSetTilesAt(m_toc, tx, ty, &entries);
+
+	int n = 0;
+	for (int i = 0; i < nentries && n < maxTiles; ++i)
+	{
+		const dtNavMeshSetTile* entry = &entries[i];
+		unsigned char* data = (unsigned char*)dtAlloc(entry->dataSize, DT_ALLOC_PERM);
+		if (!data)
+			break;
+		if (fseek(m_fp, entry->dataOffset, SEEK_SET) != 0 || fread(data, entry->dataSize, 1, m_fp) != 1)
+		{
+			dtFree(data);
+			continue;
+		}
+		tiles[n].data = data;
+		tiles[n].dataSize = entry->dataSize;
+		n++;
+	}
+	return n;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+dtTileStreamer::dtTileStreamer() :
+	m_navmesh(0),
+	m_source(0),
+	m_focus(0),
+	m_nfocus(0),
+	m_lutMask(0),
+	m_posLookup(0),
+	m_columns(0),
+	m_nextFree(0),
+	m_queue(0),
+	m_nqueue(0),
+	m_owned(0),
+	m_nowned(0),
+	m_stop(false)
+{
+	memset(&m_params, 0, sizeof(m_params));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+dtTileStreamer::~dtTileStreamer()
+{
+	if (m_thread.isRunning())
+	{
+		m_mutex.lock();
+		m_stop = true;
+		m_wakeup.broadcast();
+		m_mutex.unlock();
+		m_thread.join();
+	}
+
+	// The committed tiles belong to the navigation mesh, only release the pending ones.
+	if (m_columns)
+	{
+		for (int i = 0; i < m_params.maxColumns; ++i)
+			releaseTiles(&m_columns[i]);
+	}
+
+	dtFree(m_focus);
+	dtFree(m_posLookup);
+	dtFree(m_columns);
+	dtFree(m_queue);
+	dtFree(m_owned);
+}
+
+dtStatus dtTileStreamer::init(const dtTileStreamerParams* params, dtNavMesh* navmesh, dtTileStreamSource* source)
+{
+	if (!params || !navmesh || !source || m_columns)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (params->maxColumns <= 0 || params->maxFocusPoints <= 0 || params->loadRadius <= 0 ||
+		params->evictRadius < params->loadRadius)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	memcpy(&m_params, params, sizeof(m_params));
+	m_navmesh = navmesh;
+	m_source = source;
+
+	m_focus = (float*)dtAlloc(sizeof(float)*3*m_params.maxFocusPoints, DT_ALLOC_PERM);
+	if (!m_focus)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_nfocus = 0;
+
+	int lutSize = dtNextPow2(m_params.maxColumns/4);
+	if (!lutSize) lutSize = 1;
+	m_lutMask = lutSize-1;
+	m_posLookup = (Column**)dtAlloc(sizeof(Column*)*lutSize, DT_ALLOC_PERM);
+	if (!m_posLookup)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_posLookup, 0, sizeof(Column*)*lutSize);
+
+	m_columns = (Column*)dtAlloc(sizeof(Column)*m_params.maxColumns, DT_ALLOC_PERM);
+	if (!m_columns)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_columns, 0, sizeof(Column)*m_params.maxColumns);
+	m_nextFree = 0;
+	for (int i = m_params.maxColumns-1; i >= 0; --i)
+	{
+		m_columns[i].next = m_nextFree;
+		m_nextFree = &m_columns[i];
+	}
+
+	m_queue = (int*)dtAlloc(sizeof(int)*m_params.maxColumns, DT_ALLOC_PERM);
+	if (!m_queue)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_nqueue = 0;
+
+	m_owned = (int*)dtAlloc(sizeof(int)*m_params.maxColumns, DT_ALLOC_PERM);
+	if (!m_owned)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_nowned = 0;
+
+	if (m_params.backgroundIO)
+	{
+		m_stop = false;
+		if (!m_thread.start(ioThreadMain, this))
+			return DT_FAILURE;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileStreamer::setFocusPoints(const float* pos, const int count)
+{
+	if (count < 0 || count > m_params.maxFocusPoints)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	memcpy(m_focus, pos, sizeof(float)*3*count);
+	m_nfocus = count;
+	return DT_SUCCESS;
+}
+
+void dtTileStreamer::ioThreadMain(void* arg)
+{
+	dtTileStreamer* streamer = (dtTileStreamer*)arg;
+
+	streamer->m_mutex.lock();
+	while (!streamer->m_stop)
+	{
+		if (!streamer->m_nqueue)
+		{
+			streamer->m_wakeup.wait(streamer->m_mutex);
+			continue;
+		}
+		streamer->m_mutex.unlock();
+		streamer->loadNext();
+		streamer->m_mutex.lock();
+	}
+	streamer->m_mutex.unlock();
+}
+
+/// Loads the nearest queued column. The source is called without holding the lock.
+dtTileStreamer::Column* dtTileStreamer::loadNext()
+{
+	Column* col = 0;
+	int tx, ty;
+	{
+		dtScopedLock lock(m_mutex);
+		if (!m_nqueue)
+			return 0;
+		int best = 0;
+		for (int i = 1; i < m_nqueue; ++i)
+		{
+			if (m_columns[m_queue[i]].dist < m_columns[m_queue[best]].dist)
+				best = i;
+		}
+		col = &m_columns[m_queue[best]];
+		m_queue[best] = m_queue[--m_nqueue];
+		col->state = COLUMN_LOADING;
+		tx = col->tx;
+		ty = col->ty;
+	}
+
+	dtTileStreamData tiles[DT_TILESTREAM_MAX_LAYERS];
+	const int nloaded = m_source->loadTiles(tx, ty, tiles, DT_TILESTREAM_MAX_LAYERS);
+
+	// Drop the tiles which cannot be added to the navigation mesh.
+	int ntiles = 0;
+	for (int i = 0; i < nloaded; ++i)
+	{
+		const dtMeshHeader* header = (const dtMeshHeader*)tiles[i].data;
+		if (tiles[i].dataSize < (int)sizeof(dtMeshHeader) ||
+			header->magic != DT_NAVMESH_MAGIC || header->version != DT_NAVMESH_VERSION ||
+			header->x != tx || header->y != ty)
+		{
+			dtFree(tiles[i].data);
+			continue;
+		}
+		tiles[ntiles++] = tiles[i];
+	}
+
+	dtScopedLock lock(m_mutex);
+	memcpy(col->tiles, tiles, sizeof(dtTileStreamData)*ntiles);
+	col->ntiles = (unsigned char)ntiles;
+	col->ncommitted = 0;
+	col->state = COLUMN_LOADED;
+	return col;
+}
+
+dtTileStreamer::Column* dtTileStreamer::findColumn(const int tx, const int ty)
+{
+	Column* col = m_posLookup[computeTileHash(tx, ty, m_lutMask)];
+	while (col)
+	{
+		if (col->tx == tx && col->ty == ty)
+			return col;
+		col = col->next;
+	}
+	return 0;
+}
+
+dtTileStreamer::Column* dtTileStreamer::allocColumn(const int tx, const int ty)
+{
+	Column* col = m_nextFree;
+	if (!col)
+		return 0;
+	m_nextFree = col->next;
+
+	memset(col, 0, sizeof(Column));
+	col->tx = tx;
+	col->ty = ty;
+
+	const int h = computeTileHash(tx, ty, m_lutMask);
+	col->next = m_posLookup[h];
+	m_posLookup[h] = col;
+
+	return col;
+}
+
+void dtTileStreamer::freeColumn(Column* col)
+{
+	const int h = computeTileHash(col->tx, col->ty, m_lutMask);
+	Column* prev = 0;
+	Column* cur = m_posLookup[h];
+	while (cur)
+	{
+		if (cur == col)
+		{
+			if (prev)
+				prev->next = cur->next;
+			else
+				m_posLookup[h] = cur->next;
+			break;
+		}
+		prev = cur;
+		cur = cur->next;
+	}
+
+	col->state = COLUMN_EMPTY;
+	col->ntiles = 0;
+	col->ncommitted = 0;
+	col->next = m_nextFree;
+	m_nextFree = col;
+}
+
+void dtTileStreamer::dequeue(Column* col)
+{
+	const int idx = (int)(col - m_columns);
+	for (int i = 0; i < m_nqueue; ++i)
+	{
+		if (m_queue[i] == idx)
+		{
+			m_queue[i] = m_queue[--m_nqueue];
+			return;
+		}
+	}
+}
+
+float dtTileStreamer::getFocusDistance(const int tx, const int ty) const
+{
+	const dtNavMeshParams* params = m_navmesh->getParams();
+	const float minx = params->orig[0] + tx*params->tileWidth;
+	const float minz = params->orig[2] + ty*params->tileHeight;
+	const float maxx = minx + params->tileWidth;
+	const float maxz = minz + params->tileHeight;
+
+	float best = FLT_MAX;
+	for (int i = 0; i < m_nfocus; ++i)
+	{
+		const float* p = &m_focus[i*3];
+		const float dx = p[0] < minx ? minx-p[0] : (p[0] > maxx ? p[0]-maxx : 0.0f);
+		const float dz = p[2] < minz ? minz-p[2] : (p[2] > maxz ? p[2]-maxz : 0.0f);
+		best = dtMin(best, dx*dx + dz*dz);
+	}
+	return best == FLT_MAX ? FLT_MAX : sqrtf(best);
+}
+
+void dtTileStreamer::releaseTiles(Column* col)
+{
+	for (int i = col->ncommitted; i < col->ntiles; ++i)
+	{
+		dtFree(col->tiles[i].data);
+		col->tiles[i].data = 0;
+	}
+	col->ntiles = col->ncommitted;
+}
+
+/// @par
+///
+/// The columns are handled in three steps:
+/// -# The missing columns around the focus points are queued for loading, and the queued
+///    or loaded columns which went out of range are dropped.
+/// -# The committed columns farther than dtTileStreamerParams::evictRadius are removed
+///    from the navigation mesh.
+/// -# The loaded columns are added to the navigation mesh, nearest first.
+///
+/// The last two steps stop as soon as the time budget is exhausted, the remaining work
+/// is carried over to the next update.
+dtStatus dtTileStreamer::update(const int budgetUsec)
+{
+	if (!m_columns)
+		return DT_FAILURE;
+
+	const dtTimeVal startTime = dtGetPerfTime();
+	dtStatus status = DT_SUCCESS;
+
+	m_stats.addedTiles = 0;
+	m_stats.removedTiles = 0;
+
+	{
+		dtScopedLock lock(m_mutex);
+
+		// Update priorities and drop the pending columns which went out of range.
+		// The loaded columns are taken over by the main thread.
+		m_nowned = 0;
+		for (int i = 0; i < m_params.maxColumns; ++i)
+		{
+			Column* col = &m_columns[i];
+			if (col->state == COLUMN_EMPTY || col->state == COLUMN_LOADING)
+				continue;
+			if (col->state == COLUMN_LOADED)
+				col->state = COLUMN_READY;
+			col->dist = getFocusDistance(col->tx, col->ty);
+			if (col->dist > m_params.evictRadius)
+			{
+				if (col->state == COLUMN_QUEUED)
+				{
+					dequeue(col);
+					freeColumn(col);
+					continue;
+				}
+				if (col->state == COLUMN_READY && col->ncommitted == 0)
+				{
+					releaseTiles(col);
+					freeColumn(col);
+					continue;
+				}
+			}
+			if (col->state != COLUMN_QUEUED)
+				m_owned[m_nowned++] = i;
+		}
+
+		// Queue the missing columns.
+		const dtNavMeshParams* params = m_navmesh->getParams();
+		for (int i = 0; i < m_nfocus; ++i)
+		{
+			const float* p = &m_focus[i*3];
+			const int tx0 = (int)floorf((p[0]-m_params.loadRadius-params->orig[0]) / params->tileWidth);
+			const int tx1 = (int)floorf((p[0]+m_params.loadRadius-params->orig[0]) / params->tileWidth);
+			const int ty0 = (int)floorf((p[2]-m_params.loadRadius-params->orig[2]) / params->tileHeight);
+			const int ty1 = (int)floorf((p[2]+m_params.loadRadius-params->orig[2]) / params->tileHeight);
+			for (int ty = ty0; ty <= ty1; ++ty)
+			{
+				for (int tx = tx0; tx <= tx1; ++tx)
+				{
+					if (findColumn(tx, ty))
+						continue;
+					const float dist = getFocusDistance(tx, ty);
+					if (dist > m_params.loadRadius)
+						continue;
+					Column* col = allocColumn(tx, ty);
+					if (!col)
+					{
+						// Give the column of a farther queued one to this one.
+						status |= DT_BUFFER_TOO_SMALL;
+						Column* farthest = 0;
+						for (int j = 0; j < m_nqueue; ++j)
+						{
+							Column* queued = &m_columns[m_queue[j]];
+							if (queued->dist > dist && (!farthest || queued->dist > farthest->dist))
+								farthest = queued;
+						}
+						if (!farthest)
+							continue;
+						dequeue(farthest);
+						freeColumn(farthest);
+						col = allocColumn(tx, ty);
+					}
+					col->dist = dist;
+					col->state = COLUMN_QUEUED;
+					m_queue[m_nqueue++] = (int)(col - m_columns);
+				}
+			}
+		}
+
+		if (m_nqueue && m_thread.isRunning())
+			m_wakeup.signal();
+	}
+
+	// From here on, only the columns owned by the main thread are accessed without locking.
+	// The loader may be writing the state of the other ones.
+	bool worked = false;
+
+	// Evict the distant columns.
+	for (int i = 0; i < m_nowned; ++i)
+	{
+		if (worked && dtGetPerfDeltaTimeUsec(startTime, dtGetPerfTime()) >= budgetUsec)
+			break;
+		Column* col = &m_columns[m_owned[i]];
+		if (col->dist <= m_params.evictRadius)
+			continue;
+		for (int j = 0; j < col->ncommitted; ++j)
+		{
+			if (!col->refs[j])
+				continue;
+			m_navmesh->removeTile(col->refs[j], 0, 0);
+			m_stats.removedTiles++;
+		}
+		col->ncommitted = 0;
+		releaseTiles(col);
+		freeColumn(col);
+		m_owned[i--] = m_owned[--m_nowned];
+		worked = true;
+	}
+
+	// Load synchronously when there is no background thread.
+	if (!m_thread.isRunning())
+	{
+		while (!worked || dtGetPerfDeltaTimeUsec(startTime, dtGetPerfTime()) < budgetUsec)
+		{
+			Column* col = loadNext();
+			if (!col)
+				break;
+			col->state = COLUMN_READY;
+			m_owned[m_nowned++] = (int)(col - m_columns);
+			worked = true;
+		}
+	}
+
+	// Commit the loaded columns, nearest first.
+	while (!worked || dtGetPerfDeltaTimeUsec(startTime, dtGetPerfTime()) < budgetUsec)
+	{
+		Column* best = 0;
+		for (int i = 0; i < m_nowned; ++i)
+		{
+			Column* col = &m_columns[m_owned[i]];
+			if (col->state == COLUMN_READY && (!best || col->dist < best->dist))
+				best = col;
+		}
+		if (!best)
+			break;
+
+		if (best->ncommitted < best->ntiles)
+		{
+			const int j = best->ncommitted;
+			dtTileStreamData* tile = &best->tiles[j];
+			dtTileRef ref = 0;
+			dtStatus addStatus = m_navmesh->addTile(tile->data, tile->dataSize, DT_TILE_FREE_DATA, 0, &ref);
+			if (dtStatusFailed(addStatus))
+			{
+				dtFree(tile->data);
+				ref = 0;
+				status |= addStatus & DT_STATUS_DETAIL_MASK;
+			}
+			else
+			{
+				m_stats.addedTiles++;
+			}
+			tile->data = 0;
+			best->refs[j] = ref;
+			best->ncommitted++;
+		}
+		if (best->ncommitted == best->ntiles)
+			best->state = COLUMN_COMMITTED;
+		worked = true;
+	}
+
+	// Gather statistics.
+	m_stats.queuedColumns = 0;
+	m_stats.loadedColumns = 0;
+	m_stats.committedColumns = 0;
+	{
+		dtScopedLock lock(m_mutex);
+		m_stats.queuedColumns = m_nqueue;
+		for (int i = 0; i < m_params.maxColumns; ++i)
+		{
+			const unsigned char state = m_columns[i].state;
+			if (state == COLUMN_LOADED || state == COLUMN_READY)
+				m_stats.loadedColumns++;
+			else if (state == COLUMN_COMMITTED && m_columns[i].ntiles > 0)
+				m_stats.committedColumns++;
+		}
+	}
+	m_stats.updateTimeUsec = dtGetPerfDeltaTimeUsec(startTime, dtGetPerfTime());
+
+	return status;
+}
@@ -37,6 +37,19 @@ public:
 	/// @param[out]	newAgent	The agent storing the updated version of the oldAgent.
 	/// @param[in]	dt			The time, in seconds, to update the simulation. [Limit: > 0, otherwise strange things can happen (undefined behavior)]
 	virtual void update(const dtCrowdQuery& query, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, float dt) = 0;
+
+	/// Updates all the agents of the crowd using this behavior, each agent storing its own updated data.
+	///
+	/// The crowd calls it once per behavior and per update. By default the agents are updated one by one
+	/// using #update, behaviors able to share work between their agents can override it.
+	/// The behaviors are updated one after the other, so the agents of this behavior are not updated
+	/// in between the agents of the other behaviors. (See: dtCrowd::updateVelocity)
+	///
+	/// @param[in]		query		The crowd query object used to access elements of the crowd (agents, navmesh, etc.)
+	/// @param[in,out]	agents		The agents to update.
+	/// @param[in]		nbAgents	The number of agents to update.
+	/// @param[in]		dt			The time, in seconds, to update the simulation. [Limit: > 0]
+	virtual void updateBatch(const dtCrowdQuery& query, dtCrowdAgent* const* agents, unsigned nbAgents, float dt);
 };
 
 #endif
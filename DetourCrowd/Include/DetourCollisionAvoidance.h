@@ -144,6 +144,15 @@ public:
 	/// @return True if the initialization succeeded.
 	bool init();
 
+	/// Initializes the behavior for the given crowd.
+	///
+	/// Every neighbor of an agent is a circle obstacle, so #maximumCircleObstaclesCount is raised
+	/// to the maximum number of neighbors of the crowd. (See: dtCrowd::init)
+	///
+	/// @param[in]	query	The crowd query object of the crowd using the behavior.
+	/// @return True if the initialization succeeded.
+	bool init(const dtCrowdQuery& query);
+
 	/// Cleans the behavior.
 	void purge();
 	
@@ -155,6 +164,9 @@ public:
     /// The maximum number of circle obstacles (i.e. only agents at the moment) that
     /// can be taken into account by the avoidance algorithm
     ///
+    /// The circles are the neighbors of the agent, nearest first, so a crowd keeping more
+    /// neighbors than this only helps the avoidance once it is raised. (See: #init(const dtCrowdQuery&))
+    ///
     /// @remark Default value is 6.
     unsigned maximumCircleObstaclesCount;
     
@@ -166,6 +178,9 @@ public:
     
     /// Resize the container for obstacles according to the set sizes.
     bool resizeObstaclesContainer();
+
+    /// Gets the number of circle obstacles taken into account by the last update.
+    unsigned getCircleObstaclesCount() const { return m_circlesCount; }
     //@}
     
     /// @name Velocity samples generation parameters
@@ -28,12 +28,35 @@ class dtObstacleAvoidanceDebugData;
 class dtPathFollowing;
 
 
-/// The maximum number of neighbors that a crowd agent can take into account
-/// for steering decisions.
+/// The default maximum number of neighbors that a crowd agent can take into account
+/// for steering decisions. (See: dtCrowd::init)
 /// @ingroup crowd
 static const int DT_CROWDAGENT_MAX_NEIGHBOURS = 6;
 
 
+/// The number of bins of a #dtCrowdWorkHistogram.
+/// @ingroup crowd
+static const int DT_CROWD_WORK_HISTOGRAM_SIZE = 16;
+
+/// Counts the updates of the crowd according to the number of times they ran a periodic task.
+///
+/// When the agents run the task in lockstep, most updates run it zero times and a few run it
+/// for many agents at once. Spreading the task moves the updates toward the first bins.
+/// @ingroup crowd
+struct dtCrowdWorkHistogram
+{
+	unsigned updates[DT_CROWD_WORK_HISTOGRAM_SIZE];	///< The number of updates by number of tasks run. (The last bin also counts the larger numbers.)
+	unsigned maxTasks;								///< The largest number of tasks run during a single update.
+	unsigned totalTasks;							///< The number of tasks run during all the updates.
+
+	/// Empties the histogram.
+	void reset();
+
+	/// Records an update.
+	///  @param[in]	tasks	The number of tasks run during the update.
+	void add(unsigned tasks);
+};
+
 /// Provides neighbor data for agents managed by the crowd.
 /// @ingroup crowd
 /// @see dtCrowdAgent::neis, dtCrowd
@@ -64,9 +87,10 @@ struct dtCrowdAgentEnvironment
 	explicit dtCrowdAgentEnvironment();
 	~dtCrowdAgentEnvironment();
 
-	dtLocalBoundary boundary;									///< The local boundary data for the agent.
-	dtCrowdNeighbour neighbors[DT_CROWDAGENT_MAX_NEIGHBOURS];	///< The known neighbors of the agent.
-	unsigned nbNeighbors;										///< The number of neighbors.
+	dtLocalBoundary boundary;		///< The local boundary data for the agent.
+	dtCrowdNeighbour* neighbors;	///< The known neighbors of the agent, nearest first. (Stored by the crowd.)
+	unsigned nbNeighbors;			///< The number of neighbors.
+	unsigned maxNeighbors;			///< The maximum number of neighbors. (See: dtCrowd::setAgentMaxNeighbours)
 };
 
 /// Represents an agent managed by a #dtCrowd object.
@@ -160,6 +184,23 @@ public:
 	/// @param[in]	dist	The additional distance
 	/// @return 0 if no offMesh connection have been detected. Otherwise returns the offMesh connection
 	dtOffMeshConnection* getOffMeshConnection(unsigned id, float dist = 0.f) const;
+
+	/// Gets the number of times the behaviors of the crowd were updated. (See: dtCrowd::updateVelocity)
+	/// Lets the behaviors tell the updates apart, e.g. to spread some work over several of them.
+	unsigned getUpdateCount() const;
+
+	/// Gets the maximum number of neighbors of an agent. (See: dtCrowd::init)
+	unsigned getMaxNeighbours() const;
+
+	/// Gets the maximum number of agents of the crowd. (See: dtCrowd::init)
+	/// The ids of the agents are all lower than this number.
+	unsigned getMaxAgents() const;
+
+	/// Gets the phase of the periodic tasks of the given agent. (See: dtCrowd::setPeriodicTaskSpreading)
+	/// The periodic tasks of the agent should be offset by this fraction of their period.
+	/// @param[in]	id	The id of the agent
+	/// @return The phase of the agent, in [0, 1). Zero if the spreading is disabled.
+	float getAgentPhase(unsigned id) const;
 	/// @}
 
 	/// Makes the given agent start using the given offmesh connection.
@@ -168,12 +209,17 @@ public:
 	void startOffMeshConnection(dtCrowdAgent& ag, const dtOffMeshConnection& connection) const;
 
 private:
+	friend class dtCrowd;
+
 	float m_ext[3];								///< The query filters used for navigation queries.
 	dtNavMeshQuery* m_navMeshQuery;				///< Used to perform queries on the navigation mesh.
 	dtQueryFilter m_filter;						///< Defines polygon filtering and traversal costs for navigation mesh query operations.
 	const dtCrowdAgent* m_agents;				///< The agents of the crowd
 	unsigned m_maxAgents;						///< Max number of agents in the crowd
 	const dtCrowdAgentEnvironment* m_agentsEnv;	///< The environments of the agents
+	unsigned m_updateCount;						///< The number of updates of the behaviors. (See: #getUpdateCount)
+	unsigned m_maxNeighbours;					///< The maximum number of neighbors of an agent. (See: #getMaxNeighbours)
+	bool m_spreadPeriodicTasks;					///< Are the periodic tasks of the agents offset by their phase? (See: #getAgentPhase)
 };
 
 /// Class containing and handling the agents of the simulation.
@@ -191,11 +237,33 @@ class dtCrowd
 	dtCrowdAgent* m_agents;					///< The agents of the crowd
 	dtCrowdAgent** m_activeAgents;			///< the actives agents of the crowd
 	unsigned* m_agentsToUpdate;				///< indexes of all agents
+	/// A slot of the table mapping the behaviors to their group of agents. (Used by #updateVelocity)
+	struct BehaviorSlot
+	{
+		dtBehavior* behavior;	///< The behavior, null if the slot is free.
+		unsigned group;			///< The index of the group of agents using the behavior.
+	};
+
+	dtCrowdAgent** m_behaviorAgents;		///< The agents having a behavior, in update order. (Used by #updateVelocity)
+	unsigned* m_behaviorAgentGroups;		///< The group of each agent of #m_behaviorAgents.
+	dtCrowdAgent** m_behaviorBatch;			///< The agents of #m_behaviorAgents, grouped by behavior.
+	dtBehavior** m_groupBehaviors;			///< The behavior of each group, in the order of their first agent.
+	unsigned* m_groupEnds;					///< The end of each group in #m_behaviorBatch.
+	BehaviorSlot* m_behaviorSlots;			///< Open addressing table from the behaviors to their group.
+	unsigned m_behaviorSlotMask;			///< The number of slots of #m_behaviorSlots minus one.
+	dtCrowdNeighbour* m_neighbours;			///< The neighbors of all the agents, #m_maxNeighbours per agent.
+	unsigned m_maxNeighbours;				///< The maximum number of neighbors of an agent.
 		
 	float m_maxAgentRadius;					///< Maximal radius for an agent
 	unsigned m_maxCommonNodes;				///< Maximal number of search nodes for the navigation mesh
 
 	float** m_disp;							///< Used to prevent agents from bumping into each other
+	dtPolyRef* m_startPolys;				///< The polygons of the agents before moving them. (Used by #updatePosition)
+	float* m_startPos;						///< The positions of the agents before moving them. (Used by #updatePosition)
+
+	dtWallSegmentCache m_wallCache;			///< The wall segments shared by the boundaries of the agents
+	dtCrowdWorkHistogram m_boundaryUpdates;	///< The number of boundary updates per environment update.
+	bool m_spreadPeriodicTasks;				///< Are the periodic tasks of the agents spread? (See: #setPeriodicTaskSpreading)
 	
 	/// Returns the index of the given agent
 	inline unsigned getAgentIndex(const dtCrowdAgent* agent) const { return static_cast<unsigned>(agent - m_agents); }
@@ -225,8 +293,11 @@ public:
 	///  @param[in]		maxAgents		The maximum number of agents the crowd can manage. [Limit: >= 1]
 	///  @param[in]		maxAgentRadius	The maximum radius of any agent that will be added to the crowd. [Limit: > 0]
 	///  @param[in]		nav				The navigation mesh to use for planning.
+	///  @param[in]		maxNeighbours	The maximum number of neighbors of an agent. [Limit: >= 1]
 	/// @return True if the initialization succeeded.
-	bool init(const unsigned maxAgents, const float maxAgentRadius, dtNavMesh* nav);	
+	bool init(const unsigned maxAgents, const float maxAgentRadius, dtNavMesh* nav,
+			  const unsigned maxNeighbours = DT_CROWDAGENT_MAX_NEIGHBOURS);
+
 
 	/// @name Data access
 	/// @{
@@ -265,6 +336,15 @@ public:
 
 	const dtCrowdQuery* getCrowdQuery() const { return m_crowdQuery; }
 	dtCrowdQuery* getCrowdQuery() { return m_crowdQuery; }
+
+	/// Gets the cache of the wall segments used to build the boundaries of the agents.
+	const dtWallSegmentCache& getWallSegmentCache() const { return m_wallCache; }
+
+	/// Gets the histogram of the number of boundaries updated by #updateEnvironment.
+	const dtCrowdWorkHistogram& getBoundaryUpdateHistogram() const { return m_boundaryUpdates; }
+
+	/// Empties the histogram of the number of boundaries updated by #updateEnvironment.
+	void resetBoundaryUpdateHistogram() { m_boundaryUpdates.reset(); }
 	/// @}
 
 	/// @name Data modifiers
@@ -299,6 +379,23 @@ public:
 	/// @param[in]	position	The new desired position.
 	/// @return		False if the position is outside the navigation mesh or if the index is out of bound. True otherwise.
 	bool pushAgentPosition(unsigned id, const float* position);
+
+	/// Offsets the periodic tasks of every agent by its own phase. (See: dtCrowdQuery::getAgentPhase)
+	///
+	/// Agents created together otherwise run their periodic tasks (boundary updates, replannings, etc.)
+	/// during the same updates. The phases are spread evenly over the agents.
+	/// @param[in]	enabled		True to spread the periodic tasks. (Disabled by default.)
+	void setPeriodicTaskSpreading(bool enabled);
+
+	/// Gets the maximum number of neighbors of an agent, as given to #init.
+	unsigned getMaxNeighbours() const { return m_maxNeighbours; }
+
+	/// Sets the maximum number of neighbors the given agent takes into account.
+	/// The nearest neighbors within the perception distance of the agent are kept.
+	/// @param[in]	id				The id of the agent.
+	/// @param[in]	maxNeighbours	The maximum number of neighbors. [Limit: <= #getMaxNeighbours]
+	/// @return False if the id is out of bound or the number is too large.
+	bool setAgentMaxNeighbours(unsigned id, unsigned maxNeighbours);
 	/// @}
 
 	/// Indicates whether the agent is moving or not.
@@ -319,6 +416,10 @@ public:
 
 	/// Updates the velocity of the agents whose indices may be given by the user (but not their position).
 	/// If no indices are given, then the method updates every agent.
+	/// The agents are updated grouped by behavior, through dtBehavior::updateBatch: the behaviors in the order
+	/// of their first agent, and the agents of a behavior in the given order. When the behaviors of the agents
+	/// are interleaved, this is not the given order: a behavior reading the velocities its neighbors desire
+	/// sees the updated ones of all the agents of the previous groups, and none of the following groups.
 	///  @param[in]		dt			The time, in seconds, to update the simulation. [Limit: > 0]
 	///  @param[in]		agentsIdx	The list of the indices of the agents we want to update. [Opt]
 	///  @param[in]		nbIdx		Size of the list of indices. [Opt]
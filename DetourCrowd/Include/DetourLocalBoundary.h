@@ -22,6 +22,81 @@
 #include "DetourNavMeshQuery.h"
 
 
+/// Statistics about the use of a dtWallSegmentCache.
+struct dtWallSegmentCacheStats
+{
+	int hits;		///< The number of polygons whose segments were found in the cache.
+	int misses;		///< The number of polygons whose segments had to be queried.
+	int flushes;	///< The number of times the cache was emptied, because it was full or outdated.
+};
+
+/// Cache of the wall segments of the polygons of a navigation mesh.
+///
+/// The segments of a polygon are queried once using dtNavMeshQuery::getPolyWallSegments,
+/// then shared by all the agents whose boundary overlaps the polygon.
+/// The whole cache is dropped when the revision of the navigation mesh changes (tiles added or
+/// removed, polygon flags or areas modified) or when the include/exclude flags of the filter change.
+/// @note With #DT_VIRTUAL_QUERYFILTER, changes to a custom filter are not detected. Call #clear after them.
+class dtWallSegmentCache
+{
+public:
+	dtWallSegmentCache();
+	~dtWallSegmentCache();
+
+	/// Allocates the cache.
+	///  @param[in]	maxPolys		The maximum number of polygons the cache can hold.
+	///  @param[in]	maxSegments		The maximum number of segments the cache can hold.
+	/// @return True if the initialization succeeded.
+	bool init(const int maxPolys, const int maxSegments);
+
+	/// Frees the cache.
+	void purge();
+
+	/// Removes all the segments from the cache.
+	void clear();
+
+	/// Gets the wall segments of a polygon, querying them if they are not cached yet.
+	///  @param[in]		ref			The polygon.
+	///  @param[in]		navquery	The query object used to get the segments.
+	///  @param[in]		filter		The filter to apply to the query.
+	///  @param[out]	segments	The segments, valid until the next call. [(ax, ay, az, bx, by, bz) * return value]
+	/// @return The number of segments of the polygon.
+	int getWallSegments(dtPolyRef ref, const dtNavMeshQuery* navquery, const dtQueryFilter* filter,
+						const float** segments);
+
+	/// Gets the statistics of the cache.
+	const dtWallSegmentCacheStats& getStats() const { return m_stats; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtWallSegmentCache(const dtWallSegmentCache&);
+	dtWallSegmentCache& operator=(const dtWallSegmentCache&);
+
+	struct Entry
+	{
+		dtPolyRef ref;
+		int firstSegment;
+		int nsegments;
+		int next;				///< The next entry of the hash bucket. (-1 if none)
+	};
+
+	int* m_buckets;
+	int m_bucketMask;
+	Entry* m_entries;
+	int m_nentries;
+	int m_maxEntries;
+	float* m_segments;
+	int m_nsegments;
+	int m_maxSegments;
+
+	const dtNavMesh* m_nav;				///< The navigation mesh the segments come from.
+	unsigned int m_navRevision;			///< The revision of the navigation mesh the segments come from.
+	unsigned short m_includeFlags;		///< The include flags of the filter used to get the segments.
+	unsigned short m_excludeFlags;		///< The exclude flags of the filter used to get the segments.
+
+	dtWallSegmentCacheStats m_stats;
+};
+
 /// Set of segments representing the obstacles around an agent
 class dtLocalBoundary
 {
@@ -62,8 +137,9 @@ public:
 	/// @param[in]	collisionQueryRange		The polygon on the navigation mesh where the given position is located
 	/// @param[in]	navquery				The polygon on the navigation mesh where the given position is located
 	/// @param[in]	filter					The polygon on the navigation mesh where the given position is located
+	/// @param[in]	cache					The cache to read the wall segments of the polygons from. [opt]
 	void update(dtPolyRef ref, const float* pos, const float collisionQueryRange,
-				dtNavMeshQuery* navquery, const dtQueryFilter* filter);
+				dtNavMeshQuery* navquery, const dtQueryFilter* filter, dtWallSegmentCache* cache = 0);
 	
 	/// Checks that all polygons still pass query filter and are still valid.
 	bool isValid(dtNavMeshQuery* navquery, const dtQueryFilter* filter);
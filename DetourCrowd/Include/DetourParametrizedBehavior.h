@@ -79,10 +79,18 @@ protected:
 	struct Node
 	{
 		T value;		///< The parameter
+		T pending;		///< The parameter being computed by #update. Kept between the updates so that its storage is reused.
 		Node* next;		///< Pointer to the next element
 		unsigned id;	///< The id of the agent owning this parameter. Mandatory to handle collisions
 	};
 
+	/// Returns the node holding the parameters of the given agent, creating it if needed. NULL on allocation failure.
+	Node* getNode(unsigned id) const;
+
+	/// Destroys the parameters of all the agents.
+	/// Behaviors whose parameters reference their own members must call it from their destructor.
+	void purgeParams();
+
 	unsigned m_size;		///< Number of parameters at the beginning
 	Node* m_agentsParams;	///< The data structure containing the parameters
 };
@@ -109,6 +117,12 @@ dtParametrizedBehavior<T>::dtParametrizedBehavior(unsigned preAllocationSize)
 
 template <typename T>
 dtParametrizedBehavior<T>::~dtParametrizedBehavior()
+{
+	purgeParams();
+}
+
+template <typename T>
+void dtParametrizedBehavior<T>::purgeParams()
 {
 	for (unsigned i = 0; i < m_size; ++i)
 	{
@@ -121,14 +135,25 @@ dtParametrizedBehavior<T>::~dtParametrizedBehavior()
 			toDelete->~Node();
 			dtFree(toDelete);
 		}
+
+		n->~Node();
 	}
 
 	dtFree(m_agentsParams);
 	m_agentsParams = 0;
+	m_size = 0;
 }
 
 template <typename T>
 T* dtParametrizedBehavior<T>::getBehaviorParams(unsigned id) const
+{
+	Node* node = getNode(id);
+
+	return node ? &node->value : 0;
+}
+
+template <typename T>
+typename dtParametrizedBehavior<T>::Node* dtParametrizedBehavior<T>::getNode(unsigned id) const
 {
 	if (m_size == 0)
 		return 0;
@@ -141,14 +166,14 @@ T* dtParametrizedBehavior<T>::getBehaviorParams(unsigned id) const
 	Node* head = &m_agentsParams[index];
 
 	if (head->id == id && head->id < UINT_MAX)
-		return &head->value;
+		return head;
 	
 	while (head->next)
 	{
 		head = head->next;
 
 		if (head->id == id && head->id < UINT_MAX)
-			return &head->value;
+			return head;
 	}
 
 	void* mem = dtAlloc(sizeof(Node), DT_ALLOC_PERM);
@@ -156,28 +181,30 @@ T* dtParametrizedBehavior<T>::getBehaviorParams(unsigned id) const
 	if (mem == 0)
 		return 0;
 
-	Node* newNode = new(mem) Node;
+	Node* newNode = new(mem) Node();
 
 	newNode->next = 0;
 	newNode->id = id;
 	head->next = newNode;
 
-	return &newNode->value;
+	return newNode;
 }
 
 template <typename T>
 void dtParametrizedBehavior<T>::update(const dtCrowdQuery& query, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, float dt)
 {
-	T* params = getBehaviorParams(oldAgent.id);
+	Node* node = getNode(oldAgent.id);
 
-	if (!params)
+	if (!node)
 		return;
 
-	T newParams = *params;
+	// The new parameters start as a copy of the current ones, and replace them once the update is done.
+	// Both objects live as long as the agent, so the assignments reuse their storage instead of allocating.
+	node->pending = node->value;
 
-	doUpdate(query, oldAgent, newAgent, *params, newParams, dt);
+	doUpdate(query, oldAgent, newAgent, node->value, node->pending, dt);
 
-	*params = newParams;
+	node->value = node->pending;
 }
 
 
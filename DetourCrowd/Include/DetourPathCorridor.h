@@ -22,6 +22,82 @@
 #include "DetourNavMeshQuery.h"
 #include "DetourCommon.h"
 
+/// Statistics about the memory used by a dtPathCorridorPool.
+/// @ingroup behavior, detour
+struct dtPathCorridorPoolStats
+{
+	int slabCount;			///< The number of slabs allocated by the pool.
+	int reservedRefs;		///< The number of polygon references the slabs can hold.
+	int allocatedRefs;		///< The number of polygon references handed out to the corridors.
+	int blockCount;			///< The number of path buffers handed out to the corridors.
+};
+
+/// Stores the paths of many corridors in a few large slabs.
+///
+/// The path buffers are sized in powers of two, so short paths are packed densely
+/// and a corridor only grows its buffer when its path does.
+/// The pool must outlive the corridors using it, and is not thread safe.
+/// @ingroup behavior, detour
+class dtPathCorridorPool
+{
+public:
+	dtPathCorridorPool();
+	~dtPathCorridorPool();
+
+	/// Allocates a path buffer.
+	///  @param[in]		size		The number of polygon references the buffer must hold. [Limit: > 0]
+	///  @param[out]	capacity	The number of polygon references the buffer can actually hold.
+	/// @return The path buffer, or null if the allocation failed.
+	dtPolyRef* alloc(const int size, int* capacity);
+
+	/// Returns a path buffer to the pool.
+	///  @param[in]		path		The buffer returned by #alloc.
+	///  @param[in]		capacity	The capacity of the buffer returned by #alloc.
+	void free(dtPolyRef* path, const int capacity);
+
+	/// Gets the capacity of the buffers #alloc returns for the given size.
+	///  @param[in]		size		The number of polygon references the buffer must hold.
+	/// @return The capacity of the buffer, or zero if the pool cannot hold that many references.
+	static int getBlockSize(const int size);
+
+	/// Gets the statistics of the pool.
+	///  @param[out]	stats		The statistics.
+	void getStats(dtPathCorridorPoolStats* stats) const;
+
+	/// The smallest buffer handed out by the pool. [Unit: polygon references]
+	static const int MIN_BLOCK_SIZE = 8;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtPathCorridorPool(const dtPathCorridorPool&);
+	dtPathCorridorPool& operator=(const dtPathCorridorPool&);
+
+	/// The number of buffer sizes. (MIN_BLOCK_SIZE * 2^n)
+	static const int MAX_CLASSES = 16;
+
+	/// The number of polygon references of a regular slab.
+	static const int SLAB_SIZE = 4096;
+
+	struct Slab
+	{
+		Slab* next;
+		int size;			///< The number of polygon references of the slab.
+	};
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	void addFreeBlocks(dtPolyRef* data, int size);
+
+	FreeBlock* m_freeBlocks[MAX_CLASSES];	///< The free buffers of each size.
+	Slab* m_slabs;
+	dtPolyRef* m_slabTop;					///< The unused part of the last slab.
+	int m_slabLeft;							///< The number of polygon references left in the last slab.
+	dtPathCorridorPoolStats m_stats;
+};
+
 /// Represents a dynamic polygon corridor used to plan agent movement.
 /// @ingroup behavior, detour
 class dtPathCorridor
@@ -32,6 +108,9 @@ class dtPathCorridor
 	dtPolyRef* m_path;	///< The path as an array of polygon
 	int m_npath;		///< The number of polygon in the path
 	int m_maxPath;		///< The maximum path size the corridor can handle
+	int m_capacity;		///< The size of the path buffer. (Only smaller than #m_maxPath when the buffer comes from a pool.)
+	dtPathCorridorPool* m_pool;	///< The pool the path buffer comes from. [opt]
+	unsigned m_revision;	///< Incremented every time the path or the target changes.
 
 	bool m_isSet;		///< Has the start of the corridor been set with an agent position?
 	
@@ -47,8 +126,9 @@ public:
 	
 	/// Allocates the corridor's path buffer. 
 	///  @param[in]		maxPath		The maximum path size the corridor can handle.
+	///  @param[in]		pool		The pool to take the path buffer from. The buffer then grows with the path. [opt]
 	/// @return True if the initialization succeeded.
-	bool init(const int maxPath);
+	bool init(const int maxPath, dtPathCorridorPool* pool = 0);
 	
 	/// Resets the path corridor to the specified position.
 	///  @param[in]		ref		The polygon reference containing the position.
@@ -67,6 +147,16 @@ public:
 	int findCorners(float* cornerVerts, unsigned char* cornerFlags,
 					dtPolyRef* cornerPolys, const int maxCorners,
 					const dtNavMeshQuery* navquery, const dtQueryFilter* filter);
+
+	/// Removes the corners the current position has reached from corners found by #findCorners.
+	/// Used to keep on using corners found for a previous position of the same revision of the corridor.
+	///  @param[in,out]	cornerVerts		The corner vertices. [(x, y, z) * cornerCount]
+	///  @param[in,out]	cornerFlags		The flag for each corner. [(flag) * cornerCount]
+	///  @param[in,out]	cornerPolys		The polygon reference for each corner. [(polyRef) * cornerCount]
+	///  @param[in]		ncorners		The number of corners in the buffers.
+	/// @return The number of corners left in the buffers. [0 <= value <= @p ncorners]
+	int pruneCorners(float* cornerVerts, unsigned char* cornerFlags,
+					 dtPolyRef* cornerPolys, int ncorners) const;
 	
 	/// Attempts to optimize the path if the specified point is visible from the current position.
 	///  @param[in]		next					The point to search toward. [(x, y, z])
@@ -76,10 +166,26 @@ public:
 	void optimizePathVisibility(const float* next, const float pathOptimizationRange,
 								const dtNavMeshQuery* navquery, const dtQueryFilter* filter);
 	
+	/// Gets the ray cast by #optimizePathVisibility, so that it can be cast along with other rays.
+	/// (See: dtNavMeshQuery::raycastBatch)
+	///  @param[in]		next					The point to search toward. [(x, y, z])
+	///  @param[in]		pathOptimizationRange	The maximum range to search. [Limit: > 0]
+	///  @param[out]	ray						The ray to cast.
+	/// @return False if the point is too close to need a ray.
+	bool getVisibilityRay(const float* next, const float pathOptimizationRange, dtRaycastRequest* ray) const;
+	
+	/// Optimizes the path using the result of the ray given by #getVisibilityRay.
+	/// The corridor must not have changed since the ray was built.
+	///  @param[in]		hit			The result of the ray.
+	///  @param[in]		visited		The polygons visited by the ray. [(polyRef) * hit.pathCount]
+	/// @return True if the path was shortened.
+	bool applyVisibilityRay(const dtRaycastHit& hit, const dtPolyRef* visited);
+	
 	/// Attempts to optimize the path using a local area search. (Partial replanning.) 
 	///  @param[in]		navquery	The query object used to build the corridor.
 	///  @param[in]		filter		The filter to apply to the operation.	
-	bool optimizePathTopology(dtNavMeshQuery* navquery, const dtQueryFilter* filter);
+	///  @param[out]	doneIters	The number of iterations of the search. [opt]
+	bool optimizePathTopology(dtNavMeshQuery* navquery, const dtQueryFilter* filter, int* doneIters = 0);
 	
 	/// Updates the corridor to move through an off-mesh connection
 	///
@@ -122,20 +228,23 @@ public:
 	///  @param[in]		npos		The desired new position. [(x, y, z)]
 	///  @param[in]		navquery	The query object used to build the corridor.
 	///  @param[in]		filter		The filter to apply to the operation.
-	void movePosition(const float* npos, const dtNavMeshQuery* navquery, const dtQueryFilter* filter);
+	/// @return False if the path buffer could not hold the whole adjusted path, which may then have been truncated.
+	bool movePosition(const float* npos, const dtNavMeshQuery* navquery, const dtQueryFilter* filter);
 
 	/// Moves the target from the curent location to the desired location, adjusting the corridor
 	/// as needed to reflect the change. 
 	///  @param[in]		npos		The desired new target position. [(x, y, z)]
 	///  @param[in]		navquery	The query object used to build the corridor.
 	///  @param[in]		filter		The filter to apply to the operation.
-	void moveTargetPosition(const float* npos, dtNavMeshQuery* navquery, const dtQueryFilter* filter);
+	/// @return False if the path buffer could not hold the whole adjusted path, which may then have been truncated.
+	bool moveTargetPosition(const float* npos, dtNavMeshQuery* navquery, const dtQueryFilter* filter);
 	
 	/// Loads a new path and target into the corridor.
 	///  @param[in]		target		The target location within the last polygon of the path. [(x, y, z)]
 	///  @param[in]		path		The path corridor. [(polyRef) * @p npolys]
 	///  @param[in]		npath		The number of polygons in the path.
-	void setCorridor(const float* target, const dtPolyRef* polys, const int npath);
+	/// @return False if the path buffer could not hold the whole path, which was then truncated.
+	bool setCorridor(const float* target, const dtPolyRef* polys, const int npath);
 	
 	/// Gets the current position within the corridor. (In the first polygon.)
 	/// @return The current position within the corridor.
@@ -146,6 +255,11 @@ public:
 	inline const float* getTarget() const { return m_target; }
 
 	inline bool isSet() const { return m_isSet; }
+
+	/// The revision of the corridor. It changes every time the path or the target is modified,
+	/// including when the position moves to another polygon.
+	/// @return The revision of the corridor.
+	inline unsigned getRevision() const { return m_revision; }
 	
 	/// The polygon reference id of the first polygon in the corridor, the polygon containing the position.
 	/// @return The polygon reference id of the first polygon in the corridor. (Or zero if there is no path.)
@@ -163,7 +277,29 @@ public:
 	/// @return The number of polygons in the current corridor path.
 	inline int getPathCount() const { return m_npath; }
 
+	/// The number of polygons the path buffer can currently hold.
+	/// @return The number of polygons the path buffer can currently hold.
+	inline int getCapacity() const { return dtMin(m_capacity, m_maxPath); }
+
 	static const int MAX_VISITED = 16;
+
+private:
+	/// Makes sure the path buffer can hold the given number of polygons, growing it if needed.
+	/// The corridor keeps its current buffer if it cannot be grown.
+	/// @return False if the buffer could not be grown.
+	bool reserve(const int size);
+
+	/// Gives memory back to the pool when the path is much shorter than its buffer.
+	void compact();
+
+	/// Moves the path to a buffer from the pool holding at least the given number of polygons.
+	bool resize(const int size);
+
+	/// Allocates the path buffer, from the pool if there is one.
+	bool allocPath(const int size);
+
+	/// Frees the path buffer.
+	void freePath();
 };
 
 int dtMergeCorridorStartMoved(dtPolyRef* path, const int npath, const int maxPath,
@@ -29,6 +29,7 @@ struct dtCrowdAgent;
 struct dtCrowdAgentDebugInfo;
 struct dtCrowdAgentEnvironment;
 class dtCrowdQuery;
+struct dtTopologyQueueEntry;
 
 template <typename T>
 class dtParametrizedBehavior;
@@ -69,8 +70,9 @@ struct dtPathFollowingParams
 	/// @param[in]	maxPathResult	The maximum number of polygons that can be stored in a corridor.
 	/// @param[in]	position	The position of the agent. Used to determine which polygon it is on.
 	/// @param[in]	query		Used to access the navigation mesh query in order to get the polygon the agent is on.
+	/// @param[in]	pool		The pool storing the path of the corridor. [opt]
 	/// @return	True if the initialization was successful, false otherwise
-	bool init(unsigned maxPathResults, const float* position, const dtCrowdQuery& query);
+	bool init(unsigned maxPathResults, const float* position, const dtCrowdQuery& query, dtPathCorridorPool* pool = 0);
     
     /** @name Target */
     //@{
@@ -104,7 +106,12 @@ struct dtPathFollowingParams
 	float cornerVerts[MAX_NCORNERS*3]; ///< The local path corridor corners for the agent. (Staight path.) [(x, y, z) * #ncorners]
 	unsigned char cornerFlags[MAX_NCORNERS]; ///< The local path corridor corner flags. (See: #dtStraightPathFlags)
 	dtPolyRef cornerPolys[MAX_NCORNERS]; ///< The reference id of the polygon being entered at the corner.
+	unsigned cornersRevision; ///< The revision of the corridor the corners were found for. (See: dtPathCorridor::getRevision)
+	bool cornersCached; ///< Are the corners those of the #cornersRevision of the corridor?
+	float visibilityTarget[3]; ///< The point the next visibility optimization searches toward. [(x, y, z)]
+	bool visibilityQueued; ///< Is the agent waiting for a visibility optimization? (See: dtPathFollowing::visibilityRaysPerUpdate)
 	float topologyOptTime; ///< Time since the agent's path corridor was optimized.
+	bool topologyQueued; ///< Is the agent waiting for a topology optimization? (See: dtPathFollowing::topologyIterationsPerUpdate)
     //@}
     
     /** @name Debug */
@@ -114,6 +121,21 @@ struct dtPathFollowingParams
     //@}
 };
 
+/// Statistics about the work done by a dtPathFollowing behavior.
+/// @ingroup behavior
+struct dtPathFollowingStats
+{
+	unsigned cornerQueries;		///< The number of times the corners of an agent were needed.
+	unsigned cornerUpdates;		///< The number of times the corners had to be found again. (See: dtPathFollowing::cacheCorners)
+	unsigned visibilityOptimizations;	///< The number of visibility optimizations run. (See: dtPathFollowing::visibilityPathOptimizationRange)
+	unsigned visibilityOverflows;		///< The number of visibility optimizations not queued because the queue was full. (See: dtPathFollowing::visibilityRaysPerUpdate)
+	unsigned topologyOptimizations;		///< The number of topology optimizations run. (See: dtPathFollowing::localPathReplanningInterval)
+	unsigned topologyIterations;		///< The number of search iterations done by the topology optimizations.
+	unsigned truncatedPaths;			///< The number of paths cut short because the corridor could not grow to hold them. (See: dtPathCorridor::setCorridor, dtPathCorridor::movePosition)
+	dtCrowdWorkHistogram replanHistogram;	///< The number of path replannings per update of the crowd. (Up to the previous update.)
+	dtCrowdWorkHistogram topologyHistogram;	///< The number of topology optimizations per update of the crowd. (Up to the previous update.)
+};
+
 /// Defines a behavior for pathfollowing.
 ///
 /// Using a navigation mesh, the pathfollowing behavior works on 
@@ -152,6 +174,9 @@ public:
 
 	/// Cleans the class before destroying
 	void purge();
+
+	/// The pool storing the corridors of the agents initialized by the behavior.
+	const dtPathCorridorPool& getCorridorPool() const { return m_corridorPool; }
     
     /// @name Parameters
     //@{
@@ -175,6 +200,18 @@ public:
     ///
     /// @remark Default value is -1 (the optimization is disabled).
     float visibilityPathOptimizationRange;
+
+    /// The maximum number of rays cast for the visibility optimizations during an update of the crowd.
+    ///
+    /// Setting this parameter to a positive number queues the visibility optimizations of the
+    /// agents instead of running them right away. At the start of every update of the crowd, the
+    /// rays of the agents at the front of the queue are cast together (see
+    /// dtNavMeshQuery::raycastBatch), up to this number. The agents left in the queue keep
+    /// their place for the next update, so the optimizations are spread over several updates
+    /// when there are more agents than rays.
+    ///
+    /// @remark Default value is 0 (every agent casts its ray during its own update).
+    unsigned visibilityRaysPerUpdate;
     
     /// Local replanning time interval.
     ///
@@ -186,13 +223,45 @@ public:
     ////
     /// @remark Default value is -1 (the replanning is disabled).
     float localPathReplanningInterval;
+
+    /// The maximum number of search iterations spent on the local replannings during an update of the crowd.
+    ///
+    /// Setting this parameter to a positive number queues the agents due for a local replanning
+    /// (see dtPathFollowing::localPathReplanningInterval) instead of replanning them right away.
+    /// At the start of every update of the crowd, the agents whose corridor was optimized the
+    /// longest time ago are replanned first, until this number of iterations is reached. So
+    /// agents becoming due at the same time are spread over several updates.
+    ///
+    /// @remark Default value is 0 (every due agent is replanned during its own update).
+    unsigned topologyIterationsPerUpdate;
     
     /// Enable the turn anticipations.
     ///
     /// @remark Default value is false.
     bool anticipateTurns;
+
+    /// Reuse the corners of the agents between the updates.
+    ///
+    /// The corners are only found again when the corridor changes, which includes the
+    /// agent moving to another polygon. In between, the corners the agent has reached are
+    /// simply removed. This saves most of the string pulling for agents walking along
+    /// their path, at the price of slightly less accurate corners for agents pushed
+    /// away from it, e.g. by the collision avoidance.
+    ///
+    /// @remark Default value is false.
+    bool cacheCorners;
     //@}
+
+    /// Gets the statistics of the behavior.
+    const dtPathFollowingStats& getStats() const { return m_stats; }
+
+    /// Resets the statistics of the behavior.
+    void resetStats();
     
+    /// Runs the queued optimizations before updating the agent. (See: #visibilityRaysPerUpdate, #topologyIterationsPerUpdate)
+    /// @see dtParametrizedBehavior::update
+    virtual void update(const dtCrowdQuery& query, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, float dt);
+
     /// @see dtParametrizedBehavior::doUpdate
     virtual void doUpdate(const dtCrowdQuery& query, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, const dtPathFollowingParams& currentParams, dtPathFollowingParams& newParams, float dt);
 private:
@@ -230,12 +299,34 @@ private:
 	/// @param[in]		agParams	The parameters of the agent for this behavior
 	void getVelocity(const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, dtPathFollowingParams& agParams);
 
+	/// Loads a path into the corridor of the agent.
+	/// If the corridor could only hold the start of the path, the target is moved into the last polygon
+	/// it holds, as for a partial path, and the rest of the path is found again once the agent gets there.
+	///
+	/// @param[in]		target		The target location within the last polygon of the path. [(x, y, z)]
+	/// @param[in]		path		The path. [(polyRef) * @p npath]
+	/// @param[in]		npath		The number of polygons in the path.
+	/// @param[in]		agParams	The parameters of the agent for this behavior
+	/// @return False if the path was truncated.
+	bool loadCorridor(const dtCrowdQuery& crowdQuery, const float* target, const dtPolyRef* path, const int npath, dtPathFollowingParams& agParams);
+
 	/// Finds the next corner the agent should aim to
 	/// 
 	/// @param[in]		ag			The agent to work on.
 	/// @param[in]		agParams	The parameters of the agent for this behavior
 	void getNextCorner(const dtCrowdQuery& crowdQuery, const dtCrowdAgent& ag, dtPathFollowingParams& agParams);
 
+	/// Queues the visibility optimization of the agent. (See: #visibilityRaysPerUpdate)
+	///
+	/// @param[in]		ag			The agent to work on.
+	/// @param[in]		target		The point to search toward. [(x, y, z)]
+	/// @param[in]		agParams	The parameters of the agent for this behavior
+	/// @return False if the queue is full.
+	bool queueVisibilityOptimization(const dtCrowdAgent& ag, const float* target, dtPathFollowingParams& agParams);
+
+	/// Casts the rays of the agents at the front of the visibility queue and optimizes their corridors.
+	void castVisibilityRays(const dtCrowdQuery& crowdQuery);
+
 	/// Checks whether the agent is on an offmesh connection. If so, the path is adjusted.
 	/// 
 	/// @param[in]		agents			List of active agents.
@@ -251,13 +342,15 @@ private:
 	/// @param[in]		maxAgents		Maximal number of agents.
 	int addToPathQueue(const dtCrowdAgent& newag, dtCrowdAgent** agents, const unsigned nagents, const unsigned maxAgents);
 
-	/// Moves an agent into a list according to the last time since its path corridor was updated.
+	/// Pushes an agent into the topology optimization queue, keyed by the last time its path corridor was optimized.
+	/// If the queue is full, the agent is not queued and tries again during its next update.
 	///
 	/// @param[in]		newag			Agent we want to move.
-	/// @param[in]		agents			The list of agents.
-	/// @param[in]		nagents			Size of the list.
-	/// @param[in]		maxAgents		Maximal number of agents.
-	int addToOptQueue(const dtCrowdAgent& newag, dtCrowdAgent** agents, const unsigned nagents, const unsigned maxAgents);
+	/// @param[in]		agParams		The parameters of the agent for this behavior
+	void addToOptQueue(const dtCrowdAgent& newag, dtPathFollowingParams& agParams);
+
+	/// Optimizes the corridors of the agents at the front of the topology optimization queue.
+	void optimizeQueuedTopologies(const dtCrowdQuery& crowdQuery);
 
 	/// Is the agent standing over an offmesh connection?
 	///
@@ -292,14 +385,27 @@ private:
 	void calcStraightSteerDirection(const dtCrowdAgent& ag, float* dir, dtPathFollowingParams* agParams);
 
 	dtPathQueue m_pathQueue;				///< A Queue of destination in order to reach the target.
+	dtPathCorridorPool m_corridorPool;		///< The storage of the corridors.
 
 	dtPolyRef* m_pathResult;				///< The path results
-	unsigned m_maxAgents;					///< Maximal number of agents.
+	unsigned* m_visibilityQueue;			///< The agents waiting for a visibility optimization. (Ring buffer of #m_queueCapacity ids.)
+	unsigned m_visibilityHead;				///< The index of the front of the visibility queue.
+	unsigned m_visibilityCount;				///< The number of agents in the visibility queue.
+	dtTopologyQueueEntry* m_topologyQueue;	///< The agents waiting for a topology optimization. (Min-heap, the stalest first.)
+	unsigned m_topologyCount;				///< The number of agents in the topology queue.
+	float m_topologyClock;					///< The time elapsed since the topology queue was last empty.
+	unsigned m_queueCapacity;				///< The capacity of the optimization queues, the maximum number of agents of the crowd.
+	unsigned m_queuesUpdate;				///< The update of the crowd the queues were last processed for. (See: dtCrowdQuery::getUpdateCount)
+	unsigned m_updateReplans;				///< The number of path replannings during the current update of the crowd.
+	unsigned m_updateTopologies;			///< The number of topology optimizations during the current update of the crowd.
+	unsigned m_maxAgents;					///< Estimation of the maximal number of agents.
 	unsigned m_maxPathRes;					///< Maximal number of path results
 
 	const unsigned m_maxCommonNodes;		///< Maximal number of common nodes.
 	const unsigned m_maxPathQueueNodes;		///< Maximal number of nodes in the path queue.
 	const unsigned m_maxIterPerUpdate;		///< Maximal number of iterations per update.
+
+	dtPathFollowingStats m_stats;			///< The statistics of the behavior.
 };
 
 #endif
@@ -29,6 +29,9 @@ class dtCrowdQuery;
 /// The behavior will be called one after another, this means that there is a risk that 
 /// a behavior might erase the modifications done by the previous one (depending on how they were implemented).
 /// Also, the order in which you put your behaviors into the pipeline matters.
+///
+/// Each behavior after the first one is given the same agent as its old and new agent,
+/// which already holds the result of the previous behaviors.
 /// @ingroup behavior
 class dtPipelineBehavior : public dtBehavior
 {
@@ -57,8 +60,6 @@ public:
 	bool setBehaviors(dtBehavior const * const * behaviors, unsigned nbBehaviors);
 
 private:
-	void recursiveUpdate(const dtCrowdQuery& query, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, float dt, unsigned remainingBehaviors);
-
 	dtBehavior** m_behaviors;	///< The behaviors affected to the pipeline
 	int m_nbBehaviors;			///< The number of behaviors affected to the pipeline
 };
@@ -27,6 +27,16 @@
 
 class dtCrowdQuery;
 
+/// Applies the forces to the agents as the default dtSteeringBehavior::applyForce does, four agents at a time.
+/// The agents left over, and all of them when no SIMD implementation is available, are not updated.
+///
+/// @param[in,out]	agents		The agents to update in place.
+/// @param[in]		forces		The force of each agent. [(x, y, z) * @p nbAgents]
+/// @param[in]		nbAgents	The number of agents.
+/// @param[in]		dt			The time, in seconds, to update the simulation. [Limit: > 0]
+///
+/// @return The number of agents updated, from the start of the array.
+unsigned dtApplySteeringForcesSimd(dtCrowdAgent* const* agents, const float* forces, unsigned nbAgents, float dt);
 
 /// Interface defining a steering behavior.
 /// @ingroup behavior
@@ -39,6 +49,10 @@ public:
 	/// @param[in]	nbMaxAgent		Estimation of the maximum number of agents using this behavior
 	explicit dtSteeringBehavior(unsigned nbMaxAgent);
 	virtual ~dtSteeringBehavior();
+
+	/// Computes the forces of all the agents, then applies them.
+	/// The agents are expected to be updated in place, as done by the crowd.
+	virtual void updateBatch(const dtCrowdQuery& query, dtCrowdAgent* const* agents, unsigned nbAgents, float dt);
 	
 	/// Computes the force that should be applied to the velocity of the given agent.
 	///
@@ -48,6 +62,14 @@ public:
 	virtual void computeForce(const dtCrowdQuery& query, const dtCrowdAgent& ag, float* force, 
 							  const T& currentParams, T& newParams) = 0;
 
+	/// Enables or disables the SIMD implementation of #updateBatch, where it is available.
+	/// It applies the forces as the default #applyForce, so it must stay disabled for the behaviors overriding it.
+	///  @param[in]		state	TRUE if the SIMD implementation should be used.
+	inline void enableSimd(bool state) { m_simdEnabled = state; }
+
+	/// Returns true if the SIMD implementation of #updateBatch is enabled.
+	inline bool isSimdEnabled() const { return m_simdEnabled; }
+
 protected:
 	/// Applies the previously computed force the velocity of the old agent and stores the result into the new agent.
 	///
@@ -60,11 +82,14 @@ protected:
 
 	virtual void doUpdate(const dtCrowdQuery& query, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, 
 		const T& currentParams, T& newParams, float dt);
+
+	bool m_simdEnabled;	///< True if the forces of the batches are applied by #dtApplySteeringForcesSimd. Disabled by default.
 };
 
 template<typename T>
 dtSteeringBehavior<T>::dtSteeringBehavior(unsigned nbMaxAgent)
 	: dtParametrizedBehavior<T>(nbMaxAgent)
+	, m_simdEnabled(false)
 {
 }
 
@@ -99,4 +124,46 @@ void dtSteeringBehavior<T>::doUpdate(const dtCrowdQuery& query, const dtCrowdAge
 	applyForce(query, oldAgent, newAgent, desiredForce, dt);
 }
 
+template <typename T>
+void dtSteeringBehavior<T>::updateBatch(const dtCrowdQuery& query, dtCrowdAgent* const* agents, unsigned nbAgents, float dt)
+{
+	typedef typename dtParametrizedBehavior<T>::Node Node;
+
+	static const unsigned BATCH_SIZE = 32;
+	Node* nodes[BATCH_SIZE];
+	dtCrowdAgent* batch[BATCH_SIZE];
+	float forces[BATCH_SIZE * 3];
+
+	for (unsigned start = 0; start < nbAgents; start += BATCH_SIZE)
+	{
+		const unsigned n = dtMin(nbAgents - start, BATCH_SIZE);
+		unsigned nbBatch = 0;
+
+		// The forces only depend on the positions and velocities of the agents, which are not modified here,
+		// so they can all be computed before any of them is applied.
+		for (unsigned i = 0; i < n; ++i)
+		{
+			Node* node = this->getNode(agents[start + i]->id);
+			if (!node)
+				continue;
+
+			float* force = &forces[nbBatch * 3];
+			dtVset(force, 0, 0, 0);
+
+			node->pending = node->value;
+			computeForce(query, *agents[start + i], force, node->value, node->pending);
+
+			nodes[nbBatch] = node;
+			batch[nbBatch++] = agents[start + i];
+		}
+
+		const unsigned nbApplied = m_simdEnabled ? dtApplySteeringForcesSimd(batch, forces, nbBatch, dt) : 0;
+		for (unsigned i = nbApplied; i < nbBatch; ++i)
+			applyForce(query, *batch[i], *batch[i], &forces[i * 3], dt);
+
+		for (unsigned i = 0; i < nbBatch; ++i)
+			nodes[i]->value = nodes[i]->pending;
+	}
+}
+
 #endif
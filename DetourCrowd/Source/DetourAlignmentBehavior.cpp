@@ -27,6 +27,7 @@
 dtAlignmentBehavior::dtAlignmentBehavior(unsigned nbMaxAgents)
 	: dtSteeringBehavior<dtAlignmentBehaviorParams>(nbMaxAgents)
 {
+	enableSimd(true);
 }
 
 dtAlignmentBehavior::~dtAlignmentBehavior()
@@ -39,29 +40,25 @@ void dtAlignmentBehavior::computeForce(const dtCrowdQuery& query, const dtCrowdA
 	const unsigned* targets = currentParams.targets;
 	const unsigned nbTargets = currentParams.nbTargets;
 
-	const dtCrowdAgent** agents = (const dtCrowdAgent**) dtAlloc(sizeof(dtCrowdAgent*) * nbTargets, DT_ALLOC_TEMP);
-	query.getAgents(targets, nbTargets, agents);
-
-	if (!agents || !targets || !nbTargets)
-	{
-		dtFree(agents);
+	if (!targets || !nbTargets)
 		return;
-	}
 
 	int count = 0;
 
 	for (unsigned i = 0; i < nbTargets; ++i)
-		if (agents[i]->active)
+	{
+		const dtCrowdAgent* target = query.getAgent(targets[i]);
+
+		if (target && target->active)
 		{
 			++ count;
-			dtVadd(force, force, agents[i]->velocity);
+			dtVadd(force, force, target->velocity);
 		}
+	}
 
 	dtVscale(force, force, 1.f / (float) count);
 	dtVsub(force, force, ag.velocity);
 
-	dtFree(agents);
-
 	force[1] = 0;
 }
 
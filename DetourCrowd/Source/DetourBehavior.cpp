@@ -17,6 +17,7 @@
 //
 
 #include "DetourBehavior.h"
+#include "DetourCrowd.h"
 
 
 dtBehavior::dtBehavior()
@@ -26,3 +27,9 @@ dtBehavior::dtBehavior()
 dtBehavior::~dtBehavior()
 {
 }
+
+void dtBehavior::updateBatch(const dtCrowdQuery& query, dtCrowdAgent* const* agents, unsigned nbAgents, float dt)
+{
+	for (unsigned i = 0; i < nbAgents; ++i)
+		update(query, *agents[i], *agents[i], dt);
+}
@@ -27,6 +27,7 @@
 dtCohesionBehavior::dtCohesionBehavior(unsigned nbMaxAgents)
 	: dtSteeringBehavior<dtCohesionBehaviorParams>(nbMaxAgents)
 {
+	enableSimd(true);
 }
 
 dtCohesionBehavior::~dtCohesionBehavior()
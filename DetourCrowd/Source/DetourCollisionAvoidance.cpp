@@ -85,6 +85,12 @@ bool dtCollisionAvoidance::init()
 	return resizeObstaclesContainer();
 }
 
+bool dtCollisionAvoidance::init(const dtCrowdQuery& query)
+{
+	maximumCircleObstaclesCount = dtMax(maximumCircleObstaclesCount, query.getMaxNeighbours());
+	return init();
+}
+
 void dtCollisionAvoidance::purge()
 {
 	dtFree(m_circles);
@@ -343,7 +349,7 @@ void dtCollisionAvoidance::addCircle(const float* pos, const float rad,
 
 void dtCollisionAvoidance::addSegment(const float* p, const float* q)
 {
-	if (m_segmentsCount > maximumSegmentObstaclesCount)
+	if (m_segmentsCount >= maximumSegmentObstaclesCount)
 		return;
 
 	dtObstacleSegment* seg = &m_segments[m_segmentsCount++];
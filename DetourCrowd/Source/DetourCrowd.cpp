@@ -76,44 +76,64 @@ static void integrate(dtCrowdAgent* ag, const float dt)
 		dtVset(ag->velocity,0,0,0);
 }
 
-static int addNeighbour(const int idx, const float dist,
-						dtCrowdNeighbour* neis, const int nneis, const int maxNeis)
+// Restores the max-heap order of the neighbours, farthest first, below the given one.
+static void siftDownNeighbour(dtCrowdNeighbour* neis, const unsigned nneis, unsigned i)
 {
-	// Insert neighbour based on the distance.
-	dtCrowdNeighbour* nei = 0;
-	if (!nneis)
+	const dtCrowdNeighbour nei = neis[i];
+
+	for (;;)
 	{
-		nei = &neis[nneis];
+		unsigned child = 2*i+1;
+		if (child >= nneis)
+			break;
+		if (child+1 < nneis && neis[child+1].dist > neis[child].dist)
+			++child;
+		if (neis[child].dist <= nei.dist)
+			break;
+		neis[i] = neis[child];
+		i = child;
 	}
-	else if (dist >= neis[nneis-1].dist)
+
+	neis[i] = nei;
+}
+
+// Keeps the nearest neighbours in a max-heap, so that a farther candidate is rejected in constant time.
+static unsigned addNeighbour(const unsigned idx, const float dist,
+							 dtCrowdNeighbour* neis, const unsigned nneis, const unsigned maxNeis)
+{
+	if (nneis < maxNeis)
 	{
-		if (nneis >= maxNeis)
-			return nneis;
-		nei = &neis[nneis];
+		unsigned i = nneis;
+		while (i > 0)
+		{
+			const unsigned parent = (i-1)/2;
+			if (neis[parent].dist >= dist)
+				break;
+			neis[i] = neis[parent];
+			i = parent;
+		}
+		neis[i].idx = idx;
+		neis[i].dist = dist;
+		return nneis+1;
 	}
-	else
+
+	if (maxNeis == 0 || dist >= neis[0].dist)
+		return nneis;
+
+	neis[0].idx = idx;
+	neis[0].dist = dist;
+	siftDownNeighbour(neis, nneis, 0);
+	return nneis;
+}
+
+// Sorts the heap of neighbours, nearest first.
+static void sortNeighbours(dtCrowdNeighbour* neis, const unsigned nneis)
+{
+	for (unsigned n = nneis; n > 1; --n)
 	{
-		int i;
-		for (i = 0; i < nneis; ++i)
-			if (dist <= neis[i].dist)
-				break;
-		
-		const int tgt = i+1;
-		const int n = dtMin(nneis-i, maxNeis-tgt);
-		
-		dtAssert(tgt+n <= maxNeis);
-		
-		if (n > 0)
-			memmove(&neis[tgt], &neis[i], sizeof(dtCrowdNeighbour)*n);
-		nei = &neis[i];
+		dtSwap(neis[0], neis[n-1]);
+		siftDownNeighbour(neis, n-1, 0);
 	}
-	
-	memset(nei, 0, sizeof(dtCrowdNeighbour));
-	
-	nei->idx = idx;
-	nei->dist = dist;
-	
-	return dtMin(nneis+1, maxNeis);
 }
 
 
@@ -144,6 +164,16 @@ For a more complete documentation, check the @ref crowd module.
 
 static const int MAX_AVOIDANCE_PARAMS = 4;
 
+inline unsigned hashBehavior(const dtBehavior* behavior)
+{
+	// The low bits of the addresses are mostly zero because of the alignment.
+	unsigned h = (unsigned)((size_t)behavior >> 4);
+	h ^= h >> 16;
+	h *= 0x45d9f3bu;
+	h ^= h >> 16;
+	return h;
+}
+
 dtCrowd::dtCrowd() :
 	m_crowdQuery(0),
 	m_agentsEnv(0),
@@ -152,10 +182,23 @@ dtCrowd::dtCrowd() :
 	m_agents(0),
 	m_activeAgents(0),
 	m_agentsToUpdate(0),
+	m_behaviorAgents(0),
+	m_behaviorAgentGroups(0),
+	m_behaviorBatch(0),
+	m_groupBehaviors(0),
+	m_groupEnds(0),
+	m_behaviorSlots(0),
+	m_behaviorSlotMask(0),
+	m_neighbours(0),
+	m_maxNeighbours(0),
 	m_maxAgentRadius(0),
 	m_maxCommonNodes(512),
-	m_disp(0)
+	m_disp(0),
+	m_startPolys(0),
+	m_startPos(0),
+	m_spreadPeriodicTasks(false)
 {
+	m_boundaryUpdates.reset();
 }
 
 dtCrowd::~dtCrowd()
@@ -180,6 +223,13 @@ void dtCrowd::purge()
 		m_disp = 0;
 	}
 
+	dtFree(m_startPolys);
+	m_startPolys = 0;
+	dtFree(m_startPos);
+	m_startPos = 0;
+
+	m_wallCache.purge();
+
 	dtFree(m_agents);
 	m_agents = 0;
 	m_maxAgents = 0;
@@ -191,6 +241,24 @@ void dtCrowd::purge()
 	dtFree(m_agentsToUpdate);
 	m_agentsToUpdate = 0;
 
+	dtFree(m_behaviorAgents);
+	m_behaviorAgents = 0;
+	dtFree(m_behaviorAgentGroups);
+	m_behaviorAgentGroups = 0;
+	dtFree(m_behaviorBatch);
+	m_behaviorBatch = 0;
+	dtFree(m_groupBehaviors);
+	m_groupBehaviors = 0;
+	dtFree(m_groupEnds);
+	m_groupEnds = 0;
+	dtFree(m_behaviorSlots);
+	m_behaviorSlots = 0;
+	m_behaviorSlotMask = 0;
+
+	dtFree(m_neighbours);
+	m_neighbours = 0;
+	m_maxNeighbours = 0;
+
 	if (m_crowdQuery)
 	{
 		m_crowdQuery->~dtCrowdQuery();
@@ -205,7 +273,8 @@ void dtCrowd::purge()
 /// @par
 ///
 /// May be called more than once to purge and re-initialize the crowd.
-bool dtCrowd::init(const unsigned maxAgents, const float maxAgentRadius, dtNavMesh* nav)
+bool dtCrowd::init(const unsigned maxAgents, const float maxAgentRadius, dtNavMesh* nav,
+				   const unsigned maxNeighbours)
 {
 	purge();
 
@@ -214,6 +283,19 @@ bool dtCrowd::init(const unsigned maxAgents, const float maxAgentRadius, dtNavMe
 	for (unsigned i = 0; i < maxAgents; ++i)
 		m_disp[i] = (float*) dtAlloc(sizeof(float) * 3, DT_ALLOC_PERM);
 
+	m_startPolys = (dtPolyRef*) dtAlloc(sizeof(dtPolyRef) * maxAgents, DT_ALLOC_PERM);
+	m_startPos = (float*) dtAlloc(sizeof(float) * 3 * maxAgents, DT_ALLOC_PERM);
+	if (!m_startPolys || !m_startPos)
+		return false;
+
+	// Room for the neighbourhoods of the agents, each polygon having a handful of walls.
+	// Dense crowds share most of their polygons, hence the upper bound.
+	static const unsigned WALL_CACHE_POLYS_PER_AGENT = 16;
+	static const unsigned WALL_CACHE_SEGS_PER_POLY = 4;
+	const unsigned maxCachedPolys = dtClamp(maxAgents*WALL_CACHE_POLYS_PER_AGENT, 256u, 4096u);
+	if (!m_wallCache.init(maxCachedPolys, maxCachedPolys*WALL_CACHE_SEGS_PER_POLY))
+		return false;
+
 	// Creation of the crowd query
 	void* mem = (dtCrowdQuery*) dtAlloc(sizeof(dtCrowdQuery), DT_ALLOC_PERM);
 	if (!mem)
@@ -225,6 +307,18 @@ bool dtCrowd::init(const unsigned maxAgents, const float maxAgentRadius, dtNavMe
 
 	for (unsigned i = 0; i < maxAgents; ++i)
 		new(&m_agentsEnv[i]) dtCrowdAgentEnvironment();
+
+	// The neighbors of all the agents are stored in a single buffer.
+	m_neighbours = (dtCrowdNeighbour*) dtAlloc(sizeof(dtCrowdNeighbour) * maxAgents * dtMax(maxNeighbours, 1u), DT_ALLOC_PERM);
+	if (!m_neighbours)
+		return false;
+
+	m_maxNeighbours = maxNeighbours;
+	for (unsigned i = 0; i < maxAgents; ++i)
+	{
+		m_agentsEnv[i].neighbors = &m_neighbours[i * maxNeighbours];
+		m_agentsEnv[i].maxNeighbors = maxNeighbours;
+	}
 				
 	m_maxAgents = maxAgents;
 	m_maxAgentRadius = maxAgentRadius;
@@ -242,6 +336,8 @@ bool dtCrowd::init(const unsigned maxAgents, const float maxAgentRadius, dtNavMe
 		return false;
 
 	m_crowdQuery = new(mem) dtCrowdQuery(maxAgents, m_agents, m_agentsEnv);
+	m_crowdQuery->m_spreadPeriodicTasks = m_spreadPeriodicTasks;
+	m_crowdQuery->m_maxNeighbours = maxNeighbours;
 
 	if (dtStatusFailed(m_crowdQuery->getNavMeshQuery()->init(nav, m_maxCommonNodes)))
 		return false;
@@ -249,6 +345,18 @@ bool dtCrowd::init(const unsigned maxAgents, const float maxAgentRadius, dtNavMe
 	m_activeAgents = (dtCrowdAgent**)dtAlloc(sizeof(dtCrowdAgent*) * m_maxAgents, DT_ALLOC_PERM);
 	if (!m_activeAgents)
 		return false;
+
+	// At most one group per agent, the table being kept at most half full.
+	const unsigned nbSlots = dtNextPow2(m_maxAgents * 2);
+	m_behaviorAgents = (dtCrowdAgent**)dtAlloc(sizeof(dtCrowdAgent*) * m_maxAgents, DT_ALLOC_PERM);
+	m_behaviorAgentGroups = (unsigned*)dtAlloc(sizeof(unsigned) * m_maxAgents, DT_ALLOC_PERM);
+	m_behaviorBatch = (dtCrowdAgent**)dtAlloc(sizeof(dtCrowdAgent*) * m_maxAgents, DT_ALLOC_PERM);
+	m_groupBehaviors = (dtBehavior**)dtAlloc(sizeof(dtBehavior*) * m_maxAgents, DT_ALLOC_PERM);
+	m_groupEnds = (unsigned*)dtAlloc(sizeof(unsigned) * m_maxAgents, DT_ALLOC_PERM);
+	m_behaviorSlots = (BehaviorSlot*)dtAlloc(sizeof(BehaviorSlot) * nbSlots, DT_ALLOC_PERM);
+	if (!m_behaviorAgents || !m_behaviorAgentGroups || !m_behaviorBatch || !m_groupBehaviors || !m_groupEnds || !m_behaviorSlots)
+		return false;
+	m_behaviorSlotMask = nbSlots - 1;
 	
 	for (unsigned i = 0; i < m_maxAgents; ++i)
 	{
@@ -381,6 +489,14 @@ void dtCrowd::updateVelocity(const float dt, unsigned* agentsIdx, unsigned nbIdx
 		nbIdx = m_maxAgents;
 	}
 
+	m_crowdQuery->m_updateCount++;
+
+	// Each behavior updates all its agents at once, in the order of their first appearance.
+	// The groups are numbered through the behavior table, then filled by a counting sort.
+	unsigned nbAgents = 0;
+	unsigned nbGroups = 0;
+	memset(m_behaviorSlots, 0, sizeof(BehaviorSlot) * (m_behaviorSlotMask + 1));
+
 	for (unsigned i = 0; i < nbIdx; ++i)
 	{
 		dtCrowdAgent* ag = 0;
@@ -388,11 +504,53 @@ void dtCrowd::updateVelocity(const float dt, unsigned* agentsIdx, unsigned nbIdx
 		if (!getActiveAgent(&ag, agentsIdx[i]))
 			continue;
 		
-        // Reinitialize the desired velocity to 0. as it needs to be set by the behaviors.
-        dtVset(ag->desiredVelocity, 0.f, 0.f, 0.f);
-        
-		if (ag->behavior)
-			ag->behavior->update(*m_crowdQuery, *ag, *ag, dt);
+		if (!ag->behavior)
+		{
+			dtVset(ag->desiredVelocity, 0.f, 0.f, 0.f);
+			continue;
+		}
+
+		unsigned slot = hashBehavior(ag->behavior) & m_behaviorSlotMask;
+		while (m_behaviorSlots[slot].behavior && m_behaviorSlots[slot].behavior != ag->behavior)
+			slot = (slot + 1) & m_behaviorSlotMask;
+
+		if (!m_behaviorSlots[slot].behavior)
+		{
+			m_behaviorSlots[slot].behavior = ag->behavior;
+			m_behaviorSlots[slot].group = nbGroups;
+			m_groupBehaviors[nbGroups] = ag->behavior;
+			m_groupEnds[nbGroups] = 0;
+			++nbGroups;
+		}
+
+		const unsigned group = m_behaviorSlots[slot].group;
+		m_groupEnds[group]++;
+		m_behaviorAgentGroups[nbAgents] = group;
+		m_behaviorAgents[nbAgents++] = ag;
+	}
+
+	// The counts become the starts of the groups, and the ends once the agents are placed.
+	unsigned start = 0;
+	for (unsigned i = 0; i < nbGroups; ++i)
+	{
+		const unsigned count = m_groupEnds[i];
+		m_groupEnds[i] = start;
+		start += count;
+	}
+
+	for (unsigned i = 0; i < nbAgents; ++i)
+		m_behaviorBatch[m_groupEnds[m_behaviorAgentGroups[i]]++] = m_behaviorAgents[i];
+
+	for (unsigned i = 0; i < nbGroups; ++i)
+	{
+		const unsigned begin = (i == 0) ? 0 : m_groupEnds[i - 1];
+		const unsigned nbBatch = m_groupEnds[i] - begin;
+
+		// Reinitialize the desired velocity to 0. as it needs to be set by the behaviors.
+		for (unsigned j = begin; j < m_groupEnds[i]; ++j)
+			dtVset(m_behaviorBatch[j]->desiredVelocity, 0.f, 0.f, 0.f);
+
+		m_groupBehaviors[i]->updateBatch(*m_crowdQuery, m_behaviorBatch + begin, nbBatch, dt);
 	}
 
 	// Fake dynamic constraint
@@ -430,8 +588,8 @@ void dtCrowd::updatePosition(const float dt, unsigned* agentsIdx, unsigned nbIdx
 	nbIdx = (nbIdx < m_maxAgents) ? nbIdx : m_maxAgents;
 
 	// The current start position of the agent (not yet modified)
-	dtPolyRef* currentPosPoly = (dtPolyRef*) dtAlloc(sizeof(dtPolyRef) * nbIdx, DT_ALLOC_TEMP);
-	float* currentPos = (float*) dtAlloc(sizeof(float) * 3 * nbIdx, DT_ALLOC_TEMP);
+	dtPolyRef* currentPosPoly = m_startPolys;
+	float* currentPos = m_startPos;
 
 	for (unsigned i = 0; i < nbIdx; ++i)
 	{
@@ -599,8 +757,6 @@ void dtCrowd::updatePosition(const float dt, unsigned* agentsIdx, unsigned nbIdx
 		}
 	}
 
-	dtFree(currentPosPoly);
-	dtFree(currentPos);
 }
 
 void dtCrowd::updateEnvironment(unsigned* agentsIdx, unsigned nbIdx)
@@ -614,6 +770,8 @@ void dtCrowd::updateEnvironment(unsigned* agentsIdx, unsigned nbIdx)
 
 	nbIdx = (nbIdx < m_maxAgents) ? nbIdx : m_maxAgents;
 
+	unsigned nbBoundaryUpdates = 0;
+
 	// Get nearby navmesh segments and agents to collide with.
 	for (unsigned i = 0; i < nbIdx; ++i)
 	{
@@ -629,8 +787,9 @@ void dtCrowd::updateEnvironment(unsigned* agentsIdx, unsigned nbIdx)
 			m_agentsEnv[ag->id].boundary.reset();
 
 		// Update the collision boundary after certain distance has been passed or
-		// if it has become invalid.
-		const float updateThr = ag->perceptionDistance * 0.25f;
+		// if it has become invalid. The distance is jittered so that agents moving
+		// together do not update their boundaries at the same time.
+		const float updateThr = ag->perceptionDistance * 0.25f * (1.f - 0.5f * m_crowdQuery->getAgentPhase(ag->id));
 		if (dtVdist2DSqr(ag->position, m_agentsEnv[ag->id].boundary.getCenter()) > dtSqr(updateThr) ||
 			!m_agentsEnv[ag->id].boundary.isValid(m_crowdQuery->getNavMeshQuery(), m_crowdQuery->getQueryFilter()))
 		{
@@ -639,7 +798,8 @@ void dtCrowd::updateEnvironment(unsigned* agentsIdx, unsigned nbIdx)
 			m_crowdQuery->getNavMeshQuery()->findNearestPoly(ag->position, m_crowdQuery->getQueryExtents(), m_crowdQuery->getQueryFilter(), &ref, nearest);
 
 			m_agentsEnv[ag->id].boundary.update(ref, ag->position, ag->perceptionDistance, 
-				m_crowdQuery->getNavMeshQuery(), m_crowdQuery->getQueryFilter());
+				m_crowdQuery->getNavMeshQuery(), m_crowdQuery->getQueryFilter(), &m_wallCache);
+			nbBoundaryUpdates++;
 		}
 		// Query neighbour agents
 		m_agentsEnv[ag->id].nbNeighbors = this->computeNeighbors(ag->id);
@@ -647,6 +807,28 @@ void dtCrowd::updateEnvironment(unsigned* agentsIdx, unsigned nbIdx)
 		for (unsigned j = 0; j < m_agentsEnv[ag->id].nbNeighbors; j++)
 			m_agentsEnv[ag->id].neighbors[j].idx = getAgentIndex(&m_agents[m_agentsEnv[ag->id].neighbors[j].idx]);
 	}
+
+	m_boundaryUpdates.add(nbBoundaryUpdates);
+}
+
+void dtCrowd::setPeriodicTaskSpreading(bool enabled)
+{
+	m_spreadPeriodicTasks = enabled;
+
+	if (m_crowdQuery)
+		m_crowdQuery->m_spreadPeriodicTasks = enabled;
+}
+
+bool dtCrowd::setAgentMaxNeighbours(unsigned id, unsigned maxNeighbours)
+{
+	if (id >= m_maxAgents || maxNeighbours > m_maxNeighbours)
+		return false;
+
+	dtCrowdAgentEnvironment& env = m_agentsEnv[id];
+	env.maxNeighbors = maxNeighbours;
+	env.nbNeighbors = dtMin(env.nbNeighbors, maxNeighbours);
+
+	return true;
 }
 	
 void dtCrowd::update(const float dt, unsigned* indexList, unsigned nbIndex)
@@ -737,6 +919,7 @@ unsigned dtCrowd::computeNeighbors(unsigned id)
 {
 	unsigned n = 0;
 	const dtCrowdAgent* agent = m_crowdQuery->getAgent(id);
+	dtCrowdAgentEnvironment& env = m_agentsEnv[id];
 
 	for (unsigned i = 0; i < m_maxAgents; ++i)
 	{
@@ -759,9 +942,11 @@ unsigned dtCrowd::computeNeighbors(unsigned id)
 		if (dist2D > dtSqr(agent->perceptionDistance))
 			continue;
 
-		n = addNeighbour(target->id, dist2D, m_agentsEnv[agent->id].neighbors, n, DT_CROWDAGENT_MAX_NEIGHBOURS);
+		n = addNeighbour(target->id, dist2D, env.neighbors, n, env.maxNeighbors);
 	}
 
+	sortNeighbours(env.neighbors, n);
+
 	return n;
 }
 
@@ -774,7 +959,10 @@ dtCrowdQuery::~dtCrowdQuery()
 dtCrowdQuery::dtCrowdQuery(unsigned maxAgents, const dtCrowdAgent* agents, const dtCrowdAgentEnvironment* env)
 	: m_agents(agents),
 	m_maxAgents(maxAgents),
-	m_agentsEnv(env)
+	m_agentsEnv(env),
+	m_updateCount(0),
+	m_maxNeighbours(0),
+	m_spreadPeriodicTasks(false)
 {
 	m_navMeshQuery = dtAllocNavMeshQuery();
 }
@@ -852,6 +1040,32 @@ const dtCrowdAgentEnvironment* dtCrowdQuery::getAgentEnvironment(unsigned id) co
 	return 0;
 }
 
+unsigned dtCrowdQuery::getUpdateCount() const
+{
+	return m_updateCount;
+}
+
+unsigned dtCrowdQuery::getMaxNeighbours() const
+{
+	return m_maxNeighbours;
+}
+
+unsigned dtCrowdQuery::getMaxAgents() const
+{
+	return m_maxAgents;
+}
+
+float dtCrowdQuery::getAgentPhase(unsigned id) const
+{
+	if (!m_spreadPeriodicTasks)
+		return 0.f;
+
+	// The fractional parts of the multiples of the golden ratio are evenly spread,
+	// whatever the number of agents.
+	const float phase = (float)id * 0.6180339887f;
+	return phase - floorf(phase);
+}
+
 dtOffMeshConnection* dtCrowdQuery::getOffMeshConnection(unsigned id, float dist) const
 {
 	// Check validity of the ID
@@ -923,8 +1137,22 @@ void dtCrowdQuery::startOffMeshConnection(dtCrowdAgent& ag, const dtOffMeshConne
 	ag.state = DT_CROWDAGENT_STATE_OFFMESH;
 }
 
+void dtCrowdWorkHistogram::reset()
+{
+	memset(this, 0, sizeof(*this));
+}
+
+void dtCrowdWorkHistogram::add(unsigned tasks)
+{
+	updates[dtMin<unsigned>(tasks, DT_CROWD_WORK_HISTOGRAM_SIZE-1)]++;
+	maxTasks = dtMax(maxTasks, tasks);
+	totalTasks += tasks;
+}
+
 dtCrowdAgentEnvironment::dtCrowdAgentEnvironment() 
-	: nbNeighbors(0) 
+	: neighbors(0)
+	, nbNeighbors(0)
+	, maxNeighbors(0)
 {
 	boundary.reset();
 }
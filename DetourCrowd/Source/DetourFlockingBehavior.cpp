@@ -42,6 +42,7 @@ dtFlockingBehavior::dtFlockingBehavior(unsigned nbMaxAgents, float separationWei
 	m_separationBehavior = dtSeparationBehavior::allocate(nbMaxAgents);
 	m_cohesionBehavior = dtCohesionBehavior::allocate(nbMaxAgents);
 	m_alignmentBehavior = dtAlignmentBehavior::allocate(nbMaxAgents);
+	enableSimd(true);
 }
 
 dtFlockingBehavior::~dtFlockingBehavior()
@@ -77,14 +78,8 @@ void dtFlockingBehavior::computeForce(const dtCrowdQuery& query, const dtCrowdAg
 	unsigned* neighborsList = currentParams.toFlockWith;
 	unsigned nbNeighbors = currentParams.nbflockingTargets;
 
-	const dtCrowdAgent** agents = (const dtCrowdAgent**) dtAlloc(sizeof(dtCrowdAgent*) * nbNeighbors, DT_ALLOC_TEMP);
-	query.getAgents(neighborsList, nbNeighbors, agents);
-
-	if (!agents || nbNeighbors == 0 || !neighborsList || !m_separationBehavior)
-	{
-		dtFree(agents);
+	if (nbNeighbors == 0 || !neighborsList || !m_separationBehavior)
 		return;
-	}
 
 	dtSeparationBehaviorParams* separationParams;	
 	dtCohesionBehaviorParams* cohesionParams;
@@ -102,10 +97,7 @@ void dtFlockingBehavior::computeForce(const dtCrowdQuery& query, const dtCrowdAg
 		alignmentParams = m_alignmentBehavior->getBehaviorParams(oldAgent.id);
 
 	if (!separationParams || !cohesionParams || !alignmentParams)
-	{
-		dtFree(agents);
 		return;
-	}
 
 	separationParams->targetsID = neighborsList;
 	separationParams->nbTargets = nbNeighbors;
@@ -130,7 +122,5 @@ void dtFlockingBehavior::computeForce(const dtCrowdQuery& query, const dtCrowdAg
 	dtVmad(force, force, cohesionForce, cohesionWeight);
 	dtVmad(force, force, alignmentForce, alignmentWeight);
 
-	dtFree(agents);
-
 	force[1] = 0;
 }
@@ -22,6 +22,149 @@
 #include "DetourNavMeshQuery.h"
 #include "DetourCommon.h"
 #include "DetourAssert.h"
+#include "DetourAlloc.h"
+#include "DetourNode.h"
+
+dtWallSegmentCache::dtWallSegmentCache() :
+	m_buckets(0),
+	m_bucketMask(0),
+	m_entries(0),
+	m_nentries(0),
+	m_maxEntries(0),
+	m_segments(0),
+	m_nsegments(0),
+	m_maxSegments(0),
+	m_nav(0),
+	m_navRevision(0),
+	m_includeFlags(0),
+	m_excludeFlags(0)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+dtWallSegmentCache::~dtWallSegmentCache()
+{
+	purge();
+}
+
+bool dtWallSegmentCache::init(const int maxPolys, const int maxSegments)
+{
+	purge();
+
+	const int nbuckets = (int)dtNextPow2((unsigned int)maxPolys);
+	m_buckets = (int*)dtAlloc(sizeof(int)*nbuckets, DT_ALLOC_PERM);
+	m_entries = (Entry*)dtAlloc(sizeof(Entry)*maxPolys, DT_ALLOC_PERM);
+	m_segments = (float*)dtAlloc(sizeof(float)*6*maxSegments, DT_ALLOC_PERM);
+	if (!m_buckets || !m_entries || !m_segments)
+	{
+		purge();
+		return false;
+	}
+
+	m_bucketMask = nbuckets-1;
+	m_maxEntries = maxPolys;
+	m_maxSegments = maxSegments;
+	clear();
+
+	return true;
+}
+
+void dtWallSegmentCache::purge()
+{
+	dtFree(m_buckets);
+	dtFree(m_entries);
+	dtFree(m_segments);
+	m_buckets = 0;
+	m_bucketMask = 0;
+	m_entries = 0;
+	m_nentries = 0;
+	m_maxEntries = 0;
+	m_segments = 0;
+	m_nsegments = 0;
+	m_maxSegments = 0;
+	m_nav = 0;
+}
+
+void dtWallSegmentCache::clear()
+{
+	if (m_buckets)
+		memset(m_buckets, 0xff, sizeof(int)*(m_bucketMask+1));
+	m_nentries = 0;
+	m_nsegments = 0;
+}
+
+/// @par
+///
+/// The cache is emptied when it is full, so the segments of a polygon are queried again
+/// at most once per flush.
+int dtWallSegmentCache::getWallSegments(dtPolyRef ref, const dtNavMeshQuery* navquery, const dtQueryFilter* filter,
+										const float** segments)
+{
+	static const int MAX_SEGS_PER_POLY = DT_VERTS_PER_POLYGON*3;
+
+	dtAssert(navquery);
+	dtAssert(filter);
+	dtAssert(segments);
+
+	*segments = 0;
+	if (!m_buckets)
+		return 0;
+
+	// Drop the segments computed for another state of the navigation mesh or another filter.
+	const dtNavMesh* nav = navquery->getAttachedNavMesh();
+	if (nav != m_nav || nav->getRevision() != m_navRevision ||
+		filter->getIncludeFlags() != m_includeFlags || filter->getExcludeFlags() != m_excludeFlags)
+	{
+		if (m_nentries)
+			m_stats.flushes++;
+		clear();
+		m_nav = nav;
+		m_navRevision = nav->getRevision();
+		m_includeFlags = filter->getIncludeFlags();
+		m_excludeFlags = filter->getExcludeFlags();
+	}
+
+	const unsigned int bucket = dtHashRef(ref) & m_bucketMask;
+	for (int i = m_buckets[bucket]; i != -1; i = m_entries[i].next)
+	{
+		const Entry& entry = m_entries[i];
+		if (entry.ref == ref)
+		{
+			m_stats.hits++;
+			*segments = &m_segments[entry.firstSegment*6];
+			return entry.nsegments;
+		}
+	}
+
+	m_stats.misses++;
+
+	float segs[MAX_SEGS_PER_POLY*6];
+	int nsegs = 0;
+	if (dtStatusFailed(navquery->getPolyWallSegments(ref, filter, segs, 0, &nsegs, MAX_SEGS_PER_POLY)))
+		return 0;
+
+	if (m_nentries >= m_maxEntries || m_nsegments+nsegs > m_maxSegments)
+	{
+		m_stats.flushes++;
+		clear();
+		if (nsegs > m_maxSegments)
+			return 0;
+	}
+
+	Entry& entry = m_entries[m_nentries];
+	entry.ref = ref;
+	entry.firstSegment = m_nsegments;
+	entry.nsegments = nsegs;
+	entry.next = m_buckets[bucket];
+	m_buckets[bucket] = m_nentries++;
+
+	float* dst = &m_segments[m_nsegments*6];
+	memcpy(dst, segs, sizeof(float)*6*nsegs);
+	m_nsegments += nsegs;
+
+	*segments = dst;
+	return nsegs;
+}
 
 
 dtLocalBoundary::dtLocalBoundary() :
@@ -82,7 +225,7 @@ void dtLocalBoundary::addSegment(const float dist, const float* s)
 }
 
 void dtLocalBoundary::update(dtPolyRef ref, const float* pos, const float collisionQueryRange,
-							 dtNavMeshQuery* navquery, const dtQueryFilter* filter)
+							 dtNavMeshQuery* navquery, const dtQueryFilter* filter, dtWallSegmentCache* cache)
 {
 	static const int MAX_SEGS_PER_POLY = DT_VERTS_PER_POLYGON*3;
 	
@@ -106,10 +249,15 @@ void dtLocalBoundary::update(dtPolyRef ref, const float* pos, const float collis
 	int nsegs = 0;
 	for (int j = 0; j < m_npolys; ++j)
 	{
-		navquery->getPolyWallSegments(m_polys[j], filter, segs, 0, &nsegs, MAX_SEGS_PER_POLY);
+		const float* polySegs = segs;
+		if (cache)
+			nsegs = cache->getWallSegments(m_polys[j], navquery, filter, &polySegs);
+		else
+			navquery->getPolyWallSegments(m_polys[j], filter, segs, 0, &nsegs, MAX_SEGS_PER_POLY);
+
 		for (int k = 0; k < nsegs; ++k)
 		{
-			const float* s = &segs[k*6];
+			const float* s = &polySegs[k*6];
 			// Skip too distant segments.
 			float tseg;
 			const float distSqr = dtDistancePtSegSqr2D(pos, s, s+3, tseg);
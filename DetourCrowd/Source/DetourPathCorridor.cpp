@@ -197,10 +197,145 @@ may be needed.  E.g. If you move the target, check #getLastPoly() to see if it i
 
 */
 
+dtPathCorridorPool::dtPathCorridorPool() :
+	m_slabs(0),
+	m_slabTop(0),
+	m_slabLeft(0)
+{
+	memset(m_freeBlocks, 0, sizeof(m_freeBlocks));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+dtPathCorridorPool::~dtPathCorridorPool()
+{
+	dtAssert(m_stats.blockCount == 0);
+
+	while (m_slabs)
+	{
+		Slab* next = m_slabs->next;
+		dtFree(m_slabs);
+		m_slabs = next;
+	}
+}
+
+int dtPathCorridorPool::getBlockSize(const int size)
+{
+	int blockSize = MIN_BLOCK_SIZE;
+	for (int i = 0; i < MAX_CLASSES; ++i, blockSize *= 2)
+	{
+		if (blockSize >= size)
+			return blockSize;
+	}
+	return 0;
+}
+
+static int getBlockClass(const int blockSize)
+{
+	int cls = 0;
+	while ((dtPathCorridorPool::MIN_BLOCK_SIZE << cls) < blockSize)
+		cls++;
+	return cls;
+}
+
+void dtPathCorridorPool::addFreeBlocks(dtPolyRef* data, int size)
+{
+	// Split the space in the largest possible blocks.
+	while (size >= MIN_BLOCK_SIZE)
+	{
+		int cls = MAX_CLASSES-1;
+		while ((MIN_BLOCK_SIZE << cls) > size)
+			cls--;
+
+		FreeBlock* block = (FreeBlock*)data;
+		block->next = m_freeBlocks[cls];
+		m_freeBlocks[cls] = block;
+
+		data += MIN_BLOCK_SIZE << cls;
+		size -= MIN_BLOCK_SIZE << cls;
+	}
+}
+
+/// @par
+///
+/// The buffers are taken from the free lists first, then from the last slab. A new slab is
+/// only allocated when both are exhausted, the rest of the last slab being split into free buffers.
+dtPolyRef* dtPathCorridorPool::alloc(const int size, int* capacity)
+{
+	dtAssert(capacity);
+
+	const int blockSize = getBlockSize(size);
+	if (!blockSize)
+		return 0;
+	const int cls = getBlockClass(blockSize);
+
+	dtPolyRef* data = 0;
+	if (m_freeBlocks[cls])
+	{
+		data = (dtPolyRef*)m_freeBlocks[cls];
+		m_freeBlocks[cls] = m_freeBlocks[cls]->next;
+	}
+	else
+	{
+		if (m_slabLeft < blockSize)
+		{
+			const int slabSize = dtMax((int)SLAB_SIZE, blockSize);
+			Slab* slab = (Slab*)dtAlloc(sizeof(Slab) + sizeof(dtPolyRef)*slabSize, DT_ALLOC_PERM);
+			if (!slab)
+				return 0;
+
+			addFreeBlocks(m_slabTop, m_slabLeft);
+
+			slab->next = m_slabs;
+			slab->size = slabSize;
+			m_slabs = slab;
+			m_slabTop = (dtPolyRef*)(slab+1);
+			m_slabLeft = slabSize;
+
+			m_stats.slabCount++;
+			m_stats.reservedRefs += slabSize;
+		}
+
+		data = m_slabTop;
+		m_slabTop += blockSize;
+		m_slabLeft -= blockSize;
+	}
+
+	m_stats.allocatedRefs += blockSize;
+	m_stats.blockCount++;
+
+	*capacity = blockSize;
+	return data;
+}
+
+void dtPathCorridorPool::free(dtPolyRef* path, const int capacity)
+{
+	if (!path)
+		return;
+
+	dtAssert(getBlockSize(capacity) == capacity);
+	const int cls = getBlockClass(capacity);
+
+	FreeBlock* block = (FreeBlock*)path;
+	block->next = m_freeBlocks[cls];
+	m_freeBlocks[cls] = block;
+
+	m_stats.allocatedRefs -= capacity;
+	m_stats.blockCount--;
+}
+
+void dtPathCorridorPool::getStats(dtPathCorridorPoolStats* stats) const
+{
+	dtAssert(stats);
+	*stats = m_stats;
+}
+
 dtPathCorridor::dtPathCorridor() :
 	m_path(0),
 	m_npath(0),
 	m_maxPath(0),
+	m_capacity(0),
+	m_pool(0),
+	m_revision(0),
 	m_isSet(false)
 {
 }
@@ -209,6 +344,9 @@ dtPathCorridor::dtPathCorridor(const dtPathCorridor& o) :
 	m_path(0),
 	m_npath(0),
 	m_maxPath(0),
+	m_capacity(0),
+	m_pool(0),
+	m_revision(0),
 	m_isSet(false)
 {
 	if (this != &o)
@@ -216,16 +354,16 @@ dtPathCorridor::dtPathCorridor(const dtPathCorridor& o) :
 		dtVcopy(m_pos, o.m_pos);
 		dtVcopy(m_target, o.m_target);
 
-		m_npath = o.m_npath;
 		m_maxPath = o.m_maxPath;
-		m_isSet = o.m_isSet;
+		m_pool = o.m_pool;
+		m_revision = o.m_revision;
 
-		if (m_maxPath)
+		// The path is only copied once its buffer is allocated, the corridor is left empty otherwise.
+		if (o.m_path && allocPath(o.m_capacity))
 		{
-			m_path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef) * m_maxPath, DT_ALLOC_PERM);
-
-			for (int i = 0; i < m_maxPath; ++i)
-				m_path[i] = o.m_path[i];
+			m_npath = o.m_npath;
+			m_isSet = o.m_isSet;
+			memcpy(m_path, o.m_path, sizeof(dtPolyRef) * m_npath);
 		}
 	}	
 }
@@ -238,21 +376,31 @@ dtPathCorridor& dtPathCorridor::operator=(const dtPathCorridor& o)
 		dtVcopy(m_pos, o.m_pos);
 		dtVcopy(m_target, o.m_target);
 
-		m_npath = o.m_npath;
-		m_maxPath = o.m_maxPath;
-		m_isSet = o.m_isSet;
+		m_revision = o.m_revision;
 		
-		if (m_path)
-			dtFree(m_path);
+		// Keep the buffer when it has the same size, so that copying corridors back
+		// and forth (see: dtParametrizedBehavior::update) does not allocate.
+		if (!o.m_path || m_pool != o.m_pool || m_capacity != o.m_capacity || m_maxPath != o.m_maxPath)
+		{
+			freePath();
 
-		m_path = 0;
+			m_pool = o.m_pool;
+			m_maxPath = o.m_maxPath;
+			if (o.m_path)
+				allocPath(o.m_capacity);
+		}
 
-		if (o.m_path)
+		// The path is only copied once its buffer is secured, the corridor is left empty otherwise.
+		if (m_path)
 		{
-			m_path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef) * m_maxPath, DT_ALLOC_PERM);
-
-			for (int i = 0; i < m_maxPath; ++i)
-				m_path[i] = o.m_path[i];
+			m_npath = o.m_npath;
+			m_isSet = o.m_isSet;
+			memcpy(m_path, o.m_path, sizeof(dtPolyRef) * m_npath);
+		}
+		else
+		{
+			m_npath = 0;
+			m_isSet = false;
 		}
 	}
 
@@ -261,26 +409,99 @@ dtPathCorridor& dtPathCorridor::operator=(const dtPathCorridor& o)
 
 dtPathCorridor::~dtPathCorridor()
 {
-	dtFree(m_path);
+	freePath();
 }
 
 /// @par
 ///
+/// Without a pool, the buffer can hold @p maxPath polygons. With a pool, it starts small and is resized
+/// as the path grows and shrinks, so the memory used follows the actual length of the path.
+///
 /// @warning Cannot be called more than once.
-bool dtPathCorridor::init(const int maxPath)
+bool dtPathCorridor::init(const int maxPath, dtPathCorridorPool* pool)
 {
 	dtAssert(!m_path);
-	m_path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*maxPath, DT_ALLOC_PERM);
+	m_maxPath = maxPath;
+	m_pool = pool;
 
-	if (!m_path)
+	if (!allocPath(1))
 		return false;
 
 	m_npath = 0;
-	m_maxPath = maxPath;
+	m_revision++;
 
 	return true;
 }
 
+bool dtPathCorridor::allocPath(const int size)
+{
+	dtAssert(!m_path);
+
+	if (m_pool)
+	{
+		m_path = m_pool->alloc(dtMin(size, m_maxPath), &m_capacity);
+	}
+	else
+	{
+		m_path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*m_maxPath, DT_ALLOC_PERM);
+		m_capacity = m_maxPath;
+	}
+
+	if (!m_path)
+		m_capacity = 0;
+
+	return m_path != 0;
+}
+
+void dtPathCorridor::freePath()
+{
+	if (m_pool)
+		m_pool->free(m_path, m_capacity);
+	else
+		dtFree(m_path);
+
+	m_path = 0;
+	m_capacity = 0;
+}
+
+bool dtPathCorridor::resize(const int size)
+{
+	dtAssert(m_pool);
+
+	dtPolyRef* path = m_path;
+	const int capacity = m_capacity;
+
+	m_path = 0;
+	if (!allocPath(size))
+	{
+		m_path = path;
+		m_capacity = capacity;
+		return false;
+	}
+
+	m_npath = dtMin(m_npath, getCapacity());
+	if (path)
+		memcpy(m_path, path, sizeof(dtPolyRef)*m_npath);
+	m_pool->free(path, capacity);
+
+	return true;
+}
+
+bool dtPathCorridor::reserve(const int size)
+{
+	if (m_pool && m_capacity < dtMin(size, m_maxPath))
+		return resize(size);
+	return true;
+}
+
+void dtPathCorridor::compact()
+{
+	// Only shrink when the path is much shorter than the buffer, so that a path
+	// oscillating around a buffer size does not keep on moving.
+	if (m_pool && m_capacity > dtPathCorridorPool::MIN_BLOCK_SIZE && m_npath*4 <= m_capacity)
+		resize(m_npath);
+}
+
 /// @par
 ///
 /// Essentially, the corridor is set of one polygon in size with the target
@@ -292,6 +513,7 @@ void dtPathCorridor::reset(dtPolyRef ref, const float* pos)
 	dtVcopy(m_target, pos);
 	m_path[0] = ref;
 	m_npath = 1;
+	m_revision++;
 	m_isSet = true;
 }
 
@@ -314,12 +536,18 @@ int dtPathCorridor::findCorners(float* cornerVerts, unsigned char* cornerFlags,
 	dtAssert(m_path);
 	dtAssert(m_npath);
 	
-	static const float MIN_TARGET_DIST = 0.01f;
-	
 	int ncorners = 0;
 	navquery->findStraightPath(m_pos, m_target, m_path, m_npath,
 							   cornerVerts, cornerFlags, cornerPolys, &ncorners, maxCorners);
 	
+	return pruneCorners(cornerVerts, cornerFlags, cornerPolys, ncorners);
+}
+
+int dtPathCorridor::pruneCorners(float* cornerVerts, unsigned char* cornerFlags,
+								 dtPolyRef* cornerPolys, int ncorners) const
+{
+	static const float MIN_TARGET_DIST = 0.01f;
+
 	// Prune points in the beginning of the path which are too close.
 	while (ncorners)
 	{
@@ -354,6 +582,21 @@ void dtPathCorridor::optimizePathVisibility(const float* next, const float pathO
 {
 	dtAssert(m_path);
 	
+	dtRaycastRequest ray;
+	if (!getVisibilityRay(next, pathOptimizationRange, &ray))
+		return;
+	
+	static const int MAX_RES = 32;
+	dtPolyRef res[MAX_RES];
+	dtRaycastHit hit;
+	hit.status = navquery->raycast(ray.startRef, ray.startPos, ray.endPos, filter, &hit.t, hit.hitNormal, res, &hit.pathCount, MAX_RES);
+	applyVisibilityRay(hit, res);
+}
+
+bool dtPathCorridor::getVisibilityRay(const float* next, const float pathOptimizationRange, dtRaycastRequest* ray) const
+{
+	dtAssert(m_path);
+	
 	// Clamp the ray to max distance.
 	float goal[3];
 	dtVcopy(goal, next);
@@ -361,7 +604,7 @@ void dtPathCorridor::optimizePathVisibility(const float* next, const float pathO
 	
 	// If too close to the goal, do not try to optimize.
 	if (dist < 0.01f)
-		return;
+		return false;
 	
 	// Overshoot a little. This helps to optimize open fields in tiled meshes.
 	dist = dtMin(dist+0.01f, pathOptimizationRange);
@@ -371,24 +614,43 @@ void dtPathCorridor::optimizePathVisibility(const float* next, const float pathO
 	dtVsub(delta, goal, m_pos);
 	dtVmad(goal, m_pos, delta, pathOptimizationRange/dist);
 	
-	static const int MAX_RES = 32;
-	dtPolyRef res[MAX_RES];
-	float t, norm[3];
-	int nres = 0;
-	navquery->raycast(m_path[0], m_pos, goal, filter, &t, norm, res, &nres, MAX_RES);
-	if (nres > 1 && t > 0.99f)
+	ray->startRef = m_path[0];
+	dtVcopy(ray->startPos, m_pos);
+	dtVcopy(ray->endPos, goal);
+	return true;
+}
+
+/// @par
+///
+/// The shortcut is not taken if the pooled buffer cannot grow to hold it, since it could then cut the end of the path.
+bool dtPathCorridor::applyVisibilityRay(const dtRaycastHit& hit, const dtPolyRef* visited)
+{
+	dtAssert(m_path);
+	
+	if (dtStatusFailed(hit.status))
+		return false;
+	
+	if (hit.pathCount > 1 && hit.t > 0.99f && reserve(m_npath + hit.pathCount))
 	{
-		m_npath = dtMergeCorridorStartShortcut(m_path, m_npath, m_maxPath, res, nres);
+		m_npath = dtMergeCorridorStartShortcut(m_path, m_npath, getCapacity(), visited, hit.pathCount);
+		compact();
+		m_revision++;
+		return true;
 	}
+
+	return false;
 }
 
 // @see dtPathFollowing::localPathReplanningInterval
-bool dtPathCorridor::optimizePathTopology(dtNavMeshQuery* navquery, const dtQueryFilter* filter)
+bool dtPathCorridor::optimizePathTopology(dtNavMeshQuery* navquery, const dtQueryFilter* filter, int* doneIters)
 {
 	dtAssert(navquery);
 	dtAssert(filter);
 	dtAssert(m_path);
 	
+	if (doneIters)
+		*doneIters = 0;
+	
 	if (m_npath < 3)
 		return false;
 	
@@ -398,12 +660,15 @@ bool dtPathCorridor::optimizePathTopology(dtNavMeshQuery* navquery, const dtQuer
 	dtPolyRef res[MAX_RES];
 	int nres = 0;
 	navquery->initSlicedFindPath(m_path[0], m_path[m_npath-1], m_pos, m_target, filter);
-	navquery->updateSlicedFindPath(MAX_ITER, 0);
+	navquery->updateSlicedFindPath(MAX_ITER, doneIters);
 	dtStatus status = navquery->finalizeSlicedFindPathPartial(m_path, m_npath, res, &nres, MAX_RES);
 	
-	if (dtStatusSucceed(status) && nres > 0)
+	// The shortcut is not taken if the pooled buffer cannot grow to hold it, since it could then cut the end of the path.
+	if (dtStatusSucceed(status) && nres > 0 && reserve(m_npath + nres))
 	{
-		m_npath = dtMergeCorridorStartShortcut(m_path, m_npath, m_maxPath, res, nres);
+		m_npath = dtMergeCorridorStartShortcut(m_path, m_npath, getCapacity(), res, nres);
+		compact();
+		m_revision++;
 		return true;
 	}
 	
@@ -437,6 +702,7 @@ bool dtPathCorridor::moveOverOffmeshConnection(dtPolyRef offMeshConRef, dtPolyRe
 	for (int i = npos; i < m_npath; ++i)
 		m_path[i-npos] = m_path[i];
 	m_npath -= npos;
+	m_revision++;
 
 	refs[0] = prevRef;
 	refs[1] = polyRef;
@@ -468,8 +734,11 @@ depends on local polygon density, query search extents, etc.
 
 The resulting position will differ from the desired position if the desired position is not on the navigation mesh, 
 or it can't be reached using a local search.
+
+If the pooled buffer cannot grow to hold the adjusted corridor, the end of the path may be cut, leaving the target
+outside of the last polygon of the corridor. The caller should then move the target, as after #setCorridor.
 */
-void dtPathCorridor::movePosition(const float* npos, const dtNavMeshQuery* navquery, const dtQueryFilter* filter)
+bool dtPathCorridor::movePosition(const float* npos, const dtNavMeshQuery* navquery, const dtQueryFilter* filter)
 {
 	dtAssert(m_path);
 	dtAssert(m_npath);
@@ -481,13 +750,27 @@ void dtPathCorridor::movePosition(const float* npos, const dtNavMeshQuery* navqu
 	navquery->moveAlongSurface(m_path[0], m_pos, npos, filter,
 							   result, visited, &nvisited, MAX_VISITED);
 	
-	m_npath = dtMergeCorridorStartMoved(m_path, m_npath, m_maxPath, visited, nvisited);
+	const dtPolyRef firstPoly = m_path[0];
+	const int npath = m_npath;
+	// The merged path is at most this long, a merge cut short fills the buffer.
+	const int maxSize = m_npath + nvisited;
+	const bool fits = reserve(maxSize) && maxSize <= getCapacity();
+	m_npath = dtMergeCorridorStartMoved(m_path, m_npath, getCapacity(), visited, nvisited);
+	const bool complete = fits || m_npath < getCapacity();
+	compact();
+
+	// The merge only changes the start of the path, so the path is unchanged as
+	// long as the position stays in the same polygon.
+	if (m_path[0] != firstPoly || m_npath != npath)
+		m_revision++;
 	
 	// Adjust the position to stay on top of the navmesh.
 	float h = m_pos[1];
 	navquery->getPolyHeight(m_path[0], result, &h);
 	result[1] = h;
 	dtVcopy(m_pos, result);
+
+	return complete;
 }
 
 /**
@@ -502,8 +785,10 @@ Behavior:
 The expected use case is that the desired target will be 'near' the current corridor. What is considered 'near' depends on local polygon density, query search extents, etc.
 
 The resulting target will differ from the desired target if the desired target is not on the navigation mesh, or it can't be reached using a local search.
+
+If the pooled buffer cannot grow to hold the adjusted corridor, the target may be left beyond the last polygon of the corridor.
 */
-void dtPathCorridor::moveTargetPosition(const float* npos, dtNavMeshQuery* navquery, const dtQueryFilter* filter)
+bool dtPathCorridor::moveTargetPosition(const float* npos, dtNavMeshQuery* navquery, const dtQueryFilter* filter)
 {
 	dtAssert(m_path);
 	dtAssert(m_npath);
@@ -515,7 +800,13 @@ void dtPathCorridor::moveTargetPosition(const float* npos, dtNavMeshQuery* navqu
 	int nvisited = 0;
 	navquery->moveAlongSurface(m_path[m_npath-1], m_target, npos, filter,
 							   result, visited, &nvisited, MAX_VISITED);
-	m_npath = dtMergeCorridorEndMoved(m_path, m_npath, m_maxPath, visited, nvisited);
+	// The merged path is at most this long, a merge cut short fills the buffer.
+	const int maxSize = m_npath + nvisited;
+	const bool fits = reserve(maxSize) && maxSize <= getCapacity();
+	m_npath = dtMergeCorridorEndMoved(m_path, m_npath, getCapacity(), visited, nvisited);
+	const bool complete = fits || m_npath < getCapacity();
+	compact();
+	m_revision++;
 	
 	// TODO: should we do that?
 	// Adjust the position to stay on top of the navmesh.
@@ -524,6 +815,8 @@ void dtPathCorridor::moveTargetPosition(const float* npos, dtNavMeshQuery* navqu
 	 result[1] = h;*/
 	
 	dtVcopy(m_target, result);
+
+	return complete;
 }
 
 /// @par
@@ -531,17 +824,30 @@ void dtPathCorridor::moveTargetPosition(const float* npos, dtNavMeshQuery* navqu
 /// The current corridor position is expected to be within the first polygon in the path. The target 
 /// is expected to be in the last polygon. 
 /// 
+/// If the pooled buffer cannot grow to the size of the path, only the start of the path is loaded.
+/// The target is then left outside of the last polygon of the corridor, so the caller should move it.
+///
 /// @warning The size of the path must not exceed the size of corridor's path buffer set during #init().
-void dtPathCorridor::setCorridor(const float* target, const dtPolyRef* path, const int npath)
+bool dtPathCorridor::setCorridor(const float* target, const dtPolyRef* path, const int npath)
 {
 	dtAssert(m_path);
 	dtAssert(npath > 0);
 	dtAssert(npath < m_maxPath);
 	
+	// Fit the pooled buffer to the new path.
+	if (m_pool && dtPathCorridorPool::getBlockSize(dtMin(npath, m_maxPath)) != m_capacity)
+	{
+		m_npath = 0;
+		resize(npath);
+	}
+
 	dtVcopy(m_target, target);
-	memcpy(m_path, path, sizeof(dtPolyRef)*npath);
-	m_npath = npath;
+	m_npath = dtMin(npath, getCapacity());
+	memcpy(m_path, path, sizeof(dtPolyRef)*m_npath);
+	m_revision++;
 	m_isSet = true;
+
+	return m_npath == npath;
 }
 
 bool dtPathCorridor::fixPathStart(dtPolyRef safeRef, const float* safePos)
@@ -561,6 +867,7 @@ bool dtPathCorridor::fixPathStart(dtPolyRef safeRef, const float* safePos)
 		m_path[0] = safeRef;
 		m_path[1] = 0;
 	}
+	m_revision++;
 	
 	return true;
 }
@@ -596,6 +903,8 @@ bool dtPathCorridor::trimInvalidPath(dtPolyRef safeRef, const float* safePos,
 		m_npath = n;
 	}
 	
+	m_revision++;
+
 	// Clamp target pos to last poly
 	float tgt[3];
 	dtVcopy(tgt, m_target);
@@ -28,6 +28,57 @@
 #include <cmath>
 #include <cstring>
 
+/// An agent waiting for a topology optimization.
+struct dtTopologyQueueEntry
+{
+	float optimizedAt;	///< The time the corridor of the agent was last optimized, on the clock of the queue.
+	unsigned id;		///< The id of the agent.
+};
+
+// Is the corridor of a staler than the one of b? Ties are broken by id, so that the order does not depend on the heap.
+static inline bool isStaler(const dtTopologyQueueEntry& a, const dtTopologyQueueEntry& b)
+{
+	return a.optimizedAt < b.optimizedAt || (a.optimizedAt == b.optimizedAt && a.id < b.id);
+}
+
+// Adds the entry to the min-heap of the topology queue, the stalest first.
+static void pushTopologyEntry(dtTopologyQueueEntry* heap, unsigned& count, const dtTopologyQueueEntry& entry)
+{
+	unsigned i = count++;
+	while (i > 0)
+	{
+		const unsigned parent = (i-1)/2;
+		if (!isStaler(entry, heap[parent]))
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = entry;
+}
+
+// Removes the stalest entry from the min-heap of the topology queue.
+static dtTopologyQueueEntry popTopologyEntry(dtTopologyQueueEntry* heap, unsigned& count)
+{
+	const dtTopologyQueueEntry top = heap[0];
+	const dtTopologyQueueEntry last = heap[--count];
+	unsigned i = 0;
+	for (;;)
+	{
+		unsigned child = 2*i+1;
+		if (child >= count)
+			break;
+		if (child+1 < count && isStaler(heap[child+1], heap[child]))
+			++child;
+		if (!isStaler(heap[child], last))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	if (count > 0)
+		heap[i] = last;
+	return top;
+}
+
 dtPathFollowing* dtPathFollowing::allocate(unsigned nbMaxAgents)
 {
 	void* mem = dtAlloc(sizeof(dtPathFollowing), DT_ALLOC_PERM);
@@ -52,20 +103,37 @@ dtPathFollowing::dtPathFollowing(unsigned nbMaxAgents)
 : dtParametrizedBehavior<dtPathFollowingParams>(nbMaxAgents)
 , initialPathfindIterCount(20)
 , visibilityPathOptimizationRange(-1.)
+, visibilityRaysPerUpdate(0)
 , localPathReplanningInterval(-1.)
+, topologyIterationsPerUpdate(0)
 , anticipateTurns(false)
+, cacheCorners(false)
 , m_pathResult(0)
-, m_maxAgents(0)
+, m_visibilityQueue(0)
+, m_visibilityHead(0)
+, m_visibilityCount(0)
+, m_topologyQueue(0)
+, m_topologyCount(0)
+, m_topologyClock(0)
+, m_queueCapacity(0)
+, m_queuesUpdate(0)
+, m_updateReplans(0)
+, m_updateTopologies(0)
+, m_maxAgents(nbMaxAgents)
 , m_maxPathRes(0)
 , m_maxCommonNodes(512)
 , m_maxPathQueueNodes(4096)
 , m_maxIterPerUpdate(100)
 {
+	resetStats();
 }
 
 dtPathFollowing::~dtPathFollowing()
 {
 	purge();
+
+	// The corridors must be given back to the pool before it is destroyed.
+	purgeParams();
 }
 
 bool dtPathFollowing::init(dtCrowdQuery& crowdQuery, unsigned maxPathRes)
@@ -81,6 +149,16 @@ bool dtPathFollowing::init(dtCrowdQuery& crowdQuery, unsigned maxPathRes)
 	if (!m_pathResult)
 		return false;
 
+	// An agent is in each queue at most once, so the queues hold every agent of the crowd.
+	m_queueCapacity = crowdQuery.getMaxAgents();
+	if (m_queueCapacity > 0)
+	{
+		m_visibilityQueue = (unsigned*) dtAlloc(sizeof(unsigned) * m_queueCapacity, DT_ALLOC_PERM);
+		m_topologyQueue = (dtTopologyQueueEntry*) dtAlloc(sizeof(dtTopologyQueueEntry) * m_queueCapacity, DT_ALLOC_PERM);
+		if (!m_visibilityQueue || !m_topologyQueue)
+			return false;
+	}
+
 	return true;
 }
 
@@ -92,8 +170,54 @@ void dtPathFollowing::purge()
 		m_pathResult = 0;
 	}
 
+	if (m_visibilityQueue)
+	{
+		dtFree(m_visibilityQueue);
+		m_visibilityQueue = 0;
+	}
+
+	if (m_topologyQueue)
+	{
+		dtFree(m_topologyQueue);
+		m_topologyQueue = 0;
+	}
+
+	m_visibilityHead = 0;
+	m_visibilityCount = 0;
+	m_topologyCount = 0;
+	m_topologyClock = 0;
+	m_queueCapacity = 0;
 	m_maxPathRes = 0;
-	m_maxAgents = 0;
+}
+
+void dtPathFollowing::resetStats()
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.replanHistogram.reset();
+	m_stats.topologyHistogram.reset();
+}
+
+void dtPathFollowing::update(const dtCrowdQuery& query, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, float dt)
+{
+	// The queues are processed before the parameters of the agent are copied for its update,
+	// since the corridors of any queued agent, this one included, can be optimized.
+	if (query.getUpdateCount() != m_queuesUpdate)
+	{
+		if (m_queuesUpdate != 0)
+		{
+			m_stats.replanHistogram.add(m_updateReplans);
+			m_stats.topologyHistogram.add(m_updateTopologies);
+		}
+		m_updateReplans = 0;
+		m_updateTopologies = 0;
+
+		m_queuesUpdate = query.getUpdateCount();
+		m_topologyClock += dt;
+		castVisibilityRays(query);
+		optimizeQueuedTopologies(query);
+	}
+
+	dtParametrizedBehavior<dtPathFollowingParams>::update(query, oldAgent, newAgent, dt);
 }
 
 void dtPathFollowing::doUpdate(const dtCrowdQuery& query,
@@ -105,9 +229,16 @@ void dtPathFollowing::doUpdate(const dtCrowdQuery& query,
 {
 	// If the corridor isn't initialized, then do it
 	if (!newParams.corridor.getPath() || !newParams.corridor.isSet())
-		newParams.init(m_maxPathRes, oldAgent.position, query);
+	{
+		newParams.init(m_maxPathRes, oldAgent.position, query, &m_corridorPool);
+
+		// Offset the local replannings of the agent by its phase.
+		if (localPathReplanningInterval > 0.f)
+			newParams.topologyOptTime = query.getAgentPhase(oldAgent.id) * localPathReplanningInterval;
+	}
     
-	newParams.corridor.movePosition(oldAgent.position, query.getNavMeshQuery(), query.getQueryFilter());
+	if (!newParams.corridor.movePosition(oldAgent.position, query.getNavMeshQuery(), query.getQueryFilter()))
+		m_stats.truncatedPaths++;
 	
 	prepare(query, oldAgent, newAgent, dt, newParams);
 	getNextCorner(query, oldAgent, newParams);
@@ -207,6 +338,80 @@ void dtPathFollowing::calcStraightSteerDirection(const dtCrowdAgent& ag, float*
 	dtVnormalize(dir);
 }
 
+bool dtPathFollowing::queueVisibilityOptimization(const dtCrowdAgent& ag, const float* target, dtPathFollowingParams& agParams)
+{
+	// An agent already in the queue only updates its target.
+	dtVcopy(agParams.visibilityTarget, target);
+	if (agParams.visibilityQueued)
+		return true;
+
+	if (!m_visibilityQueue || m_visibilityCount >= m_queueCapacity)
+	{
+		m_stats.visibilityOverflows++;
+		return false;
+	}
+
+	m_visibilityQueue[(m_visibilityHead + m_visibilityCount) % m_queueCapacity] = ag.id;
+	m_visibilityCount++;
+	agParams.visibilityQueued = true;
+	return true;
+}
+
+void dtPathFollowing::castVisibilityRays(const dtCrowdQuery& crowdQuery)
+{
+	static const int MAX_BATCH = 32;
+	static const int MAX_RES = 32;
+
+	dtRaycastRequest rays[MAX_BATCH];
+	dtRaycastHit hits[MAX_BATCH];
+	dtPolyRef paths[MAX_BATCH*MAX_RES];
+	dtPathFollowingParams* params[MAX_BATCH];
+
+	unsigned budget = visibilityRaysPerUpdate;
+
+	while (budget > 0 && m_visibilityCount > 0)
+	{
+		// Gather the rays of the agents at the front of the queue, sorted by start polygon.
+		int nrays = 0;
+
+		while (nrays < MAX_BATCH && budget > 0 && m_visibilityCount > 0)
+		{
+			const unsigned id = m_visibilityQueue[m_visibilityHead];
+			m_visibilityHead = (m_visibilityHead + 1) % m_queueCapacity;
+			m_visibilityCount--;
+
+			// The agent may have been removed, or its parameters reset, since it was queued.
+			dtPathFollowingParams* agParams = getBehaviorParams(id);
+			if (!agParams || !agParams->visibilityQueued)
+				continue;
+
+			agParams->visibilityQueued = false;
+
+			dtRaycastRequest ray;
+			if (!agParams->corridor.getPath() || agParams->state == dtPathFollowingParams::NO_TARGET ||
+				!agParams->corridor.getVisibilityRay(agParams->visibilityTarget, visibilityPathOptimizationRange, &ray))
+				continue;
+
+			int i = nrays++;
+			for (; i > 0 && rays[i-1].startRef > ray.startRef; --i)
+			{
+				rays[i] = rays[i-1];
+				params[i] = params[i-1];
+			}
+			rays[i] = ray;
+			params[i] = agParams;
+			budget--;
+		}
+
+		crowdQuery.getNavMeshQuery()->raycastBatch(rays, nrays, crowdQuery.getQueryFilter(), hits, paths, MAX_RES);
+
+		for (int i = 0; i < nrays; ++i)
+			params[i]->corridor.applyVisibilityRay(hits[i], &paths[i*MAX_RES]);
+
+		m_stats.visibilityOptimizations += nrays;
+	}
+}
+
 void dtPathFollowing::triggerOffMeshConnections(const dtCrowdQuery& query, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, dtPathFollowingParams* agParams)
 {
 	if (oldAgent.state != DT_CROWDAGENT_STATE_WALKING)
@@ -237,6 +442,22 @@ void dtPathFollowing::triggerOffMeshConnections(const dtCrowdQuery& query, const
 	}
 }
 
+bool dtPathFollowing::loadCorridor(const dtCrowdQuery& crowdQuery, const float* target, const dtPolyRef* path, const int npath,
+	dtPathFollowingParams& agParams)
+{
+	if (agParams.corridor.setCorridor(target, path, npath))
+		return true;
+
+	// The path was truncated, constrain the target inside the last polygon the corridor holds.
+	m_stats.truncatedPaths++;
+	float nearest[3];
+	const int ntrunc = agParams.corridor.getPathCount();
+	if (dtStatusSucceed(crowdQuery.getNavMeshQuery()->closestPointOnPoly(path[ntrunc-1], target, nearest)))
+		agParams.corridor.setCorridor(nearest, path, ntrunc);
+
+	return false;
+}
+
 void dtPathFollowing::getNextCorner(const dtCrowdQuery& crowdQuery, const dtCrowdAgent& ag, dtPathFollowingParams& agParams)
 {
 	dtCrowdAgentDebugInfo* debug = getBehaviorParams(ag.id)->debugInfos;
@@ -248,16 +469,39 @@ void dtPathFollowing::getNextCorner(const dtCrowdQuery& crowdQuery, const dtCrow
 		return;
 
 
+	m_stats.cornerQueries++;
+
+	// Reuse the corners found for the same corridor, minus the ones the agent reached.
+	if (cacheCorners && agParams.cornersCached && agParams.cornersRevision == agParams.corridor.getRevision())
+		agParams.ncorners = agParams.corridor.pruneCorners(agParams.cornerVerts, agParams.cornerFlags, agParams.cornerPolys, agParams.ncorners);
+	else
+		agParams.ncorners = 0;
+
 	// Find corners for steering
-	agParams.ncorners = agParams.corridor.findCorners(agParams.cornerVerts, agParams.cornerFlags, agParams.cornerPolys,
-		dtPathFollowingParams::MAX_NCORNERS, crowdQuery.getNavMeshQuery(), crowdQuery.getQueryFilter());
+	if (agParams.ncorners == 0)
+	{
+		agParams.ncorners = agParams.corridor.findCorners(agParams.cornerVerts, agParams.cornerFlags, agParams.cornerPolys,
+			dtPathFollowingParams::MAX_NCORNERS, crowdQuery.getNavMeshQuery(), crowdQuery.getQueryFilter());
+		agParams.cornersRevision = agParams.corridor.getRevision();
+		agParams.cornersCached = true;
+		m_stats.cornerUpdates++;
+	}
 
 	// Check to see if the corner after the next corner is directly visible,
 	// and short cut to there.
 	if (visibilityPathOptimizationRange > 0. && agParams.ncorners > 0)
 	{
 		const float* target = &agParams.cornerVerts[dtMin<unsigned>(1,agParams.ncorners-1)*3];
-		agParams.corridor.optimizePathVisibility(target, visibilityPathOptimizationRange, crowdQuery.getNavMeshQuery(), crowdQuery.getQueryFilter());
+		if (visibilityRaysPerUpdate > 0)
+		{
+			// When the queue is full the agent simply tries again during its next update.
+			queueVisibilityOptimization(ag, target, agParams);
+		}
+		else
+		{
+			agParams.corridor.optimizePathVisibility(target, visibilityPathOptimizationRange, crowdQuery.getNavMeshQuery(), crowdQuery.getQueryFilter());
+			m_stats.visibilityOptimizations++;
+		}
 
 		// Copy data for debug purposes.
 		if (debugIdx == static_cast<int>(this->getBehaviorParams(ag.id)->debugIndex))
@@ -289,59 +533,67 @@ void dtPathFollowing::updateTopologyOptimization(const dtCrowdQuery& crowdQuery,
 
 	if (agParams->topologyOptTime >= localPathReplanningInterval)
     {
-        agParams->corridor.optimizePathTopology(const_cast<dtNavMeshQuery*>(crowdQuery.getNavMeshQuery()), crowdQuery.getQueryFilter());
+		// The agent keeps aging in the queue, the stalest agents being optimized first.
+		if (topologyIterationsPerUpdate > 0)
+		{
+			addToOptQueue(ag, *agParams);
+			return;
+		}
+
+		int iters = 0;
+        agParams->corridor.optimizePathTopology(const_cast<dtNavMeshQuery*>(crowdQuery.getNavMeshQuery()), crowdQuery.getQueryFilter(), &iters);
 		agParams->topologyOptTime = 0;
+		m_stats.topologyOptimizations++;
+		m_stats.topologyIterations += iters;
+		m_updateTopologies++;
     }
 }
 
-int dtPathFollowing::addToOptQueue(const dtCrowdAgent& newag, dtCrowdAgent** agents, const unsigned nagents, const unsigned maxAgents)
+void dtPathFollowing::addToOptQueue(const dtCrowdAgent& newag, dtPathFollowingParams& agParams)
 {
-	const dtPathFollowingParams* newAgParams = getBehaviorParams(newag.id);
-	if (!newAgParams)
-		return 0;
+	if (agParams.topologyQueued || !m_topologyQueue || m_topologyCount >= m_queueCapacity)
+		return;
 
-	const dtPathFollowingParams* agParams = getBehaviorParams(agents[nagents-1]->id);
-	if (!agParams)
-		return 0;
+	// The queued agents keep aging at the same pace, so the time of their last optimization orders them.
+	dtTopologyQueueEntry entry;
+	entry.optimizedAt = m_topologyClock - agParams.topologyOptTime;
+	entry.id = newag.id;
+	pushTopologyEntry(m_topologyQueue, m_topologyCount, entry);
+	agParams.topologyQueued = true;
+}
 
-	// Insert neighbour based on greatest time.
-	unsigned slot = 0;
-	if (!nagents)
-	{
-		slot = nagents;
-	}
-	else if (newAgParams->topologyOptTime <= agParams->topologyOptTime)
-	{
-		if (nagents >= maxAgents)
-			return nagents;
-		slot = nagents;
-	}
-	else
+void dtPathFollowing::optimizeQueuedTopologies(const dtCrowdQuery& crowdQuery)
+{
+	int budget = (int)topologyIterationsPerUpdate;
+
+	while (budget > 0 && m_topologyCount > 0)
 	{
-		unsigned i;
-		for (i = 0; i < nagents; ++i)
-		{
-			dtPathFollowingParams* pfParams = getBehaviorParams(agents[i]->id);
-			if (!pfParams)
-				continue;
+		const unsigned id = popTopologyEntry(m_topologyQueue, m_topologyCount).id;
 
-			if (newAgParams->topologyOptTime >= pfParams->topologyOptTime)
-				break;
-		}
+		// The agent may have been removed, or its parameters reset, since it was queued.
+		dtPathFollowingParams* agParams = getBehaviorParams(id);
+		if (!agParams || !agParams->topologyQueued)
+			continue;
 
-		const unsigned tgt = i+1;
-		const unsigned n = dtMin(nagents-i, maxAgents-tgt);
+		agParams->topologyQueued = false;
+		agParams->topologyOptTime = 0;
 
-		dtAssert(tgt+n <= maxAgents);
+		if (!agParams->corridor.getPath() || agParams->state == dtPathFollowingParams::NO_TARGET)
+			continue;
 
-		if (n > 0)
-			memmove(&agents[tgt], &agents[i], sizeof(dtCrowdAgent*)*n);
-		slot = i;
-	}
+		int iters = 0;
+		agParams->corridor.optimizePathTopology(const_cast<dtNavMeshQuery*>(crowdQuery.getNavMeshQuery()), crowdQuery.getQueryFilter(), &iters);
+		m_stats.topologyOptimizations++;
+		m_stats.topologyIterations += iters;
+		m_updateTopologies++;
 
-	agents[slot] = const_cast<dtCrowdAgent*>(&newag);
+		// Every search counts, even the ones failing right away, so that the loop ends.
+		budget -= dtMax(iters, 1);
+	}
 
-	return dtMin(nagents+1, maxAgents);
+	// Keeps the clock small enough for the times of the agents to stay accurate.
+	if (m_topologyCount == 0)
+		m_topologyClock = 0;
 }
 
 void dtPathFollowing::checkPathValidity(const dtCrowdQuery& crowdQuery, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, const float dt, dtPathFollowingParams* agParams)
@@ -420,7 +672,8 @@ void dtPathFollowing::checkPathValidity(const dtCrowdQuery& crowdQuery, const dt
 	// If the end of the path is near and it is not the requested location, replan.
 	if (agParams->state == dtPathFollowingParams::FOLLOWING_PATH)
 	{
-		if (agParams->targetReplanTime > TARGET_REPLAN_DELAY &&
+		// The delay is jittered so that agents finding their path together do not replan together.
+		if (agParams->targetReplanTime > TARGET_REPLAN_DELAY * (1.f + crowdQuery.getAgentPhase(oldAgent.id)) &&
 			agParams->corridor.getPathCount() < CHECK_LOOKAHEAD &&
 			agParams->corridor.getLastPoly() != agParams->targetRef)
 			replan = true;
@@ -433,6 +686,7 @@ void dtPathFollowing::checkPathValidity(const dtCrowdQuery& crowdQuery, const dt
 		{
             agParams->submitTarget(agParams->targetPos, agParams->targetRef);
             agParams->targetReplan = true;
+            m_updateReplans++;
 		}
 	}
 }
@@ -502,9 +756,9 @@ void dtPathFollowing::updateMoveRequest(const dtCrowdQuery& crowdQuery, const dt
                 reqPathCount = 1;
             }
 
-            newParams.corridor.setCorridor(reqPos, reqPath, reqPathCount);
+            const bool loaded = loadCorridor(crowdQuery, reqPos, reqPath, reqPathCount, newParams);
 
-            if (reqPath[reqPathCount-1] == newParams.targetRef)
+            if (loaded && reqPath[reqPathCount-1] == newParams.targetRef)
             {
                 // The path has been completely computed during the initial pathfind.
                 newParams.state = dtPathFollowingParams::FOLLOWING_PATH;
@@ -638,7 +892,7 @@ void dtPathFollowing::updateMoveRequest(const dtCrowdQuery& crowdQuery, const dt
 				if (valid)
 				{
 					// Set current corridor.
-					newParams.corridor.setCorridor(targetPos, m_pathResult, nres);
+					loadCorridor(crowdQuery, targetPos, m_pathResult, nres, newParams);
 
 					newParams.state = dtPathFollowingParams::FOLLOWING_PATH;
 				}
@@ -724,15 +978,20 @@ dtPathFollowingParams::dtPathFollowingParams()
     , cornerVerts()
     , cornerFlags()
     , cornerPolys()
+    , cornersRevision(0)
+    , cornersCached(false)
+    , visibilityTarget()
+    , visibilityQueued(false)
     , topologyOptTime(0)
+    , topologyQueued(false)
     , debugInfos(0)
 	, debugIndex(0)
 {
 }
 
-bool dtPathFollowingParams::init( unsigned maxPathResults, const float* position, const dtCrowdQuery& query )
+bool dtPathFollowingParams::init( unsigned maxPathResults, const float* position, const dtCrowdQuery& query, dtPathCorridorPool* pool )
 {
-	if (!corridor.init(maxPathResults))
+	if (!corridor.init(maxPathResults, pool))
 		return false;
 
 	dtPolyRef dest;
@@ -65,23 +65,20 @@ void dtPipelineBehavior::update(const dtCrowdQuery& query, const dtCrowdAgent& o
 	if (m_behaviors == 0 || m_nbBehaviors == 0)
 		return;
 
-	recursiveUpdate(query, oldAgent, newAgent, dt, m_nbBehaviors);
-}
-
-void dtPipelineBehavior::recursiveUpdate(const dtCrowdQuery& query, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, float dt, unsigned remainingBehaviors)
-{
-	if (remainingBehaviors == 0)
-		return;
+	// The first behavior reads the given agent, the following ones update the result
+	// in place, the same way the crowd updates its agents. So no copy of the agent is needed.
+	const dtCrowdAgent* current = &oldAgent;
 
-	dtBehavior* behavior = m_behaviors[m_nbBehaviors - remainingBehaviors];
-
-	if (behavior)
-		behavior->update(query, oldAgent, newAgent, dt);
+	for (int i = 0; i < m_nbBehaviors; ++i)
+	{
+		dtBehavior* behavior = m_behaviors[i];
 
-	dtCrowdAgent ag = newAgent;
+		if (!behavior)
+			continue;
 
-	recursiveUpdate(query, newAgent, ag, dt, remainingBehaviors - 1);
-	newAgent = ag;
+		behavior->update(query, *current, newAgent, dt);
+		current = &newAgent;
+	}
 }
 
 bool dtPipelineBehavior::setBehaviors(dtBehavior const * const * behaviors, unsigned nbBehaviors)
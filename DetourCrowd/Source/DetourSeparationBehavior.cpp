@@ -28,6 +28,7 @@
 dtSeparationBehavior::dtSeparationBehavior(unsigned nbMaxAgents)
 	: dtSteeringBehavior<dtSeparationBehaviorParams>(nbMaxAgents)
 {
+	enableSimd(true);
 }
 
 dtSeparationBehavior::~dtSeparationBehavior()
@@ -61,13 +62,8 @@ void dtSeparationBehavior::computeForce(const dtCrowdQuery& query, const dtCrowd
 	const unsigned nbTargets = currentParams.nbTargets;
 	const float distance = currentParams.distance;
 
-	const dtCrowdAgent** agents = (const dtCrowdAgent**) dtAlloc(sizeof(dtCrowdAgent*) * nbTargets, DT_ALLOC_TEMP);
-	query.getAgents(targets, nbTargets, agents);
-
-	if (!agents || !targets || nbTargets <= 0) {
-		dtFree(agents);
+	if (!targets || nbTargets <= 0)
 		return;
-	}
 
 	const float invSeparationDist = 1.f / distance;
 	float weight;
@@ -75,15 +71,15 @@ void dtSeparationBehavior::computeForce(const dtCrowdQuery& query, const dtCrowd
 
 	for (unsigned i = 0; i < nbTargets; ++i)
 	{
-		const dtCrowdAgent& target = *agents[i];
+		const dtCrowdAgent* target = query.getAgent(targets[i]);
 
-		if (!target.active)
+		if (!target || !target->active)
 			continue;
 
 		float diff[3];
-		dtVsub(diff, ag.position, target.position);
+		dtVsub(diff, ag.position, target->position);
 
-		float dist = dtVlen(diff) - ag.radius - target.radius;
+		float dist = dtVlen(diff) - ag.radius - target->radius;
 
 		if (dist > distance || dist < EPSILON)
 			continue;
@@ -97,7 +93,5 @@ void dtSeparationBehavior::computeForce(const dtCrowdQuery& query, const dtCrowd
 
 	if (count > 0)
 		dtVscale(force, force, (1.f / (float) count));
-
-	dtFree(agents);
 }
 
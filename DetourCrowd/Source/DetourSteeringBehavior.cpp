@@ -0,0 +1,105 @@
+//
+// Copyright (c) 2013 MASA Group recastdetour@masagroup.net
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourSteeringBehavior.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DT_STEERING_SSE2
+#include <emmintrin.h>
+#endif
+
+
+#ifdef DT_STEERING_SSE2
+inline __m128 lengths(const __m128 x, const __m128 y, const __m128 z)
+{
+	return _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+}
+
+// Clamps the lengths of four vectors, with the same operations as dtVclamp(v, dtVlen(v), maxLength).
+inline void clampLengths(__m128& x, __m128& y, __m128& z, const __m128 len, const __m128 maxLength)
+{
+	// The vectors shorter than EPSILON are not normalized, but nullified.
+	const __m128 small = _mm_cmplt_ps(len, _mm_set1_ps(EPSILON));
+	const __m128 d = _mm_andnot_ps(small, _mm_div_ps(_mm_set1_ps(1.0f), len));
+	const __m128 scale = _mm_min_ps(len, maxLength);
+
+	x = _mm_mul_ps(_mm_mul_ps(x, d), scale);
+	y = _mm_mul_ps(_mm_mul_ps(y, d), scale);
+	z = _mm_mul_ps(_mm_mul_ps(z, d), scale);
+}
+
+inline __m128 selectLanes(const __m128 mask, const __m128 a, const __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+
+unsigned dtApplySteeringForcesSimd(dtCrowdAgent* const* agents, const float* forces, unsigned nbAgents, float dt)
+{
+#ifdef DT_STEERING_SSE2
+	const __m128 vdt = _mm_set1_ps(dt);
+	unsigned i = 0;
+
+	for (; i + 4 <= nbAgents; i += 4)
+	{
+		dtCrowdAgent& a0 = *agents[i];
+		dtCrowdAgent& a1 = *agents[i + 1];
+		dtCrowdAgent& a2 = *agents[i + 2];
+		dtCrowdAgent& a3 = *agents[i + 3];
+		const float* f = &forces[i * 3];
+
+		// The acceleration is the force clamped to the maximum acceleration.
+		__m128 ax = _mm_setr_ps(f[0], f[3], f[6], f[9]);
+		__m128 ay = _mm_setr_ps(f[1], f[4], f[7], f[10]);
+		__m128 az = _mm_setr_ps(f[2], f[5], f[8], f[11]);
+		const __m128 maxAcceleration = _mm_setr_ps(a0.maxAcceleration, a1.maxAcceleration, a2.maxAcceleration, a3.maxAcceleration);
+		clampLengths(ax, ay, az, lengths(ax, ay, az), maxAcceleration);
+
+		__m128 vx = _mm_setr_ps(a0.velocity[0], a1.velocity[0], a2.velocity[0], a3.velocity[0]);
+		__m128 vy = _mm_setr_ps(a0.velocity[1], a1.velocity[1], a2.velocity[1], a3.velocity[1]);
+		__m128 vz = _mm_setr_ps(a0.velocity[2], a1.velocity[2], a2.velocity[2], a3.velocity[2]);
+		vx = _mm_add_ps(vx, _mm_mul_ps(ax, vdt));
+		vy = _mm_add_ps(vy, _mm_mul_ps(ay, vdt));
+		vz = _mm_add_ps(vz, _mm_mul_ps(az, vdt));
+
+		// Nil velocities are kept as they are, the others are clamped to the maximum speed.
+		const __m128 speed = lengths(vx, vy, vz);
+		const __m128 moving = _mm_cmpge_ps(speed, _mm_set1_ps(EPSILON));
+		__m128 cx = vx, cy = vy, cz = vz;
+		clampLengths(cx, cy, cz, speed, _mm_setr_ps(a0.maxSpeed, a1.maxSpeed, a2.maxSpeed, a3.maxSpeed));
+
+		float x[4], y[4], z[4];
+		_mm_storeu_ps(x, selectLanes(moving, cx, vx));
+		_mm_storeu_ps(y, selectLanes(moving, cy, vy));
+		_mm_storeu_ps(z, selectLanes(moving, cz, vz));
+
+		dtVset(a0.desiredVelocity, x[0], y[0], z[0]);
+		dtVset(a1.desiredVelocity, x[1], y[1], z[1]);
+		dtVset(a2.desiredVelocity, x[2], y[2], z[2]);
+		dtVset(a3.desiredVelocity, x[3], y[3], z[3]);
+	}
+
+	return i;
+#else
+	(void)agents;
+	(void)forces;
+	(void)nbAgents;
+	(void)dt;
+	return 0;
+#endif
+}
@@ -20,6 +20,7 @@
 #define DETOURCROWDTESTUTILS_H
 
 #include "DetourCrowd.h"
+#include "DetourPathFollowing.h"
 
 #include "CrowdSample.h"
 #include "InputGeom.h"
@@ -77,4 +78,42 @@ private:
 	dtCrowd* m_crowd;
 };
 
+/// Two identical square scenes, each with a crowd and a path following behavior.
+/// Used to compare the agents of a crowd using some setting with the same agents using the default one.
+class TestScenePair
+{
+public:
+	TestScenePair();
+	~TestScenePair();
+
+	/// Creates the scenes and initializes their path following behaviors.
+	///
+	/// @param[in]	nbMaxAgents	The maximum number of agents allowed for each crowd
+	/// @param[in]	maxRadius	The radius allowed for the agents of the crowds
+	///
+	/// @return False if something went wrong.
+	bool init(unsigned nbMaxAgents, float maxRadius = 0.5f);
+
+	/// Adds an agent to both crowds, and submits its target to the path following behavior of its crowd.
+	///
+	/// @param[in]	pos				The position of the agent. [(x, y, z)]
+	/// @param[in]	dest			The target of the agent. [(x, y, z)]
+	/// @param[in]	pushBehavior	Should the path following behavior be the behavior of the agent?
+	/// @param[out]	id				The id of the agent, the same in both crowds. [opt]
+	///
+	/// @return False if the agent could not be added.
+	bool addAgent(const float* pos, const float* dest, bool pushBehavior = true, unsigned* id = 0);
+
+	/// Updates both crowds.
+	void update(float dt);
+
+	dtCrowd* getCrowd(int i) { return m_crowds[i]; }
+	dtPathFollowing* getPathFollowing(int i) { return m_pathFollowings[i]; }
+
+private:
+	TestScene m_scenes[2];
+	dtCrowd* m_crowds[2];
+	dtPathFollowing* m_pathFollowings[2];
+};
+
 #endif
\ No newline at end of file
@@ -397,6 +397,226 @@ TEST_CASE("DetourBehaviorsTests/CustomBehavior", "Test whether the custom behavi
 	}
 }
 
+/// Forwards the updates to another behavior, counting the batches it receives.
+class BatchCountingBehavior : public dtBehavior
+{
+public:
+	explicit BatchCountingBehavior(dtBehavior* behavior) : m_behavior(behavior), nbBatches(0), nbAgents(0) {}
+
+	virtual void update(const dtCrowdQuery& query, const dtCrowdAgent& oldAgent, dtCrowdAgent& newAgent, float dt)
+	{
+		m_behavior->update(query, oldAgent, newAgent, dt);
+	}
+
+	virtual void updateBatch(const dtCrowdQuery& query, dtCrowdAgent* const* agents, unsigned count, float dt)
+	{
+		++nbBatches;
+		nbAgents += count;
+		m_behavior->updateBatch(query, agents, count, dt);
+	}
+
+	dtBehavior* m_behavior;
+	unsigned nbBatches;
+	unsigned nbAgents;
+};
+
+TEST_CASE("DetourBehaviorsTests/BatchUpdate", "The crowd updates all the agents of a behavior at once")
+{
+	TestScene ts;
+	dtCrowd* crowd = ts.createSquareScene(4, 0.5f);
+	REQUIRE(crowd != 0);
+
+	dtArriveBehavior* goRight = dtArriveBehavior::allocate(4);
+	dtArriveBehavior* goLeft = dtArriveBehavior::allocate(4);
+	BatchCountingBehavior right(goRight);
+	BatchCountingBehavior left(goLeft);
+
+	float destRight[] = {15, 0, 0};
+	float destLeft[] = {-15, 0, 0};
+
+	// The agents alternate between both behaviors
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		float pos[] = {0, 0, -6.f + 4.f * i};
+		dtCrowdAgent ag;
+		REQUIRE(crowd->addAgent(ag, pos));
+		ts.defaultInitializeAgent(*crowd, ag.id);
+
+		dtArriveBehavior* go = (i % 2 == 0) ? goRight : goLeft;
+		go->getBehaviorParams(ag.id)->target = (i % 2 == 0) ? destRight : destLeft;
+		crowd->pushAgentBehavior(ag.id, (i % 2 == 0) ? (dtBehavior*) &right : (dtBehavior*) &left);
+	}
+
+	crowd->update(0.5f, 0);
+
+	// One batch per behavior, holding all its agents
+	CHECK(right.nbBatches == 1);
+	CHECK(right.nbAgents == 2);
+	CHECK(left.nbBatches == 1);
+	CHECK(left.nbAgents == 2);
+
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		if (i % 2 == 0)
+			CHECK(crowd->getAgent(i)->position[0] > 0.f);
+		else
+			CHECK(crowd->getAgent(i)->position[0] < 0.f);
+	}
+
+	// One behavior per agent, as in the crowd sample
+	BatchCountingBehavior own[] = {BatchCountingBehavior(goRight), BatchCountingBehavior(goLeft),
+								   BatchCountingBehavior(goRight), BatchCountingBehavior(goLeft)};
+	for (unsigned i = 0; i < 4; ++i)
+		crowd->pushAgentBehavior(i, &own[i]);
+
+	crowd->update(0.5f, 0);
+
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		CHECK(own[i].nbBatches == 1);
+		CHECK(own[i].nbAgents == 1);
+	}
+
+	for (unsigned i = 0; i < 4; ++i)
+		crowd->pushAgentBehavior(i, 0);
+
+	dtArriveBehavior::free(goRight);
+	dtArriveBehavior::free(goLeft);
+}
+
+/// Records the order in which the crowd updates the agents, across several behaviors.
+class OrderRecordingBehavior : public dtBehavior
+{
+public:
+	OrderRecordingBehavior(unsigned* order, unsigned* nbUpdated) : m_order(order), m_nbUpdated(nbUpdated) {}
+
+	virtual void update(const dtCrowdQuery& /*query*/, const dtCrowdAgent& oldAgent, dtCrowdAgent& /*newAgent*/, float /*dt*/)
+	{
+		m_order[(*m_nbUpdated)++] = oldAgent.id;
+	}
+
+	unsigned* m_order;
+	unsigned* m_nbUpdated;
+};
+
+TEST_CASE("DetourBehaviorsTests/BatchUpdateOrder", "The crowd updates the agents grouped by behavior")
+{
+	TestScene ts;
+	dtCrowd* crowd = ts.createSquareScene(6, 0.5f);
+	REQUIRE(crowd != 0);
+
+	unsigned order[6];
+	unsigned nbUpdated = 0;
+	OrderRecordingBehavior first(order, &nbUpdated);
+	OrderRecordingBehavior second(order, &nbUpdated);
+
+	// The behaviors of the agents are interleaved: first, second, first, second, second, first
+	const bool useFirst[] = {true, false, true, false, false, true};
+	for (unsigned i = 0; i < 6; ++i)
+	{
+		float pos[] = {-5.f + 2.f * i, 0, 0};
+		dtCrowdAgent ag;
+		REQUIRE(crowd->addAgent(ag, pos));
+		ts.defaultInitializeAgent(*crowd, ag.id);
+		crowd->pushAgentBehavior(ag.id, useFirst[i] ? (dtBehavior*) &first : (dtBehavior*) &second);
+	}
+
+	crowd->updateVelocity(0.1f);
+
+	// The agents of the first behavior come first, then the ones of the second, each group keeping the crowd order
+	const unsigned expected[] = {0, 2, 5, 1, 3, 4};
+	REQUIRE(nbUpdated == 6);
+	for (unsigned i = 0; i < 6; ++i)
+		CHECK(order[i] == expected[i]);
+
+	// The groups follow the behavior of the first agent to update, not the behaviors themselves
+	unsigned reversed[] = {5, 4, 3, 2, 1, 0};
+	const unsigned expectedReversed[] = {5, 2, 0, 4, 3, 1};
+	nbUpdated = 0;
+	crowd->updateVelocity(0.1f, reversed, 6);
+
+	REQUIRE(nbUpdated == 6);
+	for (unsigned i = 0; i < 6; ++i)
+		CHECK(order[i] == expectedReversed[i]);
+
+	for (unsigned i = 0; i < 6; ++i)
+		crowd->pushAgentBehavior(i, 0);
+}
+
+TEST_CASE("DetourBehaviorsTests/SimdSteering", "The SIMD batch update applies the forces as the scalar one")
+{
+	static const unsigned nbAgents = 7;
+
+	// Only the behaviors keeping the default way of applying the forces use it
+	dtSeekBehavior* seek = dtSeekBehavior::allocate(nbAgents);
+	CHECK(!seek->isSimdEnabled());
+	dtSeekBehavior::free(seek);
+
+	TestScene scenes[2];
+	dtCrowd* crowds[2];
+	dtSeparationBehavior* separations[2];
+	unsigned targets[2][nbAgents][nbAgents - 1];
+
+	for (unsigned c = 0; c < 2; ++c)
+	{
+		crowds[c] = scenes[c].createSquareScene(nbAgents, 0.5f);
+		REQUIRE(crowds[c] != 0);
+
+		separations[c] = dtSeparationBehavior::allocate(nbAgents);
+		REQUIRE(separations[c] != 0);
+		CHECK(separations[c]->isSimdEnabled());
+
+		// Every agent flees all the others, so that the batch holds more than a multiple of four agents
+		for (unsigned i = 0; i < nbAgents; ++i)
+		{
+			float pos[] = {-3.f + (float) i, 0, (i % 2 == 0) ? 0.5f : -0.5f};
+			dtCrowdAgent ag;
+			REQUIRE(crowds[c]->addAgent(ag, pos));
+			scenes[c].defaultInitializeAgent(*crowds[c], ag.id);
+
+			unsigned nbTargets = 0;
+			for (unsigned j = 0; j < nbAgents; ++j)
+			{
+				if (j != i)
+					targets[c][i][nbTargets++] = j;
+			}
+
+			dtSeparationBehaviorParams* params = separations[c]->getBehaviorParams(ag.id);
+			params->targetsID = targets[c][i];
+			params->nbTargets = nbTargets;
+			params->distance = 5.f;
+			params->weight = 20.f;
+			crowds[c]->pushAgentBehavior(ag.id, separations[c]);
+		}
+	}
+
+	separations[1]->enableSimd(false);
+
+	for (int step = 0; step < 10; ++step)
+	{
+		crowds[0]->update(0.1f, 0);
+		crowds[1]->update(0.1f, 0);
+	}
+
+	for (unsigned i = 0; i < nbAgents; ++i)
+	{
+		const dtCrowdAgent* simd = crowds[0]->getAgent(i);
+		const dtCrowdAgent* scalar = crowds[1]->getAgent(i);
+
+		// The agents both reach their maximum acceleration and their maximum speed
+		CHECK(dtVlen(simd->velocity) > 1.9f);
+		CHECK(dtVdist(simd->velocity, scalar->velocity) < 1e-5f);
+		CHECK(dtVdist(simd->position, scalar->position) < 1e-5f);
+	}
+
+	for (unsigned c = 0; c < 2; ++c)
+	{
+		for (unsigned i = 0; i < nbAgents; ++i)
+			crowds[c]->pushAgentBehavior(i, 0);
+		dtSeparationBehavior::free(separations[c]);
+	}
+}
+
 TEST_CASE("DetourBehaviorsTests/HashTable", "Testing the hash table containing the pairs <agentID, AgentBehaviorData>")
 {
 	// Creation of the simulation
@@ -31,6 +31,7 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include <cmath>
 #include <cstring>
 
 SCENARIO("DetourCollisionAvoidanceTest/DefaultParams", "[detourCollisionAvoidance]")
@@ -65,3 +66,60 @@ SCENARIO("DetourCollisionAvoidanceTest/DefaultParams", "[detourCollisionAvoidanc
         }
     }
 }
+
+SCENARIO("DetourCollisionAvoidanceTest/ManyNeighbours", "[detourCollisionAvoidance] The avoidance sees every neighbor kept by the crowd")
+{
+	const unsigned nbAgents = 10;
+	const unsigned maxNeighbours = 12;
+
+	GIVEN("A crowd keeping up to 12 neighbors and an agent surrounded by 9 others")
+	{
+		TestScene ts;
+		dtCrowd* crowd = ts.createSquareScene(nbAgents, 0.5f);
+		REQUIRE(crowd != 0);
+		REQUIRE(crowd->init(nbAgents, 0.5f, ts.getNavMesh(), maxNeighbours));
+
+		for (unsigned i = 0; i < nbAgents; ++i)
+		{
+			const float angle = 6.2831853f * i / (nbAgents - 1);
+			const float pos[] = {i == 0 ? 0.f : 1.5f * cosf(angle), 0, i == 0 ? 0.f : 1.5f * sinf(angle)};
+			dtCrowdAgent ag;
+			REQUIRE(crowd->addAgent(ag, pos));
+			ts.defaultInitializeAgent(*crowd, ag.id);
+		}
+
+		WHEN("The surrounded agent avoids the others with a behavior initialized for the crowd")
+		{
+			dtCollisionAvoidance* ca = dtCollisionAvoidance::allocate(nbAgents);
+			REQUIRE(ca->init(*crowd->getCrowdQuery()));
+			crowd->pushAgentBehavior(0, ca);
+			crowd->update(0.1f);
+
+			THEN("Every neighbor is a circle obstacle")
+			{
+				CHECK(ca->maximumCircleObstaclesCount == maxNeighbours);
+				CHECK(crowd->getAgentEnvironment(0)->nbNeighbors == nbAgents - 1);
+				CHECK(ca->getCircleObstaclesCount() == nbAgents - 1);
+			}
+
+			crowd->pushAgentBehavior(0, 0);
+			dtCollisionAvoidance::free(ca);
+		}
+
+		WHEN("The surrounded agent avoids the others with the default behavior")
+		{
+			dtCollisionAvoidance* ca = dtCollisionAvoidance::allocate(nbAgents);
+			REQUIRE(ca->init());
+			crowd->pushAgentBehavior(0, ca);
+			crowd->update(0.1f);
+
+			THEN("Only the nearest neighbors are circle obstacles")
+			{
+				CHECK(ca->getCircleObstaclesCount() == 6);
+			}
+
+			crowd->pushAgentBehavior(0, 0);
+			dtCollisionAvoidance::free(ca);
+		}
+	}
+}
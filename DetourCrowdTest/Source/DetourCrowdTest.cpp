@@ -36,6 +36,8 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include <cstring>
+
 SCENARIO("DetourCrowdTest/DefaultCrowd", "[detourCrowd]")
 {
     dtCrowd crowd;
@@ -518,3 +520,179 @@ SCENARIO("DetourCrowdTest/UpdateCrowd", "[detourCrowd] Test the different ways t
 }
 
 
+
+SCENARIO("DetourCrowdTest/WallSegmentCache", "[detourCrowd] Test the sharing of the wall segments between the agents")
+{
+	const float posAgt[][3] = {{-18, 0, -18}, {-17, 0, -18}, {-18, 0, -17}, {-17, 0, -17}};
+
+	GIVEN("A crowd with 4 agents close to each other, near a corner of the navigation mesh")
+	{
+		TestScene ts;
+		dtCrowd* crowd = ts.createSquareScene(4, 0.5f);
+		REQUIRE(crowd != 0);
+
+		dtCrowdAgent ags[4];
+		for (int i = 0; i < 4; ++i)
+		{
+			REQUIRE(crowd->addAgent(ags[i], posAgt[i]));
+			ts.defaultInitializeAgent(*crowd, ags[i].id);
+		}
+
+		WHEN("The crowd is updated")
+		{
+			crowd->update(0.1f);
+
+			THEN("The boundaries are those computed without the cache, sharing the segments of the polygons")
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					const dtCrowdAgent* ag = crowd->getAgent(ags[i].id);
+					const dtLocalBoundary& boundary = crowd->getAgentEnvironment(ag->id)->boundary;
+					REQUIRE(boundary.getSegmentCount() > 0);
+
+					dtPolyRef ref;
+					float nearest[3];
+					const dtCrowdQuery* query = crowd->getCrowdQuery();
+					query->getNavMeshQuery()->findNearestPoly(boundary.getCenter(), query->getQueryExtents(), query->getQueryFilter(), &ref, nearest);
+
+					dtLocalBoundary expected;
+					expected.update(ref, boundary.getCenter(), ag->perceptionDistance,
+									const_cast<dtNavMeshQuery*>(query->getNavMeshQuery()), query->getQueryFilter());
+
+					REQUIRE(boundary.getSegmentCount() == expected.getSegmentCount());
+					for (int j = 0; j < expected.getSegmentCount(); ++j)
+						CHECK(memcmp(boundary.getSegment(j), expected.getSegment(j), sizeof(float)*6) == 0);
+				}
+
+				const dtWallSegmentCacheStats& stats = crowd->getWallSegmentCache().getStats();
+				CHECK(stats.misses > 0);
+				CHECK(stats.hits > 0);
+				CHECK(stats.flushes == 0);
+			}
+
+			AND_WHEN("The flags of a polygon change")
+			{
+				dtPolyRef ref;
+				float nearest[3];
+				const dtCrowdQuery* query = crowd->getCrowdQuery();
+				query->getNavMeshQuery()->findNearestPoly(posAgt[0], query->getQueryExtents(), query->getQueryFilter(), &ref, nearest);
+				REQUIRE(dtStatusSucceed(ts.getNavMesh()->setPolyFlags(ref, SAMPLE_POLYFLAGS_WALK)));
+
+				const float newPos[] = {-10, 0, -10};
+				REQUIRE(crowd->pushAgentPosition(ags[0].id, newPos));
+				crowd->update(0.1f);
+
+				THEN("The cache is emptied")
+				{
+					CHECK(crowd->getWallSegmentCache().getStats().flushes == 1);
+				}
+			}
+		}
+	}
+}
+
+SCENARIO("DetourCrowdTest/PeriodicTaskSpreading", "[detourCrowd] Test the spreading of the boundary updates of agents moving together")
+{
+	const unsigned nbAgents = 4;
+
+	GIVEN("Two crowds with agents walking side by side, one of them spreading the periodic tasks")
+	{
+		TestScenePair scenes;
+		REQUIRE(scenes.init(nbAgents));
+		dtCrowd* crowds[] = {scenes.getCrowd(0), scenes.getCrowd(1)};
+		crowds[1]->setPeriodicTaskSpreading(true);
+
+		for (unsigned j = 0; j < nbAgents; ++j)
+		{
+			unsigned id;
+			const float pos[] = {-6.f + 4.f * j, 0, -15.f};
+			const float dest[] = {-6.f + 4.f * j, 0, 15.f};
+			REQUIRE(scenes.addAgent(pos, dest, true, &id));
+
+			CHECK(crowds[0]->getCrowdQuery()->getAgentPhase(id) == 0.f);
+			const float phase = crowds[1]->getCrowdQuery()->getAgentPhase(id);
+			CHECK((phase >= 0.f && phase < 1.f));
+		}
+
+		WHEN("Updated for 5s at 10 Hz, once the initial boundaries are built")
+		{
+			for (int i = 0; i < 2; ++i)
+			{
+				crowds[i]->update(0.1f);
+				crowds[i]->resetBoundaryUpdateHistogram();
+
+				for (int j = 0; j < 50; ++j)
+					crowds[i]->update(0.1f);
+			}
+
+			THEN("The boundaries of the agents are not all updated during the same updates")
+			{
+				const dtCrowdWorkHistogram& lockstep = crowds[0]->getBoundaryUpdateHistogram();
+				const dtCrowdWorkHistogram& spread = crowds[1]->getBoundaryUpdateHistogram();
+
+				CHECK(lockstep.maxTasks == nbAgents);
+				CHECK(spread.maxTasks < nbAgents);
+				CHECK(spread.totalTasks > 0);
+				CHECK(spread.updates[0] < lockstep.updates[0]);
+				CHECK(spread.updates[0] + spread.updates[1] + spread.updates[2] + spread.updates[3] + spread.updates[4] == 50);
+			}
+		}
+	}
+}
+
+SCENARIO("DetourCrowdTest/NeighbourCapacity", "[detourCrowd] Test the number of neighbors kept by the agents")
+{
+	const unsigned nbAgents = 11;
+	const unsigned maxNeighbours = 8;
+
+	GIVEN("A crowd keeping up to 8 neighbors, with 10 agents in a row around the first one")
+	{
+		TestScene ts;
+		dtCrowd* crowd = ts.createSquareScene(nbAgents, 0.5f);
+		REQUIRE(crowd != 0);
+		REQUIRE(crowd->init(nbAgents, 0.5f, ts.getNavMesh(), maxNeighbours));
+		CHECK(crowd->getMaxNeighbours() == maxNeighbours);
+
+		// The farther agents are added first
+		for (unsigned i = 0; i < nbAgents; ++i)
+		{
+			dtCrowdAgent ag;
+			const float pos[] = {i == 0 ? 0.f : 0.3f * (nbAgents - i), 0, 0};
+			REQUIRE(crowd->addAgent(ag, pos));
+			ts.defaultInitializeAgent(*crowd, ag.id);
+		}
+
+		WHEN("The environment is updated")
+		{
+			crowd->updateEnvironment();
+
+			THEN("The first agent knows its 8 nearest neighbors, nearest first")
+			{
+				const dtCrowdAgentEnvironment* env = crowd->getAgentEnvironment(0);
+				REQUIRE(env->nbNeighbors == maxNeighbours);
+
+				for (unsigned j = 0; j < maxNeighbours; ++j)
+					CHECK(env->neighbors[j].idx == nbAgents - 1 - j);
+			}
+		}
+
+		WHEN("The first agent is limited to 3 neighbors")
+		{
+			CHECK_FALSE(crowd->setAgentMaxNeighbours(0, maxNeighbours + 1));
+			REQUIRE(crowd->setAgentMaxNeighbours(0, 3));
+			crowd->updateEnvironment();
+
+			THEN("It only knows the 3 nearest ones")
+			{
+				const dtCrowdAgentEnvironment* env = crowd->getAgentEnvironment(0);
+				REQUIRE(env->nbNeighbors == 3);
+				CHECK(env->neighbors[0].idx == nbAgents - 1);
+				CHECK(env->neighbors[1].idx == nbAgents - 2);
+				CHECK(env->neighbors[2].idx == nbAgents - 3);
+
+				// The other agents keep the capacity of the crowd
+				CHECK(crowd->getAgentEnvironment(nbAgents - 1)->nbNeighbors == maxNeighbours);
+			}
+		}
+	}
+}
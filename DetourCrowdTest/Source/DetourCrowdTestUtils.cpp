@@ -84,3 +84,59 @@ OffMeshConnectionCreator* TestScene::getOffMeshCreator()
 	return &m_cs.m_creator.m_offMeshConnectionCreator;
 }
 
+
+TestScenePair::TestScenePair()
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		m_crowds[i] = 0;
+		m_pathFollowings[i] = 0;
+	}
+}
+
+TestScenePair::~TestScenePair()
+{
+	for (int i = 0; i < 2; ++i)
+		dtPathFollowing::free(m_pathFollowings[i]);
+}
+
+bool TestScenePair::init(unsigned nbMaxAgents, float maxRadius)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		m_crowds[i] = m_scenes[i].createSquareScene(nbMaxAgents, maxRadius);
+		if (!m_crowds[i])
+			return false;
+
+		dtPathFollowing::free(m_pathFollowings[i]);
+		m_pathFollowings[i] = dtPathFollowing::allocate(nbMaxAgents);
+		if (!m_pathFollowings[i] || !m_pathFollowings[i]->init(*m_crowds[i]->getCrowdQuery()))
+			return false;
+	}
+
+	return true;
+}
+
+bool TestScenePair::addAgent(const float* pos, const float* dest, bool pushBehavior, unsigned* id)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		dtCrowdAgent ag;
+		if (!m_crowds[i] || !m_crowds[i]->addAgent(ag, pos))
+			return false;
+		if (pushBehavior && !m_crowds[i]->pushAgentBehavior(ag.id, m_pathFollowings[i]))
+			return false;
+		m_pathFollowings[i]->getBehaviorParams(ag.id)->submitTarget(dest, 0);
+
+		if (id)
+			*id = ag.id;
+	}
+
+	return true;
+}
+
+void TestScenePair::update(float dt)
+{
+	for (int i = 0; i < 2; ++i)
+		m_crowds[i]->update(dt);
+}
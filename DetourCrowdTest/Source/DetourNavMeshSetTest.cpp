@@ -0,0 +1,118 @@
+//
+// Copyright (c) 2013 MASA Group recastdetour@masagroup.net
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourCrowdTestUtils.h"
+
+#include "DetourNavMeshSet.h"
+
+#ifdef _MSC_VER
+#pragma warning(push, 0)
+#include <catch.hpp>
+#pragma warning(pop)
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wall"
+#include <catch.hpp>
+#pragma GCC diagnostic pop
+#endif
+
+#include <cstdio>
+#include <cstring>
+
+SCENARIO("DetourNavMeshSetTest/StoreAndMap", "[detourNavMeshSet]")
+{
+	TestScene ts;
+	REQUIRE(ts.createSquareScene(1, 0.5f) != 0);
+	const dtNavMesh* navMesh = ts.getNavMesh();
+
+	const dtMeshTile* tile = navMesh->getTile(0);
+	REQUIRE(tile->header != 0);
+
+	GIVEN("A navigation mesh stored as a set")
+	{
+		const int dataSize = dtGetNavMeshSetSize(navMesh);
+		REQUIRE(dataSize > 0);
+		CHECK(dataSize % DT_NAVMESHSET_DEFAULT_ALIGN == 0);
+
+		unsigned char* data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_TEMP);
+		REQUIRE(data != 0);
+		REQUIRE(dtStatusSucceed(dtStoreNavMeshSet(navMesh, data, dataSize)));
+		CHECK(dtStatusFailed(dtStoreNavMeshSet(navMesh, data, dataSize - 1)));
+
+		THEN("The table of contents references every tile at a page aligned offset")
+		{
+			REQUIRE(dtStatusSucceed(dtValidateNavMeshSet(data, dataSize)));
+
+			const dtNavMeshSetTile* entry = dtFindNavMeshSetTile(data, tile->header->x, tile->header->y, tile->header->layer);
+			REQUIRE(entry != 0);
+			CHECK(entry->dataOffset % DT_NAVMESHSET_DEFAULT_ALIGN == 0);
+			CHECK(entry->dataSize == tile->dataSize);
+			CHECK(entry->tileRef == navMesh->getTileRef(tile));
+			CHECK(dtFindNavMeshSetTile(data, tile->header->x + 1, tile->header->y, tile->header->layer) == 0);
+		}
+
+		THEN("A set whose tiles share their data is rejected")
+		{
+			// The table of contents is padded to the alignment, leaving room for a second entry.
+			dtNavMeshSetHeader* header = (dtNavMeshSetHeader*)data;
+			dtNavMeshSetTile* toc = (dtNavMeshSetTile*)(data + dtAlign4(sizeof(dtNavMeshSetHeader)));
+			toc[1] = toc[0];
+			toc[1].x++;
+			header->tileCount = 2;
+			CHECK(dtStatusFailed(dtValidateNavMeshSet(data, dataSize)));
+
+			header->tileCount = 1;
+			REQUIRE(dtStatusSucceed(dtValidateNavMeshSet(data, dataSize)));
+		}
+
+		WHEN("The set is written to a file and mapped")
+		{
+			const char* path = "navmeshset_test.bin";
+			FILE* fp = fopen(path, "wb");
+			REQUIRE(fp != 0);
+			fwrite(data, dataSize, 1, fp);
+			fclose(fp);
+
+			dtNavMeshSetMapping mapping;
+			REQUIRE(dtStatusSucceed(dtMapNavMeshSet(path, &mapping)));
+			CHECK(mapping.dataSize == dataSize);
+
+			dtNavMesh* loaded = dtAllocNavMesh();
+			REQUIRE(dtStatusSucceed(dtInitNavMeshFromSet(loaded, mapping.data, mapping.dataSize)));
+
+			THEN("The tiles are used in place with their original references")
+			{
+				const dtMeshTile* loadedTile = loaded->getTileAt(tile->header->x, tile->header->y, tile->header->layer);
+				REQUIRE(loadedTile != 0);
+				CHECK(loaded->getTileRef(loadedTile) == navMesh->getTileRef(tile));
+				CHECK(loadedTile->header->polyCount == tile->header->polyCount);
+				CHECK((loadedTile->flags & DT_TILE_FREE_DATA) == 0);
+				CHECK(loadedTile->data >= mapping.data);
+				CHECK(loadedTile->data < mapping.data + mapping.dataSize);
+				CHECK(memcmp(loadedTile->verts, tile->verts, sizeof(float)*3*tile->header->vertCount) == 0);
+			}
+
+			dtFreeNavMesh(loaded);
+			dtUnmapNavMeshSet(&mapping);
+			CHECK(mapping.data == 0);
+			remove(path);
+		}
+
+		dtFree(data);
+	}
+}
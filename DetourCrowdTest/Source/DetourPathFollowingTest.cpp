@@ -32,6 +32,7 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include <cstdlib>
 #include <cstring>
 
 SCENARIO("DetourPathFollowingTest/Default", "[detourPathFollowing]")
@@ -253,4 +254,526 @@ SCENARIO("DetourPathFollowingTest/PathFollowingAndCollisionAvoidance", "[detourP
     dtPipelineBehavior::free(pipeline);
     dtPathFollowing::free(pathFollowing);
     dtCollisionAvoidance::free(collisionAvoidance);
-}
\ No newline at end of file
+}
+static int s_allocCount = 0;
+
+static void* countingAlloc(int size, dtAllocHint)
+{
+	++s_allocCount;
+	return malloc(size);
+}
+
+static void countingFree(void* ptr)
+{
+	free(ptr);
+}
+
+static void* failingAlloc(int, dtAllocHint)
+{
+	return 0;
+}
+
+SCENARIO("DetourPathFollowingTest/AllocationFreeUpdate", "[detourPathFollowing]")
+{
+	const float posAgt1[] = {0, 0, 0};
+	const float posAgt2[] = {0, 0, 1};
+
+	TestScene ts;
+	dtCrowd* crowd = ts.createSquareScene(20, 0.5f);
+	REQUIRE(crowd != 0);
+
+	dtCrowdAgent ag1, ag2;
+	REQUIRE(crowd->addAgent(ag1, posAgt1));
+	REQUIRE(crowd->addAgent(ag2, posAgt2));
+
+	dtPathFollowing* pf = dtPathFollowing::allocate(2);
+	pf->init(*crowd->getCrowdQuery());
+	REQUIRE(crowd->pushAgentBehavior(ag1.id, pf));
+	REQUIRE(crowd->pushAgentBehavior(ag2.id, pf));
+
+	GIVEN("Two agents following their path")
+	{
+		const float destAgt1[] = {-18, 0, 0};
+		const float destAgt2[] = {18, 0, 1};
+		pf->getBehaviorParams(ag1.id)->submitTarget(destAgt1, 0);
+		pf->getBehaviorParams(ag2.id)->submitTarget(destAgt2, 0);
+
+		for (int i = 0; i < 5; ++i)
+			crowd->update(0.1f);
+		REQUIRE(pf->getBehaviorParams(ag1.id)->state == dtPathFollowingParams::FOLLOWING_PATH);
+
+		WHEN("The crowd is updated")
+		{
+			s_allocCount = 0;
+			dtAllocSetCustom(countingAlloc, countingFree);
+			for (int i = 0; i < 20; ++i)
+				crowd->update(0.1f);
+			dtAllocSetCustom(0, 0);
+
+			THEN("The parameters of the agents are updated without allocating")
+			{
+				CHECK(s_allocCount == 0);
+				CHECK(pf->getBehaviorParams(ag1.id)->corridor.getPathCount() > 0);
+			}
+		}
+	}
+
+	dtPathFollowing::free(pf);
+}
+
+SCENARIO("DetourPathFollowingTest/PooledCorridors", "[detourPathFollowing]")
+{
+	GIVEN("A pool and two corridors able to hold 256 polygons")
+	{
+		dtPathCorridorPool pool;
+		dtPathCorridor c1, c2;
+		REQUIRE(c1.init(256, &pool));
+		REQUIRE(c2.init(256, &pool));
+
+		dtPolyRef path[200];
+		for (int i = 0; i < 200; ++i)
+			path[i] = (dtPolyRef)(i+1);
+		const float target[] = {0, 0, 0};
+
+		dtPathCorridorPoolStats stats;
+
+		WHEN("Short paths are loaded")
+		{
+			c1.setCorridor(target, path, 5);
+			c2.setCorridor(target, path, 20);
+
+			THEN("The buffers fit the paths")
+			{
+				CHECK(c1.getCapacity() == 8);
+				CHECK(c2.getCapacity() == 32);
+				CHECK(c2.getPathCount() == 20);
+				CHECK(c2.getPath()[19] == 20);
+
+				pool.getStats(&stats);
+				CHECK(stats.blockCount == 2);
+				CHECK(stats.allocatedRefs == 40);
+				CHECK(stats.slabCount == 1);
+			}
+		}
+
+		WHEN("A path grows and shrinks")
+		{
+			c1.setCorridor(target, path, 5);
+			c1.setCorridor(target, path, 200);
+
+			THEN("The buffer follows the path")
+			{
+				CHECK(c1.getCapacity() == 256);
+				CHECK(c1.getPathCount() == 200);
+				CHECK(c1.getPath()[199] == 200);
+
+				c1.setCorridor(target, path, 3);
+				CHECK(c1.getCapacity() == 8);
+				CHECK(c1.getPath()[2] == 3);
+
+				pool.getStats(&stats);
+				CHECK(stats.blockCount == 2);
+				CHECK(stats.allocatedRefs == 16);
+			}
+		}
+
+		WHEN("A corridor is copied")
+		{
+			c1.setCorridor(target, path, 20);
+			dtPathCorridor copy(c1);
+			c2 = c1;
+
+			THEN("The copies share the pool")
+			{
+				CHECK(copy.getCapacity() == 32);
+				CHECK(c2.getCapacity() == 32);
+				CHECK(c2.getPath()[19] == 20);
+
+				pool.getStats(&stats);
+				CHECK(stats.blockCount == 3);
+				CHECK(stats.allocatedRefs == 96);
+			}
+		}
+	}
+
+	GIVEN("A pool and a corridor whose path outgrows the slabs while the memory is exhausted")
+	{
+		// More polygons than a slab of the pool holds.
+		static const int npath = 5000;
+		dtPathCorridorPool pool;
+		dtPathCorridor corridor;
+		REQUIRE(corridor.init(2 * npath, &pool));
+
+		static dtPolyRef path[npath];
+		for (int i = 0; i < npath; ++i)
+			path[i] = (dtPolyRef)(i+1);
+		const float target[] = {0, 0, 0};
+
+		REQUIRE(corridor.setCorridor(target, path, 5));
+		dtAllocSetCustom(failingAlloc, countingFree);
+		const bool loaded = corridor.setCorridor(target, path, npath);
+		dtAllocSetCustom(0, 0);
+
+		THEN("The truncation is reported and the start of the path is kept")
+		{
+			CHECK_FALSE(loaded);
+			CHECK(corridor.getCapacity() == 8);
+			CHECK(corridor.getPathCount() == 8);
+			CHECK(corridor.getPath()[7] == 8);
+			CHECK(corridor.setCorridor(target, path, 8));
+		}
+	}
+
+	GIVEN("A corridor holding a path longer than a slab, copied while the memory is exhausted")
+	{
+		static const int npath = 5000;
+		dtPathCorridorPool pool;
+		dtPathCorridor corridor;
+		REQUIRE(corridor.init(2 * npath, &pool));
+
+		static dtPolyRef path[npath];
+		for (int i = 0; i < npath; ++i)
+			path[i] = (dtPolyRef)(i+1);
+		const float target[] = {0, 0, 0};
+		REQUIRE(corridor.setCorridor(target, path, npath));
+
+		dtPathCorridor assigned;
+		REQUIRE(assigned.init(2 * npath, &pool));
+		REQUIRE(assigned.setCorridor(target, path, 5));
+
+		dtAllocSetCustom(failingAlloc, countingFree);
+		dtPathCorridor copy(corridor);
+		assigned = corridor;
+		dtAllocSetCustom(0, 0);
+
+		THEN("The copies are left empty")
+		{
+			CHECK(copy.getPath() == 0);
+			CHECK(copy.getPathCount() == 0);
+			CHECK_FALSE(copy.isSet());
+			CHECK(assigned.getPath() == 0);
+			CHECK(assigned.getPathCount() == 0);
+			CHECK_FALSE(assigned.isSet());
+			CHECK(assigned.getLastPoly() == 0);
+		}
+	}
+
+	GIVEN("Two agents following their path")
+	{
+		const float posAgt1[] = {0, 0, 0};
+		const float posAgt2[] = {0, 0, 1};
+		const float destAgt1[] = {-18, 0, 0};
+		const float destAgt2[] = {18, 0, 1};
+
+		TestScene ts;
+		dtCrowd* crowd = ts.createSquareScene(20, 0.5f);
+		REQUIRE(crowd != 0);
+
+		dtCrowdAgent ag1, ag2;
+		REQUIRE(crowd->addAgent(ag1, posAgt1));
+		REQUIRE(crowd->addAgent(ag2, posAgt2));
+
+		dtPathFollowing* pf = dtPathFollowing::allocate(2);
+		pf->init(*crowd->getCrowdQuery());
+		REQUIRE(crowd->pushAgentBehavior(ag1.id, pf));
+		REQUIRE(crowd->pushAgentBehavior(ag2.id, pf));
+
+		pf->getBehaviorParams(ag1.id)->submitTarget(destAgt1, 0);
+		pf->getBehaviorParams(ag2.id)->submitTarget(destAgt2, 0);
+
+		for (int i = 0; i < 10; ++i)
+			crowd->update(0.1f);
+
+		THEN("The corridors only use the memory their paths need")
+		{
+			const dtPathCorridor& corridor = pf->getBehaviorParams(ag1.id)->corridor;
+			CHECK(corridor.getPathCount() > 0);
+			CHECK(corridor.getCapacity() < 256);
+
+			dtPathCorridorPoolStats stats;
+			pf->getCorridorPool().getStats(&stats);
+			CHECK(stats.blockCount == 4);
+			CHECK(stats.allocatedRefs < 4*256);
+			CHECK(stats.allocatedRefs <= stats.reservedRefs);
+		}
+
+		dtPathFollowing::free(pf);
+	}
+}
+
+SCENARIO("DetourPathFollowingTest/CachedCorners", "[detourPathFollowing]")
+{
+	const float posAgt[] = {0, 0, 0};
+	const float destAgt[] = {-18, 0, 5};
+
+	GIVEN("Two crowds with an agent following the same path, one of them reusing its corners")
+	{
+		TestScenePair scenes;
+		REQUIRE(scenes.init(1));
+		dtPathFollowing* pfs[] = {scenes.getPathFollowing(0), scenes.getPathFollowing(1)};
+		unsigned id;
+		REQUIRE(scenes.addAgent(posAgt, destAgt, true, &id));
+		pfs[1]->cacheCorners = true;
+
+		WHEN("Updated for 5s at 10 Hz")
+		{
+			for (int i = 0; i < 50; ++i)
+				scenes.update(0.1f);
+
+			dtCrowdAgent ag1, ag2;
+			scenes.getCrowd(0)->fetchAgent(ag1, id);
+			scenes.getCrowd(1)->fetchAgent(ag2, id);
+
+			THEN("The agents have followed the same path")
+			{
+				CHECK(dtVdist2D(ag1.position, posAgt) > 5.f);
+				CHECK(dtVdist2D(ag1.position, ag2.position) < 0.01f);
+			}
+
+			THEN("The corners were only found again when the corridor changed")
+			{
+				const dtPathFollowingStats& stats = pfs[1]->getStats();
+				CHECK(stats.cornerQueries == pfs[0]->getStats().cornerQueries);
+				CHECK(stats.cornerUpdates < stats.cornerQueries);
+				CHECK(pfs[0]->getStats().cornerUpdates == pfs[0]->getStats().cornerQueries);
+
+				pfs[1]->resetStats();
+				CHECK(pfs[1]->getStats().cornerQueries == 0);
+			}
+		}
+	}
+}
+
+SCENARIO("DetourPathFollowingTest/VisibilityRayBudget", "[detourPathFollowing]")
+{
+	const float destAgt[] = {-18, 0, 5};
+	const unsigned nbAgents = 4;
+
+	GIVEN("Two crowds with agents optimizing their path, one of them with a budget of 1 ray per update")
+	{
+		TestScenePair scenes;
+		REQUIRE(scenes.init(nbAgents));
+		dtCrowd* crowds[] = {scenes.getCrowd(0), scenes.getCrowd(1)};
+		dtPathFollowing* pfs[] = {scenes.getPathFollowing(0), scenes.getPathFollowing(1)};
+		pfs[0]->visibilityPathOptimizationRange = 6.f;
+		pfs[1]->visibilityPathOptimizationRange = 6.f;
+		pfs[1]->visibilityRaysPerUpdate = 1;
+
+		unsigned ids[nbAgents];
+		for (unsigned j = 0; j < nbAgents; ++j)
+		{
+			const float pos[] = {3.f * j, 0, -4.f};
+			REQUIRE(scenes.addAgent(pos, destAgt, true, &ids[j]));
+		}
+
+		WHEN("Updated for 5s at 10 Hz")
+		{
+			for (int i = 0; i < 50; ++i)
+				scenes.update(0.1f);
+
+			THEN("At most one ray per update was cast with the budget")
+			{
+				CHECK(pfs[1]->getStats().visibilityOptimizations > 0);
+				CHECK(pfs[1]->getStats().visibilityOptimizations <= 50);
+				CHECK(pfs[0]->getStats().visibilityOptimizations > 50);
+			}
+
+			THEN("The agents still follow their path")
+			{
+				for (unsigned j = 0; j < nbAgents; ++j)
+				{
+					dtCrowdAgent ag;
+					crowds[1]->fetchAgent(ag, ids[j]);
+					const float pos[] = {3.f * j, 0, -4.f};
+					CHECK(dtVdist2D(ag.position, destAgt) < dtVdist2D(pos, destAgt) - 5.f);
+				}
+			}
+		}
+
+		WHEN("The rays of the agents are cast one by one and in a batch")
+		{
+			const dtNavMeshQuery* navquery = crowds[0]->getCrowdQuery()->getNavMeshQuery();
+			const dtQueryFilter* filter = crowds[0]->getCrowdQuery()->getQueryFilter();
+			static const int MAX_RES = 8;
+
+			dtRaycastRequest rays[nbAgents+1];
+			for (unsigned j = 0; j < nbAgents; ++j)
+			{
+				const dtCrowdAgent* ag = crowds[0]->getAgent(ids[j]);
+				float nearest[3];
+				navquery->findNearestPoly(ag->position, crowds[0]->getCrowdQuery()->getQueryExtents(), filter, &rays[j].startRef, nearest);
+				dtVcopy(rays[j].startPos, nearest);
+				dtVcopy(rays[j].endPos, destAgt);
+			}
+			rays[nbAgents] = rays[nbAgents-1];
+
+			dtRaycastHit hits[nbAgents+1];
+			dtPolyRef paths[(nbAgents+1)*MAX_RES];
+			REQUIRE(dtStatusSucceed(navquery->raycastBatch(rays, nbAgents+1, filter, hits, paths, MAX_RES)));
+
+			THEN("The results are the same")
+			{
+				for (unsigned j = 0; j < nbAgents+1; ++j)
+				{
+					float t, normal[3];
+					dtPolyRef path[MAX_RES];
+					int npath = 0;
+					const dtStatus status = navquery->raycast(rays[j].startRef, rays[j].startPos, rays[j].endPos, filter,
+															  &t, normal, path, &npath, MAX_RES);
+					CHECK(hits[j].status == status);
+					CHECK(hits[j].t == t);
+					REQUIRE(hits[j].pathCount == npath);
+					CHECK(memcmp(&paths[j*MAX_RES], path, sizeof(dtPolyRef) * npath) == 0);
+				}
+			}
+		}
+	}
+
+	GIVEN("A behavior allocated for a single agent, used by several agents queuing their rays")
+	{
+		TestScene ts;
+		dtCrowd* crowd = ts.createSquareScene(nbAgents, 0.5f);
+		REQUIRE(crowd != 0);
+
+		dtPathFollowing* pf = dtPathFollowing::allocate(1);
+		REQUIRE(pf->init(*crowd->getCrowdQuery()));
+		pf->visibilityPathOptimizationRange = 6.f;
+		pf->visibilityRaysPerUpdate = 1;
+
+		for (unsigned j = 0; j < nbAgents; ++j)
+		{
+			dtCrowdAgent ag;
+			const float pos[] = {3.f * j, 0, -4.f};
+			REQUIRE(crowd->addAgent(ag, pos));
+			REQUIRE(crowd->pushAgentBehavior(ag.id, pf));
+			pf->getBehaviorParams(ag.id)->submitTarget(destAgt, 0);
+		}
+
+		WHEN("Updated for 2s at 10 Hz")
+		{
+			for (int i = 0; i < 20; ++i)
+				crowd->update(0.1f);
+
+			THEN("Every agent found room in the queue")
+			{
+				CHECK(pf->getStats().visibilityOptimizations > 0);
+				CHECK(pf->getStats().visibilityOverflows == 0);
+			}
+		}
+
+		dtPathFollowing::free(pf);
+	}
+}
+
+SCENARIO("DetourPathFollowingTest/TopologyIterationBudget", "[detourPathFollowing]")
+{
+	const float destAgt[] = {-18, 0, 5};
+	const unsigned nbAgents = 4;
+
+	GIVEN("Two crowds with agents replanning at the same time, one of them with a budget of 1 iteration per update")
+	{
+		TestScenePair scenes;
+		REQUIRE(scenes.init(nbAgents));
+		dtCrowd* crowds[] = {scenes.getCrowd(0), scenes.getCrowd(1)};
+		dtPathFollowing* pfs[] = {scenes.getPathFollowing(0), scenes.getPathFollowing(1)};
+		pfs[0]->localPathReplanningInterval = 0.5f;
+		pfs[1]->localPathReplanningInterval = 0.5f;
+		pfs[1]->topologyIterationsPerUpdate = 1;
+
+		for (unsigned j = 0; j < nbAgents; ++j)
+		{
+			const float pos[] = {3.f * j, 0, -4.f};
+			REQUIRE(scenes.addAgent(pos, destAgt));
+		}
+
+		WHEN("Updated for 5s at 10 Hz")
+		{
+			unsigned maxPerUpdate[] = {0, 0};
+
+			for (int i = 0; i < 50; ++i)
+			{
+				for (int j = 0; j < 2; ++j)
+				{
+					const unsigned before = pfs[j]->getStats().topologyOptimizations;
+					crowds[j]->update(0.1f);
+					maxPerUpdate[j] = dtMax(maxPerUpdate[j], pfs[j]->getStats().topologyOptimizations - before);
+				}
+			}
+
+			THEN("The replannings are spread over the updates with the budget")
+			{
+				CHECK(maxPerUpdate[0] == nbAgents);
+				CHECK(maxPerUpdate[1] == 1);
+				CHECK(pfs[1]->getStats().topologyOptimizations > nbAgents);
+			}
+		}
+	}
+}
+
+SCENARIO("DetourPathFollowingTest/TopologyQueueOrder", "[detourPathFollowing]")
+{
+	const float destAgt[] = {-18, 0, 5};
+	const unsigned nbAgents = 6;
+
+	GIVEN("A behavior allocated for a single agent, used by several agents with spread replannings")
+	{
+		TestScene ts;
+		dtCrowd* crowd = ts.createSquareScene(nbAgents, 0.5f);
+		REQUIRE(crowd != 0);
+		crowd->setPeriodicTaskSpreading(true);
+
+		dtPathFollowing* pf = dtPathFollowing::allocate(1);
+		REQUIRE(pf->init(*crowd->getCrowdQuery()));
+		pf->localPathReplanningInterval = 0.5f;
+		pf->topologyIterationsPerUpdate = 1;
+
+		unsigned ids[nbAgents];
+		for (unsigned j = 0; j < nbAgents; ++j)
+		{
+			dtCrowdAgent ag;
+			const float pos[] = {3.f * j, 0, -4.f};
+			REQUIRE(crowd->addAgent(ag, pos));
+			REQUIRE(crowd->pushAgentBehavior(ag.id, pf));
+			pf->getBehaviorParams(ag.id)->submitTarget(destAgt, 0);
+			ids[j] = ag.id;
+		}
+
+		THEN("Every update optimizes the queued agent whose corridor is the stalest")
+		{
+			unsigned checked = 0;
+			unsigned maxQueued = 0;
+			for (int i = 0; i < 50; ++i)
+			{
+				int stalest = -1;
+				float stalestTime = 0;
+				unsigned queued = 0;
+				for (unsigned j = 0; j < nbAgents; ++j)
+				{
+					const dtPathFollowingParams* params = pf->getBehaviorParams(ids[j]);
+					if (params->topologyQueued)
+						++queued;
+					if (params->topologyQueued && (stalest < 0 || params->topologyOptTime > stalestTime))
+					{
+						stalest = (int)j;
+						stalestTime = params->topologyOptTime;
+					}
+				}
+				maxQueued = dtMax(maxQueued, queued);
+
+				const unsigned before = pf->getStats().topologyOptimizations;
+				crowd->update(0.1f);
+				if (stalest < 0 || pf->getStats().topologyOptimizations == before)
+					continue;
+
+				CHECK(pf->getBehaviorParams(ids[stalest])->topologyOptTime < stalestTime);
+				++checked;
+			}
+
+			// The queue is sized for the crowd, not for the agents the behavior was allocated for.
+			CHECK(checked > nbAgents);
+			CHECK(maxQueued > 1);
+		}
+
+		dtPathFollowing::free(pf);
+	}
+}
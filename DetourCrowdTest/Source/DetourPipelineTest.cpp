@@ -142,3 +142,33 @@ TEST_CASE("DetourPipelineTest/Pipeline", "Tests about the pipeline behavior")
 	dtPathFollowing::free(pf);
 	dtPipelineBehavior::free(pipeline);
 }
+
+TEST_CASE("DetourPipelineTest/SameAsBehaviors", "A pipeline moves the agents like its behaviors alone")
+{
+	float posAgt[] = {0, 0.2f, 0};
+	float destAgt[] = {15, 0, 0};
+
+	TestScenePair scenes;
+	REQUIRE(scenes.init(1));
+	dtPipelineBehavior* pipeline = dtPipelineBehavior::allocate();
+	unsigned id;
+	REQUIRE(scenes.addAgent(posAgt, destAgt, false, &id));
+
+	// The empty stages of the pipeline are skipped.
+	dtBehavior* behaviors[] = {0, scenes.getPathFollowing(1), 0};
+	REQUIRE(pipeline->setBehaviors(behaviors, 3));
+
+	scenes.getCrowd(0)->pushAgentBehavior(id, scenes.getPathFollowing(0));
+	scenes.getCrowd(1)->pushAgentBehavior(id, pipeline);
+
+	for (int i = 0; i < 20; ++i)
+		scenes.update(0.1f);
+
+	const dtCrowdAgent* ag1 = scenes.getCrowd(0)->getAgent(id);
+	const dtCrowdAgent* ag2 = scenes.getCrowd(1)->getAgent(id);
+	CHECK(dtVdist2D(ag1->position, posAgt) > 1.f);
+	CHECK(dtVequal(ag1->position, ag2->position));
+	CHECK(dtVequal(ag1->velocity, ag2->velocity));
+
+	dtPipelineBehavior::free(pipeline);
+}
@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2013 MASA Group recastdetour@masagroup.net
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourCrowdTestUtils.h"
+
+#include "DetourSharedNavMesh.h"
+
+#ifdef _MSC_VER
+#pragma warning(push, 0)
+#include <catch.hpp>
+#pragma warning(pop)
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wall"
+#include <catch.hpp>
+#pragma GCC diagnostic pop
+#endif
+
+
+#include <cstring>
+
+static unsigned char* copyTileData(const dtMeshTile* tile)
+{
+	unsigned char* data = (unsigned char*)dtAlloc(tile->dataSize, DT_ALLOC_PERM);
+	if (data)
+		memcpy(data, tile->data, tile->dataSize);
+	return data;
+}
+
+struct RemoveTileTask
+{
+	dtSharedNavMesh* mesh;
+	dtTileRef ref;
+	dtStatus status;
+};
+
+static void removeTileAndPublish(void* arg)
+{
+	RemoveTileTask* task = (RemoveTileTask*)arg;
+	task->status = task->mesh->removeTile(task->ref);
+	task->status |= task->mesh->publish();
+}
+
+SCENARIO("DetourSharedNavMeshTest/Publish", "[detourSharedNavMesh]")
+{
+	TestScene ts;
+	REQUIRE(ts.createSquareScene(1, 0.5f) != 0);
+	const dtNavMesh* source = ts.getNavMesh();
+	const dtMeshTile* tile = source->getTile(0);
+	REQUIRE(tile->header != 0);
+	const int tx = tile->header->x, ty = tile->header->y, tlayer = tile->header->layer;
+
+	dtSharedNavMesh mesh;
+	REQUIRE(dtStatusSucceed(mesh.init(source->getParams())));
+
+	GIVEN("A tile added to the shared navigation mesh")
+	{
+		dtTileRef ref = 0;
+		REQUIRE(dtStatusSucceed(mesh.addTile(copyTileData(tile), tile->dataSize, 0, &ref)));
+		REQUIRE(ref != 0);
+
+		THEN("The tile is only visible to the writer")
+		{
+			CHECK(mesh.getPendingNavMesh()->getTileRefAt(tx, ty, tlayer) == ref);
+
+			dtSharedNavMeshReadScope read(mesh);
+			CHECK(read.get()->getTileAt(tx, ty, tlayer) == 0);
+		}
+
+		WHEN("The change is published")
+		{
+			REQUIRE(dtStatusSucceed(mesh.publish()));
+
+			THEN("Both buffers hold the tile with the same reference")
+			{
+				CHECK(mesh.getVersion() == 1);
+				CHECK(mesh.getPendingNavMesh()->getTileRefAt(tx, ty, tlayer) == ref);
+
+				dtSharedNavMeshReadScope read(mesh);
+				CHECK(read.get()->getTileRefAt(tx, ty, tlayer) == ref);
+				CHECK(read.get() != mesh.getPendingNavMesh());
+			}
+
+			AND_WHEN("The polygon flags change")
+			{
+				const dtPolyRef polyRef = mesh.getPendingNavMesh()->getPolyRefBase(mesh.getPendingNavMesh()->getTileAt(tx, ty, tlayer));
+				REQUIRE(dtStatusSucceed(mesh.setPolyFlags(polyRef, 0x42)));
+
+				unsigned short flags = 0;
+				{
+					dtSharedNavMeshReadScope read(mesh);
+					REQUIRE(dtStatusSucceed(read.get()->getPolyFlags(polyRef, &flags)));
+					CHECK(flags != 0x42);
+				}
+
+				REQUIRE(dtStatusSucceed(mesh.publish()));
+
+				THEN("The readers and the writer see the new flags")
+				{
+					dtSharedNavMeshReadScope read(mesh);
+					REQUIRE(dtStatusSucceed(read.get()->getPolyFlags(polyRef, &flags)));
+					CHECK(flags == 0x42);
+					REQUIRE(dtStatusSucceed(mesh.getPendingNavMesh()->getPolyFlags(polyRef, &flags)));
+					CHECK(flags == 0x42);
+				}
+			}
+
+			AND_WHEN("The tile is removed by another thread while being read")
+			{
+				int token = 0;
+				const dtNavMesh* snapshot = mesh.beginRead(&token);
+
+				RemoveTileTask task;
+				task.mesh = &mesh;
+				task.ref = ref;
+				task.status = DT_FAILURE;
+				dtThread writer;
+				REQUIRE(writer.start(removeTileAndPublish, &task));
+
+				// The snapshot is left untouched until the reader is done with it.
+				while (mesh.getVersion() < 2)
+					dtThreadYield();
+				CHECK(snapshot->getTileRefAt(tx, ty, tlayer) == ref);
+				mesh.endRead(token);
+				writer.join();
+
+				THEN("The tile is gone from both buffers")
+				{
+					CHECK(dtStatusSucceed(task.status));
+
+					dtSharedNavMeshReadScope read(mesh);
+					CHECK(read.get()->getTileAt(tx, ty, tlayer) == 0);
+					CHECK(mesh.getPendingNavMesh()->getTileAt(tx, ty, tlayer) == 0);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,471 @@
+//
+// Copyright (c) 2013 MASA Group recastdetour@masagroup.net
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourCrowdTestUtils.h"
+
+#include "DetourNavMesh.h"
+#include "DetourThread.h"
+#include "DetourTileCache.h"
+#include "DetourTileCacheBuilder.h"
+
+#ifdef _MSC_VER
+#pragma warning(push, 0)
+#include <catch.hpp>
+#pragma warning(pop)
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wall"
+#include <catch.hpp>
+#pragma GCC diagnostic pop
+#endif
+
+
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+const int TILE_SIZE = 32;
+const int TILE_COUNT = 2;
+const float CELL_SIZE = 0.3f;
+const float CELL_HEIGHT = 0.2f;
+
+struct CopyCompressor : public dtTileCacheCompressor
+{
+	virtual int maxCompressedSize(const int bufferSize)
+	{
+		return bufferSize;
+	}
+
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+							  unsigned char* compressed, const int /*maxCompressedSize*/, int* compressedSize)
+	{
+		memcpy(compressed, buffer, bufferSize);
+		*compressedSize = bufferSize;
+		return DT_SUCCESS;
+	}
+
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+	{
+		if (compressedSize > maxBufferSize)
+			return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+		memcpy(buffer, compressed, compressedSize);
+		*bufferSize = compressedSize;
+		return DT_SUCCESS;
+	}
+};
+
+struct CountingAlloc : public dtTileCacheAlloc
+{
+	CountingAlloc() : allocCount(0) {}
+
+	virtual void* alloc(const int size)
+	{
+		dtAtomicAdd(&allocCount, 1);
+		return dtTileCacheAlloc::alloc(size);
+	}
+
+	volatile int allocCount;
+};
+
+/// A flat square ground split in TILE_COUNT x TILE_COUNT tiles, unless another count is given.
+struct FlatTileCache
+{
+	CopyCompressor comp;
+	dtTileCacheAlloc alloc;
+	dtTileCache cache;
+	dtNavMesh navMesh;
+	int tileCount;
+
+	bool init(const int count = TILE_COUNT)
+	{
+		tileCount = count;
+
+		dtTileCacheParams tcparams;
+		memset(&tcparams, 0, sizeof(tcparams));
+		tcparams.cs = CELL_SIZE;
+		tcparams.ch = CELL_HEIGHT;
+		tcparams.width = TILE_SIZE;
+		tcparams.height = TILE_SIZE;
+		tcparams.walkableHeight = 2.f;
+		tcparams.walkableRadius = 0.6f;
+		tcparams.walkableClimb = 0.9f;
+		tcparams.maxSimplificationError = 1.3f;
+		tcparams.maxTiles = tileCount*tileCount;
+		tcparams.maxObstacles = 128;
+		if (dtStatusFailed(cache.init(&tcparams, &alloc, &comp, 0)))
+			return false;
+
+		dtNavMeshParams params;
+		memset(&params, 0, sizeof(params));
+		params.tileWidth = TILE_SIZE*CELL_SIZE;
+		params.tileHeight = TILE_SIZE*CELL_SIZE;
+		params.maxTiles = tileCount*tileCount;
+		params.maxPolys = 1024;
+		if (dtStatusFailed(navMesh.init(&params)))
+			return false;
+
+		unsigned char heights[TILE_SIZE*TILE_SIZE];
+		unsigned char areas[TILE_SIZE*TILE_SIZE];
+		unsigned char cons[TILE_SIZE*TILE_SIZE];
+		memset(heights, 0, sizeof(heights));
+		memset(areas, DT_TILECACHE_WALKABLE_AREA, sizeof(areas));
+		for (int y = 0; y < TILE_SIZE; ++y)
+		{
+			for (int x = 0; x < TILE_SIZE; ++x)
+			{
+				// Connected to the neighbours inside the layer. (-x, +y, +x, -y)
+				unsigned char con = 0;
+				if (x > 0) con |= 1<<0;
+				if (y < TILE_SIZE-1) con |= 1<<1;
+				if (x < TILE_SIZE-1) con |= 1<<2;
+				if (y > 0) con |= 1<<3;
+				cons[x+y*TILE_SIZE] = con;
+			}
+		}
+
+		for (int ty = 0; ty < tileCount; ++ty)
+		{
+			for (int tx = 0; tx < tileCount; ++tx)
+			{
+				dtTileCacheLayerHeader header;
+				memset(&header, 0, sizeof(header));
+				header.magic = DT_TILECACHE_MAGIC;
+				header.version = DT_TILECACHE_VERSION;
+				header.tx = tx;
+				header.ty = ty;
+				header.bmin[0] = tx*TILE_SIZE*CELL_SIZE;
+				header.bmin[2] = ty*TILE_SIZE*CELL_SIZE;
+				header.bmax[0] = (tx+1)*TILE_SIZE*CELL_SIZE;
+				header.bmax[1] = 1.f;
+				header.bmax[2] = (ty+1)*TILE_SIZE*CELL_SIZE;
+				header.width = TILE_SIZE;
+				header.height = TILE_SIZE;
+				header.maxx = TILE_SIZE-1;
+				header.maxy = TILE_SIZE-1;
+
+				unsigned char* data = 0;
+				int dataSize = 0;
+				if (dtStatusFailed(dtBuildTileCacheLayer(&comp, &header, heights, areas, cons, &data, &dataSize)))
+					return false;
+				if (dtStatusFailed(cache.addTile(data, dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0)))
+					return false;
+				if (dtStatusFailed(cache.buildNavMeshTilesAt(tx, ty, &navMesh)))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	bool addObstacles(const int count)
+	{
+		const float size = tileCount*TILE_SIZE*CELL_SIZE;
+		for (int i = 0; i < count; ++i)
+		{
+			const float pos[] = {(0.5f + i%6)*size/6, 0, (0.5f + i/6)*size/6};
+			if (dtStatusFailed(cache.addObstacle(pos, 0.5f, 2.f, 0)))
+				return false;
+		}
+		return true;
+	}
+
+	bool obstaclesProcessed() const
+	{
+		for (int i = 0; i < cache.getObstacleCount(); ++i)
+		{
+			if (cache.getObstacle(i)->state == DT_OBSTACLE_PROCESSING || cache.getObstacle(i)->state == DT_OBSTACLE_REMOVING)
+				return false;
+		}
+		return true;
+	}
+
+	int getTilePolyCount(const int tx, const int ty) const
+	{
+		const dtMeshTile* tile = ((const dtNavMesh&)navMesh).getTileAt(tx, ty, 0);
+		return tile ? tile->header->polyCount : 0;
+	}
+
+	int getPolyCount() const
+	{
+		const dtNavMesh& mesh = navMesh;
+		int npolys = 0;
+		for (int i = 0; i < mesh.getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = mesh.getTile(i);
+			if (tile->header)
+				npolys += tile->header->polyCount;
+		}
+		return npolys;
+	}
+};
+}
+
+SCENARIO("DetourTileCacheTest/ParallelUpdate", "[detourTileCache]")
+{
+	FlatTileCache serial;
+	REQUIRE(serial.init());
+	FlatTileCache parallel;
+	REQUIRE(parallel.init());
+
+	dtTileCacheThreadPool workers;
+	REQUIRE(workers.init(4));
+	REQUIRE(workers.getWorkerCount() == 4);
+	parallel.cache.setWorkerPool(&workers);
+
+	const int initialPolyCount = serial.getPolyCount();
+	REQUIRE(initialPolyCount > 0);
+	CHECK(parallel.getPolyCount() == initialPolyCount);
+
+	GIVEN("More obstacles than the initial capacity of the request queue")
+	{
+		const int obstacleCount = 80;
+		REQUIRE(serial.addObstacles(obstacleCount));
+		REQUIRE(parallel.addObstacles(obstacleCount));
+
+		WHEN("The tile caches are updated")
+		{
+			int serialUpdates = 0;
+			while (!serial.obstaclesProcessed() && serialUpdates < 100)
+			{
+				REQUIRE(dtStatusSucceed(serial.cache.update(0, &serial.navMesh)));
+				serialUpdates++;
+			}
+			REQUIRE(dtStatusSucceed(parallel.cache.update(0, &parallel.navMesh)));
+
+			THEN("The parallel update rebuilds all the tiles at once")
+			{
+				CHECK(serialUpdates == TILE_COUNT*TILE_COUNT);
+				CHECK(parallel.obstaclesProcessed());
+				CHECK(parallel.getPolyCount() > initialPolyCount);
+				CHECK(parallel.getPolyCount() == serial.getPolyCount());
+			}
+		}
+
+		WHEN("The serial update is given a time budget")
+		{
+			REQUIRE(dtStatusSucceed(serial.cache.update(0, &serial.navMesh, 1000000)));
+
+			THEN("All the tiles are rebuilt in one update")
+			{
+				CHECK(serial.obstaclesProcessed());
+			}
+		}
+	}
+
+	GIVEN("Workers given their own allocator")
+	{
+		CountingAlloc counting;
+		for (int i = 0; i < workers.getWorkerCount(); ++i)
+			workers.setAlloc(i, &counting);
+		REQUIRE(parallel.addObstacles(1));
+
+		WHEN("The parallel tile cache is updated")
+		{
+			REQUIRE(dtStatusSucceed(parallel.cache.update(0, &parallel.navMesh)));
+
+			THEN("The workers build the tiles with that allocator")
+			{
+				CHECK(parallel.obstaclesProcessed());
+				CHECK(counting.allocCount > 0);
+			}
+		}
+
+		WHEN("The allocator is removed")
+		{
+			workers.setAlloc(0, 0);
+
+			THEN("The worker goes back to its default allocator")
+			{
+				CHECK(workers.getAlloc(0) != &counting);
+				CHECK(workers.getAlloc(0) != 0);
+			}
+		}
+	}
+}
+
+SCENARIO("DetourTileCacheTest/ObstacleShapes", "[detourTileCache]")
+{
+	FlatTileCache tc;
+	REQUIRE(tc.init());
+	const int initialPolyCount = tc.getTilePolyCount(0, 0);
+
+	GIVEN("A thin wall rotated across the corner of a tile")
+	{
+		// Rotated by -45 degrees, it crosses the tiles (0,0), (1,0) and (0,1), but its bounds also overlap the tile (1,1).
+		const float center[] = {8.5f, 0, 8.5f};
+		const float halfExtents[] = {3.f, 1.f, 0.2f};
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(tc.cache.addBoxObstacle(center, halfExtents, -0.785398f, &ref)));
+		REQUIRE(dtStatusSucceed(tc.cache.update(0, &tc.navMesh, 1000000)));
+
+		THEN("Only the tiles under the wall are rebuilt")
+		{
+			const dtTileCacheObstacle* ob = tc.cache.getObstacleByRef(ref);
+			REQUIRE(ob != 0);
+			CHECK(ob->state == DT_OBSTACLE_PROCESSED);
+			CHECK(ob->ntouched == 3);
+			CHECK(tc.getTilePolyCount(0, 0) > initialPolyCount);
+			CHECK(tc.getTilePolyCount(1, 1) == initialPolyCount);
+		}
+	}
+
+	GIVEN("A polygon which is not convex")
+	{
+		const float verts[] = {2.f,0,2.f, 6.f,0,2.f, 4.f,0,3.f, 4.f,0,6.f};
+		dtObstacleRef ref = 0;
+
+		THEN("It cannot be added as an obstacle")
+		{
+			const dtStatus status = tc.cache.addConvexObstacle(verts, 4, 0, 2.f, &ref);
+			CHECK(dtStatusFailed(status));
+			CHECK(dtStatusDetail(status, DT_INVALID_PARAM));
+			CHECK(ref == 0);
+		}
+	}
+
+	GIVEN("A star pentagon, whose edges all turn the same way")
+	{
+		// The vertices of a regular pentagon, visited in the order 0, 2, 4, 1, 3.
+		float verts[5*3];
+		for (int i = 0; i < 5; ++i)
+		{
+			const float a = (float)((i*2) % 5) * 2.f * 3.14159265f / 5.f;
+			verts[i*3+0] = 4.f + 2.f*cosf(a);
+			verts[i*3+1] = 0;
+			verts[i*3+2] = 4.f + 2.f*sinf(a);
+		}
+		dtObstacleRef ref = 0;
+
+		THEN("It cannot be added as an obstacle")
+		{
+			const dtStatus status = tc.cache.addConvexObstacle(verts, 5, 0, 2.f, &ref);
+			CHECK(dtStatusFailed(status));
+			CHECK(dtStatusDetail(status, DT_INVALID_PARAM));
+			CHECK(ref == 0);
+		}
+
+		THEN("Its vertices in the order of the pentagon can be")
+		{
+			float pentagon[5*3];
+			for (int i = 0; i < 5; ++i)
+				memcpy(&pentagon[((i*2) % 5)*3], &verts[i*3], sizeof(float)*3);
+			CHECK(dtStatusSucceed(tc.cache.addConvexObstacle(pentagon, 5, 0, 2.f, &ref)));
+		}
+	}
+
+	GIVEN("Obstacles of every shape ending a third of a cell before the border of a tile")
+	{
+		// The tile (0,0) ends at x = 9.6, the obstacles end at x = 9.5 and are grown by half a cell.
+		const float center[] = {8.5f, 0, 4.f};
+		const float halfExtents[] = {1.f, 1.f, 1.f};
+		const float bmin[] = {7.5f, 0, 3.f};
+		const float bmax[] = {9.5f, 2.f, 5.f};
+		const float verts[] = {7.5f,0,3.f, 9.5f,0,4.f, 7.5f,0,5.f};
+		dtObstacleRef refs[4];
+		REQUIRE(dtStatusSucceed(tc.cache.addObstacle(center, 1.f, 2.f, &refs[0])));
+		REQUIRE(dtStatusSucceed(tc.cache.addBoxObstacle(bmin, bmax, &refs[1])));
+		REQUIRE(dtStatusSucceed(tc.cache.addBoxObstacle(center, halfExtents, 0, &refs[2])));
+		REQUIRE(dtStatusSucceed(tc.cache.addConvexObstacle(verts, 3, 0, 2.f, &refs[3])));
+		REQUIRE(dtStatusSucceed(tc.cache.update(0, &tc.navMesh, 1000000)));
+
+		THEN("They all touch the next tile too")
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				const dtTileCacheObstacle* ob = tc.cache.getObstacleByRef(refs[i]);
+				REQUIRE(ob != 0);
+				CHECK(ob->ntouched == 2);
+			}
+		}
+	}
+
+	GIVEN("A convex obstacle inside a tile")
+	{
+		const float verts[] = {2.f,0,2.f, 6.f,0,2.f, 4.f,0,6.f};
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(tc.cache.addConvexObstacle(verts, 3, 0, 2.f, &ref)));
+		REQUIRE(dtStatusSucceed(tc.cache.update(0, &tc.navMesh, 1000000)));
+
+		const dtTileCacheObstacle* ob = tc.cache.getObstacleByRef(ref);
+		REQUIRE(ob != 0);
+		CHECK(ob->ntouched == 1);
+		CHECK(tc.getTilePolyCount(0, 0) > initialPolyCount);
+
+		WHEN("The obstacle is moved to another tile")
+		{
+			const float pos[] = {14.f, 0, 14.f};
+			REQUIRE(dtStatusSucceed(tc.cache.editObstaclePos(ref, pos)));
+			REQUIRE(dtStatusSucceed(tc.cache.update(0, &tc.navMesh, 1000000)));
+
+			THEN("Both tiles are rebuilt")
+			{
+				CHECK(ob->state == DT_OBSTACLE_PROCESSED);
+				CHECK(ob->ntouched == 1);
+				CHECK(tc.getTilePolyCount(0, 0) == initialPolyCount);
+				CHECK(tc.getTilePolyCount(1, 1) > initialPolyCount);
+			}
+		}
+	}
+}
+
+SCENARIO("DetourTileCacheTest/TouchedTiles", "[detourTileCache]")
+{
+	FlatTileCache tc;
+	REQUIRE(tc.init(5));
+
+	GIVEN("An obstacle covering more tiles than an obstacle can touch")
+	{
+		REQUIRE(5*5 > DT_MAX_TOUCHED_TILES);
+		const float bmin[] = {0.5f, 0, 0.5f};
+		const float bmax[] = {47.5f, 2.f, 47.5f};
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(tc.cache.addBoxObstacle(bmin, bmax, &ref)));
+
+		THEN("The update reports that not all of them were updated")
+		{
+			const dtStatus status = tc.cache.update(0, &tc.navMesh, 1000000);
+			CHECK(dtStatusSucceed(status));
+			CHECK(dtStatusDetail(status, DT_BUFFER_TOO_SMALL));
+
+			const dtTileCacheObstacle* ob = tc.cache.getObstacleByRef(ref);
+			REQUIRE(ob != 0);
+			CHECK(ob->ntouched == DT_MAX_TOUCHED_TILES);
+			CHECK(tc.obstaclesProcessed());
+		}
+	}
+
+	GIVEN("An obstacle covering as many tiles as an obstacle can touch")
+	{
+		const float bmin[] = {0.5f, 0, 0.5f};
+		const float bmax[] = {38.f, 2.f, 38.f};
+		dtObstacleRef ref = 0;
+		REQUIRE(dtStatusSucceed(tc.cache.addBoxObstacle(bmin, bmax, &ref)));
+
+		THEN("All of them are updated")
+		{
+			const dtStatus status = tc.cache.update(0, &tc.navMesh, 1000000);
+			CHECK(status == DT_SUCCESS);
+
+			const dtTileCacheObstacle* ob = tc.cache.getObstacleByRef(ref);
+			REQUIRE(ob != 0);
+			CHECK(ob->ntouched == DT_MAX_TOUCHED_TILES);
+		}
+	}
+}
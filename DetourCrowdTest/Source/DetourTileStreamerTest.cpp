@@ -0,0 +1,417 @@
+//
+// Copyright (c) 2013 MASA Group recastdetour@masagroup.net
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourCrowdTestUtils.h"
+
+#include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshSet.h"
+#include "DetourTileStreamer.h"
+
+#ifdef _MSC_VER
+#pragma warning(push, 0)
+#include <catch.hpp>
+#pragma warning(pop)
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wall"
+#include <catch.hpp>
+#pragma GCC diagnostic pop
+#endif
+
+#include <cstdio>
+#include <cstring>
+
+static bool storeSet(const dtNavMesh* navMesh, const char* path)
+{
+	const int dataSize = dtGetNavMeshSetSize(navMesh);
+	unsigned char* data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_TEMP);
+	if (!data)
+		return false;
+	bool ok = dtStatusSucceed(dtStoreNavMeshSet(navMesh, data, dataSize));
+	FILE* fp = ok ? fopen(path, "wb") : 0;
+	if (fp)
+	{
+		ok = fwrite(data, dataSize, 1, fp) == 1;
+		fclose(fp);
+	}
+	dtFree(data);
+	return ok && fp;
+}
+
+// Writes the given set to a file and opens it as a stream source.
+static dtStatus initSource(const unsigned char* data, const int dataSize, const char* path)
+{
+	FILE* fp = fopen(path, "wb");
+	if (!fp)
+		return DT_FAILURE;
+	const bool written = fwrite(data, dataSize, 1, fp) == 1;
+	fclose(fp);
+	if (!written)
+		return DT_FAILURE;
+
+	dtNavMeshSetStreamSource source;
+	return source.init(path);
+}
+
+static void streamTiles(bool backgroundIO)
+{
+	TestScene ts;
+	REQUIRE(ts.createSquareScene(1, 0.5f) != 0);
+	const dtMeshTile* tile = ((const dtNavMesh*)ts.getNavMesh())->getTile(0);
+	REQUIRE(tile->header != 0);
+
+	const char* path = "tilestreamer_test.bin";
+	REQUIRE(storeSet(ts.getNavMesh(), path));
+
+	dtNavMeshSetStreamSource source;
+	REQUIRE(dtStatusSucceed(source.init(path)));
+
+	dtNavMesh navMesh;
+	REQUIRE(dtStatusSucceed(navMesh.init(source.getParams())));
+
+	dtTileStreamerParams params;
+	params.loadRadius = 10.f;
+	params.evictRadius = 20.f;
+	params.maxColumns = 16;
+	params.maxFocusPoints = 2;
+	params.backgroundIO = backgroundIO;
+
+	dtTileStreamer streamer;
+	REQUIRE(dtStatusSucceed(streamer.init(&params, &navMesh, &source)));
+
+	GIVEN("A focus point on the tile")
+	{
+		const float focus[] = {0, 0, 0};
+		REQUIRE(dtStatusSucceed(streamer.setFocusPoints(focus, 1)));
+
+		WHEN("The streamer is updated until the tile is committed")
+		{
+			for (int i = 0; i < 100000 && streamer.getStats().committedColumns == 0; ++i)
+				streamer.update(1000);
+
+			THEN("The tile is in the navigation mesh")
+			{
+				CHECK(streamer.getStats().committedColumns == 1);
+				const dtMeshTile* streamed = navMesh.getTileAt(tile->header->x, tile->header->y, tile->header->layer);
+				REQUIRE(streamed != 0);
+				CHECK(streamed->header->polyCount == tile->header->polyCount);
+
+				AND_WHEN("The focus point moves away")
+				{
+					const float away[] = {1000, 0, 1000};
+					REQUIRE(dtStatusSucceed(streamer.setFocusPoints(away, 1)));
+					streamer.update(1000);
+
+					THEN("The tile is evicted")
+					{
+						CHECK(streamer.getStats().removedTiles == 1);
+						CHECK(streamer.getStats().committedColumns == 0);
+						CHECK(navMesh.getTileAt(tile->header->x, tile->header->y, tile->header->layer) == 0);
+					}
+				}
+			}
+		}
+	}
+
+	remove(path);
+}
+
+SCENARIO("DetourTileStreamerTest/BackgroundIO", "[detourTileStreamer]")
+{
+	streamTiles(true);
+}
+
+SCENARIO("DetourTileStreamerTest/SynchronousIO", "[detourTileStreamer]")
+{
+	streamTiles(false);
+}
+
+namespace
+{
+const int GRID_SIZE = 5;
+const float GRID_TILE_SIZE = 10.f;
+
+/// A grid of GRID_SIZE x GRID_SIZE tiles, each made of a single square polygon.
+bool buildGrid(dtNavMesh& navMesh)
+{
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = GRID_TILE_SIZE;
+	params.tileHeight = GRID_TILE_SIZE;
+	params.maxTiles = GRID_SIZE*GRID_SIZE;
+	params.maxPolys = 4;
+	if (dtStatusFailed(navMesh.init(&params)))
+		return false;
+
+	const float cs = 0.5f;
+	const unsigned short n = (unsigned short)(GRID_TILE_SIZE / cs);
+	const unsigned short verts[] = {0,0,0, 0,0,n, n,0,n, n,0,0};
+	const unsigned short polys[] = {0,1,2,3, 0xffff,0xffff,0xffff,0xffff};
+	const unsigned short flags[] = {1};
+	const unsigned char areas[] = {0};
+
+	for (int ty = 0; ty < GRID_SIZE; ++ty)
+	{
+		for (int tx = 0; tx < GRID_SIZE; ++tx)
+		{
+			dtNavMeshCreateParams create;
+			memset(&create, 0, sizeof(create));
+			create.verts = verts;
+			create.vertCount = 4;
+			create.polys = polys;
+			create.polyFlags = flags;
+			create.polyAreas = areas;
+			create.polyCount = 1;
+			create.nvp = 4;
+			create.walkableHeight = 2.f;
+			create.walkableRadius = 0.6f;
+			create.walkableClimb = 0.9f;
+			create.tileX = tx;
+			create.tileY = ty;
+			create.bmin[0] = tx*GRID_TILE_SIZE;
+			create.bmin[2] = ty*GRID_TILE_SIZE;
+			create.bmax[0] = (tx+1)*GRID_TILE_SIZE;
+			create.bmax[1] = 1.f;
+			create.bmax[2] = (ty+1)*GRID_TILE_SIZE;
+			create.cs = cs;
+			create.ch = 0.2f;
+			create.buildBvTree = true;
+
+			unsigned char* data = 0;
+			int dataSize = 0;
+			if (!dtCreateNavMeshData(&create, &data, &dataSize))
+				return false;
+			if (dtStatusFailed(navMesh.addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)))
+				return false;
+		}
+	}
+	return true;
+}
+
+/// The distance between the center of the grid and the given tile.
+float getGridDistance(const int tx, const int ty)
+{
+	const float center = GRID_SIZE*GRID_TILE_SIZE*0.5f;
+	const float dx = dtMax(dtAbs(center - (tx+0.5f)*GRID_TILE_SIZE) - GRID_TILE_SIZE*0.5f, 0.f);
+	const float dz = dtMax(dtAbs(center - (ty+0.5f)*GRID_TILE_SIZE) - GRID_TILE_SIZE*0.5f, 0.f);
+	return sqrtf(dx*dx + dz*dz);
+}
+}
+
+SCENARIO("DetourTileStreamerTest/Grid", "[detourTileStreamer]")
+{
+	dtNavMesh grid;
+	REQUIRE(buildGrid(grid));
+
+	const char* path = "tilestreamer_grid_test.bin";
+	REQUIRE(storeSet(&grid, path));
+
+	dtNavMeshSetStreamSource source;
+	REQUIRE(dtStatusSucceed(source.init(path)));
+
+	dtNavMesh navMesh;
+	REQUIRE(dtStatusSucceed(navMesh.init(source.getParams())));
+
+	dtTileStreamerParams params;
+	// Every tile of the grid is in range, the corners are about 21.2 wu away.
+	params.loadRadius = 22.f;
+	params.evictRadius = 30.f;
+	params.maxColumns = GRID_SIZE*GRID_SIZE;
+	params.maxFocusPoints = 1;
+	params.backgroundIO = false;
+
+	const float center[] = {GRID_SIZE*GRID_TILE_SIZE*0.5f, 0, GRID_SIZE*GRID_TILE_SIZE*0.5f};
+
+	GIVEN("A focus point at the center of the grid and no time budget")
+	{
+		dtTileStreamer streamer;
+		REQUIRE(dtStatusSucceed(streamer.init(&params, &navMesh, &source)));
+		REQUIRE(dtStatusSucceed(streamer.setFocusPoints(center, 1)));
+
+		WHEN("The streamer is updated until every tile is committed")
+		{
+			bool committed[GRID_SIZE*GRID_SIZE];
+			memset(committed, 0, sizeof(committed));
+			bool atMostOneChange = true;
+			bool nearestFirst = true;
+			float lastDist = 0.f;
+
+			for (int i = 0; i < 1000 && streamer.getStats().committedColumns < GRID_SIZE*GRID_SIZE; ++i)
+			{
+				REQUIRE(dtStatusSucceed(streamer.update(0)));
+				if (streamer.getStats().addedTiles > 1)
+					atMostOneChange = false;
+
+				for (int j = 0; j < GRID_SIZE*GRID_SIZE; ++j)
+				{
+					const int tx = j % GRID_SIZE;
+					const int ty = j / GRID_SIZE;
+					if (committed[j] || !navMesh.getTileAt(tx, ty, 0))
+						continue;
+					committed[j] = true;
+					const float dist = getGridDistance(tx, ty);
+					if (dist < lastDist)
+						nearestFirst = false;
+					lastDist = dist;
+				}
+			}
+
+			THEN("The tiles are committed one per update, nearest first")
+			{
+				CHECK(streamer.getStats().committedColumns == GRID_SIZE*GRID_SIZE);
+				CHECK(atMostOneChange);
+				CHECK(nearestFirst);
+			}
+		}
+	}
+
+	GIVEN("A focus point at the center of the grid and a large time budget")
+	{
+		dtTileStreamer streamer;
+		REQUIRE(dtStatusSucceed(streamer.init(&params, &navMesh, &source)));
+		REQUIRE(dtStatusSucceed(streamer.setFocusPoints(center, 1)));
+
+		WHEN("The streamer is updated once")
+		{
+			streamer.update(10000000);
+
+			THEN("Every tile is committed")
+			{
+				CHECK(streamer.getStats().addedTiles == GRID_SIZE*GRID_SIZE);
+				CHECK(streamer.getStats().committedColumns == GRID_SIZE*GRID_SIZE);
+			}
+		}
+	}
+
+	GIVEN("A streamer tracking fewer columns than the tiles in range")
+	{
+		params.maxColumns = 4;
+		dtTileStreamer streamer;
+		REQUIRE(dtStatusSucceed(streamer.init(&params, &navMesh, &source)));
+		REQUIRE(dtStatusSucceed(streamer.setFocusPoints(center, 1)));
+
+		WHEN("The streamer is updated")
+		{
+			const dtStatus status = streamer.update(10000000);
+
+			THEN("The missing columns are reported and only the nearest ones are committed")
+			{
+				CHECK(dtStatusSucceed(status));
+				CHECK(dtStatusDetail(status, DT_BUFFER_TOO_SMALL));
+				CHECK(streamer.getStats().committedColumns == 4);
+				CHECK(navMesh.getTileAt(GRID_SIZE/2, GRID_SIZE/2, 0) != 0);
+			}
+		}
+	}
+
+	remove(path);
+}
+
+SCENARIO("DetourTileStreamerTest/InvalidSet", "[detourTileStreamer]")
+{
+	dtNavMesh grid;
+	REQUIRE(buildGrid(grid));
+
+	const char* path = "tilestreamer_valid_test.bin";
+	const char* badPath = "tilestreamer_invalid_test.bin";
+	REQUIRE(storeSet(&grid, path));
+
+	GIVEN("A set whose header claims more tiles than the file holds")
+	{
+		FILE* fp = fopen(path, "rb");
+		REQUIRE(fp != 0);
+		dtNavMeshSetHeader header;
+		REQUIRE(fread(&header, sizeof(header), 1, fp) == 1);
+		fclose(fp);
+
+		header.tileCount = 0x7fffffff;
+		fp = fopen(badPath, "wb");
+		REQUIRE(fp != 0);
+		fwrite(&header, sizeof(header), 1, fp);
+		fclose(fp);
+
+		THEN("The source rejects it and can be initialized again")
+		{
+			dtNavMeshSetStreamSource source;
+			CHECK(dtStatusFailed(source.init(badPath)));
+			CHECK(source.getParams() == 0);
+			CHECK(dtStatusSucceed(source.init(path)));
+			CHECK(source.getParams() != 0);
+		}
+
+		remove(badPath);
+	}
+
+	GIVEN("A set whose table of contents is corrupted")
+	{
+		const int dataSize = dtGetNavMeshSetSize(&grid);
+		unsigned char* data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_TEMP);
+		REQUIRE(data != 0);
+		REQUIRE(dtStatusSucceed(dtStoreNavMeshSet(&grid, data, dataSize)));
+		REQUIRE(dtStatusSucceed(initSource(data, dataSize, badPath)));
+
+		const dtNavMeshSetHeader* header = (const dtNavMeshSetHeader*)data;
+		REQUIRE(header->tileCount > 1);
+		dtNavMeshSetTile* toc = (dtNavMeshSetTile*)(data + dtAlign4(sizeof(dtNavMeshSetHeader)));
+
+		WHEN("A tile claims more data than the file holds")
+		{
+			toc[0].dataSize = 0x7fff0000;
+
+			THEN("The source rejects it")
+			{
+				CHECK(dtStatusFailed(initSource(data, dataSize, badPath)));
+			}
+		}
+
+		WHEN("A tile starts before the table of contents ends")
+		{
+			toc[1].dataOffset = -header->tileAlign;
+
+			THEN("The source rejects it")
+			{
+				CHECK(dtStatusFailed(initSource(data, dataSize, badPath)));
+			}
+		}
+
+		WHEN("The file is truncated")
+		{
+			THEN("The source rejects it")
+			{
+				CHECK(dtStatusFailed(initSource(data, dataSize - 1, badPath)));
+			}
+		}
+
+		WHEN("The entries are not sorted")
+		{
+			dtSwap(toc[0].x, toc[1].x);
+			dtSwap(toc[0].y, toc[1].y);
+			dtSwap(toc[0].layer, toc[1].layer);
+
+			THEN("The source rejects it")
+			{
+				CHECK(dtStatusFailed(initSource(data, dataSize, badPath)));
+			}
+		}
+
+		dtFree(data);
+		remove(badPath);
+	}
+
+	remove(path);
+}
@@ -0,0 +1,755 @@
+//
+// Copyright (c) 2013 MASA Group recastdetour@masagroup.net
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourCrowdTestUtils.h"
+
+#include "DetourThread.h"
+#include "MeshLoaderObj.h"
+#include "Recast.h"
+
+#ifdef _MSC_VER
+#pragma warning(push, 0)
+#include <catch.hpp>
+#pragma warning(pop)
+#else
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wall"
+#include <catch.hpp>
+#pragma GCC diagnostic pop
+#endif
+
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+
+/// Runs the parallel loops of the build on a thread pool.
+class ThreadPoolContext : public rcContext
+{
+public:
+	ThreadPoolContext(const int workerCount) : rcContext(false) { m_pool.init(workerCount); }
+
+protected:
+	virtual int doGetWorkerCount() const { return m_pool.getWorkerCount(); }
+	virtual void doParallelFor(rcParallelForFunc* func, void* arg, const int count) { m_pool.parallelFor(func, arg, count); }
+
+private:
+	dtThreadPool m_pool;
+};
+
+/// Voxelizes one of the meshes bundled with the demo, up to the eroded compact heightfield.
+struct RecastBuild
+{
+	rcContext ctx;
+	rcConfig cfg;
+	rcMeshLoaderObj mesh;
+	unsigned char* areas;
+	rcHeightfield* solid;
+	rcCompactHeightfield* chf;
+
+	RecastBuild()
+		: ctx(false)
+		, areas(0)
+		, solid(rcAllocHeightfield())
+		, chf(rcAllocCompactHeightfield())
+	{
+	}
+
+	~RecastBuild()
+	{
+		delete [] areas;
+		rcFreeHeightField(solid);
+		rcFreeCompactHeightfield(chf);
+	}
+
+	/// Loads the mesh and marks its walkable triangles.
+	bool load(const char* meshName, const int borderSize)
+	{
+		char path[256];
+		snprintf(path, sizeof(path), "../../RecastDemo/Bin/Meshes/%s", meshName);
+		if (!mesh.load(path))
+			return false;
+
+		memset(&cfg, 0, sizeof(cfg));
+		cfg.cs = 0.3f;
+		cfg.ch = 0.2f;
+		cfg.walkableSlopeAngle = 45.0f;
+		cfg.walkableHeight = 10;
+		cfg.walkableClimb = 4;
+		cfg.walkableRadius = 2;
+		cfg.borderSize = borderSize;
+		cfg.minRegionArea = 8*8;
+		cfg.mergeRegionArea = 20*20;
+		rcCalcBounds(mesh.getVerts(), mesh.getVertCount(), cfg.bmin, cfg.bmax);
+		rcCalcGridSize(cfg.bmin, cfg.bmax, cfg.cs, &cfg.width, &cfg.height);
+
+		const int ntris = mesh.getTriCount();
+		areas = new unsigned char[ntris];
+		memset(areas, 0, ntris);
+		rcMarkWalkableTriangles(&ctx, cfg.walkableSlopeAngle, mesh.getVerts(), mesh.getVertCount(), mesh.getTris(), ntris, areas);
+		return true;
+	}
+
+	/// Rasterizes the mesh in a new heightfield.
+	bool rasterize(rcContext* rctx, rcHeightfield& hf) const
+	{
+		if (!rcCreateHeightfield(rctx, hf, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs, cfg.ch))
+			return false;
+		rcRasterizeTriangles(rctx, mesh.getVerts(), mesh.getVertCount(), mesh.getTris(), areas, mesh.getTriCount(), hf, cfg.walkableClimb);
+		return true;
+	}
+
+	bool build(const char* meshName, const int borderSize)
+	{
+		if (!load(meshName, borderSize) || !rasterize(&ctx, *solid))
+			return false;
+
+		rcFilterLowHangingWalkableObstacles(&ctx, cfg.walkableClimb, *solid);
+		rcFilterLedgeSpans(&ctx, cfg.walkableHeight, cfg.walkableClimb, *solid);
+		rcFilterWalkableLowHeightSpans(&ctx, cfg.walkableHeight, *solid);
+
+		return rcBuildCompactHeightfield(&ctx, cfg.walkableHeight, cfg.walkableClimb, *solid, *chf)
+			&& rcErodeWalkableArea(&ctx, cfg.walkableRadius, *chf);
+	}
+
+	/// Hashes the region of every span. (FNV-1a)
+	unsigned int hashRegions() const
+	{
+		unsigned int h = 2166136261u;
+		for (int i = 0; i < chf->spanCount; ++i)
+		{
+			h = (h ^ (chf->spans[i].reg & 0xff)) * 16777619u;
+			h = (h ^ (chf->spans[i].reg >> 8)) * 16777619u;
+		}
+		return h;
+	}
+};
+
+/// Checks that two heightfields of the same size hold the same spans.
+static bool sameSpans(const rcHeightfield& a, const rcHeightfield& b)
+{
+	if (a.width != b.width || a.height != b.height)
+		return false;
+	for (int i = 0; i < a.width*a.height; ++i)
+	{
+		const rcSpan* sa = a.spans[i];
+		const rcSpan* sb = b.spans[i];
+		for (; sa && sb; sa = sa->next, sb = sb->next)
+		{
+			if (sa->smin != sb->smin || sa->smax != sb->smax || sa->area != sb->area)
+				return false;
+		}
+		if (sa || sb)
+			return false;
+	}
+	return true;
+}
+
+static int countSpans(const rcHeightfield& hf)
+{
+	int n = 0;
+	for (int i = 0; i < hf.width*hf.height; ++i)
+		for (const rcSpan* s = hf.spans[i]; s; s = s->next)
+			n++;
+	return n;
+}
+
+SCENARIO("RecastBuildTest/Watershed", "[recastBuild]")
+{
+	// The expected values were recorded with the original watershed, which rescanned
+	// the whole heightfield at every level. The partitioning must not change.
+	// The regions are checked before and after the small regions are filtered out.
+	const char* meshes[] = {"dungeon.obj", "nav_test.obj"};
+	const int borderSizes[] = {0, 8};
+	const unsigned int expectedHashes[2][2][2] = {{{1796803153u, 447482934u}, {2527444155u, 1814056310u}}, {{2903665086u, 3150986205u}, {4275373110u, 3836021076u}}};
+	const int expectedRegions[2][2][2] = {{{25, 16}, {29, 20}}, {{102, 48}, {106, 52}}};
+
+	for (int m = 0; m < 2; ++m)
+	{
+		for (int b = 0; b < 2; ++b)
+		{
+			for (int f = 0; f < 2; ++f)
+			{
+				char name[96];
+				snprintf(name, sizeof(name), "The distance field of %s, with a border of %d%s",
+						 meshes[m], borderSizes[b], f ? "" : ", without filtering");
+				GIVEN(name)
+				{
+					RecastBuild build;
+					REQUIRE(build.build(meshes[m], borderSizes[b]));
+					REQUIRE(rcBuildDistanceField(&build.ctx, *build.chf));
+					const int minRegionArea = f ? build.cfg.minRegionArea : 0;
+					const int mergeRegionArea = f ? build.cfg.mergeRegionArea : 0;
+
+					THEN("The regions match the reference partitioning")
+					{
+						REQUIRE(rcBuildRegions(&build.ctx, *build.chf, borderSizes[b], minRegionArea, mergeRegionArea));
+						CHECK(build.chf->maxRegions == expectedRegions[m][b][f]);
+						CHECK(build.hashRegions() == expectedHashes[m][b][f]);
+					}
+				}
+			}
+		}
+	}
+}
+
+SCENARIO("RecastBuildTest/ParallelDistanceField", "[recastBuild]")
+{
+	const char* meshes[] = {"dungeon.obj", "nav_test.obj"};
+
+	for (int m = 0; m < 2; ++m)
+	{
+		GIVEN(std::string("The compact heightfield of ") + meshes[m])
+		{
+			RecastBuild build;
+			REQUIRE(build.build(meshes[m], 0));
+			REQUIRE(rcBuildDistanceField(&build.ctx, *build.chf));
+
+			const int spanCount = build.chf->spanCount;
+			const unsigned short maxDistance = build.chf->maxDistance;
+			unsigned short* serialDist = new unsigned short[spanCount];
+			memcpy(serialDist, build.chf->dist, sizeof(unsigned short)*spanCount);
+
+			WHEN("The distance field is built on a thread pool")
+			{
+				ThreadPoolContext ctx(4);
+				REQUIRE(ctx.getWorkerCount() == 4);
+				REQUIRE(rcBuildDistanceField(&ctx, *build.chf));
+
+				THEN("It is the same as the serial one")
+				{
+					CHECK(build.chf->maxDistance == maxDistance);
+					CHECK(memcmp(build.chf->dist, serialDist, sizeof(unsigned short)*spanCount) == 0);
+				}
+			}
+
+			delete [] serialDist;
+		}
+	}
+}
+
+SCENARIO("RecastBuildTest/SimdRasterization", "[recastBuild]")
+{
+	const char* meshes[] = {"dungeon.obj", "nav_test.obj"};
+
+	for (int m = 0; m < 2; ++m)
+	{
+		GIVEN(std::string("The triangles of ") + meshes[m])
+		{
+			RecastBuild build;
+			REQUIRE(build.load(meshes[m], 0));
+
+			THEN("The SIMD rasterizer produces the same spans as the scalar one")
+			{
+				rcContext scalarCtx(false);
+				scalarCtx.enableSimd(false);
+				REQUIRE(build.rasterize(&scalarCtx, *build.solid));
+
+				rcContext simdCtx(false);
+				rcHeightfield* simdSolid = rcAllocHeightfield();
+				REQUIRE(build.rasterize(&simdCtx, *simdSolid));
+
+				CHECK(countSpans(*simdSolid) > 0);
+				CHECK(countSpans(*simdSolid) == countSpans(*build.solid));
+				CHECK(sameSpans(*simdSolid, *build.solid));
+				rcFreeHeightField(simdSolid);
+			}
+		}
+	}
+
+	GIVEN("Random triangles of every size, crossing the bounds of the heightfield")
+	{
+		const int ntris = 2000;
+		float* verts = new float[ntris*9];
+		unsigned char* areas = new unsigned char[ntris];
+		unsigned int seed = 12345;
+		for (int i = 0; i < ntris; ++i)
+		{
+			const float size = (i % 4) == 0 ? 20.0f : (i % 4) == 1 ? 2.0f : 0.4f;
+			float center[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				seed = seed*1103515245u + 12345u;
+				center[k] = (float)((seed >> 8) & 0xffff) / 65535.0f * 24.0f - 2.0f;
+			}
+			for (int v = 0; v < 3; ++v)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					seed = seed*1103515245u + 12345u;
+					verts[i*9+v*3+k] = center[k] + ((float)((seed >> 8) & 0xffff) / 65535.0f - 0.5f) * size;
+				}
+			}
+			areas[i] = (unsigned char)(i % 3 == 0 ? RC_WALKABLE_AREA : 1);
+		}
+
+		const float bmin[3] = {0, 0, 0};
+		const float bmax[3] = {20.0f, 10.0f, 20.0f};
+
+		THEN("The SIMD rasterizer produces the same spans as the scalar one")
+		{
+			rcContext scalarCtx(false);
+			scalarCtx.enableSimd(false);
+			rcHeightfield* scalarSolid = rcAllocHeightfield();
+			REQUIRE(rcCreateHeightfield(&scalarCtx, *scalarSolid, 67, 67, bmin, bmax, 0.3f, 0.2f));
+			rcRasterizeTriangles(&scalarCtx, verts, areas, ntris, *scalarSolid, 1);
+
+			rcContext simdCtx(false);
+			rcHeightfield* simdSolid = rcAllocHeightfield();
+			REQUIRE(rcCreateHeightfield(&simdCtx, *simdSolid, 67, 67, bmin, bmax, 0.3f, 0.2f));
+			rcRasterizeTriangles(&simdCtx, verts, areas, ntris, *simdSolid, 1);
+
+			CHECK(countSpans(*simdSolid) > 0);
+			CHECK(sameSpans(*simdSolid, *scalarSolid));
+			rcFreeHeightField(scalarSolid);
+			rcFreeHeightField(simdSolid);
+		}
+
+		delete [] verts;
+		delete [] areas;
+	}
+}
+
+SCENARIO("RecastBuildTest/ParallelRasterization", "[recastBuild]")
+{
+	const char* meshes[] = {"dungeon.obj", "nav_test.obj"};
+
+	for (int m = 0; m < 2; ++m)
+	{
+		GIVEN(std::string("The triangles of ") + meshes[m])
+		{
+			RecastBuild build;
+			REQUIRE(build.load(meshes[m], 0));
+			REQUIRE(build.rasterize(&build.ctx, *build.solid));
+
+			WHEN("They are rasterized in bands on a thread pool")
+			{
+				ThreadPoolContext ctx(4);
+				rcHeightfield* parallelSolid = rcAllocHeightfield();
+				REQUIRE(build.rasterize(&ctx, *parallelSolid));
+
+				THEN("The spans are the same as when rasterizing them sequentially")
+				{
+					CHECK(countSpans(*parallelSolid) == countSpans(*build.solid));
+					CHECK(sameSpans(*parallelSolid, *build.solid));
+				}
+
+				THEN("The heightfield can still be filtered and compacted")
+				{
+					rcFilterLowHangingWalkableObstacles(&ctx, build.cfg.walkableClimb, *parallelSolid);
+					rcFilterLedgeSpans(&ctx, build.cfg.walkableHeight, build.cfg.walkableClimb, *parallelSolid);
+					rcFilterWalkableLowHeightSpans(&ctx, build.cfg.walkableHeight, *parallelSolid);
+					rcCompactHeightfield* chf = rcAllocCompactHeightfield();
+					CHECK(rcBuildCompactHeightfield(&ctx, build.cfg.walkableHeight, build.cfg.walkableClimb, *parallelSolid, *chf));
+					CHECK(chf->spanCount > 0);
+					rcFreeCompactHeightfield(chf);
+				}
+
+				rcFreeHeightField(parallelSolid);
+			}
+		}
+	}
+}
+
+SCENARIO("RecastBuildTest/PackedHeightfield", "[recastBuild]")
+{
+	const char* meshes[] = {"dungeon.obj", "nav_test.obj"};
+
+	for (int m = 0; m < 2; ++m)
+	{
+		GIVEN(std::string("The rasterized heightfield of ") + meshes[m])
+		{
+			RecastBuild build;
+			REQUIRE(build.load(meshes[m], 0));
+			REQUIRE(build.rasterize(&build.ctx, *build.solid));
+			const rcConfig& cfg = build.cfg;
+
+			rcPackedHeightfield* phf = rcAllocPackedHeightfield();
+			REQUIRE(rcBuildPackedHeightfield(&build.ctx, *build.solid, *phf));
+
+			THEN("The packed heightfield holds the same spans in a quarter of the memory")
+			{
+				CHECK(phf->spanCount == countSpans(*build.solid));
+				const size_t linkedSize = sizeof(rcSpan)*phf->spanCount + sizeof(rcSpan*)*cfg.width*cfg.height;
+				const size_t packedSize = sizeof(rcPackedSpan)*phf->spanCount + sizeof(unsigned int)*(cfg.width*cfg.height+1);
+				CHECK(packedSize*2 < linkedSize);
+			}
+
+			WHEN("Both heightfields are filtered and compacted")
+			{
+				rcFilterLowHangingWalkableObstacles(&build.ctx, cfg.walkableClimb, *build.solid);
+				rcFilterLedgeSpans(&build.ctx, cfg.walkableHeight, cfg.walkableClimb, *build.solid);
+				rcFilterWalkableLowHeightSpans(&build.ctx, cfg.walkableHeight, *build.solid);
+				REQUIRE(rcBuildCompactHeightfield(&build.ctx, cfg.walkableHeight, cfg.walkableClimb, *build.solid, *build.chf));
+
+				rcFilterLowHangingWalkableObstacles(&build.ctx, cfg.walkableClimb, *phf);
+				rcFilterLedgeSpans(&build.ctx, cfg.walkableHeight, cfg.walkableClimb, *phf);
+				rcFilterWalkableLowHeightSpans(&build.ctx, cfg.walkableHeight, *phf);
+				rcCompactHeightfield* chf = rcAllocCompactHeightfield();
+				REQUIRE(rcBuildCompactHeightfield(&build.ctx, cfg.walkableHeight, cfg.walkableClimb, *phf, *chf));
+
+				THEN("The compact heightfields are the same")
+				{
+					REQUIRE(chf->spanCount == build.chf->spanCount);
+					CHECK(chf->spanCount > 0);
+					CHECK(memcmp(chf->cells, build.chf->cells, sizeof(rcCompactCell)*cfg.width*cfg.height) == 0);
+					CHECK(memcmp(chf->spans, build.chf->spans, sizeof(rcCompactSpan)*chf->spanCount) == 0);
+					CHECK(memcmp(chf->areas, build.chf->areas, chf->spanCount) == 0);
+				}
+
+				rcFreeCompactHeightfield(chf);
+			}
+
+			rcFreePackedHeightfield(phf);
+		}
+	}
+}
+
+/// Checks that two contour sets hold the same contours, in the same order.
+static bool sameContours(const rcContourSet& a, const rcContourSet& b)
+{
+	if (a.nconts != b.nconts)
+		return false;
+	for (int i = 0; i < a.nconts; ++i)
+	{
+		const rcContour& ca = a.conts[i];
+		const rcContour& cb = b.conts[i];
+		if (ca.reg != cb.reg || ca.area != cb.area || ca.nverts != cb.nverts || ca.nrverts != cb.nrverts)
+			return false;
+		if (memcmp(ca.verts, cb.verts, sizeof(int)*ca.nverts*4) != 0 ||
+			memcmp(ca.rverts, cb.rverts, sizeof(int)*ca.nrverts*4) != 0)
+			return false;
+	}
+	return true;
+}
+
+SCENARIO("RecastBuildTest/ParallelContours", "[recastBuild]")
+{
+	const char* meshes[] = {"dungeon.obj", "nav_test.obj"};
+
+	for (int m = 0; m < 2; ++m)
+	{
+		GIVEN(std::string("The regions of ") + meshes[m])
+		{
+			RecastBuild build;
+			REQUIRE(build.build(meshes[m], 8));
+			REQUIRE(rcBuildDistanceField(&build.ctx, *build.chf));
+			REQUIRE(rcBuildRegions(&build.ctx, *build.chf, build.cfg.borderSize, build.cfg.minRegionArea, build.cfg.mergeRegionArea));
+
+			rcContourSet* serial = rcAllocContourSet();
+			REQUIRE(rcBuildContours(&build.ctx, *build.chf, 1.3f, 40, *serial));
+
+			WHEN("The contours are built on a thread pool")
+			{
+				ThreadPoolContext ctx(4);
+				rcContourSet* parallel = rcAllocContourSet();
+				REQUIRE(rcBuildContours(&ctx, *build.chf, 1.3f, 40, *parallel));
+
+				THEN("They are the same as the serial ones, in the same order")
+				{
+					CHECK(serial->nconts > 0);
+					CHECK(sameContours(*serial, *parallel));
+				}
+
+				rcFreeContourSet(parallel);
+			}
+
+			rcFreeContourSet(serial);
+		}
+	}
+}
+
+/// Hashes the submeshes, vertices and triangles of a detail mesh. (FNV-1a)
+static unsigned int hashDetailMesh(const rcPolyMeshDetail& dmesh)
+{
+	unsigned int h = 2166136261u;
+	const unsigned char* data[3] = {(const unsigned char*)dmesh.meshes, (const unsigned char*)dmesh.verts, dmesh.tris};
+	const int sizes[3] = {(int)sizeof(unsigned int)*dmesh.nmeshes*4, (int)sizeof(float)*dmesh.nverts*3, dmesh.ntris*4};
+	for (int i = 0; i < 3; ++i)
+		for (int j = 0; j < sizes[i]; ++j)
+			h = (h ^ data[i][j]) * 16777619u;
+	return h;
+}
+
+SCENARIO("RecastBuildTest/ParallelDetailMesh", "[recastBuild]")
+{
+	const char* meshes[] = {"dungeon.obj", "nav_test.obj"};
+	const unsigned int expectedHashes[2] = {105801968u, 3288806507u};
+
+	for (int m = 0; m < 2; ++m)
+	{
+		GIVEN(std::string("The polygon mesh of ") + meshes[m])
+		{
+			RecastBuild build;
+			REQUIRE(build.build(meshes[m], 0));
+			REQUIRE(rcBuildDistanceField(&build.ctx, *build.chf));
+			REQUIRE(rcBuildRegions(&build.ctx, *build.chf, 0, build.cfg.minRegionArea, build.cfg.mergeRegionArea));
+			rcContourSet* cset = rcAllocContourSet();
+			REQUIRE(rcBuildContours(&build.ctx, *build.chf, 1.3f, 40, *cset));
+			rcPolyMesh* pmesh = rcAllocPolyMesh();
+			REQUIRE(rcBuildPolyMesh(&build.ctx, *cset, 6, *pmesh));
+
+			rcPolyMeshDetail* serial = rcAllocPolyMeshDetail();
+			REQUIRE(rcBuildPolyMeshDetail(&build.ctx, *pmesh, *build.chf, 6*build.cfg.cs, 1*build.cfg.ch, *serial));
+
+			THEN("The detail mesh matches the reference one")
+			{
+				CHECK(serial->nmeshes == pmesh->npolys);
+				CHECK(hashDetailMesh(*serial) == expectedHashes[m]);
+			}
+
+			WHEN("The detail mesh is built on a thread pool")
+			{
+				ThreadPoolContext ctx(4);
+				rcPolyMeshDetail* parallel = rcAllocPolyMeshDetail();
+				REQUIRE(rcBuildPolyMeshDetail(&ctx, *pmesh, *build.chf, 6*build.cfg.cs, 1*build.cfg.ch, *parallel));
+
+				THEN("It is the same as the serial one")
+				{
+					CHECK(parallel->nverts == serial->nverts);
+					CHECK(parallel->ntris == serial->ntris);
+					CHECK(hashDetailMesh(*parallel) == hashDetailMesh(*serial));
+				}
+
+				rcFreePolyMeshDetail(parallel);
+			}
+
+			rcFreePolyMeshDetail(serial);
+			rcFreePolyMesh(pmesh);
+			rcFreeContourSet(cset);
+		}
+	}
+}
+
+/// Checks that the triangles of each submesh are clockwise and cover the xz-area of their polygon.
+static bool coversPolygons(const rcPolyMesh& pmesh, const rcPolyMeshDetail& dmesh)
+{
+	for (int i = 0; i < dmesh.nmeshes; ++i)
+	{
+		const unsigned short* p = &pmesh.polys[i*pmesh.nvp*2];
+		float polyArea = 0;
+		for (int j = 2; j < pmesh.nvp && p[j] != RC_MESH_NULL_IDX; ++j)
+		{
+			const unsigned short* a = &pmesh.verts[p[0]*3];
+			const unsigned short* b = &pmesh.verts[p[j-1]*3];
+			const unsigned short* c = &pmesh.verts[p[j]*3];
+			polyArea += ((b[0]-a[0])*(c[2]-a[2]) - (c[0]-a[0])*(b[2]-a[2])) * pmesh.cs*pmesh.cs;
+		}
+
+		const unsigned int* m = &dmesh.meshes[i*4];
+		float detailArea = 0;
+		for (unsigned int j = 0; j < m[3]; ++j)
+		{
+			const unsigned char* t = &dmesh.tris[(m[2]+j)*4];
+			const float* a = &dmesh.verts[(m[0]+t[0])*3];
+			const float* b = &dmesh.verts[(m[0]+t[1])*3];
+			const float* c = &dmesh.verts[(m[0]+t[2])*3];
+			const float area = (c[0]-a[0])*(b[2]-a[2]) - (b[0]-a[0])*(c[2]-a[2]);
+			if (area <= 0)
+				return false;
+			detailArea += area;
+		}
+
+		polyArea = fabsf(polyArea);
+		if (fabsf(detailArea - polyArea) > 0.001f*polyArea + 0.001f)
+			return false;
+	}
+	return true;
+}
+
+SCENARIO("RecastBuildTest/IncrementalDelaunay", "[recastBuild]")
+{
+	const char* meshes[] = {"dungeon.obj", "nav_test.obj"};
+
+	for (int m = 0; m < 2; ++m)
+	{
+		GIVEN(std::string("The polygon mesh of ") + meshes[m])
+		{
+			RecastBuild build;
+			REQUIRE(build.build(meshes[m], 0));
+			REQUIRE(rcBuildDistanceField(&build.ctx, *build.chf));
+			REQUIRE(rcBuildRegions(&build.ctx, *build.chf, 0, build.cfg.minRegionArea, build.cfg.mergeRegionArea));
+			rcContourSet* cset = rcAllocContourSet();
+			REQUIRE(rcBuildContours(&build.ctx, *build.chf, 1.3f, 40, *cset));
+			rcPolyMesh* pmesh = rcAllocPolyMesh();
+			REQUIRE(rcBuildPolyMesh(&build.ctx, *cset, 6, *pmesh));
+
+			WHEN("The detail mesh is densely sampled with the incremental triangulation")
+			{
+				const float sampleDist = 2*build.cfg.cs;
+				rcPolyMeshDetail* classic = rcAllocPolyMeshDetail();
+				REQUIRE(rcBuildPolyMeshDetail(&build.ctx, *pmesh, *build.chf, sampleDist, 1*build.cfg.ch, *classic));
+				rcPolyMeshDetail* incremental = rcAllocPolyMeshDetail();
+				REQUIRE(rcBuildPolyMeshDetail(&build.ctx, *pmesh, *build.chf, sampleDist, 1*build.cfg.ch, *incremental,
+											  RC_DETAIL_INCREMENTAL_DELAUNAY));
+
+				THEN("Every polygon is exactly covered by clockwise triangles")
+				{
+					CHECK(incremental->nmeshes == pmesh->npolys);
+					CHECK(coversPolygons(*pmesh, *incremental));
+				}
+
+				THEN("It adds about as many samples as the classic triangulation")
+				{
+					CHECK(abs(incremental->nverts - classic->nverts) <= classic->nverts/50);
+				}
+
+				rcFreePolyMeshDetail(incremental);
+				rcFreePolyMeshDetail(classic);
+			}
+
+			rcFreePolyMesh(pmesh);
+			rcFreeContourSet(cset);
+		}
+	}
+}
+
+/// Builds the polygon mesh of a marked compact heightfield and hashes its vertices, polygons and areas. (FNV-1a)
+static unsigned int hashPolyMesh(rcContext* ctx, const rcConfig& cfg, rcCompactHeightfield& chf)
+{
+	unsigned int h = 0;
+	rcContourSet* cset = rcAllocContourSet();
+	rcPolyMesh* pmesh = rcAllocPolyMesh();
+	if (rcBuildDistanceField(ctx, chf) && rcBuildRegions(ctx, chf, 0, cfg.minRegionArea, cfg.mergeRegionArea) &&
+		rcBuildContours(ctx, chf, 1.3f, 40, *cset) && rcBuildPolyMesh(ctx, *cset, 6, *pmesh))
+	{
+		h = 2166136261u;
+		const unsigned char* data[3] = {(const unsigned char*)pmesh->verts, (const unsigned char*)pmesh->polys, pmesh->areas};
+		const int sizes[3] = {(int)sizeof(unsigned short)*pmesh->nverts*3, (int)sizeof(unsigned short)*pmesh->npolys*pmesh->nvp*2, pmesh->npolys};
+		for (int i = 0; i < 3; ++i)
+			for (int j = 0; j < sizes[i]; ++j)
+				h = (h ^ data[i][j]) * 16777619u;
+	}
+	rcFreePolyMesh(pmesh);
+	rcFreeContourSet(cset);
+	return h;
+}
+
+SCENARIO("RecastBuildTest/CachedCompactHeightfield", "[recastBuild]")
+{
+	GIVEN("The eroded compact heightfield of dungeon.obj and a copy of it")
+	{
+		RecastBuild build;
+		REQUIRE(build.build("dungeon.obj", 0));
+		rcCompactHeightfield* cached = rcAllocCompactHeightfield();
+		REQUIRE(rcCopyCompactHeightfield(&build.ctx, *build.chf, *cached));
+
+		THEN("The copy holds the same spans")
+		{
+			CHECK(cached->spanCount == build.chf->spanCount);
+			CHECK(memcmp(cached->cells, build.chf->cells, sizeof(rcCompactCell)*cached->width*cached->height) == 0);
+			CHECK(memcmp(cached->spans, build.chf->spans, sizeof(rcCompactSpan)*cached->spanCount) == 0);
+			CHECK(memcmp(cached->areas, build.chf->areas, cached->spanCount) == 0);
+		}
+
+		WHEN("An area is marked on the original and then on a fresh copy of the cached field")
+		{
+			float bmin[3], bmax[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				bmin[i] = build.cfg.bmin[i] + (build.cfg.bmax[i] - build.cfg.bmin[i])*0.3f;
+				bmax[i] = build.cfg.bmin[i] + (build.cfg.bmax[i] - build.cfg.bmin[i])*0.6f;
+			}
+			bmin[1] = build.cfg.bmin[1];
+			bmax[1] = build.cfg.bmax[1];
+
+			rcMarkBoxArea(&build.ctx, bmin, bmax, 1, *build.chf);
+			const unsigned int expected = hashPolyMesh(&build.ctx, build.cfg, *build.chf);
+
+			rcCompactHeightfield* chf = rcAllocCompactHeightfield();
+			REQUIRE(rcCopyCompactHeightfield(&build.ctx, *cached, *chf));
+			rcMarkBoxArea(&build.ctx, bmin, bmax, 1, *chf);
+
+			THEN("The rebuilt polygon mesh is the same as the one built from the triangles")
+			{
+				CHECK(expected != 0);
+				CHECK(hashPolyMesh(&build.ctx, build.cfg, *chf) == expected);
+				CHECK(hashPolyMesh(&build.ctx, build.cfg, *cached) != expected);
+			}
+
+			rcFreeCompactHeightfield(chf);
+		}
+
+		rcFreeCompactHeightfield(cached);
+	}
+}
+
+SCENARIO("RecastBuildTest/ParallelAreaFilters", "[recastBuild]")
+{
+	const char* meshes[] = {"dungeon.obj", "nav_test.obj"};
+
+	for (int m = 0; m < 2; ++m)
+	{
+		GIVEN(std::string("The compact heightfield of ") + meshes[m])
+		{
+			RecastBuild build;
+			REQUIRE(build.build(meshes[m], 0));
+			ThreadPoolContext ctx(4);
+
+			WHEN("The walkable area is eroded on a thread pool")
+			{
+				rcCompactHeightfield* chf = rcAllocCompactHeightfield();
+				REQUIRE(rcBuildCompactHeightfield(&ctx, build.cfg.walkableHeight, build.cfg.walkableClimb, *build.solid, *chf));
+				REQUIRE(rcErodeWalkableArea(&ctx, build.cfg.walkableRadius, *chf));
+
+				THEN("It is the same as the serial erosion")
+				{
+					REQUIRE(chf->spanCount == build.chf->spanCount);
+					CHECK(memcmp(chf->areas, build.chf->areas, chf->spanCount) == 0);
+				}
+
+				rcFreeCompactHeightfield(chf);
+			}
+
+			WHEN("A polygon is marked and the areas are filtered on a thread pool")
+			{
+				float verts[6*3];
+				for (int i = 0; i < 6; ++i)
+				{
+					const float a = i*1.0471976f; // 60 degrees
+					verts[i*3+0] = (build.cfg.bmin[0] + build.cfg.bmax[0])*0.5f + cosf(a)*(build.cfg.bmax[0] - build.cfg.bmin[0])*0.3f;
+					verts[i*3+1] = 0;
+					verts[i*3+2] = (build.cfg.bmin[2] + build.cfg.bmax[2])*0.5f + sinf(a)*(build.cfg.bmax[2] - build.cfg.bmin[2])*0.3f;
+				}
+
+				rcCompactHeightfield* chf = rcAllocCompactHeightfield();
+				REQUIRE(rcCopyCompactHeightfield(&ctx, *build.chf, *chf));
+				rcMarkConvexPolyArea(&build.ctx, verts, 6, build.cfg.bmin[1], build.cfg.bmax[1], 1, *build.chf);
+				rcMarkConvexPolyArea(&ctx, verts, 6, build.cfg.bmin[1], build.cfg.bmax[1], 1, *chf);
+
+				THEN("The marked areas are the same as the serial ones")
+				{
+					int marked = 0;
+					for (int i = 0; i < chf->spanCount; ++i)
+						marked += chf->areas[i] == 1 ? 1 : 0;
+					CHECK(marked > 0);
+					CHECK(memcmp(chf->areas, build.chf->areas, chf->spanCount) == 0);
+				}
+
+				REQUIRE(rcMedianFilterWalkableArea(&build.ctx, *build.chf));
+				REQUIRE(rcMedianFilterWalkableArea(&ctx, *chf));
+
+				THEN("The filtered areas are the same as the serial ones")
+				{
+					CHECK(memcmp(chf->areas, build.chf->areas, chf->spanCount) == 0);
+				}
+
+				rcFreeCompactHeightfield(chf);
+			}
+		}
+	}
+}
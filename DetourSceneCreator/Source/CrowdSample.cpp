@@ -217,7 +217,7 @@ void CrowdSample::parseBehavior(JSONValue* behavior, std::size_t iAgent, dtCrowd
 	if (type && type->IsString() && type->AsString() == L"collisionAvoidance")
 	{
 		dtCollisionAvoidance* ca = dtCollisionAvoidance::allocate(m_agentCount);
-		ca->init();
+		ca->init(*crowd->getCrowdQuery());
 		
 		dtCollisionAvoidanceParams* params = ca->getBehaviorParams(crowd->getAgent(iAgent)->id);
 
@@ -588,6 +588,9 @@ bool CrowdSample::initializeNavmesh(const InputGeom& scene, dtNavMesh* navMesh)
 
 bool CrowdSample::initializeCrowd(dtCrowd* crowd)
 {
+	// The agents are all created at once, so their periodic tasks would otherwise run during the same updates.
+	crowd->setPeriodicTaskSpreading(true);
+
 	for (int i(0) ; i < m_agentCount ; ++i)
     {
 		// Pipeline behavior
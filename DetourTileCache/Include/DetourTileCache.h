@@ -35,13 +35,56 @@ enum ObstacleState
 	DT_OBSTACLE_REMOVING,
 };
 
-static const int DT_MAX_TOUCHED_TILES = 8;
+enum ObstacleType
+{
+	DT_OBSTACLE_CYLINDER,
+	DT_OBSTACLE_BOX,				///< Axis aligned box.
+	DT_OBSTACLE_ORIENTED_BOX,		///< Box rotated around the y-axis.
+	DT_OBSTACLE_CONVEX,				///< Extruded convex polygon.
+};
+
+struct dtObstacleCylinder
+{
+	float pos[3];
+	float radius;
+	float height;
+};
+
+struct dtObstacleBox
+{
+	float bmin[3];
+	float bmax[3];
+};
+
+struct dtObstacleOrientedBox
+{
+	float center[3];
+	float halfExtents[3];
+	float rot[2];					///< Cosine and sine of the rotation around the y-axis.
+};
+
+static const int DT_MAX_CONVEX_OBSTACLE_VERTS = 12;
+struct dtObstacleConvex
+{
+	float verts[DT_MAX_CONVEX_OBSTACLE_VERTS*3];	///< The polygon vertices, the y-coordinates are ignored.
+	float hmin, hmax;				///< The height range of the extrusion.
+	int nverts;
+};
+
+static const int DT_MAX_TOUCHED_TILES = 16;
 struct dtTileCacheObstacle
 {
-	float pos[3], radius, height;
+	union
+	{
+		dtObstacleCylinder cylinder;
+		dtObstacleBox box;
+		dtObstacleOrientedBox orientedBox;
+		dtObstacleConvex convex;
+	};
 	dtCompressedTileRef touched[DT_MAX_TOUCHED_TILES];
 	dtCompressedTileRef pending[DT_MAX_TOUCHED_TILES];
 	unsigned short salt;
+	unsigned char type;
 	unsigned char state;
 	unsigned char ntouched;
 	unsigned char npending;
@@ -67,6 +110,57 @@ struct dtTileCacheMeshProcess
 						 unsigned char* polyAreas, unsigned short* polyFlags) = 0;
 };
 
+/// The body of a parallel loop run by a dtTileCacheWorkerPool.
+typedef void (dtTileCacheTaskFunc)(void* arg, const int index, const int worker);
+
+/// Runs the tile builds of dtTileCache::update() on several threads.
+/// When a worker pool is used, the compressor and the mesh process must be thread safe.
+struct dtTileCacheWorkerPool
+{
+	/// The number of workers, including the thread calling dtTileCache::update(). [Limit: > 0]
+	virtual int getWorkerCount() = 0;
+	/// The allocator used by the worker, reset before each tile is built.
+	virtual struct dtTileCacheAlloc* getAlloc(const int worker) = 0;
+	/// Calls func(arg, index, worker) for each index in [0, count), and returns once all the calls are done.
+	virtual void parallelFor(dtTileCacheTaskFunc* func, void* arg, const int count) = 0;
+};
+
+/// A worker pool running the tile builds on a dtThreadPool.
+/// Each worker uses its own default dtTileCacheAlloc unless setAlloc() replaces it.
+/// The pool must be initialized before it is given to dtTileCache::setWorkerPool().
+class dtTileCacheThreadPool : public dtTileCacheWorkerPool
+{
+public:
+	dtTileCacheThreadPool();
+	virtual ~dtTileCacheThreadPool();
+
+	/// Starts the threads of the pool.
+	///  @param[in]	workerCount		The number of workers, the calling thread included. [Limit: > 0]
+	/// @return True if the allocators were created and all the threads were started.
+	bool init(const int workerCount);
+
+	/// Stops the threads of the pool and frees the default allocators.
+	void destroy();
+
+	/// Replaces the allocator of a worker. The pool does not own @\p alloc.
+	/// Passing null restores the default allocator.
+	void setAlloc(const int worker, struct dtTileCacheAlloc* alloc);
+
+	virtual int getWorkerCount();
+	virtual struct dtTileCacheAlloc* getAlloc(const int worker);
+	virtual void parallelFor(dtTileCacheTaskFunc* func, void* arg, const int count);
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtTileCacheThreadPool(const dtTileCacheThreadPool&);
+	dtTileCacheThreadPool& operator=(const dtTileCacheThreadPool&);
+
+	class dtThreadPool* m_pool;
+	struct dtTileCacheAlloc* m_defaultAllocs;	///< One default allocator per worker.
+	struct dtTileCacheAlloc** m_allocs;			///< The allocator used by each worker.
+	int m_nworkers;
+};
+
 
 class dtTileCache
 {
@@ -104,6 +198,13 @@ public:
 	dtStatus removeTile(dtCompressedTileRef ref, unsigned char** data, int* dataSize);
 	
 	dtStatus addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result);
+	/// Adds an axis aligned box obstacle.
+	dtStatus addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result);
+	/// Adds a box obstacle rotated by @p yRadians around the y-axis.
+	dtStatus addBoxObstacle(const float* center, const float* halfExtents, const float yRadians, dtObstacleRef* result);
+	/// Adds an obstacle extruded from a convex polygon. [Limit: nverts <= #DT_MAX_CONVEX_OBSTACLE_VERTS]
+	/// Fails with #DT_INVALID_PARAM if the polygon is not convex on the xz-plane.
+	dtStatus addConvexObstacle(const float* verts, const int nverts, const float hmin, const float hmax, dtObstacleRef* result);
 	dtStatus removeObstacle(const dtObstacleRef ref);
 	dtStatus editObstaclePos(const dtObstacleRef ref, const float* pos);
 	dtStatus editObstacleRadius(const dtObstacleRef ref, const float& radius);
@@ -113,7 +214,12 @@ public:
 	dtStatus queryTiles(const float* bmin, const float* bmax,
 						dtCompressedTileRef* results, int* resultCount, const int maxResults) const;
 	
-	dtStatus update(const float /*dt*/, class dtNavMesh* navmesh);
+	/// Uses a worker pool to build the updated tiles in parallel. [opt]
+	/// dtTileCacheThreadPool runs them on the threads of a dtThreadPool.
+	void setWorkerPool(dtTileCacheWorkerPool* workers) { m_workers = workers; }
+	dtTileCacheWorkerPool* getWorkerPool() { return m_workers; }
+	
+	dtStatus update(const float /*dt*/, class dtNavMesh* navmesh, const int budgetUsec = 0);
 	
 	dtStatus buildNavMeshTilesAt(const int tx, const int ty, class dtNavMesh* navmesh);
 	
@@ -123,6 +229,9 @@ public:
 	
 	void getObstacleBounds(const struct dtTileCacheObstacle* ob, float* bmin, float* bmax) const;
 	
+	/// Whether the footprint of the obstacle overlaps the xz-rectangle of the bounds.
+	bool obstacleOverlapsBounds(const struct dtTileCacheObstacle* ob, const float* bmin, const float* bmax) const;
+	
 
 	/// Encodes a tile id.
 	inline dtCompressedTileRef encodeTileId(unsigned int salt, unsigned int it) const
@@ -180,6 +289,27 @@ private:
 		dtObstacleRef ref;
 	};
 	
+	struct TileBuild
+	{
+		dtCompressedTileRef ref;
+		unsigned char* navData;
+		int navDataSize;
+		dtStatus status;
+	};
+	
+	ObstacleRequest* allocRequest();
+	dtTileCacheObstacle* allocObstacle(const unsigned char type, dtObstacleRef* result);
+	dtStatus queryTouchedTiles(dtTileCacheObstacle* ob);
+	void translateObstacle(dtTileCacheObstacle* ob, const float* delta);
+	dtStatus addUpdate(const dtCompressedTileRef ref);
+	dtStatus buildNavMeshTileData(const dtCompressedTileRef ref, struct dtTileCacheAlloc* talloc,
+								  unsigned char** navData, int* navDataSize) const;
+	dtStatus commitNavMeshTile(const dtCompressedTileRef ref, unsigned char* navData, const int navDataSize,
+							   class dtNavMesh* navmesh);
+	dtStatus buildUpdates(const int maxTiles, class dtNavMesh* navmesh);
+	void updateObstacleStates(const dtCompressedTileRef ref);
+	static void buildTileTask(void* arg, const int index, const int worker);
+	
 	int m_tileLutSize;						///< Tile hash lookup size (must be pot).
 	int m_tileLutMask;						///< Tile hash lookup mask.
 	
@@ -195,17 +325,24 @@ private:
 	dtTileCacheAlloc* m_talloc;
 	dtTileCacheCompressor* m_tcomp;
 	dtTileCacheMeshProcess* m_tmproc;
+	dtTileCacheWorkerPool* m_workers;
 	
 	dtTileCacheObstacle* m_obstacles;
 	dtTileCacheObstacle* m_nextFreeObstacle;
 	
-	static const int MAX_REQUESTS = 64;
-	ObstacleRequest m_reqs[MAX_REQUESTS];
+	static const int MAX_REQUESTS = 64;		///< Initial capacity of the request queue, which grows on demand.
+	ObstacleRequest* m_reqs;
 	int m_nreqs;
+	int m_maxReqs;
 	
-	static const int MAX_UPDATE = 64;
-	dtCompressedTileRef m_update[MAX_UPDATE];
+	static const int MAX_UPDATE = 64;		///< Initial capacity of the update queue, which grows on demand.
+	dtCompressedTileRef* m_update;
 	int m_nupdate;
+	int m_maxUpdate;
+	dtCompressedTileRef* m_queuedRefs;		///< The reference of each tile in the update queue, indexed by tile, or zero.
+	
+	TileBuild* m_builds;					///< The tiles being built in parallel.
+	int m_maxBuilds;
 	
 };
 
@@ -125,6 +125,20 @@ void dtFreeTileCachePolyMesh(dtTileCacheAlloc* alloc, dtTileCachePolyMesh* lmesh
 dtStatus dtMarkCylinderArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
 							const float* pos, const float radius, const float height, const unsigned char areaId);
 
+dtStatus dtMarkBoxArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+					   const float* bmin, const float* bmax, const unsigned char areaId);
+
+/// Marks the cells inside a box rotated around the y-axis.
+///  @param[in]	rot		Cosine and sine of the rotation around the y-axis.
+dtStatus dtMarkBoxArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+					   const float* center, const float* halfExtents, const float* rot, const unsigned char areaId);
+
+/// Marks the cells inside an extruded convex polygon.
+///  @param[in]	verts	The polygon vertices, in either winding order. [(x, y, z) * @p nverts]
+dtStatus dtMarkConvexArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+						  const float* verts, const int nverts, const float hmin, const float hmax,
+						  const unsigned char areaId);
+
 dtStatus dtBuildTileCacheRegions(dtTileCacheAlloc* alloc,
 								 dtTileCacheLayer& layer,
 								 const int walkableClimb);
@@ -5,7 +5,9 @@
 #include "DetourCommon.h"
 #include "DetourAlloc.h"
 #include "DetourAssert.h"
+#include "DetourThread.h"
 #include <math.h>
+#include <float.h>
 #include <string.h>
 #include <new>
 
@@ -31,6 +33,23 @@ static bool contains(const dtCompressedTileRef* a, const int n, const dtCompress
 	return false;
 }
 
+// Makes room for one more item in a growable array.
+static bool reserveItem(void** items, int* capacity, const int count, const int itemSize)
+{
+	if (count < *capacity)
+		return true;
+	const int newCapacity = *capacity ? *capacity*2 : 16;
+	void* newItems = dtAlloc(itemSize*newCapacity, DT_ALLOC_PERM);
+	if (!newItems)
+		return false;
+	if (count)
+		memcpy(newItems, *items, itemSize*count);
+	dtFree(*items);
+	*items = newItems;
+	*capacity = newCapacity;
+	return true;
+}
+
 inline int computeTileHash(int x, int y, const int mask)
 {
 	const unsigned int h1 = 0x8da6b343; // Large multiplicative constants;
@@ -60,6 +79,92 @@ struct BuildContext
 };
 
 
+dtTileCacheThreadPool::dtTileCacheThreadPool() :
+	m_pool(0),
+	m_defaultAllocs(0),
+	m_allocs(0),
+	m_nworkers(0)
+{
+}
+
+dtTileCacheThreadPool::~dtTileCacheThreadPool()
+{
+	destroy();
+}
+
+bool dtTileCacheThreadPool::init(const int workerCount)
+{
+	destroy();
+	if (workerCount <= 0)
+		return false;
+	
+	void* mem = dtAlloc(sizeof(dtThreadPool), DT_ALLOC_PERM);
+	if (!mem)
+		return false;
+	m_pool = new(mem) dtThreadPool;
+	
+	m_defaultAllocs = (dtTileCacheAlloc*)dtAlloc(sizeof(dtTileCacheAlloc)*workerCount, DT_ALLOC_PERM);
+	m_allocs = (dtTileCacheAlloc**)dtAlloc(sizeof(dtTileCacheAlloc*)*workerCount, DT_ALLOC_PERM);
+	if (!m_defaultAllocs || !m_allocs)
+	{
+		destroy();
+		return false;
+	}
+	m_nworkers = workerCount;
+	for (int i = 0; i < m_nworkers; ++i)
+		m_allocs[i] = new(&m_defaultAllocs[i]) dtTileCacheAlloc;
+	
+	if (!m_pool->init(workerCount))
+	{
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+void dtTileCacheThreadPool::destroy()
+{
+	if (m_pool)
+	{
+		m_pool->~dtThreadPool();
+		dtFree(m_pool);
+		m_pool = 0;
+	}
+	if (m_defaultAllocs)
+	{
+		for (int i = 0; i < m_nworkers; ++i)
+			m_defaultAllocs[i].~dtTileCacheAlloc();
+		dtFree(m_defaultAllocs);
+		m_defaultAllocs = 0;
+	}
+	dtFree(m_allocs);
+	m_allocs = 0;
+	m_nworkers = 0;
+}
+
+void dtTileCacheThreadPool::setAlloc(const int worker, dtTileCacheAlloc* alloc)
+{
+	if (worker < 0 || worker >= m_nworkers)
+		return;
+	m_allocs[worker] = alloc ? alloc : &m_defaultAllocs[worker];
+}
+
+int dtTileCacheThreadPool::getWorkerCount()
+{
+	return m_pool ? m_pool->getWorkerCount() : 0;
+}
+
+dtTileCacheAlloc* dtTileCacheThreadPool::getAlloc(const int worker)
+{
+	return m_allocs[worker];
+}
+
+void dtTileCacheThreadPool::parallelFor(dtTileCacheTaskFunc* func, void* arg, const int count)
+{
+	m_pool->parallelFor(func, arg, count);
+}
+
+
 dtTileCache::dtTileCache() :
 	m_tileLutSize(0),
 	m_tileLutMask(0),
@@ -71,10 +176,18 @@ dtTileCache::dtTileCache() :
 	m_talloc(0),
 	m_tcomp(0),
 	m_tmproc(0),
+	m_workers(0),
 	m_obstacles(0),
 	m_nextFreeObstacle(0),
+	m_reqs(0),
 	m_nreqs(0),
-	m_nupdate(0)
+	m_maxReqs(0),
+	m_update(0),
+	m_nupdate(0),
+	m_maxUpdate(0),
+	m_queuedRefs(0),
+	m_builds(0),
+	m_maxBuilds(0)
 {
 	memset(&m_params, 0, sizeof(m_params));
 }
@@ -95,8 +208,16 @@ dtTileCache::~dtTileCache()
 	m_posLookup = 0;
 	dtFree(m_tiles);
 	m_tiles = 0;
+	dtFree(m_reqs);
+	m_reqs = 0;
 	m_nreqs = 0;
+	dtFree(m_update);
+	m_update = 0;
 	m_nupdate = 0;
+	dtFree(m_queuedRefs);
+	m_queuedRefs = 0;
+	dtFree(m_builds);
+	m_builds = 0;
 }
 
 const dtCompressedTile* dtTileCache::getTileByRef(dtCompressedTileRef ref) const
@@ -125,6 +246,16 @@ dtStatus dtTileCache::init(const dtTileCacheParams* params,
 	m_nreqs = 0;
 	memcpy(&m_params, params, sizeof(m_params));
 	
+	// Alloc the queues, they grow when needed.
+	m_reqs = (ObstacleRequest*)dtAlloc(sizeof(ObstacleRequest)*MAX_REQUESTS, DT_ALLOC_PERM);
+	if (!m_reqs)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_maxReqs = MAX_REQUESTS;
+	m_update = (dtCompressedTileRef*)dtAlloc(sizeof(dtCompressedTileRef)*MAX_UPDATE, DT_ALLOC_PERM);
+	if (!m_update)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_maxUpdate = MAX_UPDATE;
+	
 	// Alloc space for obstacles.
 	m_obstacles = (dtTileCacheObstacle*)dtAlloc(sizeof(dtTileCacheObstacle)*m_params.maxObstacles, DT_ALLOC_PERM);
 	if (!m_obstacles)
@@ -149,8 +280,12 @@ dtStatus dtTileCache::init(const dtTileCacheParams* params,
 	m_posLookup = (dtCompressedTile**)dtAlloc(sizeof(dtCompressedTile*)*m_tileLutSize, DT_ALLOC_PERM);
 	if (!m_posLookup)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_queuedRefs = (dtCompressedTileRef*)dtAlloc(sizeof(dtCompressedTileRef)*m_params.maxTiles, DT_ALLOC_PERM);
+	if (!m_queuedRefs)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	memset(m_tiles, 0, sizeof(dtCompressedTile)*m_params.maxTiles);
 	memset(m_posLookup, 0, sizeof(dtCompressedTile*)*m_tileLutSize);
+	memset(m_queuedRefs, 0, sizeof(dtCompressedTileRef)*m_params.maxTiles);
 	m_nextFreeTile = 0;
 	for (int i = m_params.maxTiles-1; i >= 0; --i)
 	{
@@ -350,37 +485,124 @@ dtStatus dtTileCache::removeTile(dtCompressedTileRef ref, unsigned char** data,
 }
 
 
-dtObstacleRef dtTileCache::addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result)
+dtTileCacheObstacle* dtTileCache::allocObstacle(const unsigned char type, dtObstacleRef* result)
 {
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	if (!m_nextFreeObstacle)
+		return 0;
+	ObstacleRequest* req = allocRequest();
+	if (!req)
+		return 0;
 	
-	dtTileCacheObstacle* ob = 0;
-	if (m_nextFreeObstacle)
-	{
-		ob = m_nextFreeObstacle;
-		m_nextFreeObstacle = ob->next;
-		ob->next = 0;
-	}
-	if (!ob)
-		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	dtTileCacheObstacle* ob = m_nextFreeObstacle;
+	m_nextFreeObstacle = ob->next;
+	ob->next = 0;
 	
 	unsigned short salt = ob->salt;
 	memset(ob, 0, sizeof(dtTileCacheObstacle));
 	ob->salt = salt;
+	ob->type = type;
 	ob->state = DT_OBSTACLE_PROCESSING;
-	dtVcopy(ob->pos, pos);
-	ob->radius = radius;
-	ob->height = height;
 	
-	ObstacleRequest* req = &m_reqs[m_nreqs++];
-	memset(req, 0, sizeof(ObstacleRequest));
 	req->action = REQUEST_ADD;
 	req->ref = getObstacleRef(ob);
 	
 	if (result)
 		*result = req->ref;
 	
+	return ob;
+}
+
+dtObstacleRef dtTileCache::addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result)
+{
+	dtTileCacheObstacle* ob = allocObstacle(DT_OBSTACLE_CYLINDER, result);
+	if (!ob)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	dtVcopy(ob->cylinder.pos, pos);
+	ob->cylinder.radius = radius;
+	ob->cylinder.height = height;
+	
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileCache::addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result)
+{
+	dtTileCacheObstacle* ob = allocObstacle(DT_OBSTACLE_BOX, result);
+	if (!ob)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	dtVcopy(ob->box.bmin, bmin);
+	dtVcopy(ob->box.bmax, bmax);
+	
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileCache::addBoxObstacle(const float* center, const float* halfExtents, const float yRadians, dtObstacleRef* result)
+{
+	dtTileCacheObstacle* ob = allocObstacle(DT_OBSTACLE_ORIENTED_BOX, result);
+	if (!ob)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	dtVcopy(ob->orientedBox.center, center);
+	dtVcopy(ob->orientedBox.halfExtents, halfExtents);
+	ob->orientedBox.rot[0] = cosf(yRadians);
+	ob->orientedBox.rot[1] = sinf(yRadians);
+	
+	return DT_SUCCESS;
+}
+
+// Checks that the polygon is convex on the xz-plane, in either winding, and not degenerate.
+static bool isConvexPoly(const float* verts, const int nverts)
+{
+	int sign = 0;
+	// The edges of a star polygon all turn the same way too, but they go around more than once.
+	// Going around once, the direction of the edges changes of side along the x-axis exactly twice.
+	int firstSide = 0, side = 0, nflips = 0;
+	for (int i = 0; i < nverts; ++i)
+	{
+		const float* a = &verts[i*3];
+		const float* b = &verts[((i+1) % nverts)*3];
+		const float* c = &verts[((i+2) % nverts)*3];
+		
+		if (b[0] != a[0])
+		{
+			const int s = b[0] > a[0] ? 1 : -1;
+			if (!firstSide)
+				firstSide = s;
+			else if (s != side)
+				nflips++;
+			side = s;
+		}
+		
+		const float area = dtTriArea2D(a, b, c);
+		if (area == 0.0f)
+			continue;
+		const int s = area > 0.0f ? 1 : -1;
+		if (sign && s != sign)
+			return false;
+		sign = s;
+	}
+	if (side != firstSide)
+		nflips++;
+	return sign != 0 && nflips == 2;
+}
+
+dtStatus dtTileCache::addConvexObstacle(const float* verts, const int nverts, const float hmin, const float hmax, dtObstacleRef* result)
+{
+	if (nverts < 3 || nverts > DT_MAX_CONVEX_OBSTACLE_VERTS)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!isConvexPoly(verts, nverts))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	dtTileCacheObstacle* ob = allocObstacle(DT_OBSTACLE_CONVEX, result);
+	if (!ob)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	memcpy(ob->convex.verts, verts, sizeof(float)*3*nverts);
+	ob->convex.nverts = nverts;
+	ob->convex.hmin = hmin;
+	ob->convex.hmax = hmax;
+	
 	return DT_SUCCESS;
 }
 
@@ -388,86 +610,131 @@ dtObstacleRef dtTileCache::removeObstacle(const dtObstacleRef ref)
 {
 	if (!ref)
 		return DT_SUCCESS;
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
 	
-	ObstacleRequest* req = &m_reqs[m_nreqs++];
-	memset(req, 0, sizeof(ObstacleRequest));
+	ObstacleRequest* req = allocRequest();
+	if (!req)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	req->action = REQUEST_REMOVE;
 	req->ref = ref;
 	
 	return DT_SUCCESS;
 }
 
+void dtTileCache::translateObstacle(dtTileCacheObstacle* ob, const float* delta)
+{
+	switch (ob->type)
+	{
+	case DT_OBSTACLE_CYLINDER:
+		dtVadd(ob->cylinder.pos, ob->cylinder.pos, delta);
+		break;
+	case DT_OBSTACLE_BOX:
+		dtVadd(ob->box.bmin, ob->box.bmin, delta);
+		dtVadd(ob->box.bmax, ob->box.bmax, delta);
+		break;
+	case DT_OBSTACLE_ORIENTED_BOX:
+		dtVadd(ob->orientedBox.center, ob->orientedBox.center, delta);
+		break;
+	case DT_OBSTACLE_CONVEX:
+		for (int i = 0; i < ob->convex.nverts; ++i)
+			dtVadd(&ob->convex.verts[i*3], &ob->convex.verts[i*3], delta);
+		ob->convex.hmin += delta[1];
+		ob->convex.hmax += delta[1];
+		break;
+	}
+}
+
+/// @par
+///
+/// The position is the center of the base of the obstacle bounds. (See: #getObstacleBounds)
 dtStatus dtTileCache::editObstaclePos( const dtObstacleRef ref, const float* pos )
 {
 	if (!ref)
 		return DT_FAILURE;
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
 
 	dtTileCacheObstacle* ob = const_cast<dtTileCacheObstacle*>(getObstacleByRef(ref));
 	if (!ob)
 	{
 		return DT_FAILURE;
 	}
-	unsigned short salt = ob->salt;
-	ob->salt = salt;
+	ObstacleRequest* req = allocRequest();
+	if (!req)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	ob->state = DT_OBSTACLE_PROCESSING;
-	dtVcopy(ob->pos, pos);
+	
+	float bmin[3], bmax[3], delta[3];
+	getObstacleBounds(ob, bmin, bmax);
+	delta[0] = pos[0] - (bmin[0]+bmax[0])*0.5f;
+	delta[1] = pos[1] - bmin[1];
+	delta[2] = pos[2] - (bmin[2]+bmax[2])*0.5f;
+	translateObstacle(ob, delta);
 
-	ObstacleRequest* req = &m_reqs[m_nreqs++];
-	memset(req, 0, sizeof(ObstacleRequest));
 	req->action = REQUEST_EDIT;
 	req->ref = ref;
 
 	return DT_SUCCESS;
 }
 
+/// @par
+///
+/// Only cylinder obstacles have a radius.
 dtStatus dtTileCache::editObstacleRadius( const dtObstacleRef ref, const float& radius )
 {
 	if (!ref)
 		return DT_FAILURE;
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
 
 	dtTileCacheObstacle* ob = const_cast<dtTileCacheObstacle*>(getObstacleByRef(ref));
 	if (!ob)
 	{
 		return DT_FAILURE;
 	}
-	unsigned short salt = ob->salt;
-	ob->salt = salt;
+	if (ob->type != DT_OBSTACLE_CYLINDER)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	ObstacleRequest* req = allocRequest();
+	if (!req)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	ob->state = DT_OBSTACLE_PROCESSING;
-	ob->radius = radius;
+	ob->cylinder.radius = radius;
 
-	ObstacleRequest* req = &m_reqs[m_nreqs++];
-	memset(req, 0, sizeof(ObstacleRequest));
 	req->action = REQUEST_EDIT;
 	req->ref = ref;
 
 	return DT_SUCCESS;
 }
 
+/// @par
+///
+/// The base of the obstacle stays in place.
 dtStatus dtTileCache::editObstacleHeight( const dtObstacleRef ref, const float& height )
 {
 	if (!ref)
 		return DT_FAILURE;
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
 
 	dtTileCacheObstacle* ob = const_cast<dtTileCacheObstacle*>(getObstacleByRef(ref));
 	if (!ob)
 	{
 		return DT_FAILURE;
 	}
-	unsigned short salt = ob->salt;
-	ob->salt = salt;
+	ObstacleRequest* req = allocRequest();
+	if (!req)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	ob->state = DT_OBSTACLE_PROCESSING;
-	ob->height = height;
+	switch (ob->type)
+	{
+	case DT_OBSTACLE_CYLINDER:
+		ob->cylinder.height = height;
+		break;
+	case DT_OBSTACLE_BOX:
+		ob->box.bmax[1] = ob->box.bmin[1] + height;
+		break;
+	case DT_OBSTACLE_ORIENTED_BOX:
+		ob->orientedBox.center[1] += height*0.5f - ob->orientedBox.halfExtents[1];
+		ob->orientedBox.halfExtents[1] = height*0.5f;
+		break;
+	case DT_OBSTACLE_CONVEX:
+		ob->convex.hmax = ob->convex.hmin + height;
+		break;
+	}
 
-	ObstacleRequest* req = &m_reqs[m_nreqs++];
-	memset(req, 0, sizeof(ObstacleRequest));
 	req->action = REQUEST_EDIT;
 	req->ref = ref;
 
@@ -481,6 +748,7 @@ dtStatus dtTileCache::queryTiles(const float* bmin, const float* bmax,
 	dtCompressedTileRef tiles[MAX_TILES];
 	
 	int n = 0;
+	dtStatus status = DT_SUCCESS;
 	
 	const float tw = m_params.width * m_params.cs;
 	const float th = m_params.height * m_params.cs;
@@ -505,6 +773,8 @@ dtStatus dtTileCache::queryTiles(const float* bmin, const float* bmax,
 				{
 					if (n < maxResults)
 						results[n++] = tiles[i];
+					else
+						status |= DT_BUFFER_TOO_SMALL;
 				}
 			}
 		}
@@ -512,11 +782,49 @@ dtStatus dtTileCache::queryTiles(const float* bmin, const float* bmax,
 	
 	*resultCount = n;
 	
+	return status;
+}
+
+dtTileCache::ObstacleRequest* dtTileCache::allocRequest()
+{
+	if (!reserveItem((void**)&m_reqs, &m_maxReqs, m_nreqs, sizeof(ObstacleRequest)))
+		return 0;
+	ObstacleRequest* req = &m_reqs[m_nreqs++];
+	memset(req, 0, sizeof(ObstacleRequest));
+	return req;
+}
+
+dtStatus dtTileCache::addUpdate(const dtCompressedTileRef ref)
+{
+	// The queued tiles are looked up by index, instead of searching the queue.
+	const unsigned int tileIndex = decodeTileIdTile(ref);
+	if ((int)tileIndex >= m_params.maxTiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (m_queuedRefs[tileIndex] == ref)
+		return DT_SUCCESS;
+	if (!reserveItem((void**)&m_update, &m_maxUpdate, m_nupdate, sizeof(dtCompressedTileRef)))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_update[m_nupdate++] = ref;
+	m_queuedRefs[tileIndex] = ref;
 	return DT_SUCCESS;
 }
 
-dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh)
+/// @par
+///
+/// Without a worker pool, the tiles are rebuilt one at a time. With a worker pool,
+/// a step rebuilds one tile per worker in parallel, or all the pending tiles when
+/// no budget is given, and adds them to the navigation mesh together.
+///
+/// When @p budgetUsec is zero, a single step is done per update. Otherwise steps are
+/// done until the budget is exhausted. (At least one step is done.)
+///
+/// An obstacle touching more than #DT_MAX_TOUCHED_TILES tiles only updates the first of them,
+/// and the update returns #DT_BUFFER_TOO_SMALL.
+dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh, const int budgetUsec)
 {
+	const dtTimeVal startTime = dtGetPerfTime();
+	dtStatus status = DT_SUCCESS;
+	
 	if (m_nupdate == 0)
 	{
 		// Process requests.
@@ -535,22 +843,27 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh)
 			if (req->action == REQUEST_ADD)
 			{
 				// Find touched tiles.
-				float bmin[3], bmax[3];
-				getObstacleBounds(ob, bmin, bmax);
-
-				int ntouched = 0;
-				queryTiles(bmin, bmax, ob->touched, &ntouched, DT_MAX_TOUCHED_TILES);
-				ob->ntouched = (unsigned char)ntouched;
+				status |= queryTouchedTiles(ob) & DT_STATUS_DETAIL_MASK;
 				// Add tiles to update list.
 				ob->npending = 0;
 				for (int j = 0; j < ob->ntouched; ++j)
 				{
-					if (m_nupdate < MAX_UPDATE)
-					{
-						if (!contains(m_update, m_nupdate, ob->touched[j]))
-							m_update[m_nupdate++] = ob->touched[j];
+					if (dtStatusSucceed(addUpdate(ob->touched[j])))
+						ob->pending[ob->npending++] = ob->touched[j];
+				}
+			}
+			else if (req->action == REQUEST_EDIT)
+			{
+				// Clear the obstacle from the tiles it touched.
+				for (int j = 0; j < ob->ntouched; ++j)
+					addUpdate(ob->touched[j]);
+				// Add the obstacle to the tiles it touches now.
+				status |= queryTouchedTiles(ob) & DT_STATUS_DETAIL_MASK;
+				ob->npending = 0;
+				for (int j = 0; j < ob->ntouched; ++j)
+				{
+					if (dtStatusSucceed(addUpdate(ob->touched[j])))
 						ob->pending[ob->npending++] = ob->touched[j];
-					}
 				}
 			}
 			else if (req->action == REQUEST_REMOVE)
@@ -561,12 +874,8 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh)
 				ob->npending = 0;
 				for (int j = 0; j < ob->ntouched; ++j)
 				{
-					if (m_nupdate < MAX_UPDATE)
-					{
-						if (!contains(m_update, m_nupdate, ob->touched[j]))
-							m_update[m_nupdate++] = ob->touched[j];
+					if (dtStatusSucceed(addUpdate(ob->touched[j])))
 						ob->pending[ob->npending++] = ob->touched[j];
-					}
 				}
 			}
 		}
@@ -575,59 +884,132 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh)
 	}
 	
 	// Process updates
-	if (m_nupdate)
+	while (m_nupdate)
+	{
+		int maxTiles = 1;
+		if (m_workers)
+			maxTiles = budgetUsec > 0 ? m_workers->getWorkerCount() : m_nupdate;
+		
+		dtStatus stepStatus = buildUpdates(maxTiles, navmesh);
+		if (dtStatusFailed(stepStatus) && !dtStatusFailed(status))
+			status = stepStatus;
+		
+		if (budgetUsec <= 0 || dtGetPerfDeltaTimeUsec(startTime, dtGetPerfTime()) >= budgetUsec)
+			break;
+	}
+	
+	return status;
+}
+
+void dtTileCache::buildTileTask(void* arg, const int index, const int worker)
+{
+	dtTileCache* tc = (dtTileCache*)arg;
+	TileBuild* build = &tc->m_builds[index];
+	build->status = tc->buildNavMeshTileData(build->ref, tc->m_workers->getAlloc(worker),
+											 &build->navData, &build->navDataSize);
+}
+
+dtStatus dtTileCache::buildUpdates(const int maxTiles, dtNavMesh* navmesh)
+{
+	const int ntiles = dtMin(maxTiles, m_nupdate);
+	dtStatus status = DT_SUCCESS;
+	
+	if (m_workers && ntiles > m_maxBuilds)
+	{
+		dtFree(m_builds);
+		m_builds = (TileBuild*)dtAlloc(sizeof(TileBuild)*ntiles, DT_ALLOC_PERM);
+		m_maxBuilds = m_builds ? ntiles : 0;
+	}
+	
+	if (m_workers && m_builds)
+	{
+		// Build the tiles in parallel.
+		for (int i = 0; i < ntiles; ++i)
+		{
+			TileBuild* build = &m_builds[i];
+			build->ref = m_update[i];
+			build->navData = 0;
+			build->navDataSize = 0;
+			build->status = DT_SUCCESS;
+		}
+		m_workers->parallelFor(buildTileTask, this, ntiles);
+		
+		// Add them to the navmesh in one go.
+		for (int i = 0; i < ntiles; ++i)
+		{
+			TileBuild* build = &m_builds[i];
+			dtStatus tileStatus = build->status;
+			if (dtStatusSucceed(tileStatus))
+				tileStatus = commitNavMeshTile(build->ref, build->navData, build->navDataSize, navmesh);
+			if (dtStatusFailed(tileStatus) && !dtStatusFailed(status))
+				status = tileStatus;
+		}
+	}
+	else
 	{
-		// Build mesh
-		const dtCompressedTileRef ref = m_update[0];
-		dtStatus status = buildNavMeshTile(ref, navmesh);
-		m_nupdate--;
-		if (m_nupdate > 0)
-			memmove(m_update, m_update+1, m_nupdate*sizeof(dtCompressedTileRef));
+		for (int i = 0; i < ntiles; ++i)
+		{
+			dtStatus tileStatus = buildNavMeshTile(m_update[i], navmesh);
+			if (dtStatusFailed(tileStatus) && !dtStatusFailed(status))
+				status = tileStatus;
+		}
+	}
+	
+	for (int i = 0; i < ntiles; ++i)
+	{
+		updateObstacleStates(m_update[i]);
+		
+		const unsigned int tileIndex = decodeTileIdTile(m_update[i]);
+		if (m_queuedRefs[tileIndex] == m_update[i])
+			m_queuedRefs[tileIndex] = 0;
+	}
+	
+	m_nupdate -= ntiles;
+	if (m_nupdate > 0)
+		memmove(m_update, m_update+ntiles, m_nupdate*sizeof(dtCompressedTileRef));
+	
+	return status;
+}
 
-		// Update obstacle states.
-		for (int i = 0; i < m_params.maxObstacles; ++i)
+void dtTileCache::updateObstacleStates(const dtCompressedTileRef ref)
+{
+	for (int i = 0; i < m_params.maxObstacles; ++i)
+	{
+		dtTileCacheObstacle* ob = &m_obstacles[i];
+		if (ob->state == DT_OBSTACLE_PROCESSING || ob->state == DT_OBSTACLE_REMOVING)
 		{
-			dtTileCacheObstacle* ob = &m_obstacles[i];
-			if (ob->state == DT_OBSTACLE_PROCESSING || ob->state == DT_OBSTACLE_REMOVING)
+			// Remove handled tile from pending list.
+			for (int j = 0; j < (int)ob->npending; j++)
 			{
-				// Remove handled tile from pending list.
-				for (int j = 0; j < (int)ob->npending; j++)
+				if (ob->pending[j] == ref)
 				{
-					if (ob->pending[j] == ref)
-					{
-						ob->pending[j] = ob->pending[(int)ob->npending-1];
-						ob->npending--;
-						break;
-					}
+					ob->pending[j] = ob->pending[(int)ob->npending-1];
+					ob->npending--;
+					break;
 				}
-				
-				// If all pending tiles processed, change state.
-				if (ob->npending == 0)
+			}
+			
+			// If all pending tiles processed, change state.
+			if (ob->npending == 0)
+			{
+				if (ob->state == DT_OBSTACLE_PROCESSING)
+				{
+					ob->state = DT_OBSTACLE_PROCESSED;
+				}
+				else if (ob->state == DT_OBSTACLE_REMOVING)
 				{
-					if (ob->state == DT_OBSTACLE_PROCESSING)
-					{
-						ob->state = DT_OBSTACLE_PROCESSED;
-					}
-					else if (ob->state == DT_OBSTACLE_REMOVING)
-					{
-						ob->state = DT_OBSTACLE_EMPTY;
-						// Update salt, salt should never be zero.
-						ob->salt = (ob->salt+1) & ((1<<16)-1);
-						if (ob->salt == 0)
-							ob->salt++;
-						// Return obstacle to free list.
-						ob->next = m_nextFreeObstacle;
-						m_nextFreeObstacle = ob;
-					}
+					ob->state = DT_OBSTACLE_EMPTY;
+					// Update salt, salt should never be zero.
+					ob->salt = (ob->salt+1) & ((1<<16)-1);
+					if (ob->salt == 0)
+						ob->salt++;
+					// Return obstacle to free list.
+					ob->next = m_nextFreeObstacle;
+					m_nextFreeObstacle = ob;
 				}
 			}
 		}
-			
-		if (dtStatusFailed(status))
-			return status;
 	}
-	
-	return DT_SUCCESS;
 }
 
 
@@ -650,8 +1032,29 @@ dtStatus dtTileCache::buildNavMeshTilesAt(const int tx, const int ty, dtNavMesh*
 dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh* navmesh)
 {	
 	dtAssert(m_talloc);
+	
+	unsigned char* navData = 0;
+	int navDataSize = 0;
+	dtStatus status = buildNavMeshTileData(ref, m_talloc, &navData, &navDataSize);
+	if (dtStatusFailed(status))
+		return status;
+	
+	return commitNavMeshTile(ref, navData, navDataSize, navmesh);
+}
+
+/// @par
+///
+/// Only reads the tile cache, so several tiles can be built at the same time
+/// provided each build uses its own allocator.
+dtStatus dtTileCache::buildNavMeshTileData(const dtCompressedTileRef ref, dtTileCacheAlloc* talloc,
+										   unsigned char** navData, int* navDataSize) const
+{
+	dtAssert(talloc);
 	dtAssert(m_tcomp);
 	
+	*navData = 0;
+	*navDataSize = 0;
+	
 	unsigned int idx = decodeTileIdTile(ref);
 	if (idx > (unsigned int)m_params.maxTiles)
 		return DT_FAILURE | DT_INVALID_PARAM;
@@ -660,14 +1063,14 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 	if (tile->salt != salt)
 		return DT_FAILURE | DT_INVALID_PARAM;
 	
-	m_talloc->reset();
+	talloc->reset();
 	
-	BuildContext bc(m_talloc);
+	BuildContext bc(talloc);
 	const int walkableClimbVx = (int)(m_params.walkableClimb / m_params.ch);
 	dtStatus status;
 	
 	// Decompress tile layer data. 
-	status = dtDecompressTileCacheLayer(m_talloc, m_tcomp, tile->data, tile->dataSize, &bc.layer);
+	status = dtDecompressTileCacheLayer(talloc, m_tcomp, tile->data, tile->dataSize, &bc.layer);
 	if (dtStatusFailed(status))
 		return status;
 	
@@ -677,34 +1080,50 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 		const dtTileCacheObstacle* ob = &m_obstacles[i];
 		if (ob->state == DT_OBSTACLE_EMPTY || ob->state == DT_OBSTACLE_REMOVING)
 			continue;
-		if (contains(ob->touched, ob->ntouched, ref))
+		if (!contains(ob->touched, ob->ntouched, ref))
+			continue;
+		switch (ob->type)
 		{
+		case DT_OBSTACLE_CYLINDER:
 			dtMarkCylinderArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch,
-							   ob->pos, ob->radius, ob->height, 0);
+							   ob->cylinder.pos, ob->cylinder.radius, ob->cylinder.height, 0);
+			break;
+		case DT_OBSTACLE_BOX:
+			dtMarkBoxArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch,
+						  ob->box.bmin, ob->box.bmax, 0);
+			break;
+		case DT_OBSTACLE_ORIENTED_BOX:
+			dtMarkBoxArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch,
+						  ob->orientedBox.center, ob->orientedBox.halfExtents, ob->orientedBox.rot, 0);
+			break;
+		case DT_OBSTACLE_CONVEX:
+			dtMarkConvexArea(*bc.layer, tile->header->bmin, m_params.cs, m_params.ch,
+							 ob->convex.verts, ob->convex.nverts, ob->convex.hmin, ob->convex.hmax, 0);
+			break;
 		}
 	}
 	
 	// Build navmesh
-	status = dtBuildTileCacheRegions(m_talloc, *bc.layer, walkableClimbVx);
+	status = dtBuildTileCacheRegions(talloc, *bc.layer, walkableClimbVx);
 	if (dtStatusFailed(status))
 		return status;
 	
-	bc.lcset = dtAllocTileCacheContourSet(m_talloc);
+	bc.lcset = dtAllocTileCacheContourSet(talloc);
 	if (!bc.lcset)
 		return status;
-	status = dtBuildTileCacheContours(m_talloc, *bc.layer, walkableClimbVx,
+	status = dtBuildTileCacheContours(talloc, *bc.layer, walkableClimbVx,
 									  m_params.maxSimplificationError, *bc.lcset);
 	if (dtStatusFailed(status))
 		return status;
 	
-	bc.lmesh = dtAllocTileCachePolyMesh(m_talloc);
+	bc.lmesh = dtAllocTileCachePolyMesh(talloc);
 	if (!bc.lmesh)
 		return status;
-	status = dtBuildTileCachePolyMesh(m_talloc, *bc.lcset, *bc.lmesh);
+	status = dtBuildTileCachePolyMesh(talloc, *bc.lcset, *bc.lmesh);
 	if (dtStatusFailed(status))
 		return status;
 	
-	// Early out if the mesh tile is empty.
+	// Early out if the mesh tile is empty, the location is left empty.
 	if (!bc.lmesh->npolys)
 		return DT_SUCCESS;
 	
@@ -734,19 +1153,30 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 		m_tmproc->process(&params, bc.lmesh->areas, bc.lmesh->flags);
 	}
 	
-	unsigned char* navData = 0;
-	int navDataSize = 0;
-	if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
+	if (!dtCreateNavMeshData(&params, navData, navDataSize))
 		return DT_FAILURE;
+	
+	return DT_SUCCESS;
+}
 
+dtStatus dtTileCache::commitNavMeshTile(const dtCompressedTileRef ref, unsigned char* navData, const int navDataSize,
+										dtNavMesh* navmesh)
+{
+	const dtCompressedTile* tile = getTileByRef(ref);
+	if (!tile)
+	{
+		dtFree(navData);
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	
 	// Remove existing tile.
 	navmesh->removeTile(navmesh->getTileRefAt(tile->header->tx,tile->header->ty,tile->header->tlayer),0,0);
-
+	
 	// Add new tile, or leave the location empty.
 	if (navData)
 	{
 		// Let the navmesh own the data.
-		status = navmesh->addTile(navData,navDataSize,DT_TILE_FREE_DATA,0,0);
+		dtStatus status = navmesh->addTile(navData,navDataSize,DT_TILE_FREE_DATA,0,0);
 		if (dtStatusFailed(status))
 		{
 			dtFree(navData);
@@ -770,10 +1200,175 @@ void dtTileCache::calcTightTileBounds(const dtTileCacheLayerHeader* header, floa
 
 void dtTileCache::getObstacleBounds(const struct dtTileCacheObstacle* ob, float* bmin, float* bmax) const
 {
-	bmin[0] = ob->pos[0] - ob->radius;
-	bmin[1] = ob->pos[1];
-	bmin[2] = ob->pos[2] - ob->radius;
-	bmax[0] = ob->pos[0] + ob->radius;
-	bmax[1] = ob->pos[1] + ob->height;
-	bmax[2] = ob->pos[2] + ob->radius;	
+	switch (ob->type)
+	{
+	case DT_OBSTACLE_CYLINDER:
+	{
+		const dtObstacleCylinder& cl = ob->cylinder;
+		bmin[0] = cl.pos[0] - cl.radius;
+		bmin[1] = cl.pos[1];
+		bmin[2] = cl.pos[2] - cl.radius;
+		bmax[0] = cl.pos[0] + cl.radius;
+		bmax[1] = cl.pos[1] + cl.height;
+		bmax[2] = cl.pos[2] + cl.radius;
+		break;
+	}
+	case DT_OBSTACLE_BOX:
+		dtVcopy(bmin, ob->box.bmin);
+		dtVcopy(bmax, ob->box.bmax);
+		break;
+	case DT_OBSTACLE_ORIENTED_BOX:
+	{
+		const dtObstacleOrientedBox& obb = ob->orientedBox;
+		const float ex = dtAbs(obb.rot[0])*obb.halfExtents[0] + dtAbs(obb.rot[1])*obb.halfExtents[2];
+		const float ez = dtAbs(obb.rot[1])*obb.halfExtents[0] + dtAbs(obb.rot[0])*obb.halfExtents[2];
+		bmin[0] = obb.center[0] - ex;
+		bmin[1] = obb.center[1] - obb.halfExtents[1];
+		bmin[2] = obb.center[2] - ez;
+		bmax[0] = obb.center[0] + ex;
+		bmax[1] = obb.center[1] + obb.halfExtents[1];
+		bmax[2] = obb.center[2] + ez;
+		break;
+	}
+	case DT_OBSTACLE_CONVEX:
+	{
+		const dtObstacleConvex& cv = ob->convex;
+		dtVcopy(bmin, cv.verts);
+		dtVcopy(bmax, cv.verts);
+		for (int i = 1; i < cv.nverts; ++i)
+		{
+			dtVmin(bmin, &cv.verts[i*3]);
+			dtVmax(bmax, &cv.verts[i*3]);
+		}
+		bmin[1] = cv.hmin;
+		bmax[1] = cv.hmax;
+		break;
+	}
+	default:
+		dtVset(bmin, 0, 0, 0);
+		dtVset(bmax, 0, 0, 0);
+		break;
+	}
+}
+
+// Separating axis test between a convex polygon and a rectangle on the xz-plane.
+static bool overlapPolyRect(const float* verts, const int nverts, const float* bmin, const float* bmax)
+{
+	// The axes of the rectangle.
+	float pmin[3], pmax[3];
+	dtVcopy(pmin, verts);
+	dtVcopy(pmax, verts);
+	for (int i = 1; i < nverts; ++i)
+	{
+		dtVmin(pmin, &verts[i*3]);
+		dtVmax(pmax, &verts[i*3]);
+	}
+	if (pmin[0] > bmax[0] || pmax[0] < bmin[0] || pmin[2] > bmax[2] || pmax[2] < bmin[2])
+		return false;
+	
+	// The edge normals of the polygon.
+	const float rect[4*2] = { bmin[0],bmin[2], bmax[0],bmin[2], bmax[0],bmax[2], bmin[0],bmax[2] };
+	for (int i = 0, j = nverts-1; i < nverts; j = i++)
+	{
+		const float nx = verts[i*3+2] - verts[j*3+2];
+		const float nz = verts[j*3+0] - verts[i*3+0];
+		float pmn = FLT_MAX, pmx = -FLT_MAX;
+		for (int k = 0; k < nverts; ++k)
+		{
+			const float d = nx*verts[k*3+0] + nz*verts[k*3+2];
+			pmn = dtMin(pmn, d);
+			pmx = dtMax(pmx, d);
+		}
+		float rmn = FLT_MAX, rmx = -FLT_MAX;
+		for (int k = 0; k < 4; ++k)
+		{
+			const float d = nx*rect[k*2+0] + nz*rect[k*2+1];
+			rmn = dtMin(rmn, d);
+			rmx = dtMax(rmx, d);
+		}
+		if (pmn > rmx || pmx < rmn)
+			return false;
+	}
+	return true;
+}
+
+/// @par
+///
+/// The marking functions mark the cells whose center is at most half a cell away from the obstacle.
+/// The same margin is kept here by growing the bounds by half a cell, whatever the shape of the obstacle.
+bool dtTileCache::obstacleOverlapsBounds(const struct dtTileCacheObstacle* ob, const float* bmin, const float* bmax) const
+{
+	const float pad = m_params.cs*0.5f;
+	const float pbmin[3] = {bmin[0]-pad, bmin[1], bmin[2]-pad};
+	const float pbmax[3] = {bmax[0]+pad, bmax[1], bmax[2]+pad};
+	switch (ob->type)
+	{
+	case DT_OBSTACLE_CYLINDER:
+	{
+		const dtObstacleCylinder& cl = ob->cylinder;
+		const float dx = cl.pos[0] - dtClamp(cl.pos[0], pbmin[0], pbmax[0]);
+		const float dz = cl.pos[2] - dtClamp(cl.pos[2], pbmin[2], pbmax[2]);
+		return dx*dx + dz*dz <= dtSqr(cl.radius);
+	}
+	case DT_OBSTACLE_ORIENTED_BOX:
+	{
+		const dtObstacleOrientedBox& obb = ob->orientedBox;
+		const float hx = obb.halfExtents[0], hz = obb.halfExtents[2];
+		const float ax = obb.rot[0]*hx, az = obb.rot[1]*hx;
+		const float bx = -obb.rot[1]*hz, bz = obb.rot[0]*hz;
+		const float* c = obb.center;
+		const float verts[4*3] = {
+			c[0]-ax-bx, c[1], c[2]-az-bz,
+			c[0]+ax-bx, c[1], c[2]+az-bz,
+			c[0]+ax+bx, c[1], c[2]+az+bz,
+			c[0]-ax+bx, c[1], c[2]-az+bz,
+		};
+		return overlapPolyRect(verts, 4, pbmin, pbmax);
+	}
+	case DT_OBSTACLE_CONVEX:
+		return overlapPolyRect(ob->convex.verts, ob->convex.nverts, pbmin, pbmax);
+	default:
+		// The bounds of the box are exact.
+		return ob->box.bmin[0] <= pbmax[0] && ob->box.bmax[0] >= pbmin[0] &&
+			   ob->box.bmin[2] <= pbmax[2] && ob->box.bmax[2] >= pbmin[2];
+	}
+}
+
+/// @par
+///
+/// Only the tiles overlapping the footprint of the obstacle are kept, not all
+/// the tiles overlapping its bounds. When the obstacle touches more than
+/// #DT_MAX_TOUCHED_TILES tiles, the first ones are kept and #DT_BUFFER_TOO_SMALL
+/// is returned.
+dtStatus dtTileCache::queryTouchedTiles(dtTileCacheObstacle* ob)
+{
+	// Grown by half a cell, like the obstacles. (See: #obstacleOverlapsBounds)
+	const float pad = m_params.cs*0.5f;
+	float bmin[3], bmax[3];
+	getObstacleBounds(ob, bmin, bmax);
+	bmin[0] -= pad;
+	bmin[2] -= pad;
+	bmax[0] += pad;
+	bmax[2] += pad;
+	
+	const int MAX_CANDIDATES = DT_MAX_TOUCHED_TILES*4;
+	dtCompressedTileRef candidates[MAX_CANDIDATES];
+	int ncandidates = 0;
+	dtStatus status = queryTiles(bmin, bmax, candidates, &ncandidates, MAX_CANDIDATES);
+	
+	ob->ntouched = 0;
+	for (int i = 0; i < ncandidates; ++i)
+	{
+		const dtCompressedTile* tile = getTileByRef(candidates[i]);
+		float tbmin[3], tbmax[3];
+		calcTightTileBounds(tile->header, tbmin, tbmax);
+		if (!obstacleOverlapsBounds(ob, tbmin, tbmax))
+			continue;
+		if (ob->ntouched < DT_MAX_TOUCHED_TILES)
+			ob->touched[ob->ntouched++] = candidates[i];
+		else
+			status |= DT_BUFFER_TOO_SMALL;
+	}
+	
+	return status;
 }
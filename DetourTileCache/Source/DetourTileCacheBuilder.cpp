@@ -2004,6 +2004,172 @@ dtStatus dtMarkCylinderArea(dtTileCacheLayer& layer, const float* orig, const fl
 }
 
 
+// Clamps the cell range covered by the bounds to the layer, returns false if they do not overlap.
+static bool getCellRange(const dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+						 const float* bmin, const float* bmax,
+						 int& minx, int& miny, int& minz, int& maxx, int& maxy, int& maxz)
+{
+	const int w = (int)layer.header->width;
+	const int h = (int)layer.header->height;
+	const float ics = 1.0f/cs;
+	const float ich = 1.0f/ch;
+	
+	minx = (int)floorf((bmin[0]-orig[0])*ics);
+	miny = (int)floorf((bmin[1]-orig[1])*ich);
+	minz = (int)floorf((bmin[2]-orig[2])*ics);
+	maxx = (int)floorf((bmax[0]-orig[0])*ics);
+	maxy = (int)floorf((bmax[1]-orig[1])*ich);
+	maxz = (int)floorf((bmax[2]-orig[2])*ics);
+	
+	if (maxx < 0) return false;
+	if (minx >= w) return false;
+	if (maxz < 0) return false;
+	if (minz >= h) return false;
+	
+	if (minx < 0) minx = 0;
+	if (maxx >= w) maxx = w-1;
+	if (minz < 0) minz = 0;
+	if (maxz >= h) maxz = h-1;
+	
+	return true;
+}
+
+dtStatus dtMarkBoxArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+					   const float* bmin, const float* bmax, const unsigned char areaId)
+{
+	const int w = (int)layer.header->width;
+	int minx, miny, minz, maxx, maxy, maxz;
+	if (!getCellRange(layer, orig, cs, ch, bmin, bmax, minx, miny, minz, maxx, maxy, maxz))
+		return DT_SUCCESS;
+	
+	// All the cells overlapping the box are marked, which grows it by half a cell like the cylinder.
+	for (int z = minz; z <= maxz; ++z)
+	{
+		for (int x = minx; x <= maxx; ++x)
+		{
+			const int y = layer.heights[x+z*w];
+			if (y < miny || y > maxy)
+				continue;
+			layer.areas[x+z*w] = areaId;
+		}
+	}
+	
+	return DT_SUCCESS;
+}
+
+dtStatus dtMarkBoxArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+					   const float* center, const float* halfExtents, const float* rot, const unsigned char areaId)
+{
+	// Grow the box by half a cell, like the cylinder.
+	const float hx = halfExtents[0] + cs*0.5f;
+	const float hz = halfExtents[2] + cs*0.5f;
+	
+	// The footprint of the grown box fits in this square.
+	const float maxr = sqrtf(dtSqr(hx) + dtSqr(hz));
+	float bmin[3], bmax[3];
+	bmin[0] = center[0] - maxr;
+	bmin[1] = center[1] - halfExtents[1];
+	bmin[2] = center[2] - maxr;
+	bmax[0] = center[0] + maxr;
+	bmax[1] = center[1] + halfExtents[1];
+	bmax[2] = center[2] + maxr;
+	
+	const int w = (int)layer.header->width;
+	int minx, miny, minz, maxx, maxy, maxz;
+	if (!getCellRange(layer, orig, cs, ch, bmin, bmax, minx, miny, minz, maxx, maxy, maxz))
+		return DT_SUCCESS;
+	
+	for (int z = minz; z <= maxz; ++z)
+	{
+		for (int x = minx; x <= maxx; ++x)
+		{
+			// Cell center in the box frame.
+			const float dx = orig[0] + (x+0.5f)*cs - center[0];
+			const float dz = orig[2] + (z+0.5f)*cs - center[2];
+			const float lx = rot[0]*dx + rot[1]*dz;
+			const float lz = rot[0]*dz - rot[1]*dx;
+			if (dtAbs(lx) > hx || dtAbs(lz) > hz)
+				continue;
+			const int y = layer.heights[x+z*w];
+			if (y < miny || y > maxy)
+				continue;
+			layer.areas[x+z*w] = areaId;
+		}
+	}
+	
+	return DT_SUCCESS;
+}
+
+static bool pointInPoly(const float* verts, const int nverts, const float x, const float z)
+{
+	bool c = false;
+	for (int i = 0, j = nverts-1; i < nverts; j = i++)
+	{
+		const float* vi = &verts[i*3];
+		const float* vj = &verts[j*3];
+		if (((vi[2] > z) != (vj[2] > z)) &&
+			(x < (vj[0]-vi[0]) * (z-vi[2]) / (vj[2]-vi[2]) + vi[0]))
+			c = !c;
+	}
+	return c;
+}
+
+// Whether the point is inside the polygon grown by the given distance.
+static bool pointInGrownPoly(const float* verts, const int nverts, const float x, const float z, const float dist)
+{
+	if (pointInPoly(verts, nverts, x, z))
+		return true;
+	const float pt[3] = {x, 0, z};
+	float t;
+	for (int i = 0, j = nverts-1; i < nverts; j = i++)
+	{
+		if (dtDistancePtSegSqr2D(pt, &verts[j*3], &verts[i*3], t) <= dtSqr(dist))
+			return true;
+	}
+	return false;
+}
+
+dtStatus dtMarkConvexArea(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+						  const float* verts, const int nverts, const float hmin, const float hmax,
+						  const unsigned char areaId)
+{
+	if (nverts < 3)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	float bmin[3], bmax[3];
+	dtVcopy(bmin, verts);
+	dtVcopy(bmax, verts);
+	for (int i = 1; i < nverts; ++i)
+	{
+		dtVmin(bmin, &verts[i*3]);
+		dtVmax(bmax, &verts[i*3]);
+	}
+	bmin[1] = hmin;
+	bmax[1] = hmax;
+	
+	const int w = (int)layer.header->width;
+	int minx, miny, minz, maxx, maxy, maxz;
+	if (!getCellRange(layer, orig, cs, ch, bmin, bmax, minx, miny, minz, maxx, maxy, maxz))
+		return DT_SUCCESS;
+	
+	// Grow the polygon by half a cell, like the cylinder.
+	for (int z = minz; z <= maxz; ++z)
+	{
+		for (int x = minx; x <= maxx; ++x)
+		{
+			if (!pointInGrownPoly(verts, nverts, orig[0] + (x+0.5f)*cs, orig[2] + (z+0.5f)*cs, cs*0.5f))
+				continue;
+			const int y = layer.heights[x+z*w];
+			if (y < miny || y > maxy)
+				continue;
+			layer.areas[x+z*w] = areaId;
+		}
+	}
+	
+	return DT_SUCCESS;
+}
+
+
 dtStatus dtBuildTileCacheLayer(dtTileCacheCompressor* comp,
 							   dtTileCacheLayerHeader* header,
 							   const unsigned char* heights,
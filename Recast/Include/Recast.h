@@ -43,6 +43,8 @@ enum rcTimerLabel
 	RC_TIMER_RASTERIZE_TRIANGLES,
 	/// The time to build the compact heightfield. (See: #rcBuildCompactHeightfield)
 	RC_TIMER_BUILD_COMPACTHEIGHTFIELD,
+	/// The time to build the packed heightfield. (See: #rcBuildPackedHeightfield)
+	RC_TIMER_BUILD_PACKEDHEIGHTFIELD,
 	/// The total time to build the contours. (See: #rcBuildContours)
 	RC_TIMER_BUILD_CONTOURS,
 	/// The time to trace the boundaries of the contours. (See: #rcBuildContours)
@@ -95,6 +97,13 @@ enum rcTimerLabel
 	RC_MAX_TIMERS
 };
 
+/// A function run by #rcContext::parallelFor for each index of a loop.
+///  @param[in]		arg		The argument passed to #rcContext::parallelFor.
+///  @param[in]		index	The index of the iteration. [Limit: 0 <= value < count]
+///  @param[in]		worker	The index of the worker running the iteration. [Limit: 0 <= value < #rcContext::getWorkerCount]
+/// @ingroup recast
+typedef void (rcParallelForFunc)(void* arg, const int index, const int worker);
+
 /// Provides an interface for optional logging and performance tracking of the Recast 
 /// build process.
 /// @ingroup recast
@@ -104,7 +113,7 @@ public:
 
 	/// Contructor.
 	///  @param[in]		state	TRUE if the logging and performance timers should be enabled.  [Default: true]
-	inline rcContext(bool state = true) : m_logEnabled(state), m_timerEnabled(state) {}
+	inline rcContext(bool state = true) : m_logEnabled(state), m_timerEnabled(state), m_simdEnabled(true) {}
 	virtual ~rcContext() {}
 
 	/// Enables or disables logging.
@@ -139,6 +148,23 @@ public:
 	///  @return The accumulated time of the timer, or -1 if timers are disabled or the timer has never been started.
 	inline int getAccumulatedTime(const rcTimerLabel label) const { return m_timerEnabled ? doGetAccumulatedTime(label) : -1; }
 
+	/// Enables or disables the SIMD implementations of the build functions, where they are available.
+	///  @param[in]		state	TRUE if the SIMD implementations should be used.
+	inline void enableSimd(bool state) { m_simdEnabled = state; }
+
+	/// Returns true if the SIMD implementations of the build functions are enabled.
+	inline bool isSimdEnabled() const { return m_simdEnabled; }
+
+	/// Returns the number of workers which can run the iterations of #parallelFor concurrently.
+	///  @return The number of workers. [Limit: >= 1]
+	inline int getWorkerCount() const { return doGetWorkerCount(); }
+
+	/// Runs a function for each index of a loop, possibly concurrently.
+	///  @param[in]		func	The function to run.
+	///  @param[in]		arg		The argument to pass to the function.
+	///  @param[in]		count	The number of iterations.
+	inline void parallelFor(rcParallelForFunc* func, void* arg, const int count) { doParallelFor(func, arg, count); }
+
 protected:
 
 	/// Clears all log entries.
@@ -165,12 +191,24 @@ protected:
 	///  @param[in]		label	The category of the timer.
 	///  @return The accumulated time of the timer, or -1 if timers are disabled or the timer has never been started.
 	virtual int doGetAccumulatedTime(const rcTimerLabel /*label*/) const { return -1; }
+
+	/// Returns the number of workers which can run the iterations of #parallelFor concurrently.
+	virtual int doGetWorkerCount() const { return 1; }
+
+	/// Runs a function for each index of a loop, possibly concurrently.
+	///  @param[in]		func	The function to run.
+	///  @param[in]		arg		The argument to pass to the function.
+	///  @param[in]		count	The number of iterations.
+	virtual void doParallelFor(rcParallelForFunc* func, void* arg, const int count);
 	
 	/// True if logging is enabled.
 	bool m_logEnabled;
 
 	/// True if the performance timers are enabled.
 	bool m_timerEnabled;
+
+	/// True if the SIMD implementations of the build functions are enabled.
+	bool m_simdEnabled;
 };
 
 /// Specifies a configuration to use when performing Recast builds.
@@ -284,6 +322,31 @@ struct rcHeightfield
 	rcSpan* freelist;	///< The next free span.
 };
 
+/// Represents a span in a packed heightfield.
+/// @see rcPackedHeightfield
+struct rcPackedSpan
+{
+	unsigned int smin : 13;			///< The lower limit of the span. [Limit: < #smax]
+	unsigned int smax : 13;			///< The upper limit of the span. [Limit: <= #RC_SPAN_MAX_HEIGHT]
+	unsigned int area : 6;			///< The area id assigned to the span.
+};
+
+/// A heightfield representing obstructed space, with the spans of each column
+/// stored contiguously.
+/// @ingroup recast
+struct rcPackedHeightfield
+{
+	int width;				///< The width of the heightfield. (Along the x-axis in cell units.)
+	int height;				///< The height of the heightfield. (Along the z-axis in cell units.)
+	float bmin[3];  		///< The minimum bounds in world space. [(x, y, z)]
+	float bmax[3];			///< The maximum bounds in world space. [(x, y, z)]
+	float cs;				///< The size of each cell. (On the xz-plane.)
+	float ch;				///< The height of each cell. (The minimum increment along the y-axis.)
+	int spanCount;			///< The number of spans in the heightfield.
+	unsigned int* cells;	///< The index of the first span of each column. [Size: width*height + 1]
+	rcPackedSpan* spans;	///< The spans, by column and from the bottom up. [Size: #spanCount]
+};
+
 /// Provides information on the content of a cell column in a compact heightfield. 
 struct rcCompactCell
 {
@@ -428,6 +491,18 @@ rcHeightfield* rcAllocHeightfield();
 ///  @see rcAllocHeightfield
 void rcFreeHeightField(rcHeightfield* hf);
 
+/// Allocates a packed heightfield object using the Recast allocator.
+///  @return A packed heightfield that is ready for initialization, or null on failure.
+///  @ingroup recast
+///  @see rcBuildPackedHeightfield, rcFreePackedHeightfield
+rcPackedHeightfield* rcAllocPackedHeightfield();
+
+/// Frees the specified packed heightfield object using the Recast allocator.
+///  @param[in]		phf		A packed heightfield allocated using #rcAllocPackedHeightfield
+///  @ingroup recast
+///  @see rcAllocPackedHeightfield
+void rcFreePackedHeightfield(rcPackedHeightfield* phf);
+
 /// Allocates a compact heightfield object using the Recast allocator.
 ///  @return A compact heightfield that is ready for initialization, or null on failure.
 ///  @ingroup recast
@@ -521,6 +596,16 @@ enum rcBuildContoursFlags
 	RC_CONTOUR_TESS_AREA_EDGES = 0x02,	///< Tessellate edges between areas during contour simplification.
 };
 
+/// Detail mesh build flags.
+/// @see rcBuildPolyMeshDetail
+enum rcBuildPolyMeshDetailFlags
+{
+	/// Inserts the height samples in the triangulation one at a time instead of triangulating
+	/// all the vertices again after each sample. Faster with small sample distances, but the
+	/// triangles may differ where several vertices are cocircular.
+	RC_DETAIL_INCREMENTAL_DELAUNAY = 0x01,
+};
+
 /// Applied to the region id field of contour vertices in order to extract the region id.
 /// The region id field of a vertex may have several flags applied to it.  So the
 /// fields value can't be used directly.
@@ -746,6 +831,14 @@ bool rcCreateHeightfield(rcContext* ctx, rcHeightfield& hf, int width, int heigh
 						 const float* bmin, const float* bmax,
 						 float cs, float ch);
 
+/// Builds a packed heightfield holding the same spans as the specified heightfield.
+///  @ingroup recast
+///  @param[in,out]	ctx		The build context to use during the operation.
+///  @param[in]		hf		A fully built heightfield. (All spans have been added.)
+///  @param[out]	phf		The resulting packed heightfield. (Must be pre-allocated.)
+///  @returns True if the operation completed successfully.
+bool rcBuildPackedHeightfield(rcContext* ctx, const rcHeightfield& hf, rcPackedHeightfield& phf);
+
 /// Sets the area id of all triangles with a slope below the specified value
 /// to #RC_WALKABLE_AREA.
 ///  @ingroup recast
@@ -853,6 +946,14 @@ void rcRasterizeTriangles(rcContext* ctx, const float* verts, const unsigned cha
 ///  @param[in,out]	solid			A fully built heightfield.  (All spans have been added.)
 void rcFilterLowHangingWalkableObstacles(rcContext* ctx, const int walkableClimb, rcHeightfield& solid);
 
+/// Marks non-walkable spans as walkable if their maximum is within @p walkableClimp of a walkable neihbor. 
+///  @ingroup recast
+///  @param[in,out]	ctx				The build context to use during the operation.
+///  @param[in]		walkableClimb	Maximum ledge height that is considered to still be traversable. 
+///  								[Limit: >=0] [Units: vx]
+///  @param[in,out]	solid			A packed heightfield.
+void rcFilterLowHangingWalkableObstacles(rcContext* ctx, const int walkableClimb, rcPackedHeightfield& solid);
+
 /// Marks spans that are ledges as not-walkable. 
 ///  @ingroup recast
 ///  @param[in,out]	ctx				The build context to use during the operation.
@@ -864,6 +965,17 @@ void rcFilterLowHangingWalkableObstacles(rcContext* ctx, const int walkableClimb
 void rcFilterLedgeSpans(rcContext* ctx, const int walkableHeight,
 						const int walkableClimb, rcHeightfield& solid);
 
+/// Marks spans that are ledges as not-walkable. 
+///  @ingroup recast
+///  @param[in,out]	ctx				The build context to use during the operation.
+///  @param[in]		walkableHeight	Minimum floor to 'ceiling' height that will still allow the floor area to 
+///  								be considered walkable. [Limit: >= 3] [Units: vx]
+///  @param[in]		walkableClimb	Maximum ledge height that is considered to still be traversable. 
+///  								[Limit: >=0] [Units: vx]
+///  @param[in,out]	solid			A packed heightfield.
+void rcFilterLedgeSpans(rcContext* ctx, const int walkableHeight,
+						const int walkableClimb, rcPackedHeightfield& solid);
+
 /// Marks walkable spans as not walkable if the clearence above the span is less than the specified height. 
 ///  @ingroup recast
 ///  @param[in,out]	ctx				The build context to use during the operation.
@@ -872,6 +984,14 @@ void rcFilterLedgeSpans(rcContext* ctx, const int walkableHeight,
 ///  @param[in,out]	solid			A fully built heightfield.  (All spans have been added.)
 void rcFilterWalkableLowHeightSpans(rcContext* ctx, int walkableHeight, rcHeightfield& solid);
 
+/// Marks walkable spans as not walkable if the clearence above the span is less than the specified height. 
+///  @ingroup recast
+///  @param[in,out]	ctx				The build context to use during the operation.
+///  @param[in]		walkableHeight	Minimum floor to 'ceiling' height that will still allow the floor area to 
+///  								be considered walkable. [Limit: >= 3] [Units: vx]
+///  @param[in,out]	solid			A packed heightfield.
+void rcFilterWalkableLowHeightSpans(rcContext* ctx, int walkableHeight, rcPackedHeightfield& solid);
+
 /// Returns the number of spans contained in the specified heightfield.
 ///  @ingroup recast
 ///  @param[in,out]	ctx		The build context to use during the operation.
@@ -879,6 +999,13 @@ void rcFilterWalkableLowHeightSpans(rcContext* ctx, int walkableHeight, rcHeight
 ///  @returns The number of spans in the heightfield.
 int rcGetHeightFieldSpanCount(rcContext* ctx, rcHeightfield& hf);
 
+/// Returns the number of walkable spans contained in the specified packed heightfield.
+///  @ingroup recast
+///  @param[in,out]	ctx		The build context to use during the operation.
+///  @param[in]		phf		An initialized packed heightfield.
+///  @returns The number of walkable spans in the heightfield.
+int rcGetHeightFieldSpanCount(rcContext* ctx, const rcPackedHeightfield& phf);
+
 /// @}
 /// @name Compact Heightfield Functions
 /// @see rcCompactHeightfield
@@ -897,6 +1024,27 @@ int rcGetHeightFieldSpanCount(rcContext* ctx, rcHeightfield& hf);
 bool rcBuildCompactHeightfield(rcContext* ctx, const int walkableHeight, const int walkableClimb,
 							   rcHeightfield& hf, rcCompactHeightfield& chf);
 
+/// Builds a compact heightfield representing open space, from a packed heightfield representing solid space.
+///  @ingroup recast
+///  @param[in,out]	ctx				The build context to use during the operation.
+///  @param[in]		walkableHeight	Minimum floor to 'ceiling' height that will still allow the floor area 
+///  								to be considered walkable. [Limit: >= 3] [Units: vx]
+///  @param[in]		walkableClimb	Maximum ledge height that is considered to still be traversable. 
+///  								[Limit: >=0] [Units: vx]
+///  @param[in]		phf				The packed heightfield to be compacted.
+///  @param[out]	chf				The resulting compact heightfield. (Must be pre-allocated.)
+///  @returns True if the operation completed successfully.
+bool rcBuildCompactHeightfield(rcContext* ctx, const int walkableHeight, const int walkableClimb,
+							   const rcPackedHeightfield& phf, rcCompactHeightfield& chf);
+
+/// Copies the compact heightfield data from src to dst.
+///  @ingroup recast
+///  @param[in,out]	ctx		The build context to use during the operation.
+///  @param[in]		src		The source compact heightfield to copy from.
+///  @param[out]	dst		The resulting compact heightfield. (Must be pre-allocated, must be empty.)
+///  @returns True if the operation completed successfully.
+bool rcCopyCompactHeightfield(rcContext* ctx, const rcCompactHeightfield& src, rcCompactHeightfield& dst);
+
 /// Erodes the walkable area within the heightfield by the specified radius. 
 ///  @ingroup recast
 ///  @param[in,out]	ctx		The build context to use during the operation.
@@ -1097,10 +1245,11 @@ bool rcMergePolyMeshes(rcContext* ctx, rcPolyMesh** meshes, const int nmeshes, r
 ///  @param[in]		sampleMaxError	The maximum distance the detail mesh surface should deviate from 
 ///  								heightfield data. [Limit: >=0] [Units: wu]
 ///  @param[out]	dmesh			The resulting detail mesh.  (Must be pre-allocated.)
+///  @param[in]		buildFlags		The build flags. (See: #rcBuildPolyMeshDetailFlags)
 ///  @returns True if the operation completed successfully.
 bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompactHeightfield& chf,
 						   const float sampleDist, const float sampleMaxError,
-						   rcPolyMeshDetail& dmesh);
+						   rcPolyMeshDetail& dmesh, const int buildFlags = 0);
 
 /// Copies the poly mesh data from src to dst.
 ///  @ingroup recast
@@ -45,6 +45,21 @@ float rcSqrt(float x)
 /// class through the Recast build process.
 ///
 
+/// @par
+///
+/// The build functions split some of their work in independent iterations run
+/// through #parallelFor. The default implementation runs them in order on the
+/// calling thread. An implementation backed by a thread pool must run every
+/// iteration before returning, and must give the concurrent iterations distinct
+/// worker indices, which the build functions use to select their scratch memory.
+/// The iterations may allocate memory, so a custom allocator set with
+/// #rcAllocSetCustom must be thread-safe when the loops run concurrently.
+void rcContext::doParallelFor(rcParallelForFunc* func, void* arg, const int count)
+{
+	for (int i = 0; i < count; ++i)
+		func(arg, i, 0);
+}
+
 /// @par
 ///
 /// Example:
@@ -92,6 +107,21 @@ void rcFreeHeightField(rcHeightfield* hf)
 	rcFree(hf);
 }
 
+rcPackedHeightfield* rcAllocPackedHeightfield()
+{
+	rcPackedHeightfield* phf = (rcPackedHeightfield*)rcAlloc(sizeof(rcPackedHeightfield), RC_ALLOC_PERM);
+	memset(phf, 0, sizeof(rcPackedHeightfield));
+	return phf;
+}
+
+void rcFreePackedHeightfield(rcPackedHeightfield* phf)
+{
+	if (!phf) return;
+	rcFree(phf->cells);
+	rcFree(phf->spans);
+	rcFree(phf);
+}
+
 rcCompactHeightfield* rcAllocCompactHeightfield()
 {
 	rcCompactHeightfield* chf = (rcCompactHeightfield*)rcAlloc(sizeof(rcCompactHeightfield), RC_ALLOC_PERM);
@@ -228,6 +258,76 @@ bool rcCreateHeightfield(rcContext* /*ctx*/, rcHeightfield& hf, int width, int h
 	return true;
 }
 
+/// @par
+///
+/// The packed heightfield stores the spans of each column in a single array,
+/// so the filters and #rcBuildCompactHeightfield walk the memory linearly
+/// instead of following the span links. Each span takes 4 bytes instead of the
+/// 16 bytes of a 64-bit rcSpan, plus 4 bytes per column for the index table.
+///
+/// The spans can not be added to a packed heightfield, so it is built once
+/// the rasterization is done. The source heightfield can then be freed.
+///
+/// @see rcAllocPackedHeightfield, rcPackedHeightfield
+bool rcBuildPackedHeightfield(rcContext* ctx, const rcHeightfield& hf, rcPackedHeightfield& phf)
+{
+	rcAssert(ctx);
+	
+	ctx->startTimer(RC_TIMER_BUILD_PACKEDHEIGHTFIELD);
+	
+	const int w = hf.width;
+	const int h = hf.height;
+	
+	rcFree(phf.cells);
+	rcFree(phf.spans);
+	phf.spans = 0;
+	phf.width = w;
+	phf.height = h;
+	rcVcopy(phf.bmin, hf.bmin);
+	rcVcopy(phf.bmax, hf.bmax);
+	phf.cs = hf.cs;
+	phf.ch = hf.ch;
+	
+	phf.cells = (unsigned int*)rcAlloc(sizeof(unsigned int)*(w*h+1), RC_ALLOC_PERM);
+	if (!phf.cells)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildPackedHeightfield: Out of memory 'phf.cells' (%d)", w*h+1);
+		return false;
+	}
+	
+	int spanCount = 0;
+	for (int i = 0; i < w*h; ++i)
+	{
+		phf.cells[i] = (unsigned int)spanCount;
+		for (const rcSpan* s = hf.spans[i]; s; s = s->next)
+			spanCount++;
+	}
+	phf.cells[w*h] = (unsigned int)spanCount;
+	phf.spanCount = spanCount;
+	
+	phf.spans = (rcPackedSpan*)rcAlloc(sizeof(rcPackedSpan)*rcMax(spanCount, 1), RC_ALLOC_PERM);
+	if (!phf.spans)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildPackedHeightfield: Out of memory 'phf.spans' (%d)", spanCount);
+		return false;
+	}
+	
+	rcPackedSpan* ps = phf.spans;
+	for (int i = 0; i < w*h; ++i)
+	{
+		for (const rcSpan* s = hf.spans[i]; s; s = s->next, ++ps)
+		{
+			ps->smin = s->smin;
+			ps->smax = s->smax;
+			ps->area = s->area;
+		}
+	}
+	
+	ctx->stopTimer(RC_TIMER_BUILD_PACKEDHEIGHTFIELD);
+	
+	return true;
+}
+
 static void calcTriNormal(const float* v0, const float* v1, const float* v2, float* norm)
 {
 	float e0[3], e1[3];
@@ -319,26 +419,22 @@ int rcGetHeightFieldSpanCount(rcContext* /*ctx*/, rcHeightfield& hf)
 	return spanCount;
 }
 
-/// @par
-///
-/// This is just the beginning of the process of fully building a compact heightfield.
-/// Various filters may be applied applied, then the distance field and regions built.
-/// E.g: #rcBuildDistanceField and #rcBuildRegions
-///
-/// See the #rcConfig documentation for more information on the configuration parameters.
-///
-/// @see rcAllocCompactHeightfield, rcHeightfield, rcCompactHeightfield, rcConfig
-bool rcBuildCompactHeightfield(rcContext* ctx, const int walkableHeight, const int walkableClimb,
-							   rcHeightfield& hf, rcCompactHeightfield& chf)
+int rcGetHeightFieldSpanCount(rcContext* /*ctx*/, const rcPackedHeightfield& phf)
 {
-	rcAssert(ctx);
-	
-	ctx->startTimer(RC_TIMER_BUILD_COMPACTHEIGHTFIELD);
-	
-	const int w = hf.width;
-	const int h = hf.height;
-	const int spanCount = rcGetHeightFieldSpanCount(ctx, hf);
+	int spanCount = 0;
+	for (int i = 0; i < phf.spanCount; ++i)
+	{
+		if (phf.spans[i].area != RC_NULL_AREA)
+			spanCount++;
+	}
+	return spanCount;
+}
 
+static bool initCompactHeightfield(rcContext* ctx, const int walkableHeight, const int walkableClimb,
+								  const int w, const int h, const float* bmin, const float* bmax,
+								  const float cs, const float ch, const int spanCount,
+								  rcCompactHeightfield& chf)
+{
 	// Fill in header.
 	chf.width = w;
 	chf.height = h;
@@ -346,11 +442,11 @@ bool rcBuildCompactHeightfield(rcContext* ctx, const int walkableHeight, const i
 	chf.walkableHeight = walkableHeight;
 	chf.walkableClimb = walkableClimb;
 	chf.maxRegions = 0;
-	rcVcopy(chf.bmin, hf.bmin);
-	rcVcopy(chf.bmax, hf.bmax);
-	chf.bmax[1] += walkableHeight*hf.ch;
-	chf.cs = hf.cs;
-	chf.ch = hf.ch;
+	rcVcopy(chf.bmin, bmin);
+	rcVcopy(chf.bmax, bmax);
+	chf.bmax[1] += walkableHeight*ch;
+	chf.cs = cs;
+	chf.ch = ch;
 	chf.cells = (rcCompactCell*)rcAlloc(sizeof(rcCompactCell)*w*h, RC_ALLOC_PERM);
 	if (!chf.cells)
 	{
@@ -373,37 +469,15 @@ bool rcBuildCompactHeightfield(rcContext* ctx, const int walkableHeight, const i
 	}
 	memset(chf.areas, RC_NULL_AREA, sizeof(unsigned char)*spanCount);
 	
-	const int MAX_HEIGHT = 0xffff;
-	
-	// Fill in cells and spans.
-	int idx = 0;
-	for (int y = 0; y < h; ++y)
-	{
-		for (int x = 0; x < w; ++x)
-		{
-			const rcSpan* s = hf.spans[x + y*w];
-			// If there are no spans at this cell, just leave the data to index=0, count=0.
-			if (!s) continue;
-			rcCompactCell& c = chf.cells[x+y*w];
-			c.index = idx;
-			c.count = 0;
-			while (s)
-			{
-				if (s->area != RC_NULL_AREA)
-				{
-					const int bot = (int)s->smax;
-					const int top = s->next ? (int)s->next->smin : MAX_HEIGHT;
-					chf.spans[idx].y = (unsigned short)rcClamp(bot, 0, 0xffff);
-					chf.spans[idx].h = (unsigned char)rcClamp(top - bot, 0, 0xff);
-					chf.areas[idx] = s->area;
-					idx++;
-					c.count++;
-				}
-				s = s->next;
-			}
-		}
-	}
+	return true;
+}
 
+static void buildCompactConnections(rcContext* ctx, const int walkableHeight, const int walkableClimb,
+									rcCompactHeightfield& chf)
+{
+	const int w = chf.width;
+	const int h = chf.height;
+	
 	// Find neighbour connections.
 	const int MAX_LAYERS = RC_NOT_CONNECTED-1;
 	int tooHighNeighbour = 0;
@@ -460,12 +534,194 @@ bool rcBuildCompactHeightfield(rcContext* ctx, const int walkableHeight, const i
 		ctx->log(RC_LOG_ERROR, "rcBuildCompactHeightfield: Heightfield has too many layers %d (max: %d)",
 				 tooHighNeighbour, MAX_LAYERS);
 	}
+}
+
+/// @par
+///
+/// This is just the beginning of the process of fully building a compact heightfield.
+/// Various filters may be applied applied, then the distance field and regions built.
+/// E.g: #rcBuildDistanceField and #rcBuildRegions
+///
+/// See the #rcConfig documentation for more information on the configuration parameters.
+///
+/// @see rcAllocCompactHeightfield, rcHeightfield, rcCompactHeightfield, rcConfig
+bool rcBuildCompactHeightfield(rcContext* ctx, const int walkableHeight, const int walkableClimb,
+							   rcHeightfield& hf, rcCompactHeightfield& chf)
+{
+	rcAssert(ctx);
+	
+	ctx->startTimer(RC_TIMER_BUILD_COMPACTHEIGHTFIELD);
+	
+	const int w = hf.width;
+	const int h = hf.height;
+	const int spanCount = rcGetHeightFieldSpanCount(ctx, hf);
+	
+	if (!initCompactHeightfield(ctx, walkableHeight, walkableClimb, w, h, hf.bmin, hf.bmax, hf.cs, hf.ch, spanCount, chf))
+		return false;
+	
+	const int MAX_HEIGHT = 0xffff;
+	
+	// Fill in cells and spans.
+	int idx = 0;
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			const rcSpan* s = hf.spans[x + y*w];
+			// If there are no spans at this cell, just leave the data to index=0, count=0.
+			if (!s) continue;
+			rcCompactCell& c = chf.cells[x+y*w];
+			c.index = idx;
+			c.count = 0;
+			while (s)
+			{
+				if (s->area != RC_NULL_AREA)
+				{
+					const int bot = (int)s->smax;
+					const int top = s->next ? (int)s->next->smin : MAX_HEIGHT;
+					chf.spans[idx].y = (unsigned short)rcClamp(bot, 0, 0xffff);
+					chf.spans[idx].h = (unsigned char)rcClamp(top - bot, 0, 0xff);
+					chf.areas[idx] = s->area;
+					idx++;
+					c.count++;
+				}
+				s = s->next;
+			}
+		}
+	}
+	
+	buildCompactConnections(ctx, walkableHeight, walkableClimb, chf);
 		
 	ctx->stopTimer(RC_TIMER_BUILD_COMPACTHEIGHTFIELD);
 	
 	return true;
 }
 
+/// @par
+///
+/// Gives the same compact heightfield as the rcHeightfield overload, when the packed
+/// heightfield was built from that heightfield and the same filters were applied.
+///
+/// @see rcBuildPackedHeightfield, rcAllocCompactHeightfield, rcCompactHeightfield, rcConfig
+bool rcBuildCompactHeightfield(rcContext* ctx, const int walkableHeight, const int walkableClimb,
+							   const rcPackedHeightfield& phf, rcCompactHeightfield& chf)
+{
+	rcAssert(ctx);
+	
+	ctx->startTimer(RC_TIMER_BUILD_COMPACTHEIGHTFIELD);
+	
+	const int w = phf.width;
+	const int h = phf.height;
+	const int spanCount = rcGetHeightFieldSpanCount(ctx, phf);
+	
+	if (!initCompactHeightfield(ctx, walkableHeight, walkableClimb, w, h, phf.bmin, phf.bmax, phf.cs, phf.ch, spanCount, chf))
+		return false;
+	
+	const int MAX_HEIGHT = 0xffff;
+	
+	// Fill in cells and spans.
+	int idx = 0;
+	for (int i = 0; i < w*h; ++i)
+	{
+		const int first = (int)phf.cells[i];
+		const int last = (int)phf.cells[i+1];
+		// If there are no spans at this cell, just leave the data to index=0, count=0.
+		if (first == last) continue;
+		rcCompactCell& c = chf.cells[i];
+		c.index = idx;
+		c.count = 0;
+		for (int j = first; j < last; ++j)
+		{
+			const rcPackedSpan& s = phf.spans[j];
+			if (s.area != RC_NULL_AREA)
+			{
+				const int bot = (int)s.smax;
+				const int top = j+1 < last ? (int)phf.spans[j+1].smin : MAX_HEIGHT;
+				chf.spans[idx].y = (unsigned short)rcClamp(bot, 0, 0xffff);
+				chf.spans[idx].h = (unsigned char)rcClamp(top - bot, 0, 0xff);
+				chf.areas[idx] = s.area;
+				idx++;
+				c.count++;
+			}
+		}
+	}
+	
+	buildCompactConnections(ctx, walkableHeight, walkableClimb, chf);
+	
+	ctx->stopTimer(RC_TIMER_BUILD_COMPACTHEIGHTFIELD);
+	
+	return true;
+}
+
+/// @par
+///
+/// A copy of the compact heightfield taken after the filtering and the erosion
+/// can be kept per tile, so that a change of the marked areas only needs to
+/// restore the copy and rebuild the tile from the regions on, without
+/// rasterizing the input triangles again.
+///
+/// @see rcAllocCompactHeightfield, rcCompactHeightfield
+bool rcCopyCompactHeightfield(rcContext* ctx, const rcCompactHeightfield& src, rcCompactHeightfield& dst)
+{
+	rcAssert(ctx);
+	
+	// Destination must be empty.
+	rcAssert(dst.cells == 0);
+	rcAssert(dst.spans == 0);
+	rcAssert(dst.dist == 0);
+	rcAssert(dst.areas == 0);
+	
+	dst.width = src.width;
+	dst.height = src.height;
+	dst.spanCount = src.spanCount;
+	dst.walkableHeight = src.walkableHeight;
+	dst.walkableClimb = src.walkableClimb;
+	dst.borderSize = src.borderSize;
+	dst.maxDistance = src.maxDistance;
+	dst.maxRegions = src.maxRegions;
+	rcVcopy(dst.bmin, src.bmin);
+	rcVcopy(dst.bmax, src.bmax);
+	dst.cs = src.cs;
+	dst.ch = src.ch;
+	
+	dst.cells = (rcCompactCell*)rcAlloc(sizeof(rcCompactCell)*src.width*src.height, RC_ALLOC_PERM);
+	if (!dst.cells)
+	{
+		ctx->log(RC_LOG_ERROR, "rcCopyCompactHeightfield: Out of memory 'dst.cells' (%d).", src.width*src.height);
+		return false;
+	}
+	memcpy(dst.cells, src.cells, sizeof(rcCompactCell)*src.width*src.height);
+	
+	dst.spans = (rcCompactSpan*)rcAlloc(sizeof(rcCompactSpan)*src.spanCount, RC_ALLOC_PERM);
+	if (!dst.spans)
+	{
+		ctx->log(RC_LOG_ERROR, "rcCopyCompactHeightfield: Out of memory 'dst.spans' (%d).", src.spanCount);
+		return false;
+	}
+	memcpy(dst.spans, src.spans, sizeof(rcCompactSpan)*src.spanCount);
+	
+	dst.areas = (unsigned char*)rcAlloc(sizeof(unsigned char)*src.spanCount, RC_ALLOC_PERM);
+	if (!dst.areas)
+	{
+		ctx->log(RC_LOG_ERROR, "rcCopyCompactHeightfield: Out of memory 'dst.areas' (%d).", src.spanCount);
+		return false;
+	}
+	memcpy(dst.areas, src.areas, sizeof(unsigned char)*src.spanCount);
+	
+	if (src.dist)
+	{
+		dst.dist = (unsigned short*)rcAlloc(sizeof(unsigned short)*src.spanCount, RC_ALLOC_PERM);
+		if (!dst.dist)
+		{
+			ctx->log(RC_LOG_ERROR, "rcCopyCompactHeightfield: Out of memory 'dst.dist' (%d).", src.spanCount);
+			return false;
+		}
+		memcpy(dst.dist, src.dist, sizeof(unsigned short)*src.spanCount);
+	}
+	
+	return true;
+}
+
 /*
 static int getHeightfieldMemoryUsage(const rcHeightfield& hf)
 {
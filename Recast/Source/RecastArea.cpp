@@ -26,6 +26,229 @@
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
 
+/// The size of the tiles the erosion sweeps are split in. [Units: vx]
+static const int RC_ERODE_TILE_SIZE = 64;
+
+struct rcAreaJob
+{
+	const rcCompactHeightfield* chf;
+	unsigned char* dist;
+	unsigned char* areas;
+	int ntiles;		// The number of tiles along the skewed x-axis.
+	int wave;
+	int firstTile;	// The first tile row of the current wave.
+};
+
+static void markErodeBoundaryRow(void* arg, const int y, const int /*worker*/)
+{
+	const rcAreaJob* job = (const rcAreaJob*)arg;
+	const rcCompactHeightfield& chf = *job->chf;
+	unsigned char* dist = job->dist;
+	const int w = chf.width;
+	
+	for (int x = 0; x < w; ++x)
+	{
+		const rcCompactCell& c = chf.cells[x+y*w];
+		for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+		{
+			if (chf.areas[i] == RC_NULL_AREA)
+			{
+				dist[i] = 0;
+			}
+			else
+			{
+				const rcCompactSpan& s = chf.spans[i];
+				int nc = 0;
+				for (int dir = 0; dir < 4; ++dir)
+				{
+					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
+					{
+						const int nx = x + rcGetDirOffsetX(dir);
+						const int ny = y + rcGetDirOffsetY(dir);
+						const int nidx = (int)chf.cells[nx+ny*w].index + rcGetCon(s, dir);
+						if (chf.areas[nidx] != RC_NULL_AREA)
+						{
+							nc++;
+						}
+					}
+				}
+				// At least one missing neighbour.
+				dist[i] = nc != 4 ? 0 : 0xff;
+			}
+		}
+	}
+}
+
+// Pass 1: the cell depends on its (-1,0), (-1,-1), (0,-1) and (1,-1) neighbours.
+static inline void erodeForward(const rcCompactHeightfield& chf, unsigned char* dist, const int x, const int y)
+{
+	const int w = chf.width;
+	unsigned char nd;
+	const rcCompactCell& c = chf.cells[x+y*w];
+	for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+	{
+		const rcCompactSpan& s = chf.spans[i];
+		
+		if (rcGetCon(s, 0) != RC_NOT_CONNECTED)
+		{
+			// (-1,0)
+			const int ax = x + rcGetDirOffsetX(0);
+			const int ay = y + rcGetDirOffsetY(0);
+			const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 0);
+			const rcCompactSpan& as = chf.spans[ai];
+			nd = (unsigned char)rcMin((int)dist[ai]+2, 255);
+			if (nd < dist[i])
+				dist[i] = nd;
+			
+			// (-1,-1)
+			if (rcGetCon(as, 3) != RC_NOT_CONNECTED)
+			{
+				const int aax = ax + rcGetDirOffsetX(3);
+				const int aay = ay + rcGetDirOffsetY(3);
+				const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 3);
+				nd = (unsigned char)rcMin((int)dist[aai]+3, 255);
+				if (nd < dist[i])
+					dist[i] = nd;
+			}
+		}
+		if (rcGetCon(s, 3) != RC_NOT_CONNECTED)
+		{
+			// (0,-1)
+			const int ax = x + rcGetDirOffsetX(3);
+			const int ay = y + rcGetDirOffsetY(3);
+			const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 3);
+			const rcCompactSpan& as = chf.spans[ai];
+			nd = (unsigned char)rcMin((int)dist[ai]+2, 255);
+			if (nd < dist[i])
+				dist[i] = nd;
+			
+			// (1,-1)
+			if (rcGetCon(as, 2) != RC_NOT_CONNECTED)
+			{
+				const int aax = ax + rcGetDirOffsetX(2);
+				const int aay = ay + rcGetDirOffsetY(2);
+				const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 2);
+				nd = (unsigned char)rcMin((int)dist[aai]+3, 255);
+				if (nd < dist[i])
+					dist[i] = nd;
+			}
+		}
+	}
+}
+
+// Pass 2: the cell depends on its (1,0), (1,1), (0,1) and (-1,1) neighbours.
+static inline void erodeBackward(const rcCompactHeightfield& chf, unsigned char* dist, const int x, const int y)
+{
+	const int w = chf.width;
+	unsigned char nd;
+	const rcCompactCell& c = chf.cells[x+y*w];
+	for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+	{
+		const rcCompactSpan& s = chf.spans[i];
+		
+		if (rcGetCon(s, 2) != RC_NOT_CONNECTED)
+		{
+			// (1,0)
+			const int ax = x + rcGetDirOffsetX(2);
+			const int ay = y + rcGetDirOffsetY(2);
+			const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 2);
+			const rcCompactSpan& as = chf.spans[ai];
+			nd = (unsigned char)rcMin((int)dist[ai]+2, 255);
+			if (nd < dist[i])
+				dist[i] = nd;
+			
+			// (1,1)
+			if (rcGetCon(as, 1) != RC_NOT_CONNECTED)
+			{
+				const int aax = ax + rcGetDirOffsetX(1);
+				const int aay = ay + rcGetDirOffsetY(1);
+				const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 1);
+				nd = (unsigned char)rcMin((int)dist[aai]+3, 255);
+				if (nd < dist[i])
+					dist[i] = nd;
+			}
+		}
+		if (rcGetCon(s, 1) != RC_NOT_CONNECTED)
+		{
+			// (0,1)
+			const int ax = x + rcGetDirOffsetX(1);
+			const int ay = y + rcGetDirOffsetY(1);
+			const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 1);
+			const rcCompactSpan& as = chf.spans[ai];
+			nd = (unsigned char)rcMin((int)dist[ai]+2, 255);
+			if (nd < dist[i])
+				dist[i] = nd;
+			
+			// (-1,1)
+			if (rcGetCon(as, 0) != RC_NOT_CONNECTED)
+			{
+				const int aax = ax + rcGetDirOffsetX(0);
+				const int aay = ay + rcGetDirOffsetY(0);
+				const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 0);
+				nd = (unsigned char)rcMin((int)dist[aai]+3, 255);
+				if (nd < dist[i])
+					dist[i] = nd;
+			}
+		}
+	}
+}
+
+// Sweeps a tile of the skewed grid, like the distance field sweeps of rcBuildDistanceField.
+static void erodeTile(void* arg, const int index, const bool forward)
+{
+	const rcAreaJob* job = (const rcAreaJob*)arg;
+	const rcCompactHeightfield& chf = *job->chf;
+	const int w = chf.width;
+	const int h = chf.height;
+	
+	const int tv = job->firstTile + index;
+	const int tu = job->wave - tv;
+	const int umin = tu*RC_ERODE_TILE_SIZE;
+	const int umax = umin + RC_ERODE_TILE_SIZE;
+	const int vmax = rcMin(h, (tv+1)*RC_ERODE_TILE_SIZE);
+	
+	for (int v = tv*RC_ERODE_TILE_SIZE; v < vmax; ++v)
+	{
+		const int xmin = rcMax(umin - v, 0);
+		const int xmax = rcMin(umax - v, w);
+		if (forward)
+		{
+			for (int x = xmin; x < xmax; ++x)
+				erodeForward(chf, job->dist, x, v);
+		}
+		else
+		{
+			for (int x = xmin; x < xmax; ++x)
+				erodeBackward(chf, job->dist, w-1-x, h-1-v);
+		}
+	}
+}
+
+static void erodeForwardTile(void* arg, const int index, const int /*worker*/)
+{
+	erodeTile(arg, index, true);
+}
+
+static void erodeBackwardTile(void* arg, const int index, const int /*worker*/)
+{
+	erodeTile(arg, index, false);
+}
+
+static void erodeWaves(rcContext* ctx, rcAreaJob& job, rcParallelForFunc* func)
+{
+	const int h = job.chf->height;
+	const int ntv = (h + RC_ERODE_TILE_SIZE-1) / RC_ERODE_TILE_SIZE;
+	
+	for (int wave = 0; wave < job.ntiles + ntv - 1; ++wave)
+	{
+		const int first = rcMax(0, wave - job.ntiles + 1);
+		const int last = rcMin(wave, ntv - 1);
+		job.wave = wave;
+		job.firstTile = first;
+		ctx->parallelFor(func, &job, last - first + 1);
+	}
+}
+
 /// @par 
 /// 
 /// Basically, any spans that are closer to a boundary or obstruction than the specified radius 
@@ -33,6 +256,9 @@
 ///
 /// This method is usually called immediately after the heightfield has been built.
 ///
+/// The boundary marking is split by rows and the distance sweeps run as a wavefront of tiles
+/// when the context has several workers. (See: #rcContext::parallelFor) The result is the same.
+///
 /// @see rcCompactHeightfield, rcBuildCompactHeightfield, rcConfig::walkableRadius
 bool rcErodeWalkableArea(rcContext* ctx, int radius, rcCompactHeightfield& chf)
 {
@@ -50,162 +276,31 @@ bool rcErodeWalkableArea(rcContext* ctx, int radius, rcCompactHeightfield& chf)
 		return false;
 	}
 	
-	// Init distance.
-	memset(dist, 0xff, sizeof(unsigned char)*chf.spanCount);
+	rcAreaJob job;
+	memset(&job, 0, sizeof(job));
+	job.chf = &chf;
+	job.dist = dist;
 	
-	// Mark boundary cells.
-	for (int y = 0; y < h; ++y)
-	{
-		for (int x = 0; x < w; ++x)
-		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				if (chf.areas[i] == RC_NULL_AREA)
-				{
-					dist[i] = 0;
-				}
-				else
-				{
-					const rcCompactSpan& s = chf.spans[i];
-					int nc = 0;
-					for (int dir = 0; dir < 4; ++dir)
-					{
-						if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-						{
-							const int nx = x + rcGetDirOffsetX(dir);
-							const int ny = y + rcGetDirOffsetY(dir);
-							const int nidx = (int)chf.cells[nx+ny*w].index + rcGetCon(s, dir);
-							if (chf.areas[nidx] != RC_NULL_AREA)
-							{
-								nc++;
-							}
-						}
-					}
-					// At least one missing neighbour.
-					if (nc != 4)
-						dist[i] = 0;
-				}
-			}
-		}
-	}
+	// Init distance and mark boundary cells.
+	ctx->parallelFor(markErodeBoundaryRow, &job, h);
 	
-	unsigned char nd;
-	
-	// Pass 1
-	for (int y = 0; y < h; ++y)
+	if (ctx->getWorkerCount() > 1)
 	{
-		for (int x = 0; x < w; ++x)
-		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				const rcCompactSpan& s = chf.spans[i];
-				
-				if (rcGetCon(s, 0) != RC_NOT_CONNECTED)
-				{
-					// (-1,0)
-					const int ax = x + rcGetDirOffsetX(0);
-					const int ay = y + rcGetDirOffsetY(0);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 0);
-					const rcCompactSpan& as = chf.spans[ai];
-					nd = (unsigned char)rcMin((int)dist[ai]+2, 255);
-					if (nd < dist[i])
-						dist[i] = nd;
-					
-					// (-1,-1)
-					if (rcGetCon(as, 3) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(3);
-						const int aay = ay + rcGetDirOffsetY(3);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 3);
-						nd = (unsigned char)rcMin((int)dist[aai]+3, 255);
-						if (nd < dist[i])
-							dist[i] = nd;
-					}
-				}
-				if (rcGetCon(s, 3) != RC_NOT_CONNECTED)
-				{
-					// (0,-1)
-					const int ax = x + rcGetDirOffsetX(3);
-					const int ay = y + rcGetDirOffsetY(3);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 3);
-					const rcCompactSpan& as = chf.spans[ai];
-					nd = (unsigned char)rcMin((int)dist[ai]+2, 255);
-					if (nd < dist[i])
-						dist[i] = nd;
-					
-					// (1,-1)
-					if (rcGetCon(as, 2) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(2);
-						const int aay = ay + rcGetDirOffsetY(2);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 2);
-						nd = (unsigned char)rcMin((int)dist[aai]+3, 255);
-						if (nd < dist[i])
-							dist[i] = nd;
-					}
-				}
-			}
-		}
+		job.ntiles = (w + h - 1 + RC_ERODE_TILE_SIZE-1) / RC_ERODE_TILE_SIZE;
+		erodeWaves(ctx, job, erodeForwardTile);
+		erodeWaves(ctx, job, erodeBackwardTile);
 	}
-	
-	// Pass 2
-	for (int y = h-1; y >= 0; --y)
+	else
 	{
-		for (int x = w-1; x >= 0; --x)
-		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				const rcCompactSpan& s = chf.spans[i];
-				
-				if (rcGetCon(s, 2) != RC_NOT_CONNECTED)
-				{
-					// (1,0)
-					const int ax = x + rcGetDirOffsetX(2);
-					const int ay = y + rcGetDirOffsetY(2);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 2);
-					const rcCompactSpan& as = chf.spans[ai];
-					nd = (unsigned char)rcMin((int)dist[ai]+2, 255);
-					if (nd < dist[i])
-						dist[i] = nd;
-					
-					// (1,1)
-					if (rcGetCon(as, 1) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(1);
-						const int aay = ay + rcGetDirOffsetY(1);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 1);
-						nd = (unsigned char)rcMin((int)dist[aai]+3, 255);
-						if (nd < dist[i])
-							dist[i] = nd;
-					}
-				}
-				if (rcGetCon(s, 1) != RC_NOT_CONNECTED)
-				{
-					// (0,1)
-					const int ax = x + rcGetDirOffsetX(1);
-					const int ay = y + rcGetDirOffsetY(1);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 1);
-					const rcCompactSpan& as = chf.spans[ai];
-					nd = (unsigned char)rcMin((int)dist[ai]+2, 255);
-					if (nd < dist[i])
-						dist[i] = nd;
-					
-					// (-1,1)
-					if (rcGetCon(as, 0) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(0);
-						const int aay = ay + rcGetDirOffsetY(0);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 0);
-						nd = (unsigned char)rcMin((int)dist[aai]+3, 255);
-						if (nd < dist[i])
-							dist[i] = nd;
-					}
-				}
-			}
-		}
+		// Pass 1
+		for (int y = 0; y < h; ++y)
+			for (int x = 0; x < w; ++x)
+				erodeForward(chf, dist, x, y);
+		
+		// Pass 2
+		for (int y = h-1; y >= 0; --y)
+			for (int x = w-1; x >= 0; --x)
+				erodeBackward(chf, dist, x, y);
 	}
 	
 	const unsigned char thr = (unsigned char)(radius*2);
@@ -232,19 +327,79 @@ static void insertSort(unsigned char* a, const int n)
 	}
 }
 
+static void medianFilterRow(void* arg, const int y, const int /*worker*/)
+{
+	const rcAreaJob* job = (const rcAreaJob*)arg;
+	const rcCompactHeightfield& chf = *job->chf;
+	unsigned char* areas = job->areas;
+	const int w = chf.width;
+	
+	for (int x = 0; x < w; ++x)
+	{
+		const rcCompactCell& c = chf.cells[x+y*w];
+		for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+		{
+			const rcCompactSpan& s = chf.spans[i];
+			if (chf.areas[i] == RC_NULL_AREA)
+			{
+				areas[i] = chf.areas[i];
+				continue;
+			}
+			
+			unsigned char nei[9];
+			for (int j = 0; j < 9; ++j)
+				nei[j] = chf.areas[i];
+			
+			bool uniform = true;
+			for (int dir = 0; dir < 4; ++dir)
+			{
+				if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
+				{
+					const int ax = x + rcGetDirOffsetX(dir);
+					const int ay = y + rcGetDirOffsetY(dir);
+					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
+					if (chf.areas[ai] != RC_NULL_AREA)
+						nei[dir*2+0] = chf.areas[ai];
+					
+					const rcCompactSpan& as = chf.spans[ai];
+					const int dir2 = (dir+1) & 0x3;
+					if (rcGetCon(as, dir2) != RC_NOT_CONNECTED)
+					{
+						const int ax2 = ax + rcGetDirOffsetX(dir2);
+						const int ay2 = ay + rcGetDirOffsetY(dir2);
+						const int ai2 = (int)chf.cells[ax2+ay2*w].index + rcGetCon(as, dir2);
+						if (chf.areas[ai2] != RC_NULL_AREA)
+							nei[dir*2+1] = chf.areas[ai2];
+					}
+					uniform = uniform && nei[dir*2+0] == nei[8] && nei[dir*2+1] == nei[8];
+				}
+			}
+			
+			// Most spans are surrounded by their own area, which is then the median.
+			if (uniform)
+			{
+				areas[i] = nei[8];
+				continue;
+			}
+			insertSort(nei, 9);
+			areas[i] = nei[4];
+		}
+	}
+}
+
 /// @par
 ///
 /// This filter is usually applied after applying area id's using functions
 /// such as #rcMarkBoxArea, #rcMarkConvexPolyArea, and #rcMarkCylinderArea.
+///
+/// The rows are filtered concurrently when the context has several workers.
+/// (See: #rcContext::parallelFor)
 /// 
 /// @see rcCompactHeightfield
 bool rcMedianFilterWalkableArea(rcContext* ctx, rcCompactHeightfield& chf)
 {
 	rcAssert(ctx);
 	
-	const int w = chf.width;
-	const int h = chf.height;
-	
 	ctx->startTimer(RC_TIMER_MEDIAN_AREA);
 	
 	unsigned char* areas = (unsigned char*)rcAlloc(sizeof(unsigned char)*chf.spanCount, RC_ALLOC_TEMP);
@@ -254,54 +409,13 @@ bool rcMedianFilterWalkableArea(rcContext* ctx, rcCompactHeightfield& chf)
 		return false;
 	}
 	
-	// Init distance.
-	memset(areas, 0xff, sizeof(unsigned char)*chf.spanCount);
+	rcAreaJob job;
+	memset(&job, 0, sizeof(job));
+	job.chf = &chf;
+	job.areas = areas;
 	
-	for (int y = 0; y < h; ++y)
-	{
-		for (int x = 0; x < w; ++x)
-		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				const rcCompactSpan& s = chf.spans[i];
-				if (chf.areas[i] == RC_NULL_AREA)
-				{
-					areas[i] = chf.areas[i];
-					continue;
-				}
-				
-				unsigned char nei[9];
-				for (int j = 0; j < 9; ++j)
-					nei[j] = chf.areas[i];
-				
-				for (int dir = 0; dir < 4; ++dir)
-				{
-					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-					{
-						const int ax = x + rcGetDirOffsetX(dir);
-						const int ay = y + rcGetDirOffsetY(dir);
-						const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
-						if (chf.areas[ai] != RC_NULL_AREA)
-							nei[dir*2+0] = chf.areas[ai];
-						
-						const rcCompactSpan& as = chf.spans[ai];
-						const int dir2 = (dir+1) & 0x3;
-						if (rcGetCon(as, dir2) != RC_NOT_CONNECTED)
-						{
-							const int ax2 = ax + rcGetDirOffsetX(dir2);
-							const int ay2 = ay + rcGetDirOffsetY(dir2);
-							const int ai2 = (int)chf.cells[ax2+ay2*w].index + rcGetCon(as, dir2);
-							if (chf.areas[ai2] != RC_NULL_AREA)
-								nei[dir*2+1] = chf.areas[ai2];
-						}
-					}
-				}
-				insertSort(nei, 9);
-				areas[i] = nei[4];
-			}
-		}
-	}
+	// The rows only read chf.areas, so they are filtered independently.
+	ctx->parallelFor(medianFilterRow, &job, chf.height);
 	
 	memcpy(chf.areas, areas, sizeof(unsigned char)*chf.spanCount);
 	
@@ -377,12 +491,98 @@ static int pointInPoly(int nvert, const float* verts, const float* p)
 	return c;
 }
 
+/// The maximum number of polygon edges crossing a row that #rcMarkConvexPolyArea tracks.
+static const int RC_MAX_ROW_CROSSINGS = 32;
+
+struct rcMarkPolyJob
+{
+	rcCompactHeightfield* chf;
+	const float* verts;
+	int nverts;
+	int minx, maxx;
+	int miny, maxy;
+	int minz;
+	unsigned char areaId;
+};
+
+static void markConvexPolyRow(void* arg, const int index, const int /*worker*/)
+{
+	const rcMarkPolyJob* job = (const rcMarkPolyJob*)arg;
+	rcCompactHeightfield& chf = *job->chf;
+	const float* verts = job->verts;
+	const int nverts = job->nverts;
+	const int z = job->minz + index;
+	
+	float p[3];
+	p[0] = 0;
+	p[1] = 0;
+	p[2] = chf.bmin[2] + (z+0.5f)*chf.cs; 
+	
+	// Find where the edges cross the row, in the same way as pointInPoly(),
+	// so that the inside test of each cell reduces to counting the crossings.
+	float cross[RC_MAX_ROW_CROSSINGS];
+	int ncross = 0;
+	bool overflow = false;
+	for (int i = 0, j = nverts-1; i < nverts; j = i++)
+	{
+		const float* vi = &verts[i*3];
+		const float* vj = &verts[j*3];
+		if ((vi[2] > p[2]) != (vj[2] > p[2]))
+		{
+			if (ncross < RC_MAX_ROW_CROSSINGS)
+				cross[ncross++] = (vj[0]-vi[0]) * (p[2]-vi[2]) / (vj[2]-vi[2]) + vi[0];
+			else
+				overflow = true;
+		}
+	}
+	if (ncross == 0)
+		return;
+	
+	for (int x = job->minx; x <= job->maxx; ++x)
+	{
+		const rcCompactCell& c = chf.cells[x+z*chf.width];
+		int inside = -1;
+		for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+		{
+			rcCompactSpan& s = chf.spans[i];
+			if (chf.areas[i] == RC_NULL_AREA)
+				continue;
+			if ((int)s.y >= job->miny && (int)s.y <= job->maxy)
+			{
+				if (inside == -1)
+				{
+					p[0] = chf.bmin[0] + (x+0.5f)*chf.cs; 
+					if (overflow)
+					{
+						inside = pointInPoly(nverts, verts, p);
+					}
+					else
+					{
+						inside = 0;
+						for (int k = 0; k < ncross; ++k)
+							if (p[0] < cross[k])
+								inside = !inside;
+					}
+				}
+				
+				if (inside)
+				{
+					chf.areas[i] = job->areaId;
+				}
+			}
+		}
+	}
+}
+
 /// @par
 ///
 /// The value of spacial parameters are in world units.
 /// 
 /// The y-values of the polygon vertices are ignored. So the polygon is effectively 
 /// projected onto the xz-plane at @p hmin, then extruded to @p hmax.
+///
+/// The polygon edges crossing each row are found once per row, and the rows are
+/// marked concurrently when the context has several workers. (See: #rcContext::parallelFor)
 /// 
 /// @see rcCompactHeightfield, rcMedianFilterWalkableArea
 void rcMarkConvexPolyArea(rcContext* ctx, const float* verts, const int nverts,
@@ -421,33 +621,19 @@ void rcMarkConvexPolyArea(rcContext* ctx, const float* verts, const int nverts,
 	if (minz < 0) minz = 0;
 	if (maxz >= chf.height) maxz = chf.height-1;	
 	
-	
-	// TODO: Optimize.
-	for (int z = minz; z <= maxz; ++z)
-	{
-		for (int x = minx; x <= maxx; ++x)
-		{
-			const rcCompactCell& c = chf.cells[x+z*chf.width];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				rcCompactSpan& s = chf.spans[i];
-				if (chf.areas[i] == RC_NULL_AREA)
-					continue;
-				if ((int)s.y >= miny && (int)s.y <= maxy)
-				{
-					float p[3];
-					p[0] = chf.bmin[0] + (x+0.5f)*chf.cs; 
-					p[1] = 0;
-					p[2] = chf.bmin[2] + (z+0.5f)*chf.cs; 
-
-					if (pointInPoly(nverts, verts, p))
-					{
-						chf.areas[i] = areaId;
-					}
-				}
-			}
-		}
-	}
+	rcMarkPolyJob job;
+	job.chf = &chf;
+	job.verts = verts;
+	job.nverts = nverts;
+	job.minx = minx;
+	job.maxx = maxx;
+	job.miny = miny;
+	job.maxy = maxy;
+	job.minz = minz;
+	job.areaId = areaId;
+	
+	// Each row only writes the areas of its own spans.
+	ctx->parallelFor(markConvexPolyRow, &job, maxz - minz + 1);
 
 	ctx->stopTimer(RC_TIMER_MARK_CONVEXPOLY_AREA);
 }
@@ -20,6 +20,8 @@
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <new>
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
@@ -590,6 +592,284 @@ static bool mergeContours(rcContour& ca, rcContour& cb, int ia, int ib)
 	return true;
 }
 
+static bool addContour(rcContext* ctx, rcContourSet& cset, int& maxContours,
+					   const int* verts, const int nverts, const int* rverts, const int nrverts,
+					   const unsigned short reg, const unsigned char area)
+{
+	const int borderSize = cset.borderSize;
+	
+	if (cset.nconts >= maxContours)
+	{
+		// Allocate more contours.
+		// This can happen when there are tiny holes in the heightfield.
+		const int oldMax = maxContours;
+		maxContours *= 2;
+		rcContour* newConts = (rcContour*)rcAlloc(sizeof(rcContour)*maxContours, RC_ALLOC_PERM);
+		for (int j = 0; j < cset.nconts; ++j)
+		{
+			newConts[j] = cset.conts[j];
+			// Reset source pointers to prevent data deletion.
+			cset.conts[j].verts = 0;
+			cset.conts[j].rverts = 0;
+		}
+		rcFree(cset.conts);
+		cset.conts = newConts;
+	
+		ctx->log(RC_LOG_WARNING, "rcBuildContours: Expanding max contours from %d to %d.", oldMax, maxContours);
+	}
+		
+	rcContour* cont = &cset.conts[cset.nconts++];
+	
+	cont->nverts = nverts;
+	cont->verts = (int*)rcAlloc(sizeof(int)*cont->nverts*4, RC_ALLOC_PERM);
+	if (!cont->verts)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'verts' (%d).", cont->nverts);
+		return false;
+	}
+	memcpy(cont->verts, verts, sizeof(int)*cont->nverts*4);
+	if (borderSize > 0)
+	{
+		// If the heightfield was build with bordersize, remove the offset.
+		for (int j = 0; j < cont->nverts; ++j)
+		{
+			int* v = &cont->verts[j*4];
+			v[0] -= borderSize;
+			v[2] -= borderSize;
+		}
+	}
+	
+	cont->nrverts = nrverts;
+	cont->rverts = (int*)rcAlloc(sizeof(int)*cont->nrverts*4, RC_ALLOC_PERM);
+	if (!cont->rverts)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'rverts' (%d).", cont->nrverts);
+		return false;
+	}
+	memcpy(cont->rverts, rverts, sizeof(int)*cont->nrverts*4);
+	if (borderSize > 0)
+	{
+		// If the heightfield was build with bordersize, remove the offset.
+		for (int j = 0; j < cont->nrverts; ++j)
+		{
+			int* v = &cont->rverts[j*4];
+			v[0] -= borderSize;
+			v[2] -= borderSize;
+		}
+	}
+	
+	cont->reg = reg;
+	cont->area = area;
+	
+	return true;
+}
+
+struct rcContourWorker
+{
+	rcIntArray verts;
+	rcIntArray simplified;
+	rcIntArray traced;		// (order, reg, area, nverts, nrverts, verts, rverts) per traced contour.
+};
+
+struct rcContourJob
+{
+	rcCompactHeightfield* chf;
+	unsigned char* flags;
+	float maxError;
+	int maxEdgeLen;
+	int buildFlags;
+	const int* regStart;	// The first start candidate of each region.
+	const int* cands;		// (x, y, span, order) per start candidate, grouped by region in scan order.
+	rcContourWorker* workers;
+};
+
+static void markBoundaryRow(void* arg, const int y, const int /*worker*/)
+{
+	const rcContourJob* job = (const rcContourJob*)arg;
+	const rcCompactHeightfield& chf = *job->chf;
+	unsigned char* flags = job->flags;
+	const int w = chf.width;
+	
+	for (int x = 0; x < w; ++x)
+	{
+		const rcCompactCell& c = chf.cells[x+y*w];
+		for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+		{
+			unsigned char res = 0;
+			const rcCompactSpan& s = chf.spans[i];
+			if (!chf.spans[i].reg || (chf.spans[i].reg & RC_BORDER_REG))
+			{
+				flags[i] = 0;
+				continue;
+			}
+			for (int dir = 0; dir < 4; ++dir)
+			{
+				unsigned short r = 0;
+				if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
+				{
+					const int ax = x + rcGetDirOffsetX(dir);
+					const int ay = y + rcGetDirOffsetY(dir);
+					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
+					r = chf.spans[ai].reg;
+				}
+				if (r == chf.spans[i].reg)
+					res |= (1 << dir);
+			}
+			flags[i] = res ^ 0xf; // Inverse, mark non connected edges.
+		}
+	}
+}
+
+static void traceRegionContours(void* arg, const int reg, const int worker)
+{
+	const rcContourJob* job = (const rcContourJob*)arg;
+	rcCompactHeightfield& chf = *job->chf;
+	unsigned char* flags = job->flags;
+	rcContourWorker& wk = job->workers[worker];
+	
+	for (int j = job->regStart[reg]; j < job->regStart[reg+1]; ++j)
+	{
+		const int* cand = &job->cands[j*4];
+		const int i = cand[2];
+		// The edges may have been visited by an earlier contour of the region.
+		if (flags[i] == 0)
+			continue;
+		
+		wk.verts.resize(0);
+		wk.simplified.resize(0);
+		walkContour(cand[0], cand[1], i, chf, flags, wk.verts);
+		simplifyContour(wk.verts, wk.simplified, job->maxError, job->maxEdgeLen, job->buildFlags);
+		removeDegenerateSegments(wk.simplified);
+		
+		const int nverts = wk.simplified.size()/4;
+		const int nrverts = wk.verts.size()/4;
+		if (nverts < 3)
+			continue;
+		
+		rcIntArray& traced = wk.traced;
+		const int base = traced.size();
+		traced.resize(base + 5 + (nverts+nrverts)*4);
+		traced[base+0] = cand[3];
+		traced[base+1] = reg;
+		traced[base+2] = chf.areas[i];
+		traced[base+3] = nverts;
+		traced[base+4] = nrverts;
+		memcpy(&traced[base+5], &wk.simplified[0], sizeof(int)*nverts*4);
+		memcpy(&traced[base+5+nverts*4], &wk.verts[0], sizeof(int)*nrverts*4);
+	}
+}
+
+static int compareTracedOrder(const void* a, const void* b)
+{
+	const int oa = *(const int*)a;
+	const int ob = *(const int*)b;
+	return oa < ob ? -1 : (oa > ob ? 1 : 0);
+}
+
+// Traces the contours of the regions in parallel. The contours of a region only
+// visit the spans of that region, so each region is traced by a single worker,
+// starting from its boundary spans in scan order. The traced contours are then
+// added to the set in the order the serial scan would have found them.
+// Returns false without touching the flags if the regions can not be traced in parallel.
+static bool traceContoursParallel(rcContext* ctx, rcCompactHeightfield& chf, rcContourJob& job,
+								  rcContourSet& cset, int& maxContours, bool& failed)
+{
+	const int w = chf.width;
+	const int h = chf.height;
+	const int nreg = (int)chf.maxRegions+1;
+	unsigned char* flags = job.flags;
+	
+	// Find the spans which can start a contour, and bin them by region.
+	rcScopedDelete<int> regStart = (int*)rcAlloc(sizeof(int)*(nreg+1), RC_ALLOC_TEMP);
+	if (!regStart)
+		return false;
+	memset((int*)regStart, 0, sizeof(int)*(nreg+1));
+	int ncands = 0;
+	for (int i = 0; i < chf.spanCount; ++i)
+	{
+		if (flags[i] == 0 || flags[i] == 0xf)
+			continue;
+		const int reg = (int)chf.spans[i].reg;
+		if (reg >= nreg)
+			return false;
+		regStart[reg+1]++;
+		ncands++;
+	}
+	for (int r = 0; r < nreg; ++r)
+		regStart[r+1] += regStart[r];
+	
+	rcScopedDelete<int> cands = (int*)rcAlloc(sizeof(int)*rcMax(ncands, 1)*4, RC_ALLOC_TEMP);
+	rcScopedDelete<int> next = (int*)rcAlloc(sizeof(int)*nreg, RC_ALLOC_TEMP);
+	const int nworkers = ctx->getWorkerCount();
+	rcContourWorker* workers = (rcContourWorker*)rcAlloc(sizeof(rcContourWorker)*nworkers, RC_ALLOC_TEMP);
+	if (!cands || !next || !workers)
+	{
+		rcFree(workers);
+		return false;
+	}
+	memcpy((int*)next, (int*)regStart, sizeof(int)*nreg);
+	int order = 0;
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			const rcCompactCell& c = chf.cells[x+y*w];
+			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			{
+				if (flags[i] == 0 || flags[i] == 0xf)
+				{
+					flags[i] = 0;
+					continue;
+				}
+				int* cand = &cands[next[chf.spans[i].reg]++ * 4];
+				cand[0] = x;
+				cand[1] = y;
+				cand[2] = i;
+				cand[3] = order++;
+			}
+		}
+	}
+	
+	for (int i = 0; i < nworkers; ++i)
+		new(&workers[i]) rcContourWorker;
+	
+	job.regStart = regStart;
+	job.cands = cands;
+	job.workers = workers;
+	ctx->parallelFor(traceRegionContours, &job, nreg);
+	
+	// Sort the traced contours in scan order.
+	rcIntArray traced;
+	for (int i = 0; i < nworkers; ++i)
+	{
+		const rcIntArray& wt = workers[i].traced;
+		for (int j = 0; j < wt.size(); j += 5 + (wt[j+3]+wt[j+4])*4)
+		{
+			traced.push(wt[j]);
+			traced.push(i);
+			traced.push(j);
+		}
+	}
+	if (traced.size() > 0)
+		qsort(&traced[0], traced.size()/3, sizeof(int)*3, compareTracedOrder);
+	
+	for (int i = 0; i < traced.size() && !failed; i += 3)
+	{
+		const int* t = &workers[traced[i+1]].traced[traced[i+2]];
+		const int nverts = t[3];
+		const int nrverts = t[4];
+		if (!addContour(ctx, cset, maxContours, &t[5], nverts, &t[5+nverts*4], nrverts,
+						(unsigned short)t[1], (unsigned char)t[2]))
+			failed = true;
+	}
+	
+	for (int i = 0; i < nworkers; ++i)
+		workers[i].~rcContourWorker();
+	rcFree(workers);
+	
+	return true;
+}
+
 /// @par
 ///
 /// The raw contours will match the region outlines exactly. The @p maxError and @p maxEdgeLen
@@ -599,6 +879,11 @@ static bool mergeContours(rcContour& ca, rcContour& cb, int ia, int ib)
 /// (They are considered mandatory vertices.)
 ///
 /// Setting @p maxEdgeLength to zero will disabled the edge length feature.
+///
+/// When the context provides several workers, the regions are traced and simplified in
+/// parallel. (See: #rcContext::parallelFor) The contours are the same, and in the same order,
+/// as when they are built sequentially, but the simplification time is then included in
+/// the #RC_TIMER_BUILD_CONTOURS_TRACE timer.
 /// 
 /// See the #rcConfig documentation for more information on the configuration parameters.
 /// 
@@ -648,46 +933,32 @@ bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 	ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
 	
 	// Mark boundaries.
-	for (int y = 0; y < h; ++y)
-	{
-		for (int x = 0; x < w; ++x)
-		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				unsigned char res = 0;
-				const rcCompactSpan& s = chf.spans[i];
-				if (!chf.spans[i].reg || (chf.spans[i].reg & RC_BORDER_REG))
-				{
-					flags[i] = 0;
-					continue;
-				}
-				for (int dir = 0; dir < 4; ++dir)
-				{
-					unsigned short r = 0;
-					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-					{
-						const int ax = x + rcGetDirOffsetX(dir);
-						const int ay = y + rcGetDirOffsetY(dir);
-						const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
-						r = chf.spans[ai].reg;
-					}
-					if (r == chf.spans[i].reg)
-						res |= (1 << dir);
-				}
-				flags[i] = res ^ 0xf; // Inverse, mark non connected edges.
-			}
-		}
-	}
+	rcContourJob job;
+	memset(&job, 0, sizeof(job));
+	job.chf = &chf;
+	job.flags = flags;
+	job.maxError = maxError;
+	job.maxEdgeLen = maxEdgeLen;
+	job.buildFlags = buildFlags;
+	ctx->parallelFor(markBoundaryRow, &job, h);
 	
 	ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
 	
+	bool failed = false;
+	bool traced = false;
+	if (ctx->getWorkerCount() > 1)
+	{
+		ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+		traced = traceContoursParallel(ctx, chf, job, cset, maxContours, failed);
+		ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+	}
+	
 	rcIntArray verts(256);
 	rcIntArray simplified(64);
 	
-	for (int y = 0; y < h; ++y)
+	for (int y = 0; y < h && !traced && !failed; ++y)
 	{
-		for (int x = 0; x < w; ++x)
+		for (int x = 0; x < w && !failed; ++x)
 		{
 			const rcCompactCell& c = chf.cells[x+y*w];
 			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
@@ -719,84 +990,20 @@ bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 				// Create contour.
 				if (simplified.size()/4 >= 3)
 				{
-					if (cset.nconts >= maxContours)
+					if (!addContour(ctx, cset, maxContours, &simplified[0], simplified.size()/4,
+									&verts[0], verts.size()/4, reg, area))
 					{
-						// Allocate more contours.
-						// This can happen when there are tiny holes in the heightfield.
-						const int oldMax = maxContours;
-						maxContours *= 2;
-						rcContour* newConts = (rcContour*)rcAlloc(sizeof(rcContour)*maxContours, RC_ALLOC_PERM);
-						for (int j = 0; j < cset.nconts; ++j)
-						{
-							newConts[j] = cset.conts[j];
-							// Reset source pointers to prevent data deletion.
-							cset.conts[j].verts = 0;
-							cset.conts[j].rverts = 0;
-						}
-						rcFree(cset.conts);
-						cset.conts = newConts;
-					
-						ctx->log(RC_LOG_WARNING, "rcBuildContours: Expanding max contours from %d to %d.", oldMax, maxContours);
-					}
-						
-					rcContour* cont = &cset.conts[cset.nconts++];
-					
-					cont->nverts = simplified.size()/4;
-					cont->verts = (int*)rcAlloc(sizeof(int)*cont->nverts*4, RC_ALLOC_PERM);
-					if (!cont->verts)
-					{
-						ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'verts' (%d).", cont->nverts);
-						return false;
-					}
-					memcpy(cont->verts, &simplified[0], sizeof(int)*cont->nverts*4);
-					if (borderSize > 0)
-					{
-						// If the heightfield was build with bordersize, remove the offset.
-						for (int j = 0; j < cont->nverts; ++j)
-						{
-							int* v = &cont->verts[j*4];
-							v[0] -= borderSize;
-							v[2] -= borderSize;
-						}
-					}
-					
-					cont->nrverts = verts.size()/4;
-					cont->rverts = (int*)rcAlloc(sizeof(int)*cont->nrverts*4, RC_ALLOC_PERM);
-					if (!cont->rverts)
-					{
-						ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'rverts' (%d).", cont->nrverts);
-						return false;
-					}
-					memcpy(cont->rverts, &verts[0], sizeof(int)*cont->nrverts*4);
-					if (borderSize > 0)
-					{
-						// If the heightfield was build with bordersize, remove the offset.
-						for (int j = 0; j < cont->nrverts; ++j)
-						{
-							int* v = &cont->rverts[j*4];
-							v[0] -= borderSize;
-							v[2] -= borderSize;
-						}
-					}
-					
-/*					cont->cx = cont->cy = cont->cz = 0;
-					for (int i = 0; i < cont->nverts; ++i)
-					{
-						cont->cx += cont->verts[i*4+0];
-						cont->cy += cont->verts[i*4+1];
-						cont->cz += cont->verts[i*4+2];
+						failed = true;
+						break;
 					}
-					cont->cx /= cont->nverts;
-					cont->cy /= cont->nverts;
-					cont->cz /= cont->nverts;*/
-					
-					cont->reg = reg;
-					cont->area = area;
 				}
 			}
 		}
 	}
 	
+	if (failed)
+		return false;
+	
 	// Check and merge droppings.
 	// Sometimes the previous algorithms can fail and create several contours
 	// per area. This pass will try to merge the holes into the main region.
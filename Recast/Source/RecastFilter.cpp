@@ -205,3 +205,171 @@ void rcFilterWalkableLowHeightSpans(rcContext* ctx, int walkableHeight, rcHeight
 	
 	ctx->stopTimer(RC_TIMER_FILTER_WALKABLE);
 }
+
+/// @par
+///
+/// Gives the same result as the rcHeightfield overload.
+///
+/// @see rcPackedHeightfield, rcConfig
+void rcFilterLowHangingWalkableObstacles(rcContext* ctx, const int walkableClimb, rcPackedHeightfield& solid)
+{
+	rcAssert(ctx);
+
+	ctx->startTimer(RC_TIMER_FILTER_LOW_OBSTACLES);
+	
+	const int ncells = solid.width*solid.height;
+	
+	for (int i = 0; i < ncells; ++i)
+	{
+		bool previousWalkable = false;
+		unsigned char previousArea = RC_NULL_AREA;
+		
+		for (int j = (int)solid.cells[i], nj = (int)solid.cells[i+1]; j < nj; ++j)
+		{
+			rcPackedSpan& s = solid.spans[j];
+			const bool walkable = s.area != RC_NULL_AREA;
+			// If current span is not walkable, but there is walkable
+			// span just below it, mark the span above it walkable too.
+			if (!walkable && previousWalkable)
+			{
+				if (rcAbs((int)s.smax - (int)solid.spans[j-1].smax) <= walkableClimb)
+					s.area = previousArea;
+			}
+			// Copy walkable flag so that it cannot propagate
+			// past multiple non-walkable objects.
+			previousWalkable = walkable;
+			previousArea = (unsigned char)s.area;
+		}
+	}
+
+	ctx->stopTimer(RC_TIMER_FILTER_LOW_OBSTACLES);
+}
+
+/// @par
+///
+/// Gives the same result as the rcHeightfield overload.
+///
+/// @see rcPackedHeightfield, rcConfig
+void rcFilterLedgeSpans(rcContext* ctx, const int walkableHeight, const int walkableClimb,
+						rcPackedHeightfield& solid)
+{
+	rcAssert(ctx);
+	
+	ctx->startTimer(RC_TIMER_FILTER_BORDER);
+
+	const int w = solid.width;
+	const int h = solid.height;
+	const int MAX_HEIGHT = 0xffff;
+	
+	// Mark border spans.
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			const int last = (int)solid.cells[x + y*w + 1];
+			for (int i = (int)solid.cells[x + y*w]; i < last; ++i)
+			{
+				rcPackedSpan& s = solid.spans[i];
+				// Skip non walkable spans.
+				if (s.area == RC_NULL_AREA)
+					continue;
+				
+				const int bot = (int)(s.smax);
+				const int top = i+1 < last ? (int)(solid.spans[i+1].smin) : MAX_HEIGHT;
+				
+				// Find neighbours minimum height.
+				int minh = MAX_HEIGHT;
+
+				// Min and max height of accessible neighbours.
+				int asmin = s.smax;
+				int asmax = s.smax;
+
+				for (int dir = 0; dir < 4; ++dir)
+				{
+					int dx = x + rcGetDirOffsetX(dir);
+					int dy = y + rcGetDirOffsetY(dir);
+					// Skip neighbours which are out of bounds.
+					if (dx < 0 || dy < 0 || dx >= w || dy >= h)
+					{
+						minh = rcMin(minh, -walkableClimb - bot);
+						continue;
+					}
+
+					// From minus infinity to the first span.
+					const int nfirst = (int)solid.cells[dx + dy*w];
+					const int nlast = (int)solid.cells[dx + dy*w + 1];
+					int nbot = -walkableClimb;
+					int ntop = nfirst < nlast ? (int)solid.spans[nfirst].smin : MAX_HEIGHT;
+					// Skip neightbour if the gap between the spans is too small.
+					if (rcMin(top,ntop) - rcMax(bot,nbot) > walkableHeight)
+						minh = rcMin(minh, nbot - bot);
+					
+					// Rest of the spans.
+					for (int j = nfirst; j < nlast; ++j)
+					{
+						nbot = (int)solid.spans[j].smax;
+						ntop = j+1 < nlast ? (int)solid.spans[j+1].smin : MAX_HEIGHT;
+						// Skip neightbour if the gap between the spans is too small.
+						if (rcMin(top,ntop) - rcMax(bot,nbot) > walkableHeight)
+						{
+							minh = rcMin(minh, nbot - bot);
+						
+							// Find min/max accessible neighbour height. 
+							if (rcAbs(nbot - bot) <= walkableClimb)
+							{
+								if (nbot < asmin) asmin = nbot;
+								if (nbot > asmax) asmax = nbot;
+							}
+							
+						}
+					}
+				}
+				
+				// The current span is close to a ledge if the drop to any
+				// neighbour span is less than the walkableClimb.
+				if (minh < -walkableClimb)
+					s.area = RC_NULL_AREA;
+					
+				// If the difference between all neighbours is too large,
+				// we are at steep slope, mark the span as ledge.
+				if ((asmax - asmin) > walkableClimb)
+				{
+					s.area = RC_NULL_AREA;
+				}
+			}
+		}
+	}
+	
+	ctx->stopTimer(RC_TIMER_FILTER_BORDER);
+}
+
+/// @par
+///
+/// Gives the same result as the rcHeightfield overload.
+///
+/// @see rcPackedHeightfield, rcConfig
+void rcFilterWalkableLowHeightSpans(rcContext* ctx, int walkableHeight, rcPackedHeightfield& solid)
+{
+	rcAssert(ctx);
+	
+	ctx->startTimer(RC_TIMER_FILTER_WALKABLE);
+	
+	const int ncells = solid.width*solid.height;
+	const int MAX_HEIGHT = 0xffff;
+	
+	// Remove walkable flag from spans which do not have enough
+	// space above them for the agent to stand there.
+	for (int i = 0; i < ncells; ++i)
+	{
+		const int last = (int)solid.cells[i+1];
+		for (int j = (int)solid.cells[i]; j < last; ++j)
+		{
+			const int bot = (int)(solid.spans[j].smax);
+			const int top = j+1 < last ? (int)(solid.spans[j+1].smin) : MAX_HEIGHT;
+			if ((top - bot) <= walkableHeight)
+				solid.spans[j].area = RC_NULL_AREA;
+		}
+	}
+	
+	ctx->stopTimer(RC_TIMER_FILTER_WALKABLE);
+}
@@ -22,6 +22,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <new>
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
@@ -500,17 +501,382 @@ inline float getJitterY(const int i)
 	return (((i * 0xd8163841) & 0xffff) / 65535.0f * 2.0f) - 1.0f;
 }
 
+// The incremental triangulation used with #RC_DETAIL_INCREMENTAL_DELAUNAY stores each
+// triangle as (v0, v1, v2, n0, n1, n2, stamp). The vertices are counter-clockwise on
+// the xz-plane, n[i] is the triangle across the edge v[i]-v[i+1] or -1 on the hull,
+// and stamp is the last insertion which changed the triangle.
+static const int DT_STRIDE = 7;
+
+static void setTri(rcIntArray& dt, const int t, const int a, const int b, const int c,
+				   const int na, const int nb, const int nc, const int stamp)
+{
+	int* tri = &dt[t*DT_STRIDE];
+	tri[0] = a; tri[1] = b; tri[2] = c;
+	tri[3] = na; tri[4] = nb; tri[5] = nc;
+	tri[6] = stamp;
+}
+
+static void replaceNeighbour(rcIntArray& dt, const int t, const int from, const int to)
+{
+	if (t < 0)
+		return;
+	int* tri = &dt[t*DT_STRIDE];
+	for (int i = 0; i < 3; ++i)
+	{
+		if (tri[3+i] == from)
+			tri[3+i] = to;
+	}
+}
+
+// Returns true if d is inside the circumcircle of the counter-clockwise triangle abc.
+static bool inCircumCircle(const float* a, const float* b, const float* c, const float* d)
+{
+	const double adx = a[0]-d[0], adz = a[2]-d[2];
+	const double bdx = b[0]-d[0], bdz = b[2]-d[2];
+	const double cdx = c[0]-d[0], cdz = c[2]-d[2];
+	const double alift = adx*adx + adz*adz;
+	const double blift = bdx*bdx + bdz*bdz;
+	const double clift = cdx*cdx + cdz*cdz;
+	const double det = alift*(bdx*cdz - cdx*bdz) + blift*(cdx*adz - adx*cdz) + clift*(adx*bdz - bdx*adz);
+	const double permanent = alift*(fabs(bdx*cdz) + fabs(cdx*bdz)) + blift*(fabs(cdx*adz) + fabs(adx*cdz)) +
+							 clift*(fabs(adx*bdz) + fabs(bdx*adz));
+	// Cocircular points are not flipped, so that the flips always terminate.
+	return det > permanent*1e-10;
+}
+
+// Flips the edges on the stack until the triangles around them are Delaunay.
+// Each stack entry is (t, k), the edge v[k]-v[k+1] of the triangle t.
+static void legalizeEdges(const float* pts, rcIntArray& dt, rcIntArray& stack, const int stamp)
+{
+	const int ntris = dt.size()/DT_STRIDE;
+	int maxFlips = ntris*ntris + 16;
+	while (stack.size() > 0)
+	{
+		const int k = stack.pop();
+		const int t = stack.pop();
+		int* tt = &dt[t*DT_STRIDE];
+		const int u = tt[3+k];
+		if (u < 0)
+			continue;
+		const int a = tt[k];
+		const int b = tt[(k+1)%3];
+		const int p = tt[(k+2)%3];
+		int* tu = &dt[u*DT_STRIDE];
+		int m = 0;
+		while (m < 3 && tu[m] != b)
+			++m;
+		if (m == 3 || tu[(m+1)%3] != a)
+			continue;
+		const int d = tu[(m+2)%3];
+		
+		if (!inCircumCircle(&pts[a*3], &pts[b*3], &pts[p*3], &pts[d*3]))
+			continue;
+		// The quad a, d, b, p must be convex for the flip to be valid.
+		if (vcross2(&pts[p*3], &pts[a*3], &pts[d*3]) <= 0 || vcross2(&pts[p*3], &pts[d*3], &pts[b*3]) <= 0)
+			continue;
+		if (--maxFlips < 0)
+			break;
+		
+		const int nap = tt[3+(k+2)%3];
+		const int nbp = tt[3+(k+1)%3];
+		const int nad = tu[3+(m+1)%3];
+		const int nbd = tu[3+(m+2)%3];
+		setTri(dt, t, p, a, d, nap, nad, u, stamp);
+		setTri(dt, u, p, d, b, t, nbd, nbp, stamp);
+		replaceNeighbour(dt, nad, u, t);
+		replaceNeighbour(dt, nbp, t, u);
+		
+		stack.push(t); stack.push(0);
+		stack.push(t); stack.push(1);
+		stack.push(u); stack.push(1);
+		stack.push(u); stack.push(2);
+	}
+	stack.resize(0);
+}
+
+// Triangulates the hull by clipping its shortest ears, then flips the edges until
+// the triangulation is Delaunay. Returns false if the hull is not a polygon.
+static bool triangulateHull(const float* pts, const int nhull, const int* hull,
+							rcIntArray& dt, rcIntArray& stack)
+{
+	static const int MAX_HULL = 128;
+	int poly[MAX_HULL];		// The remaining vertices, counter-clockwise.
+	int edgeTri[MAX_HULL];	// The triangle inside the edge from each remaining vertex to the next one.
+	int edgeIdx[MAX_HULL];
+	if (nhull < 3 || nhull > MAX_HULL)
+		return false;
+	
+	// Make the hull counter-clockwise.
+	float area = 0;
+	for (int i = 0, j = nhull-1; i < nhull; j=i++)
+		area += pts[hull[j]*3+0]*pts[hull[i]*3+2] - pts[hull[i]*3+0]*pts[hull[j]*3+2];
+	for (int i = 0; i < nhull; ++i)
+	{
+		poly[i] = area < 0 ? hull[nhull-1-i] : hull[i];
+		edgeTri[i] = -1;
+		edgeIdx[i] = 0;
+	}
+	
+	static const float EPS = 1e-6f;
+	dt.resize(0);
+	int n = nhull;
+	int ntris = 0;
+	while (n >= 3)
+	{
+		int ncorners = 0;
+		for (int i = 0; i < n; ++i)
+		{
+			if (vcross2(&pts[poly[(i+n-1)%n]*3], &pts[poly[i]*3], &pts[poly[(i+1)%n]*3]) > EPS)
+				ncorners++;
+		}
+		
+		// Find the shortest ear with a positive area. The hull vertices are often collinear,
+		// so the ears which would leave only collinear vertices are skipped. If the rest of
+		// the hull is a sliver, the ear with the largest area is used instead.
+		int best = -1;
+		float bestLen = FLT_MAX;
+		int widest = 0;
+		float widestArea = -FLT_MAX;
+		for (int i = 0; i < n; ++i)
+		{
+			const float* vpp = &pts[poly[(i+n-2)%n]*3];
+			const float* va = &pts[poly[(i+n-1)%n]*3];
+			const float* vb = &pts[poly[i]*3];
+			const float* vc = &pts[poly[(i+1)%n]*3];
+			const float* vnn = &pts[poly[(i+2)%n]*3];
+			const float ear = vcross2(va, vb, vc);
+			if (ear > widestArea)
+			{
+				widestArea = ear;
+				widest = i;
+			}
+			if (ear <= EPS)
+				continue;
+			int corners = ncorners-1;
+			corners -= (vcross2(vpp, va, vb) > EPS ? 1 : 0) + (vcross2(vb, vc, vnn) > EPS ? 1 : 0);
+			corners += (vcross2(vpp, va, vc) > EPS ? 1 : 0) + (vcross2(va, vc, vnn) > EPS ? 1 : 0);
+			if (n > 3 && corners == 0)
+				continue;
+			const float len = vdistSq2(va, vc);
+			if (len < bestLen)
+			{
+				bestLen = len;
+				best = i;
+			}
+		}
+		if (best == -1)
+			best = widest;
+		
+		const int ip = (best+n-1)%n;
+		const int in = (best+1)%n;
+		const int t = ntris++;
+		dt.resize(ntris*DT_STRIDE);
+		setTri(dt, t, poly[ip], poly[best], poly[in], edgeTri[ip], edgeTri[best], -1, 0);
+		if (edgeTri[ip] >= 0)
+			dt[edgeTri[ip]*DT_STRIDE+3+edgeIdx[ip]] = t;
+		if (edgeTri[best] >= 0)
+			dt[edgeTri[best]*DT_STRIDE+3+edgeIdx[best]] = t;
+		
+		// The diagonal becomes the edge from the previous vertex.
+		edgeTri[ip] = t;
+		edgeIdx[ip] = 2;
+		for (int i = best; i < n-1; ++i)
+		{
+			poly[i] = poly[i+1];
+			edgeTri[i] = edgeTri[i+1];
+			edgeIdx[i] = edgeIdx[i+1];
+		}
+		n--;
+		
+		if (n == 2)
+		{
+			// The last diagonal is the edge of the last triangle.
+			if (edgeTri[0] >= 0 && edgeTri[1] >= 0)
+			{
+				dt[edgeTri[0]*DT_STRIDE+3+edgeIdx[0]] = edgeTri[1];
+				dt[edgeTri[1]*DT_STRIDE+3+edgeIdx[1]] = edgeTri[0];
+			}
+			break;
+		}
+	}
+	
+	stack.resize(0);
+	for (int t = 0; t < ntris; ++t)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			stack.push(t);
+			stack.push(k);
+		}
+	}
+	legalizeEdges(pts, dt, stack, 0);
+	
+	return true;
+}
+
+// Returns the triangle containing the point among the triangles changed by the
+// specified insertion, or among all the triangles if stamp is negative, or -1.
+static int findTriangle(const float* pts, const rcIntArray& dt, const float* p, const int stamp)
+{
+	static const float EPS = 1e-6f;
+	for (int t = 0; t < dt.size()/DT_STRIDE; ++t)
+	{
+		const int* tri = &dt[t*DT_STRIDE];
+		if (stamp >= 0 && tri[6] != stamp)
+			continue;
+		if (vcross2(&pts[tri[0]*3], &pts[tri[1]*3], p) >= -EPS &&
+			vcross2(&pts[tri[1]*3], &pts[tri[2]*3], p) >= -EPS &&
+			vcross2(&pts[tri[2]*3], &pts[tri[0]*3], p) >= -EPS)
+			return t;
+	}
+	return -1;
+}
+
+// Inserts the vertex p, located in the triangle t, and restores the Delaunay property.
+static void insertVertex(const float* pts, rcIntArray& dt, rcIntArray& stack, const int t, const int p, const float edgeEps)
+{
+	int* tt = &dt[t*DT_STRIDE];
+	const float* vp = &pts[p*3];
+	
+	// Split the edge the vertex lies on, if any, to not create a degenerate triangle.
+	for (int k = 0; k < 3; ++k)
+	{
+		const int a = tt[k];
+		const int b = tt[(k+1)%3];
+		const int u = tt[3+k];
+		if (u < 0 || distancePtSeg2d(vp, &pts[a*3], &pts[b*3]) > rcSqr(edgeEps))
+			continue;
+		
+		const int c = tt[(k+2)%3];
+		const int nbc = tt[3+(k+1)%3];
+		const int nca = tt[3+(k+2)%3];
+		const int* tu = &dt[u*DT_STRIDE];
+		int m = 0;
+		while (m < 3 && tu[m] != b)
+			++m;
+		if (m == 3 || tu[(m+1)%3] != a)
+			break;
+		const int d = tu[(m+2)%3];
+		const int nad = tu[3+(m+1)%3];
+		const int ndb = tu[3+(m+2)%3];
+		
+		const int t1 = dt.size()/DT_STRIDE;
+		const int u1 = t1+1;
+		dt.resize(dt.size() + DT_STRIDE*2);
+		setTri(dt, t, a, p, c, u, t1, nca, p);
+		setTri(dt, t1, p, b, c, u1, nbc, t, p);
+		setTri(dt, u, p, a, d, t, nad, u1, p);
+		setTri(dt, u1, b, p, d, t1, u, ndb, p);
+		replaceNeighbour(dt, nbc, t, t1);
+		replaceNeighbour(dt, ndb, u, u1);
+		
+		stack.push(t); stack.push(2);
+		stack.push(t1); stack.push(1);
+		stack.push(u); stack.push(1);
+		stack.push(u1); stack.push(2);
+		legalizeEdges(pts, dt, stack, p);
+		return;
+	}
+	
+	const int a = tt[0], b = tt[1], c = tt[2];
+	const int nab = tt[3], nbc = tt[4], nca = tt[5];
+	const int t1 = dt.size()/DT_STRIDE;
+	const int t2 = t1+1;
+	dt.resize(dt.size() + DT_STRIDE*2);
+	setTri(dt, t, a, b, p, nab, t1, t2, p);
+	setTri(dt, t1, b, c, p, nbc, t2, t, p);
+	setTri(dt, t2, c, a, p, nca, t, t1, p);
+	replaceNeighbour(dt, nbc, t, t1);
+	replaceNeighbour(dt, nca, t, t2);
+	
+	stack.push(t); stack.push(0);
+	stack.push(t1); stack.push(0);
+	stack.push(t2); stack.push(0);
+	legalizeEdges(pts, dt, stack, p);
+}
+
+// Adds the samples with the most error to the triangulation, one at a time, until
+// the error is within the threshold. Each sample keeps the triangle it lies in, so
+// only the samples in the triangles changed by an insertion are located again.
+static void addSamplesIncremental(float* verts, int& nverts, const int maxVerts,
+								  rcIntArray& samples, rcIntArray& dt, rcIntArray& stack,
+								  const float sampleDist, const float sampleMaxError,
+								  const float cs, const float ch)
+{
+	const int nsamples = samples.size()/4;
+	
+	// From now on, the fourth component of a sample is its triangle, or -1 once added.
+	for (int i = 0; i < nsamples; ++i)
+	{
+		int* s = &samples[i*4];
+		float pt[3];
+		pt[0] = s[0]*sampleDist + getJitterX(i)*cs*0.1f;
+		pt[1] = s[1]*ch;
+		pt[2] = s[2]*sampleDist + getJitterY(i)*cs*0.1f;
+		s[3] = findTriangle(verts, dt, pt, -1);
+	}
+	
+	int lastStamp = -1;
+	for (int iter = 0; iter < nsamples; ++iter)
+	{
+		if (nverts >= maxVerts)
+			break;
+		
+		// Find sample with most error.
+		float bestpt[3] = {0,0,0};
+		float bestd = 0;
+		int besti = -1;
+		for (int i = 0; i < nsamples; ++i)
+		{
+			int* s = &samples[i*4];
+			if (s[3] < 0) continue; // skip added.
+			float pt[3];
+			// The sample location is jittered to get rid of some bad triangulations
+			// which are cause by symmetrical data from the grid structure.
+			pt[0] = s[0]*sampleDist + getJitterX(i)*cs*0.1f;
+			pt[1] = s[1]*ch;
+			pt[2] = s[2]*sampleDist + getJitterY(i)*cs*0.1f;
+			if (dt[s[3]*DT_STRIDE+6] == lastStamp)
+			{
+				s[3] = findTriangle(verts, dt, pt, lastStamp);
+				if (s[3] < 0) continue; // did not hit the mesh.
+			}
+			const int* t = &dt[s[3]*DT_STRIDE];
+			const float d = distPtTri(pt, &verts[t[0]*3], &verts[t[1]*3], &verts[t[2]*3]);
+			if (d == FLT_MAX) continue; // did not hit the mesh.
+			if (d > bestd)
+			{
+				bestd = d;
+				besti = i;
+				rcVcopy(bestpt,pt);
+			}
+		}
+		// If the max error is within accepted threshold, stop tesselating.
+		if (bestd <= sampleMaxError || besti == -1)
+			break;
+		
+		// Add the new sample point.
+		const int t = samples[besti*4+3];
+		samples[besti*4+3] = -1;
+		rcVcopy(&verts[nverts*3],bestpt);
+		insertVertex(verts, dt, stack, t, nverts, cs*0.001f);
+		lastStamp = nverts;
+		nverts++;
+	}
+}
+
 static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 							const float sampleDist, const float sampleMaxError,
 							const rcCompactHeightfield& chf, const rcHeightPatch& hp,
 							float* verts, int& nverts, rcIntArray& tris,
-							rcIntArray& edges, rcIntArray& samples)
+							rcIntArray& edges, rcIntArray& samples, rcIntArray& stack,
+							const int buildFlags)
 {
 	static const int MAX_VERTS = 127;
 	static const int MAX_TRIS = 255;	// Max tris for delaunay is 2n-2-k (n=num verts, k=num hull verts).
 	static const int MAX_VERTS_PER_EDGE = 32;
 	float edge[(MAX_VERTS_PER_EDGE+1)*3];
-	int hull[MAX_VERTS];
+	int hull[MAX_VERTS] = {0};
 	int nhull = 0;
 
 	nverts = 0;
@@ -633,9 +999,22 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 	edges.resize(0);
 	tris.resize(0);
 
-	delaunayHull(ctx, nverts, verts, nhull, hull, tris, edges);
+	// The incremental triangulation is kept in the edges array.
+	const bool incremental = (buildFlags & RC_DETAIL_INCREMENTAL_DELAUNAY) != 0;
+	bool triangulated;
+	if (incremental)
+	{
+		triangulated = triangulateHull(verts, nhull, hull, edges, stack);
+		if (!triangulated)
+			edges.resize(0);
+	}
+	else
+	{
+		delaunayHull(ctx, nverts, verts, nhull, hull, tris, edges);
+		triangulated = tris.size() > 0;
+	}
 	
-	if (tris.size() == 0)
+	if (!triangulated)
 	{
 		// Could not triangulate the poly, make sure there is some valid data there.
 		ctx->log(RC_LOG_WARNING, "buildPolyDetail: Could not triangulate polygon, adding default data.");
@@ -686,7 +1065,10 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 		// error. The procedure stops when all samples are added
 		// or when the max error is within treshold.
 		const int nsamples = samples.size()/4;
-		for (int iter = 0; iter < nsamples; ++iter)
+		if (incremental)
+			addSamplesIncremental(verts, nverts, MAX_VERTS, samples, edges, stack,
+								  sampleDist, sampleMaxError, cs, chf.ch);
+		for (int iter = 0; iter < nsamples && !incremental; ++iter)
 		{
 			if (nverts >= MAX_VERTS)
 				break;
@@ -730,6 +1112,19 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 			delaunayHull(ctx, nverts, verts, nhull, hull, tris, edges);
 		}		
 	}
+	
+	if (incremental)
+	{
+		// Store the triangles clockwise, like the triangulation above.
+		for (int i = 0; i < edges.size()/DT_STRIDE; ++i)
+		{
+			const int* t = &edges[i*DT_STRIDE];
+			tris.push(t[0]);
+			tris.push(t[2]);
+			tris.push(t[1]);
+			tris.push(0);
+		}
+	}
 
 	const int ntris = tris.size()/4;
 	if (ntris > MAX_TRIS)
@@ -941,14 +1336,296 @@ static unsigned char getTriFlags(const float* va, const float* vb, const float*
 	return flags;
 }
 
+/// The detail meshes of a range of polygons, in polygon order.
+struct rcDetailChunk
+{
+	float* verts;
+	int nverts, vcap;
+	unsigned char* tris;
+	int ntris, tcap;
+	char* log;				// (category, message, '\0') per logged message.
+	int logSize, logCap;
+	bool failed;
+};
+
+/// Keeps the messages logged by a worker in the chunk it builds, so that they
+/// can be logged in polygon order once all the chunks are done.
+class rcDetailLogContext : public rcContext
+{
+public:
+	rcDetailLogContext() : m_chunk(0) {}
+	void setChunk(rcDetailChunk* chunk) { m_chunk = chunk; }
+
+protected:
+	virtual void doLog(const rcLogCategory category, const char* msg, const int len)
+	{
+		rcDetailChunk& c = *m_chunk;
+		if (c.logSize+len+2 > c.logCap)
+		{
+			const int cap = rcMax(c.logCap*2, c.logSize+len+2+256);
+			char* log = (char*)rcAlloc(sizeof(char)*cap, RC_ALLOC_TEMP);
+			if (!log)
+				return;
+			if (c.logSize)
+				memcpy(log, c.log, c.logSize);
+			rcFree(c.log);
+			c.log = log;
+			c.logCap = cap;
+		}
+		c.log[c.logSize++] = (char)category;
+		memcpy(&c.log[c.logSize], msg, len);
+		c.logSize += len;
+		c.log[c.logSize++] = '\0';
+	}
+
+private:
+	rcDetailChunk* m_chunk;
+};
+
+/// The scratch memory of a worker.
+struct rcDetailWorker
+{
+	rcIntArray edges;
+	rcIntArray tris;
+	rcIntArray stack;
+	rcIntArray samples;
+	float verts[256*3];
+	float* poly;
+	rcHeightPatch hp;
+	rcDetailLogContext log;
+	rcContext* ctx;			// The context to log to, the build context or #log.
+	
+	rcDetailWorker() : edges(64), tris(512), stack(512), samples(512), poly(0), ctx(0) {}
+	~rcDetailWorker() { rcFree(poly); }
+};
+
+struct rcDetailJob
+{
+	const rcPolyMesh* mesh;
+	const rcCompactHeightfield* chf;
+	float sampleDist;
+	float sampleMaxError;
+	int buildFlags;
+	const int* bounds;
+	unsigned int* meshes;
+	int nchunks;
+	rcDetailChunk* chunks;
+	rcDetailWorker* workers;
+};
+
+static bool reserveDetailChunk(rcDetailChunk& chunk, const int nverts, const int ntris)
+{
+	if (chunk.nverts+nverts > chunk.vcap)
+	{
+		const int vcap = rcMax(chunk.vcap*2, chunk.nverts+nverts);
+		float* newv = (float*)rcAlloc(sizeof(float)*vcap*3, RC_ALLOC_TEMP);
+		if (!newv)
+			return false;
+		if (chunk.nverts)
+			memcpy(newv, chunk.verts, sizeof(float)*3*chunk.nverts);
+		rcFree(chunk.verts);
+		chunk.verts = newv;
+		chunk.vcap = vcap;
+	}
+	if (chunk.ntris+ntris > chunk.tcap)
+	{
+		const int tcap = rcMax(chunk.tcap*2, chunk.ntris+ntris);
+		unsigned char* newt = (unsigned char*)rcAlloc(sizeof(unsigned char)*tcap*4, RC_ALLOC_TEMP);
+		if (!newt)
+			return false;
+		if (chunk.ntris)
+			memcpy(newt, chunk.tris, sizeof(unsigned char)*4*chunk.ntris);
+		rcFree(chunk.tris);
+		chunk.tris = newt;
+		chunk.tcap = tcap;
+	}
+	return true;
+}
+
+static void buildDetailChunk(void* arg, const int index, const int worker)
+{
+	const rcDetailJob* job = (const rcDetailJob*)arg;
+	const rcPolyMesh& mesh = *job->mesh;
+	const rcCompactHeightfield& chf = *job->chf;
+	rcDetailChunk& chunk = job->chunks[index];
+	rcDetailWorker& wk = job->workers[worker];
+	rcContext* ctx = wk.ctx;
+	wk.log.setChunk(&chunk);
+	
+	const int nvp = mesh.nvp;
+	const float cs = mesh.cs;
+	const float ch = mesh.ch;
+	const float* orig = mesh.bmin;
+	float* poly = wk.poly;
+	float* verts = wk.verts;
+	rcHeightPatch& hp = wk.hp;
+	
+	const int first = (int)((long long)mesh.npolys*index / job->nchunks);
+	const int last = (int)((long long)mesh.npolys*(index+1) / job->nchunks);
+	for (int i = first; i < last; ++i)
+	{
+		const unsigned short* p = &mesh.polys[i*nvp*2];
+		
+		// Store polygon vertices for processing.
+		int npoly = 0;
+		for (int j = 0; j < nvp; ++j)
+		{
+			if(p[j] == RC_MESH_NULL_IDX) break;
+			const unsigned short* v = &mesh.verts[p[j]*3];
+			poly[j*3+0] = v[0]*cs;
+			poly[j*3+1] = v[1]*ch;
+			poly[j*3+2] = v[2]*cs;
+			npoly++;
+		}
+		
+		// Get the height data from the area of the polygon.
+		const int* bounds = &job->bounds[i*4];
+		hp.xmin = bounds[0];
+		hp.ymin = bounds[2];
+		hp.width = bounds[1]-bounds[0];
+		hp.height = bounds[3]-bounds[2];
+		getHeightData(chf, p, npoly, mesh.verts, mesh.borderSize, hp, wk.stack);
+		
+		// Build detail mesh.
+		int nverts = 0;
+		if (!buildPolyDetail(ctx, poly, npoly,
+							 job->sampleDist, job->sampleMaxError,
+							 chf, hp, verts, nverts, wk.tris,
+							 wk.edges, wk.samples, wk.stack, job->buildFlags))
+		{
+			chunk.failed = true;
+			return;
+		}
+
+		// Move detail verts to world space.
+		for (int j = 0; j < nverts; ++j)
+		{
+			verts[j*3+0] += orig[0];
+			verts[j*3+1] += orig[1] + chf.ch; // Is this offset necessary?
+			verts[j*3+2] += orig[2];
+		}
+		// Offset poly too, will be used to flag checking.
+		for (int j = 0; j < npoly; ++j)
+		{
+			poly[j*3+0] += orig[0];
+			poly[j*3+1] += orig[1];
+			poly[j*3+2] += orig[2];
+		}
+	
+		// Store detail submesh, the offsets are set once all the chunks are done.
+		const rcIntArray& tris = wk.tris;
+		const int ntris = tris.size()/4;
+
+		job->meshes[i*4+1] = (unsigned int)nverts;
+		job->meshes[i*4+3] = (unsigned int)ntris;
+		
+		if (!reserveDetailChunk(chunk, nverts, ntris))
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'chunk' (%d).", chunk.nverts+nverts);
+			chunk.failed = true;
+			return;
+		}
+		memcpy(&chunk.verts[chunk.nverts*3], verts, sizeof(float)*nverts*3);
+		chunk.nverts += nverts;
+		for (int j = 0; j < ntris; ++j)
+		{
+			const int* t = &tris[j*4];
+			chunk.tris[chunk.ntris*4+0] = (unsigned char)t[0];
+			chunk.tris[chunk.ntris*4+1] = (unsigned char)t[1];
+			chunk.tris[chunk.ntris*4+2] = (unsigned char)t[2];
+			chunk.tris[chunk.ntris*4+3] = getTriFlags(&verts[t[0]*3], &verts[t[1]*3], &verts[t[2]*3], poly, npoly);
+			chunk.ntris++;
+		}
+	}
+}
+
+static bool buildDetailChunks(rcContext* ctx, rcDetailJob& job, const int nworkers, const int maxhw, const int maxhh,
+							  rcPolyMeshDetail& dmesh)
+{
+	const int nvp = job.mesh->nvp;
+	
+	for (int i = 0; i < nworkers; ++i)
+	{
+		rcDetailWorker& wk = job.workers[i];
+		wk.ctx = nworkers > 1 ? &wk.log : ctx;
+		wk.poly = (float*)rcAlloc(sizeof(float)*nvp*3, RC_ALLOC_TEMP);
+		if (!wk.poly)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'poly' (%d).", nvp*3);
+			return false;
+		}
+		wk.hp.data = (unsigned short*)rcAlloc(sizeof(unsigned short)*maxhw*maxhh, RC_ALLOC_TEMP);
+		if (!wk.hp.data)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'hp.data' (%d).", maxhw*maxhh);
+			return false;
+		}
+	}
+	
+	ctx->parallelFor(buildDetailChunk, &job, job.nchunks);
+	
+	// Log the messages of the workers in polygon order.
+	bool failed = false;
+	for (int i = 0; i < job.nchunks; ++i)
+	{
+		const rcDetailChunk& chunk = job.chunks[i];
+		for (int j = 0; j < chunk.logSize; j += (int)strlen(&chunk.log[j+1]) + 2)
+			ctx->log((rcLogCategory)chunk.log[j], "%s", &chunk.log[j+1]);
+		if (chunk.failed)
+			failed = true;
+	}
+	if (failed)
+		return false;
+	
+	// Compute the offsets of the submeshes and copy them.
+	int nverts = 0, ntris = 0;
+	for (int i = 0; i < dmesh.nmeshes; ++i)
+	{
+		dmesh.meshes[i*4+0] = (unsigned int)nverts;
+		dmesh.meshes[i*4+2] = (unsigned int)ntris;
+		nverts += (int)dmesh.meshes[i*4+1];
+		ntris += (int)dmesh.meshes[i*4+3];
+	}
+	
+	dmesh.verts = (float*)rcAlloc(sizeof(float)*rcMax(nverts, 1)*3, RC_ALLOC_PERM);
+	if (!dmesh.verts)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.verts' (%d).", nverts*3);
+		return false;
+	}
+	dmesh.tris = (unsigned char*)rcAlloc(sizeof(unsigned char)*rcMax(ntris, 1)*4, RC_ALLOC_PERM);
+	if (!dmesh.tris)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.tris' (%d).", ntris*4);
+		return false;
+	}
+	for (int i = 0; i < job.nchunks; ++i)
+	{
+		const rcDetailChunk& chunk = job.chunks[i];
+		if (chunk.nverts)
+			memcpy(&dmesh.verts[dmesh.nverts*3], chunk.verts, sizeof(float)*chunk.nverts*3);
+		if (chunk.ntris)
+			memcpy(&dmesh.tris[dmesh.ntris*4], chunk.tris, sizeof(unsigned char)*chunk.ntris*4);
+		dmesh.nverts += chunk.nverts;
+		dmesh.ntris += chunk.ntris;
+	}
+	
+	return true;
+}
+
 /// @par
 ///
+/// When the context provides several workers, the polygons are split in chunks
+/// built in parallel. (See: #rcContext::parallelFor) The detail meshes are the
+/// same as when they are built sequentially, and the messages logged while building
+/// them are logged in polygon order once all the chunks are done.
+///
 /// See the #rcConfig documentation for more information on the configuration parameters.
 ///
 /// @see rcAllocPolyMeshDetail, rcPolyMesh, rcCompactHeightfield, rcPolyMeshDetail, rcConfig
 bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompactHeightfield& chf,
 						   const float sampleDist, const float sampleMaxError,
-						   rcPolyMeshDetail& dmesh)
+						   rcPolyMeshDetail& dmesh, const int buildFlags)
 {
 	rcAssert(ctx);
 	
@@ -958,18 +1635,6 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		return true;
 	
 	const int nvp = mesh.nvp;
-	const float cs = mesh.cs;
-	const float ch = mesh.ch;
-	const float* orig = mesh.bmin;
-	const int borderSize = mesh.borderSize;
-	
-	rcIntArray edges(64);
-	rcIntArray tris(512);
-	rcIntArray stack(512);
-	rcIntArray samples(512);
-	float verts[256*3];
-	rcHeightPatch hp;
-	int nPolyVerts = 0;
 	int maxhw = 0, maxhh = 0;
 	
 	rcScopedDelete<int> bounds = (int*)rcAlloc(sizeof(int)*mesh.npolys*4, RC_ALLOC_TEMP);
@@ -978,12 +1643,6 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'bounds' (%d).", mesh.npolys*4);
 		return false;
 	}
-	rcScopedDelete<float> poly = (float*)rcAlloc(sizeof(float)*nvp*3, RC_ALLOC_TEMP);
-	if (!poly)
-	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'poly' (%d).", nvp*3);
-		return false;
-	}
 	
 	// Find max size for a polygon area.
 	for (int i = 0; i < mesh.npolys; ++i)
@@ -1005,7 +1664,6 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 			xmax = rcMax(xmax, (int)v[0]);
 			ymin = rcMin(ymin, (int)v[2]);
 			ymax = rcMax(ymax, (int)v[2]);
-			nPolyVerts++;
 		}
 		xmin = rcMax(0,xmin-1);
 		xmax = rcMin(chf.width,xmax+1);
@@ -1016,13 +1674,6 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		maxhh = rcMax(maxhh, ymax-ymin);
 	}
 	
-	hp.data = (unsigned short*)rcAlloc(sizeof(unsigned short)*maxhw*maxhh, RC_ALLOC_TEMP);
-	if (!hp.data)
-	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'hp.data' (%d).", maxhw*maxhh);
-		return false;
-	}
-	
 	dmesh.nmeshes = mesh.npolys;
 	dmesh.nverts = 0;
 	dmesh.ntris = 0;
@@ -1032,132 +1683,50 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.meshes' (%d).", dmesh.nmeshes*4);
 		return false;
 	}
-
-	int vcap = nPolyVerts+nPolyVerts/2;
-	int tcap = vcap*2;
-
-	dmesh.nverts = 0;
-	dmesh.verts = (float*)rcAlloc(sizeof(float)*vcap*3, RC_ALLOC_PERM);
-	if (!dmesh.verts)
+	
+	const int nworkers = ctx->getWorkerCount();
+	const int nchunks = nworkers > 1 ? rcMin(mesh.npolys, nworkers*8) : 1;
+	rcScopedDelete<rcDetailChunk> chunks = (rcDetailChunk*)rcAlloc(sizeof(rcDetailChunk)*nchunks, RC_ALLOC_TEMP);
+	if (!chunks)
 	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.verts' (%d).", vcap*3);
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'chunks' (%d).", nchunks);
 		return false;
 	}
-	dmesh.ntris = 0;
-	dmesh.tris = (unsigned char*)rcAlloc(sizeof(unsigned char*)*tcap*4, RC_ALLOC_PERM);
-	if (!dmesh.tris)
+	memset((rcDetailChunk*)chunks, 0, sizeof(rcDetailChunk)*nchunks);
+	rcDetailWorker* workers = (rcDetailWorker*)rcAlloc(sizeof(rcDetailWorker)*nworkers, RC_ALLOC_TEMP);
+	if (!workers)
 	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.tris' (%d).", tcap*4);
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'workers' (%d).", nworkers);
 		return false;
 	}
+	for (int i = 0; i < nworkers; ++i)
+		new(&workers[i]) rcDetailWorker;
 	
-	for (int i = 0; i < mesh.npolys; ++i)
-	{
-		const unsigned short* p = &mesh.polys[i*nvp*2];
-		
-		// Store polygon vertices for processing.
-		int npoly = 0;
-		for (int j = 0; j < nvp; ++j)
-		{
-			if(p[j] == RC_MESH_NULL_IDX) break;
-			const unsigned short* v = &mesh.verts[p[j]*3];
-			poly[j*3+0] = v[0]*cs;
-			poly[j*3+1] = v[1]*ch;
-			poly[j*3+2] = v[2]*cs;
-			npoly++;
-		}
-		
-		// Get the height data from the area of the polygon.
-		hp.xmin = bounds[i*4+0];
-		hp.ymin = bounds[i*4+2];
-		hp.width = bounds[i*4+1]-bounds[i*4+0];
-		hp.height = bounds[i*4+3]-bounds[i*4+2];
-		getHeightData(chf, p, npoly, mesh.verts, borderSize, hp, stack);
-		
-		// Build detail mesh.
-		int nverts = 0;
-		if (!buildPolyDetail(ctx, poly, npoly,
-							 sampleDist, sampleMaxError,
-							 chf, hp, verts, nverts, tris,
-							 edges, samples))
-		{
-			return false;
-		}
-
-		// Move detail verts to world space.
-		for (int j = 0; j < nverts; ++j)
-		{
-			verts[j*3+0] += orig[0];
-			verts[j*3+1] += orig[1] + chf.ch; // Is this offset necessary?
-			verts[j*3+2] += orig[2];
-		}
-		// Offset poly too, will be used to flag checking.
-		for (int j = 0; j < npoly; ++j)
-		{
-			poly[j*3+0] += orig[0];
-			poly[j*3+1] += orig[1];
-			poly[j*3+2] += orig[2];
-		}
+	rcDetailJob job;
+	job.mesh = &mesh;
+	job.chf = &chf;
+	job.sampleDist = sampleDist;
+	job.sampleMaxError = sampleMaxError;
+	job.buildFlags = buildFlags;
+	job.bounds = bounds;
+	job.meshes = dmesh.meshes;
+	job.nchunks = nchunks;
+	job.chunks = chunks;
+	job.workers = workers;
+	const bool built = buildDetailChunks(ctx, job, nworkers, maxhw, maxhh, dmesh);
 	
-		// Store detail submesh.
-		const int ntris = tris.size()/4;
-
-		dmesh.meshes[i*4+0] = (unsigned int)dmesh.nverts;
-		dmesh.meshes[i*4+1] = (unsigned int)nverts;
-		dmesh.meshes[i*4+2] = (unsigned int)dmesh.ntris;
-		dmesh.meshes[i*4+3] = (unsigned int)ntris;		
-		
-		// Store vertices, allocate more memory if necessary.
-		if (dmesh.nverts+nverts > vcap)
-		{
-			while (dmesh.nverts+nverts > vcap)
-				vcap += 256;
-				
-			float* newv = (float*)rcAlloc(sizeof(float)*vcap*3, RC_ALLOC_PERM);
-			if (!newv)
-			{
-				ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'newv' (%d).", vcap*3);
-				return false;
-			}
-			if (dmesh.nverts)
-				memcpy(newv, dmesh.verts, sizeof(float)*3*dmesh.nverts);
-			rcFree(dmesh.verts);
-			dmesh.verts = newv;
-		}
-		for (int j = 0; j < nverts; ++j)
-		{
-			dmesh.verts[dmesh.nverts*3+0] = verts[j*3+0];
-			dmesh.verts[dmesh.nverts*3+1] = verts[j*3+1];
-			dmesh.verts[dmesh.nverts*3+2] = verts[j*3+2];
-			dmesh.nverts++;
-		}
-		
-		// Store triangles, allocate more memory if necessary.
-		if (dmesh.ntris+ntris > tcap)
-		{
-			while (dmesh.ntris+ntris > tcap)
-				tcap += 256;
-			unsigned char* newt = (unsigned char*)rcAlloc(sizeof(unsigned char)*tcap*4, RC_ALLOC_PERM);
-			if (!newt)
-			{
-				ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'newt' (%d).", tcap*4);
-				return false;
-			}
-			if (dmesh.ntris)
-				memcpy(newt, dmesh.tris, sizeof(unsigned char)*4*dmesh.ntris);
-			rcFree(dmesh.tris);
-			dmesh.tris = newt;
-		}
-		for (int j = 0; j < ntris; ++j)
-		{
-			const int* t = &tris[j*4];
-			dmesh.tris[dmesh.ntris*4+0] = (unsigned char)t[0];
-			dmesh.tris[dmesh.ntris*4+1] = (unsigned char)t[1];
-			dmesh.tris[dmesh.ntris*4+2] = (unsigned char)t[2];
-			dmesh.tris[dmesh.ntris*4+3] = getTriFlags(&verts[t[0]*3], &verts[t[1]*3], &verts[t[2]*3], poly, npoly);
-			dmesh.ntris++;
-		}
+	for (int i = 0; i < nworkers; ++i)
+		workers[i].~rcDetailWorker();
+	rcFree(workers);
+	for (int i = 0; i < nchunks; ++i)
+	{
+		rcFree(chunks[i].verts);
+		rcFree(chunks[i].tris);
+		rcFree(chunks[i].log);
 	}
+	
+	if (!built)
+		return false;
 		
 	ctx->stopTimer(RC_TIMER_BUILD_POLYMESHDETAIL);
 
@@ -18,11 +18,18 @@
 
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include <float.h>
 #include <stdio.h>
+#include <string.h>
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RC_RASTERIZE_SSE2
+#include <emmintrin.h>
+#endif
+
 inline bool overlapBounds(const float* amin, const float* amax, const float* bmin, const float* bmax)
 {
 	bool overlap = true;
@@ -199,11 +206,128 @@ static int clipPoly(const float* in, int n, float* out, float pnx, float pnz, fl
 	return m;
 }
 
+static inline void addClippedSpan(rcHeightfield& hf, const int x, const int y, float smin, float smax,
+								  const float* bmin, const float by, const float ich,
+								  const unsigned char area, const int flagMergeThr)
+{
+	smin -= bmin[1];
+	smax -= bmin[1];
+	// Skip the span if it is outside the heightfield bbox
+	if (smax < 0.0f) return;
+	if (smin > by) return;
+	// Clamp the span to the heightfield bbox.
+	if (smin < 0.0f) smin = 0;
+	if (smax > by) smax = by;
+	
+	// Snap the span to the heightfield height grid.
+	unsigned short ismin = (unsigned short)rcClamp((int)floorf(smin * ich), 0, RC_SPAN_MAX_HEIGHT);
+	unsigned short ismax = (unsigned short)rcClamp((int)ceilf(smax * ich), (int)ismin+1, RC_SPAN_MAX_HEIGHT);
+	
+	addSpan(hf, x, y, ismin, ismax, area, flagMergeThr);
+}
+
+#ifdef RC_RASTERIZE_SSE2
+
+// Clips the row polygon against the columns x..x+3 at once, and returns the height range of the
+// clipped polygons. Every lane performs the operations of the two clipPoly calls of the scalar
+// path in the same order, so the ranges are bit-identical. The first clip leaves its vertices
+// in place with a validity mask, and the second clip walks the valid ones of each lane.
+static void clipRowColumnsSSE2(const float* inrow, const int nvrow, const int x,
+							   const float bminx, const float cs,
+							   float* smin, float* smax, int* valid)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 cx = _mm_add_ps(_mm_set1_ps(bminx),
+								 _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x), _mm_set_epi32(3, 2, 1, 0))),
+											_mm_set1_ps(cs)));
+	const __m128 cx2 = _mm_add_ps(cx, _mm_set1_ps(cs));
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 ncx = _mm_xor_ps(cx, signMask);
+	
+	// Clip against the plane x >= cx.
+	__m128 d1[7];
+	for (int i = 0; i < nvrow; ++i)
+		d1[i] = _mm_add_ps(_mm_set1_ps(1.0f*inrow[i*3+0] + 0.0f*inrow[i*3+2]), ncx);
+	
+	__m128 px[14], py[14], pm[14];
+	int np = 0;
+	__m128i count1 = _mm_setzero_si128();
+	for (int i = 0, j = nvrow-1; i < nvrow; j=i, ++i)
+	{
+		const __m128 ina = _mm_cmpge_ps(d1[j], zero);
+		const __m128 inb = _mm_cmpge_ps(d1[i], zero);
+		const __m128 cross = _mm_xor_ps(ina, inb);
+		const __m128 xj = _mm_set1_ps(inrow[j*3+0]), yj = _mm_set1_ps(inrow[j*3+1]);
+		const __m128 xi = _mm_set1_ps(inrow[i*3+0]), yi = _mm_set1_ps(inrow[i*3+1]);
+		if (_mm_movemask_ps(cross))
+		{
+			const __m128 t = _mm_div_ps(d1[j], _mm_sub_ps(d1[j], d1[i]));
+			px[np] = _mm_add_ps(xj, _mm_mul_ps(_mm_sub_ps(xi, xj), t));
+			py[np] = _mm_add_ps(yj, _mm_mul_ps(_mm_sub_ps(yi, yj), t));
+			pm[np] = cross;
+			np++;
+			count1 = _mm_sub_epi32(count1, _mm_castps_si128(cross));
+		}
+		if (_mm_movemask_ps(inb))
+		{
+			px[np] = xi;
+			py[np] = yi;
+			pm[np] = inb;
+			np++;
+			count1 = _mm_sub_epi32(count1, _mm_castps_si128(inb));
+		}
+	}
+	
+	// Clip against the plane x <= cx+cs, starting from the last valid vertex of each lane.
+	__m128 d2[14];
+	__m128 prevd = zero, prevy = zero;
+	for (int i = 0; i < np; ++i)
+	{
+		d2[i] = _mm_add_ps(_mm_xor_ps(px[i], signMask), cx2);
+		prevd = _mm_or_ps(_mm_and_ps(pm[i], d2[i]), _mm_andnot_ps(pm[i], prevd));
+		prevy = _mm_or_ps(_mm_and_ps(pm[i], py[i]), _mm_andnot_ps(pm[i], prevy));
+	}
+	
+	__m128 ymin = _mm_set1_ps(FLT_MAX);
+	__m128 ymax = _mm_set1_ps(-FLT_MAX);
+	__m128i count2 = _mm_setzero_si128();
+	for (int i = 0; i < np; ++i)
+	{
+		const __m128 ina = _mm_cmpge_ps(prevd, zero);
+		const __m128 inb = _mm_cmpge_ps(d2[i], zero);
+		const __m128 cross = _mm_and_ps(pm[i], _mm_xor_ps(ina, inb));
+		const __m128 keep = _mm_and_ps(pm[i], inb);
+		if (_mm_movemask_ps(cross))
+		{
+			const __m128 t = _mm_div_ps(prevd, _mm_sub_ps(prevd, d2[i]));
+			const __m128 y = _mm_add_ps(prevy, _mm_mul_ps(_mm_sub_ps(py[i], prevy), t));
+			ymin = _mm_or_ps(_mm_and_ps(cross, _mm_min_ps(ymin, y)), _mm_andnot_ps(cross, ymin));
+			ymax = _mm_or_ps(_mm_and_ps(cross, _mm_max_ps(ymax, y)), _mm_andnot_ps(cross, ymax));
+			count2 = _mm_sub_epi32(count2, _mm_castps_si128(cross));
+		}
+		ymin = _mm_or_ps(_mm_and_ps(keep, _mm_min_ps(ymin, py[i])), _mm_andnot_ps(keep, ymin));
+		ymax = _mm_or_ps(_mm_and_ps(keep, _mm_max_ps(ymax, py[i])), _mm_andnot_ps(keep, ymax));
+		count2 = _mm_sub_epi32(count2, _mm_castps_si128(keep));
+		prevd = _mm_or_ps(_mm_and_ps(pm[i], d2[i]), _mm_andnot_ps(pm[i], prevd));
+		prevy = _mm_or_ps(_mm_and_ps(pm[i], py[i]), _mm_andnot_ps(pm[i], prevy));
+	}
+	
+	// The scalar path skips the cell when either clip leaves less than 3 vertices.
+	const __m128i three = _mm_set1_epi32(2);
+	const __m128i ok = _mm_and_si128(_mm_cmpgt_epi32(count1, three), _mm_cmpgt_epi32(count2, three));
+	_mm_storeu_ps(smin, ymin);
+	_mm_storeu_ps(smax, ymax);
+	_mm_storeu_si128((__m128i*)valid, ok);
+}
+
+#endif
+
 static void rasterizeTri(const float* v0, const float* v1, const float* v2,
 						 const unsigned char area, rcHeightfield& hf,
 						 const float* bmin, const float* bmax,
 						 const float cs, const float ics, const float ich,
-						 const int flagMergeThr)
+						 const int flagMergeThr, const bool simd,
+						 const int rowMin, const int rowMax)
 {
 	const int w = hf.width;
 	const int h = hf.height;
@@ -231,6 +355,8 @@ static void rasterizeTri(const float* v0, const float* v1, const float* v2,
 	y0 = rcClamp(y0, 0, h-1);
 	x1 = rcClamp(x1, 0, w-1);
 	y1 = rcClamp(y1, 0, h-1);
+	y0 = rcMax(y0, rowMin);
+	y1 = rcMin(y1, rowMax);
 	
 	// Clip the triangle into all grid cells it touches.
 	float in[7*3], out[7*3], inrow[7*3];
@@ -248,6 +374,25 @@ static void rasterizeTri(const float* v0, const float* v1, const float* v2,
 		nvrow = clipPoly(out, nvrow, inrow, 0, -1, cz+cs);
 		if (nvrow < 3) continue;
 		
+#ifdef RC_RASTERIZE_SSE2
+		if (simd)
+		{
+			for (int x = x0; x <= x1; x += 4)
+			{
+				float smin[4], smax[4];
+				int valid[4];
+				clipRowColumnsSSE2(inrow, nvrow, x, bmin[0], cs, smin, smax, valid);
+				const int n = rcMin(4, x1-x+1);
+				for (int k = 0; k < n; ++k)
+				{
+					if (valid[k])
+						addClippedSpan(hf, x+k, y, smin[k], smax[k], bmin, by, ich, area, flagMergeThr);
+				}
+			}
+			continue;
+		}
+#endif
+		
 		for (int x = x0; x <= x1; ++x)
 		{
 			// Clip polygon to column.
@@ -265,20 +410,7 @@ static void rasterizeTri(const float* v0, const float* v1, const float* v2,
 				smin = rcMin(smin, in[i*3+1]);
 				smax = rcMax(smax, in[i*3+1]);
 			}
-			smin -= bmin[1];
-			smax -= bmin[1];
-			// Skip the span if it is outside the heightfield bbox
-			if (smax < 0.0f) continue;
-			if (smin > by) continue;
-			// Clamp the span to the heightfield bbox.
-			if (smin < 0.0f) smin = 0;
-			if (smax > by) smax = by;
-			
-			// Snap the span to the heightfield height grid.
-			unsigned short ismin = (unsigned short)rcClamp((int)floorf(smin * ich), 0, RC_SPAN_MAX_HEIGHT);
-			unsigned short ismax = (unsigned short)rcClamp((int)ceilf(smax * ich), (int)ismin+1, RC_SPAN_MAX_HEIGHT);
-			
-			addSpan(hf, x, y, ismin, ismax, area, flagMergeThr);
+			addClippedSpan(hf, x, y, smin, smax, bmin, by, ich, area, flagMergeThr);
 		}
 	}
 }
@@ -298,15 +430,194 @@ void rcRasterizeTriangle(rcContext* ctx, const float* v0, const float* v1, const
 
 	const float ics = 1.0f/solid.cs;
 	const float ich = 1.0f/solid.ch;
-	rasterizeTri(v0, v1, v2, area, solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr);
+	rasterizeTri(v0, v1, v2, area, solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr, ctx->isSimdEnabled(), 0, solid.height-1);
 
 	ctx->stopTimer(RC_TIMER_RASTERIZE_TRIANGLES);
 }
 
+struct rcRasterizeJob
+{
+	const float* verts;
+	const int* tris;				// Triangle indices, or null.
+	const unsigned short* stris;	// Triangle indices, or null.
+	const unsigned char* areas;
+	int flagMergeThr;
+	bool simd;
+	float ics, ich;
+	int bandHeight;
+	rcHeightfield* bands;			// One heightfield per band, sharing the columns of the solid.
+	const int* binStart;
+	const int* bins;				// The triangles overlapping each band, in order.
+};
+
+static inline void getTriangle(const rcRasterizeJob& job, const int i,
+							   const float*& v0, const float*& v1, const float*& v2)
+{
+	if (job.tris)
+	{
+		v0 = &job.verts[job.tris[i*3+0]*3];
+		v1 = &job.verts[job.tris[i*3+1]*3];
+		v2 = &job.verts[job.tris[i*3+2]*3];
+	}
+	else if (job.stris)
+	{
+		v0 = &job.verts[job.stris[i*3+0]*3];
+		v1 = &job.verts[job.stris[i*3+1]*3];
+		v2 = &job.verts[job.stris[i*3+2]*3];
+	}
+	else
+	{
+		v0 = &job.verts[(i*3+0)*3];
+		v1 = &job.verts[(i*3+1)*3];
+		v2 = &job.verts[(i*3+2)*3];
+	}
+}
+
+static void rasterizeBand(void* arg, const int band, const int /*worker*/)
+{
+	const rcRasterizeJob& job = *(const rcRasterizeJob*)arg;
+	rcHeightfield& hf = job.bands[band];
+	const int rowMin = band*job.bandHeight;
+	const int rowMax = rcMin(rowMin + job.bandHeight, hf.height) - 1;
+	
+	for (int j = job.binStart[band]; j < job.binStart[band+1]; ++j)
+	{
+		const int i = job.bins[j];
+		const float *v0, *v1, *v2;
+		getTriangle(job, i, v0, v1, v2);
+		rasterizeTri(v0, v1, v2, job.areas[i], hf, hf.bmin, hf.bmax, hf.cs, job.ics, job.ich,
+					 job.flagMergeThr, job.simd, rowMin, rowMax);
+	}
+}
+
+// Splits the heightfield in bands of rows and rasterizes them in parallel. Each band
+// allocates its spans from its own pools, which are handed over to the heightfield once
+// the band is done. The triangles of a band are rasterized in their original order, so
+// the spans are merged exactly as when rasterizing sequentially.
+static bool rasterizeTrianglesParallel(rcContext* ctx, rcRasterizeJob& job, const int nt, rcHeightfield& solid)
+{
+	const int h = solid.height;
+	const int nbands = rcMin(h, ctx->getWorkerCount()*4);
+	if (nbands < 2)
+		return false;
+	job.bandHeight = (h + nbands-1) / nbands;
+	const int nb = (h + job.bandHeight-1) / job.bandHeight;
+	
+	// Find the bands overlapped by each triangle.
+	rcScopedDelete<int> binStart = (int*)rcAlloc(sizeof(int)*(nb+1), RC_ALLOC_TEMP);
+	rcScopedDelete<int> triBands = (int*)rcAlloc(sizeof(int)*nt*2, RC_ALLOC_TEMP);
+	rcScopedDelete<rcHeightfield> bands = (rcHeightfield*)rcAlloc(sizeof(rcHeightfield)*nb, RC_ALLOC_TEMP);
+	if (!binStart || !triBands || !bands)
+		return false;
+	
+	memset((int*)binStart, 0, sizeof(int)*(nb+1));
+	int nbins = 0;
+	for (int i = 0; i < nt; ++i)
+	{
+		const float *v0, *v1, *v2;
+		getTriangle(job, i, v0, v1, v2);
+		const float zmin = rcMin(v0[2], rcMin(v1[2], v2[2]));
+		const float zmax = rcMax(v0[2], rcMax(v1[2], v2[2]));
+		int b0 = 0, b1 = -1;
+		if (zmax >= solid.bmin[2] && zmin <= solid.bmax[2])
+		{
+			const int y0 = rcClamp((int)((zmin - solid.bmin[2])*job.ics), 0, h-1);
+			const int y1 = rcClamp((int)((zmax - solid.bmin[2])*job.ics), 0, h-1);
+			b0 = y0 / job.bandHeight;
+			b1 = y1 / job.bandHeight;
+		}
+		triBands[i*2+0] = b0;
+		triBands[i*2+1] = b1;
+		for (int b = b0; b <= b1; ++b)
+			binStart[b+1]++;
+		nbins += b1-b0+1;
+	}
+	for (int b = 0; b < nb; ++b)
+		binStart[b+1] += binStart[b];
+	
+	rcScopedDelete<int> bins = (int*)rcAlloc(sizeof(int)*rcMax(nbins, 1), RC_ALLOC_TEMP);
+	rcScopedDelete<int> next = (int*)rcAlloc(sizeof(int)*nb, RC_ALLOC_TEMP);
+	if (!bins || !next)
+		return false;
+	memcpy((int*)next, (int*)binStart, sizeof(int)*nb);
+	for (int i = 0; i < nt; ++i)
+	{
+		for (int b = triBands[i*2+0]; b <= triBands[i*2+1]; ++b)
+			bins[next[b]++] = i;
+	}
+	
+	for (int b = 0; b < nb; ++b)
+	{
+		bands[b] = solid;
+		bands[b].pools = 0;
+		bands[b].freelist = 0;
+	}
+	job.bands = bands;
+	job.binStart = binStart;
+	job.bins = bins;
+	
+	ctx->parallelFor(rasterizeBand, &job, nb);
+	
+	// Hand the span pools of the bands over to the heightfield.
+	for (int b = 0; b < nb; ++b)
+	{
+		rcHeightfield& band = bands[b];
+		if (!band.pools)
+			continue;
+		rcSpanPool* lastPool = band.pools;
+		while (lastPool->next)
+			lastPool = lastPool->next;
+		lastPool->next = solid.pools;
+		solid.pools = band.pools;
+		
+		if (band.freelist)
+		{
+			rcSpan* last = band.freelist;
+			while (last->next)
+				last = last->next;
+			last->next = solid.freelist;
+			solid.freelist = band.freelist;
+		}
+	}
+	
+	return true;
+}
+
+static void rasterizeTriangles(rcContext* ctx, rcRasterizeJob& job, const int nt, rcHeightfield& solid)
+{
+	if (ctx->getWorkerCount() > 1 && rasterizeTrianglesParallel(ctx, job, nt, solid))
+		return;
+	
+	// Rasterize triangles.
+	for (int i = 0; i < nt; ++i)
+	{
+		const float *v0, *v1, *v2;
+		getTriangle(job, i, v0, v1, v2);
+		// Rasterize.
+		rasterizeTri(v0, v1, v2, job.areas[i], solid, solid.bmin, solid.bmax, solid.cs, job.ics, job.ich,
+					 job.flagMergeThr, job.simd, 0, solid.height-1);
+	}
+}
+
+static void initRasterizeJob(rcContext* ctx, rcRasterizeJob& job, const float* verts,
+							 const unsigned char* areas, const rcHeightfield& solid, const int flagMergeThr)
+{
+	memset(&job, 0, sizeof(job));
+	job.verts = verts;
+	job.areas = areas;
+	job.flagMergeThr = flagMergeThr;
+	job.simd = ctx->isSimdEnabled();
+	job.ics = 1.0f/solid.cs;
+	job.ich = 1.0f/solid.ch;
+}
+
 /// @par
 ///
 /// Spans will only be added for triangles that overlap the heightfield grid.
 ///
+/// When the context provides several workers, the heightfield is split in bands
+/// of rows rasterized in parallel. (See: #rcContext::parallelFor)
+///
 /// @see rcHeightfield
 void rcRasterizeTriangles(rcContext* ctx, const float* verts, const int /*nv*/,
 						  const int* tris, const unsigned char* areas, const int nt,
@@ -316,17 +627,10 @@ void rcRasterizeTriangles(rcContext* ctx, const float* verts, const int /*nv*/,
 
 	ctx->startTimer(RC_TIMER_RASTERIZE_TRIANGLES);
 	
-	const float ics = 1.0f/solid.cs;
-	const float ich = 1.0f/solid.ch;
-	// Rasterize triangles.
-	for (int i = 0; i < nt; ++i)
-	{
-		const float* v0 = &verts[tris[i*3+0]*3];
-		const float* v1 = &verts[tris[i*3+1]*3];
-		const float* v2 = &verts[tris[i*3+2]*3];
-		// Rasterize.
-		rasterizeTri(v0, v1, v2, areas[i], solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr);
-	}
+	rcRasterizeJob job;
+	initRasterizeJob(ctx, job, verts, areas, solid, flagMergeThr);
+	job.tris = tris;
+	rasterizeTriangles(ctx, job, nt, solid);
 	
 	ctx->stopTimer(RC_TIMER_RASTERIZE_TRIANGLES);
 }
@@ -335,6 +639,9 @@ void rcRasterizeTriangles(rcContext* ctx, const float* verts, const int /*nv*/,
 ///
 /// Spans will only be added for triangles that overlap the heightfield grid.
 ///
+/// When the context provides several workers, the heightfield is split in bands
+/// of rows rasterized in parallel. (See: #rcContext::parallelFor)
+///
 /// @see rcHeightfield
 void rcRasterizeTriangles(rcContext* ctx, const float* verts, const int /*nv*/,
 						  const unsigned short* tris, const unsigned char* areas, const int nt,
@@ -344,17 +651,10 @@ void rcRasterizeTriangles(rcContext* ctx, const float* verts, const int /*nv*/,
 
 	ctx->startTimer(RC_TIMER_RASTERIZE_TRIANGLES);
 	
-	const float ics = 1.0f/solid.cs;
-	const float ich = 1.0f/solid.ch;
-	// Rasterize triangles.
-	for (int i = 0; i < nt; ++i)
-	{
-		const float* v0 = &verts[tris[i*3+0]*3];
-		const float* v1 = &verts[tris[i*3+1]*3];
-		const float* v2 = &verts[tris[i*3+2]*3];
-		// Rasterize.
-		rasterizeTri(v0, v1, v2, areas[i], solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr);
-	}
+	rcRasterizeJob job;
+	initRasterizeJob(ctx, job, verts, areas, solid, flagMergeThr);
+	job.stris = tris;
+	rasterizeTriangles(ctx, job, nt, solid);
 	
 	ctx->stopTimer(RC_TIMER_RASTERIZE_TRIANGLES);
 }
@@ -363,6 +663,9 @@ void rcRasterizeTriangles(rcContext* ctx, const float* verts, const int /*nv*/,
 ///
 /// Spans will only be added for triangles that overlap the heightfield grid.
 ///
+/// When the context provides several workers, the heightfield is split in bands
+/// of rows rasterized in parallel. (See: #rcContext::parallelFor)
+///
 /// @see rcHeightfield
 void rcRasterizeTriangles(rcContext* ctx, const float* verts, const unsigned char* areas, const int nt,
 						  rcHeightfield& solid, const int flagMergeThr)
@@ -371,17 +674,9 @@ void rcRasterizeTriangles(rcContext* ctx, const float* verts, const unsigned cha
 	
 	ctx->startTimer(RC_TIMER_RASTERIZE_TRIANGLES);
 	
-	const float ics = 1.0f/solid.cs;
-	const float ich = 1.0f/solid.ch;
-	// Rasterize triangles.
-	for (int i = 0; i < nt; ++i)
-	{
-		const float* v0 = &verts[(i*3+0)*3];
-		const float* v1 = &verts[(i*3+1)*3];
-		const float* v2 = &verts[(i*3+2)*3];
-		// Rasterize.
-		rasterizeTri(v0, v1, v2, areas[i], solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr);
-	}
+	rcRasterizeJob job;
+	initRasterizeJob(ctx, job, verts, areas, solid, flagMergeThr);
+	rasterizeTriangles(ctx, job, nt, solid);
 	
 	ctx->stopTimer(RC_TIMER_RASTERIZE_TRIANGLES);
 }
@@ -28,152 +28,247 @@
 #include <new>
 
 
-static void calculateDistanceField(rcCompactHeightfield& chf, unsigned short* src, unsigned short& maxDist)
+/// The size of the tiles the distance field sweeps are split in. [Units: vx]
+static const int RC_DISTANCE_TILE_SIZE = 64;
+
+struct rcDistanceFieldJob
+{
+	const rcCompactHeightfield* chf;
+	unsigned short* src;
+	unsigned short* dst;
+	int thr;
+	int ntiles;		// The number of tiles along the skewed x-axis.
+	int wave;
+	int firstTile;	// The first tile row of the current wave.
+};
+
+static void markBoundaryRow(void* arg, const int y, const int /*worker*/)
 {
+	const rcDistanceFieldJob* job = (const rcDistanceFieldJob*)arg;
+	const rcCompactHeightfield& chf = *job->chf;
+	unsigned short* src = job->src;
 	const int w = chf.width;
-	const int h = chf.height;
-	
-	// Init distance and points.
-	for (int i = 0; i < chf.spanCount; ++i)
-		src[i] = 0xffff;
 	
-	// Mark boundary cells.
-	for (int y = 0; y < h; ++y)
+	for (int x = 0; x < w; ++x)
 	{
-		for (int x = 0; x < w; ++x)
+		const rcCompactCell& c = chf.cells[x+y*w];
+		for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			const rcCompactSpan& s = chf.spans[i];
+			const unsigned char area = chf.areas[i];
+			
+			int nc = 0;
+			for (int dir = 0; dir < 4; ++dir)
 			{
-				const rcCompactSpan& s = chf.spans[i];
-				const unsigned char area = chf.areas[i];
-				
-				int nc = 0;
-				for (int dir = 0; dir < 4; ++dir)
+				if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
 				{
-					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-					{
-						const int ax = x + rcGetDirOffsetX(dir);
-						const int ay = y + rcGetDirOffsetY(dir);
-						const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
-						if (area == chf.areas[ai])
-							nc++;
-					}
+					const int ax = x + rcGetDirOffsetX(dir);
+					const int ay = y + rcGetDirOffsetY(dir);
+					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
+					if (area == chf.areas[ai])
+						nc++;
 				}
-				if (nc != 4)
-					src[i] = 0;
 			}
+			src[i] = nc != 4 ? 0 : 0xffff;
 		}
 	}
-	
-			
-	// Pass 1
-	for (int y = 0; y < h; ++y)
+}
+
+// Pass 1: the cell depends on its (-1,0), (-1,-1), (0,-1) and (1,-1) neighbours.
+static inline void sweepForward(const rcCompactHeightfield& chf, unsigned short* src, const int x, const int y)
+{
+	const int w = chf.width;
+	const rcCompactCell& c = chf.cells[x+y*w];
+	for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 	{
-		for (int x = 0; x < w; ++x)
+		const rcCompactSpan& s = chf.spans[i];
+		
+		if (rcGetCon(s, 0) != RC_NOT_CONNECTED)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			// (-1,0)
+			const int ax = x + rcGetDirOffsetX(0);
+			const int ay = y + rcGetDirOffsetY(0);
+			const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 0);
+			const rcCompactSpan& as = chf.spans[ai];
+			if (src[ai]+2 < src[i])
+				src[i] = src[ai]+2;
+			
+			// (-1,-1)
+			if (rcGetCon(as, 3) != RC_NOT_CONNECTED)
 			{
-				const rcCompactSpan& s = chf.spans[i];
-				
-				if (rcGetCon(s, 0) != RC_NOT_CONNECTED)
-				{
-					// (-1,0)
-					const int ax = x + rcGetDirOffsetX(0);
-					const int ay = y + rcGetDirOffsetY(0);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 0);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (-1,-1)
-					if (rcGetCon(as, 3) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(3);
-						const int aay = ay + rcGetDirOffsetY(3);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 3);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
-				}
-				if (rcGetCon(s, 3) != RC_NOT_CONNECTED)
-				{
-					// (0,-1)
-					const int ax = x + rcGetDirOffsetX(3);
-					const int ay = y + rcGetDirOffsetY(3);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 3);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (1,-1)
-					if (rcGetCon(as, 2) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(2);
-						const int aay = ay + rcGetDirOffsetY(2);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 2);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
-				}
+				const int aax = ax + rcGetDirOffsetX(3);
+				const int aay = ay + rcGetDirOffsetY(3);
+				const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 3);
+				if (src[aai]+3 < src[i])
+					src[i] = src[aai]+3;
+			}
+		}
+		if (rcGetCon(s, 3) != RC_NOT_CONNECTED)
+		{
+			// (0,-1)
+			const int ax = x + rcGetDirOffsetX(3);
+			const int ay = y + rcGetDirOffsetY(3);
+			const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 3);
+			const rcCompactSpan& as = chf.spans[ai];
+			if (src[ai]+2 < src[i])
+				src[i] = src[ai]+2;
+			
+			// (1,-1)
+			if (rcGetCon(as, 2) != RC_NOT_CONNECTED)
+			{
+				const int aax = ax + rcGetDirOffsetX(2);
+				const int aay = ay + rcGetDirOffsetY(2);
+				const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 2);
+				if (src[aai]+3 < src[i])
+					src[i] = src[aai]+3;
 			}
 		}
 	}
-	
-	// Pass 2
-	for (int y = h-1; y >= 0; --y)
+}
+
+// Pass 2: the cell depends on its (1,0), (1,1), (0,1) and (-1,1) neighbours.
+static inline void sweepBackward(const rcCompactHeightfield& chf, unsigned short* src, const int x, const int y)
+{
+	const int w = chf.width;
+	const rcCompactCell& c = chf.cells[x+y*w];
+	for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 	{
-		for (int x = w-1; x >= 0; --x)
+		const rcCompactSpan& s = chf.spans[i];
+		
+		if (rcGetCon(s, 2) != RC_NOT_CONNECTED)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			// (1,0)
+			const int ax = x + rcGetDirOffsetX(2);
+			const int ay = y + rcGetDirOffsetY(2);
+			const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 2);
+			const rcCompactSpan& as = chf.spans[ai];
+			if (src[ai]+2 < src[i])
+				src[i] = src[ai]+2;
+			
+			// (1,1)
+			if (rcGetCon(as, 1) != RC_NOT_CONNECTED)
 			{
-				const rcCompactSpan& s = chf.spans[i];
-				
-				if (rcGetCon(s, 2) != RC_NOT_CONNECTED)
-				{
-					// (1,0)
-					const int ax = x + rcGetDirOffsetX(2);
-					const int ay = y + rcGetDirOffsetY(2);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 2);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (1,1)
-					if (rcGetCon(as, 1) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(1);
-						const int aay = ay + rcGetDirOffsetY(1);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 1);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
-				}
-				if (rcGetCon(s, 1) != RC_NOT_CONNECTED)
-				{
-					// (0,1)
-					const int ax = x + rcGetDirOffsetX(1);
-					const int ay = y + rcGetDirOffsetY(1);
-					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 1);
-					const rcCompactSpan& as = chf.spans[ai];
-					if (src[ai]+2 < src[i])
-						src[i] = src[ai]+2;
-					
-					// (-1,1)
-					if (rcGetCon(as, 0) != RC_NOT_CONNECTED)
-					{
-						const int aax = ax + rcGetDirOffsetX(0);
-						const int aay = ay + rcGetDirOffsetY(0);
-						const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 0);
-						if (src[aai]+3 < src[i])
-							src[i] = src[aai]+3;
-					}
-				}
+				const int aax = ax + rcGetDirOffsetX(1);
+				const int aay = ay + rcGetDirOffsetY(1);
+				const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 1);
+				if (src[aai]+3 < src[i])
+					src[i] = src[aai]+3;
 			}
 		}
-	}	
+		if (rcGetCon(s, 1) != RC_NOT_CONNECTED)
+		{
+			// (0,1)
+			const int ax = x + rcGetDirOffsetX(1);
+			const int ay = y + rcGetDirOffsetY(1);
+			const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, 1);
+			const rcCompactSpan& as = chf.spans[ai];
+			if (src[ai]+2 < src[i])
+				src[i] = src[ai]+2;
+			
+			// (-1,1)
+			if (rcGetCon(as, 0) != RC_NOT_CONNECTED)
+			{
+				const int aax = ax + rcGetDirOffsetX(0);
+				const int aay = ay + rcGetDirOffsetY(0);
+				const int aai = (int)chf.cells[aax+aay*w].index + rcGetCon(as, 0);
+				if (src[aai]+3 < src[i])
+					src[i] = src[aai]+3;
+			}
+		}
+	}
+}
+
+// Sweeps a tile of the skewed grid (u, v), where u = x+y and v = y for the forward pass, and
+// u = (w-1-x)+(h-1-y) and v = h-1-y for the backward pass. In this grid a cell only depends on
+// cells with smaller or equal coordinates, so the tiles of the same wave (tu+tv) are independent.
+static void sweepTile(void* arg, const int index, const int /*worker*/, const bool forward)
+{
+	const rcDistanceFieldJob* job = (const rcDistanceFieldJob*)arg;
+	const rcCompactHeightfield& chf = *job->chf;
+	const int w = chf.width;
+	const int h = chf.height;
+	
+	const int tv = job->firstTile + index;
+	const int tu = job->wave - tv;
+	const int umin = tu*RC_DISTANCE_TILE_SIZE;
+	const int umax = umin + RC_DISTANCE_TILE_SIZE;
+	const int vmax = rcMin(h, (tv+1)*RC_DISTANCE_TILE_SIZE);
+	
+	for (int v = tv*RC_DISTANCE_TILE_SIZE; v < vmax; ++v)
+	{
+		const int xmin = rcMax(umin - v, 0);
+		const int xmax = rcMin(umax - v, w);
+		if (forward)
+		{
+			for (int x = xmin; x < xmax; ++x)
+				sweepForward(chf, job->src, x, v);
+		}
+		else
+		{
+			for (int x = xmin; x < xmax; ++x)
+				sweepBackward(chf, job->src, w-1-x, h-1-v);
+		}
+	}
+}
+
+static void sweepForwardTile(void* arg, const int index, const int worker)
+{
+	sweepTile(arg, index, worker, true);
+}
+
+static void sweepBackwardTile(void* arg, const int index, const int worker)
+{
+	sweepTile(arg, index, worker, false);
+}
+
+static void sweepWaves(rcContext* ctx, rcDistanceFieldJob& job, rcParallelForFunc* func)
+{
+	const int h = job.chf->height;
+	const int ntv = (h + RC_DISTANCE_TILE_SIZE-1) / RC_DISTANCE_TILE_SIZE;
+	
+	for (int wave = 0; wave < job.ntiles + ntv - 1; ++wave)
+	{
+		const int first = rcMax(0, wave - job.ntiles + 1);
+		const int last = rcMin(wave, ntv - 1);
+		job.wave = wave;
+		job.firstTile = first;
+		ctx->parallelFor(func, &job, last - first + 1);
+	}
+}
+
+static void calculateDistanceField(rcContext* ctx, rcCompactHeightfield& chf, unsigned short* src, unsigned short& maxDist)
+{
+	const int w = chf.width;
+	const int h = chf.height;
+	
+	rcDistanceFieldJob job;
+	memset(&job, 0, sizeof(job));
+	job.chf = &chf;
+	job.src = src;
+	
+	// Init distance and mark boundary cells.
+	ctx->parallelFor(markBoundaryRow, &job, h);
+	
+	if (ctx->getWorkerCount() > 1)
+	{
+		// The sweeps visit each cell after the same neighbours as the serial
+		// sweeps below, so the result is the same.
+		job.ntiles = (w + h - 1 + RC_DISTANCE_TILE_SIZE-1) / RC_DISTANCE_TILE_SIZE;
+		sweepWaves(ctx, job, sweepForwardTile);
+		sweepWaves(ctx, job, sweepBackwardTile);
+	}
+	else
+	{
+		// Pass 1
+		for (int y = 0; y < h; ++y)
+			for (int x = 0; x < w; ++x)
+				sweepForward(chf, src, x, y);
+		
+		// Pass 2
+		for (int y = h-1; y >= 0; --y)
+			for (int x = w-1; x >= 0; --x)
+				sweepBackward(chf, src, x, y);
+	}
 	
 	maxDist = 0;
 	for (int i = 0; i < chf.spanCount; ++i)
@@ -181,62 +276,75 @@ static void calculateDistanceField(rcCompactHeightfield& chf, unsigned short* sr
 	
 }
 
-static unsigned short* boxBlur(rcCompactHeightfield& chf, int thr,
-							   unsigned short* src, unsigned short* dst)
+static void boxBlurRow(void* arg, const int y, const int /*worker*/)
 {
+	const rcDistanceFieldJob* job = (const rcDistanceFieldJob*)arg;
+	const rcCompactHeightfield& chf = *job->chf;
+	const unsigned short* src = job->src;
+	unsigned short* dst = job->dst;
+	const int thr = job->thr;
 	const int w = chf.width;
-	const int h = chf.height;
-	
-	thr *= 2;
 	
-	for (int y = 0; y < h; ++y)
+	for (int x = 0; x < w; ++x)
 	{
-		for (int x = 0; x < w; ++x)
+		const rcCompactCell& c = chf.cells[x+y*w];
+		for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			const rcCompactSpan& s = chf.spans[i];
+			const unsigned short cd = src[i];
+			if (cd <= thr)
 			{
-				const rcCompactSpan& s = chf.spans[i];
-				const unsigned short cd = src[i];
-				if (cd <= thr)
-				{
-					dst[i] = cd;
-					continue;
-				}
+				dst[i] = cd;
+				continue;
+			}
 
-				int d = (int)cd;
-				for (int dir = 0; dir < 4; ++dir)
+			int d = (int)cd;
+			for (int dir = 0; dir < 4; ++dir)
+			{
+				if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
 				{
-					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
+					const int ax = x + rcGetDirOffsetX(dir);
+					const int ay = y + rcGetDirOffsetY(dir);
+					const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
+					d += (int)src[ai];
+					
+					const rcCompactSpan& as = chf.spans[ai];
+					const int dir2 = (dir+1) & 0x3;
+					if (rcGetCon(as, dir2) != RC_NOT_CONNECTED)
 					{
-						const int ax = x + rcGetDirOffsetX(dir);
-						const int ay = y + rcGetDirOffsetY(dir);
-						const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
-						d += (int)src[ai];
-						
-						const rcCompactSpan& as = chf.spans[ai];
-						const int dir2 = (dir+1) & 0x3;
-						if (rcGetCon(as, dir2) != RC_NOT_CONNECTED)
-						{
-							const int ax2 = ax + rcGetDirOffsetX(dir2);
-							const int ay2 = ay + rcGetDirOffsetY(dir2);
-							const int ai2 = (int)chf.cells[ax2+ay2*w].index + rcGetCon(as, dir2);
-							d += (int)src[ai2];
-						}
-						else
-						{
-							d += cd;
-						}
+						const int ax2 = ax + rcGetDirOffsetX(dir2);
+						const int ay2 = ay + rcGetDirOffsetY(dir2);
+						const int ai2 = (int)chf.cells[ax2+ay2*w].index + rcGetCon(as, dir2);
+						d += (int)src[ai2];
 					}
 					else
 					{
-						d += cd*2;
+						d += cd;
 					}
 				}
-				dst[i] = (unsigned short)((d+5)/9);
+				else
+				{
+					d += cd*2;
+				}
 			}
+			dst[i] = (unsigned short)((d+5)/9);
 		}
 	}
+}
+
+static unsigned short* boxBlur(rcContext* ctx, rcCompactHeightfield& chf, int thr,
+							   unsigned short* src, unsigned short* dst)
+{
+	rcDistanceFieldJob job;
+	memset(&job, 0, sizeof(job));
+	job.chf = &chf;
+	job.src = src;
+	job.dst = dst;
+	job.thr = thr*2;
+	
+	// The rows only read the source, so they are blurred independently.
+	ctx->parallelFor(boxBlurRow, &job, chf.height);
+	
 	return dst;
 }
 
@@ -336,41 +444,21 @@ static bool floodRegion(int x, int y, int i,
 	return count > 0;
 }
 
-static unsigned short* expandRegions(int maxIter, unsigned short level,
-									 rcCompactHeightfield& chf,
-									 unsigned short* srcReg, unsigned short* srcDist,
-									 unsigned short* dstReg, unsigned short* dstDist, 
-									 rcIntArray& stack)
+static void expandRegions(int maxIter, unsigned short level,
+						  rcCompactHeightfield& chf,
+						  unsigned short* srcReg, unsigned short* srcDist,
+						  rcIntArray& stack, rcIntArray& dirty)
 {
 	const int w = chf.width;
-	const int h = chf.height;
 
-	// Find cells revealed by the raised level.
-	stack.resize(0);
-	for (int y = 0; y < h; ++y)
-	{
-		for (int x = 0; x < w; ++x)
-		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				if (chf.dist[i] >= level && srcReg[i] == 0 && chf.areas[i] != RC_NULL_AREA)
-				{
-					stack.push(x);
-					stack.push(y);
-					stack.push(i);
-				}
-			}
-		}
-	}
-	
 	int iter = 0;
 	while (stack.size() > 0)
 	{
 		int failed = 0;
 		
-		memcpy(dstReg, srcReg, sizeof(unsigned short)*chf.spanCount);
-		memcpy(dstDist, srcDist, sizeof(unsigned short)*chf.spanCount);
+		// The cells of an iteration only see the regions of the previous one,
+		// so the new regions are collected and applied after the pass.
+		dirty.resize(0);
 		
 		for (int j = 0; j < stack.size(); j += 3)
 		{
@@ -406,8 +494,9 @@ static unsigned short* expandRegions(int maxIter, unsigned short level,
 			if (r)
 			{
 				stack[j+2] = -1; // mark as used
-				dstReg[i] = r;
-				dstDist[i] = d2;
+				dirty.push(i);
+				dirty.push(r);
+				dirty.push(d2);
 			}
 			else
 			{
@@ -415,9 +504,12 @@ static unsigned short* expandRegions(int maxIter, unsigned short level,
 			}
 		}
 		
-		// rcSwap source and dest.
-		rcSwap(srcReg, dstReg);
-		rcSwap(srcDist, dstDist);
+		for (int j = 0; j < dirty.size(); j += 3)
+		{
+			const int i = dirty[j+0];
+			srcReg[i] = (unsigned short)dirty[j+1];
+			srcDist[i] = (unsigned short)dirty[j+2];
+		}
 		
 		if (failed*3 == stack.size())
 			break;
@@ -429,8 +521,107 @@ static unsigned short* expandRegions(int maxIter, unsigned short level,
 				break;
 		}
 	}
+}
+
+// Bins the walkable spans by the watershed level revealing them. The bin k holds the
+// spans revealed at the level (startLevel - 2*(k+1)), as (x, y, i) triplets in scan order.
+static void sortCellsByLevel(const unsigned short startLevel, const rcCompactHeightfield& chf,
+							 const int nbins, int* binStart, int* cells)
+{
+	const int w = chf.width;
+	const int h = chf.height;
+	const int lastLevel = startLevel >= 2 ? startLevel-2 : 0;
+	
+	memset(binStart, 0, sizeof(int)*(nbins+1));
+	for (int i = 0; i < chf.spanCount; ++i)
+	{
+		if (chf.areas[i] == RC_NULL_AREA)
+			continue;
+		const int level = rcMin((int)chf.dist[i] & ~1, lastLevel);
+		binStart[(lastLevel - level)/2]++;
+	}
+	
+	// Turn the counts into the start of each bin.
+	int n = 0;
+	for (int k = 0; k < nbins; ++k)
+	{
+		const int count = binStart[k];
+		binStart[k] = n;
+		n += count;
+	}
+	binStart[nbins] = n;
+	
+	// Fill the bins, advancing the start of each bin, then restore the starts.
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			const rcCompactCell& c = chf.cells[x+y*w];
+			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			{
+				if (chf.areas[i] == RC_NULL_AREA)
+					continue;
+				const int level = rcMin((int)chf.dist[i] & ~1, lastLevel);
+				int* cell = &cells[binStart[(lastLevel - level)/2]++ * 3];
+				cell[0] = x;
+				cell[1] = y;
+				cell[2] = i;
+			}
+		}
+	}
+	for (int k = nbins; k > 0; --k)
+		binStart[k] = binStart[k-1];
+	binStart[0] = 0;
+}
+
+// Merges the cells of a bin into the cells still waiting for a region, keeping the scan order.
+// The cells which already belong to a region are dropped.
+static void mergeLevelCells(const int* cells, const int ncells, const unsigned short* srcReg,
+							rcIntArray& stack, rcIntArray& tmp)
+{
+	tmp.resize(0);
+	int j = 0;
+	int k = 0;
+	while (j < stack.size() || k < ncells)
+	{
+		const int* cell;
+		if (k >= ncells || (j < stack.size() && stack[j+2] < cells[k*3+2]))
+		{
+			cell = &stack[j];
+			j += 3;
+		}
+		else
+		{
+			cell = &cells[k*3];
+			k++;
+		}
+		if (srcReg[cell[2]] != 0)
+			continue;
+		tmp.push(cell[0]);
+		tmp.push(cell[1]);
+		tmp.push(cell[2]);
+	}
 	
-	return srcReg;
+	stack.resize(tmp.size());
+	if (tmp.size() > 0)
+		memcpy(&stack[0], &tmp[0], sizeof(int)*tmp.size());
+}
+
+// Removes the cells which got a region from the list of cells waiting for a region.
+static void removeAssignedCells(const unsigned short* srcReg, rcIntArray& stack)
+{
+	int n = 0;
+	for (int j = 0; j < stack.size(); j += 3)
+	{
+		const int i = stack[j+2];
+		if (i < 0 || srcReg[i] != 0)
+			continue;
+		stack[n+0] = stack[j+0];
+		stack[n+1] = stack[j+1];
+		stack[n+2] = i;
+		n += 3;
+	}
+	stack.resize(n);
 }
 
 
@@ -976,7 +1167,7 @@ bool rcBuildDistanceField(rcContext* ctx, rcCompactHeightfield& chf)
 
 	ctx->startTimer(RC_TIMER_BUILD_DISTANCEFIELD_DIST);
 	
-	calculateDistanceField(chf, src, maxDist);
+	calculateDistanceField(ctx, chf, src, maxDist);
 	chf.maxDistance = maxDist;
 	
 	ctx->stopTimer(RC_TIMER_BUILD_DISTANCEFIELD_DIST);
@@ -984,7 +1175,7 @@ bool rcBuildDistanceField(rcContext* ctx, rcCompactHeightfield& chf)
 	ctx->startTimer(RC_TIMER_BUILD_DISTANCEFIELD_BLUR);
 	
 	// Blur
-	if (boxBlur(chf, 1, src, dst) != src)
+	if (boxBlur(ctx, chf, 1, src, dst) != src)
 		rcSwap(src, dst);
 	
 	// Store distance.
@@ -1228,28 +1419,45 @@ bool rcBuildRegions(rcContext* ctx, rcCompactHeightfield& chf,
 	const int w = chf.width;
 	const int h = chf.height;
 	
-	rcScopedDelete<unsigned short> buf = (unsigned short*)rcAlloc(sizeof(unsigned short)*chf.spanCount*4, RC_ALLOC_TEMP);
+	rcScopedDelete<unsigned short> buf = (unsigned short*)rcAlloc(sizeof(unsigned short)*chf.spanCount*2, RC_ALLOC_TEMP);
 	if (!buf)
 	{
-		ctx->log(RC_LOG_ERROR, "rcBuildRegions: Out of memory 'tmp' (%d).", chf.spanCount*4);
+		ctx->log(RC_LOG_ERROR, "rcBuildRegions: Out of memory 'tmp' (%d).", chf.spanCount*2);
+		return false;
+	}
+	
+	unsigned short level = (chf.maxDistance+1) & ~1;
+	
+	// Each level only visits the spans it reveals, plus the ones left without a region.
+	const int nbins = rcMax(level/2, 1);
+	rcScopedDelete<int> binStart = (int*)rcAlloc(sizeof(int)*(nbins+1), RC_ALLOC_TEMP);
+	if (!binStart)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildRegions: Out of memory 'binStart' (%d).", nbins+1);
+		return false;
+	}
+	rcScopedDelete<int> cells = (int*)rcAlloc(sizeof(int)*chf.spanCount*3, RC_ALLOC_TEMP);
+	if (!cells)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildRegions: Out of memory 'cells' (%d).", chf.spanCount*3);
 		return false;
 	}
 	
 	ctx->startTimer(RC_TIMER_BUILD_REGIONS_WATERSHED);
 	
+	sortCellsByLevel(level, chf, nbins, binStart, cells);
+	
 	rcIntArray stack(1024);
-	rcIntArray visited(1024);
+	rcIntArray tmp(1024);
+	rcIntArray floodStack(1024);
 	
 	unsigned short* srcReg = buf;
 	unsigned short* srcDist = buf+chf.spanCount;
-	unsigned short* dstReg = buf+chf.spanCount*2;
-	unsigned short* dstDist = buf+chf.spanCount*3;
 	
 	memset(srcReg, 0, sizeof(unsigned short)*chf.spanCount);
 	memset(srcDist, 0, sizeof(unsigned short)*chf.spanCount);
 	
 	unsigned short regionId = 1;
-	unsigned short level = (chf.maxDistance+1) & ~1;
 
 	// TODO: Figure better formula, expandIters defines how much the 
 	// watershed "overflows" and simplifies the regions. Tying it to
@@ -1271,6 +1479,10 @@ bool rcBuildRegions(rcContext* ctx, rcCompactHeightfield& chf,
 		chf.borderSize = borderSize;
 	}
 	
+	// The stack holds the cells revealed so far which have no region, in scan order.
+	stack.resize(0);
+	int bin = 0;
+	
 	while (level > 0)
 	{
 		level = level >= 2 ? level-2 : 0;
@@ -1278,41 +1490,33 @@ bool rcBuildRegions(rcContext* ctx, rcCompactHeightfield& chf,
 		ctx->startTimer(RC_TIMER_BUILD_REGIONS_EXPAND);
 		
 		// Expand current regions until no empty connected cells found.
-		if (expandRegions(expandIters, level, chf, srcReg, srcDist, dstReg, dstDist, stack) != srcReg)
-		{
-			rcSwap(srcReg, dstReg);
-			rcSwap(srcDist, dstDist);
-		}
+		mergeLevelCells(&cells[binStart[bin]*3], binStart[bin+1]-binStart[bin], srcReg, stack, tmp);
+		bin++;
+		expandRegions(expandIters, level, chf, srcReg, srcDist, stack, tmp);
+		removeAssignedCells(srcReg, stack);
 		
 		ctx->stopTimer(RC_TIMER_BUILD_REGIONS_EXPAND);
 		
 		ctx->startTimer(RC_TIMER_BUILD_REGIONS_FLOOD);
 		
 		// Mark new regions with IDs.
-		for (int y = 0; y < h; ++y)
+		for (int j = 0; j < stack.size(); j += 3)
 		{
-			for (int x = 0; x < w; ++x)
-			{
-				const rcCompactCell& c = chf.cells[x+y*w];
-				for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-				{
-					if (chf.dist[i] < level || srcReg[i] != 0 || chf.areas[i] == RC_NULL_AREA)
-						continue;
-					if (floodRegion(x, y, i, level, regionId, chf, srcReg, srcDist, stack))
-						regionId++;
-				}
-			}
+			const int i = stack[j+2];
+			if (srcReg[i] != 0)
+				continue;
+			if (floodRegion(stack[j+0], stack[j+1], i, level, regionId, chf, srcReg, srcDist, floodStack))
+				regionId++;
 		}
+		removeAssignedCells(srcReg, stack);
 		
 		ctx->stopTimer(RC_TIMER_BUILD_REGIONS_FLOOD);
 	}
 	
 	// Expand current regions until no empty connected cells found.
-	if (expandRegions(expandIters*8, 0, chf, srcReg, srcDist, dstReg, dstDist, stack) != srcReg)
-	{
-		rcSwap(srcReg, dstReg);
-		rcSwap(srcDist, dstDist);
-	}
+	for (; bin < nbins; ++bin)
+		mergeLevelCells(&cells[binStart[bin]*3], binStart[bin+1]-binStart[bin], srcReg, stack, tmp);
+	expandRegions(expandIters*8, 0, chf, srcReg, srcDist, stack, tmp);
 	
 	ctx->stopTimer(RC_TIMER_BUILD_REGIONS_WATERSHED);
 	
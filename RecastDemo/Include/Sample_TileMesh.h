@@ -21,6 +21,7 @@
 
 #include "Sample.h"
 #include "DetourNavMesh.h"
+#include "DetourNavMeshSet.h"
 #include "Recast.h"
 #include "ChunkyTriMesh.h"
 
@@ -28,6 +29,7 @@ class Sample_TileMesh : public Sample
 {
 protected:
 	bool m_keepInterResults;
+	bool m_cacheCompactFields;
 	bool m_buildAll;
 	float m_totalBuildTimeMs;
 
@@ -74,10 +76,26 @@ protected:
 	float m_tileBuildTime;
 	float m_tileMemUsage;
 	int m_tileTriCount;
+	
+	dtNavMeshSetMapping m_navMeshSet;
+	
+	/// The eroded compact heightfield of a tile, before the convex volumes are marked.
+	struct CachedTile
+	{
+		rcCompactHeightfield* chf;
+		int triCount;
+	};
+	CachedTile* m_cachedTiles;
+	int m_cachedTilesWidth;
+	int m_cachedTilesHeight;
+	rcConfig m_cachedCfg;		///< The configuration the cached tiles were built with.
 
 	unsigned char* buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize);
+	bool buildTileCompactHeightfield();
+	CachedTile* getCachedTile(const int tx, const int ty);
 	
 	void cleanup();
+	void freeTileCache();
 	
 	void saveAll(const char* path, const dtNavMesh* mesh);
 	dtNavMesh* loadAll(const char* path);
@@ -635,6 +635,24 @@ dtObstacleRef hitTestObstacle(const dtTileCache* tc, const float* sp, const floa
 	return tc->getObstacleRef(obmin);
 }
 	
+static void drawObstacleOutline(duDebugDraw* dd, const float* verts, const int nverts,
+								const float hmin, const float hmax, unsigned int col)
+{
+	dd->begin(DU_DRAW_LINES, 2.0f);
+	for (int i = 0, j = nverts-1; i < nverts; j = i++)
+	{
+		const float* vi = &verts[i*3];
+		const float* vj = &verts[j*3];
+		dd->vertex(vj[0],hmin,vj[2], col);
+		dd->vertex(vi[0],hmin,vi[2], col);
+		dd->vertex(vj[0],hmax,vj[2], col);
+		dd->vertex(vi[0],hmax,vi[2], col);
+		dd->vertex(vi[0],hmin,vi[2], col);
+		dd->vertex(vi[0],hmax,vi[2], col);
+	}
+	dd->end();
+}
+
 void drawObstacles(duDebugDraw* dd, const dtTileCache* tc)
 {
 	// Draw obstacles
@@ -653,8 +671,36 @@ void drawObstacles(duDebugDraw* dd, const dtTileCache* tc)
 		else if (ob->state == DT_OBSTACLE_REMOVING)
 			col = duRGBA(220,0,0,128);
 
-		duDebugDrawCylinder(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], col);
-		duDebugDrawCylinderWire(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], duDarkenCol(col), 2);
+		if (ob->type == DT_OBSTACLE_CYLINDER)
+		{
+			duDebugDrawCylinder(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], col);
+			duDebugDrawCylinderWire(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], duDarkenCol(col), 2);
+		}
+		else if (ob->type == DT_OBSTACLE_BOX)
+		{
+			unsigned int fcol[6];
+			duCalcBoxColors(fcol, col, col);
+			duDebugDrawBox(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], fcol);
+			duDebugDrawBoxWire(dd, bmin[0],bmin[1],bmin[2], bmax[0],bmax[1],bmax[2], duDarkenCol(col), 2);
+		}
+		else if (ob->type == DT_OBSTACLE_ORIENTED_BOX)
+		{
+			const dtObstacleOrientedBox& obb = ob->orientedBox;
+			const float ax = obb.rot[0]*obb.halfExtents[0], az = obb.rot[1]*obb.halfExtents[0];
+			const float bx = -obb.rot[1]*obb.halfExtents[2], bz = obb.rot[0]*obb.halfExtents[2];
+			const float* c = obb.center;
+			const float verts[4*3] = {
+				c[0]-ax-bx, c[1], c[2]-az-bz,
+				c[0]+ax-bx, c[1], c[2]+az-bz,
+				c[0]+ax+bx, c[1], c[2]+az+bz,
+				c[0]-ax+bx, c[1], c[2]-az+bz,
+			};
+			drawObstacleOutline(dd, verts, 4, bmin[1], bmax[1], duDarkenCol(col));
+		}
+		else if (ob->type == DT_OBSTACLE_CONVEX)
+		{
+			drawObstacleOutline(dd, ob->convex.verts, ob->convex.nverts, bmin[1], bmax[1], duDarkenCol(col));
+		}
 	}
 }
 
@@ -30,6 +30,7 @@
 #include "RecastDebugDraw.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshSet.h"
 #include "DetourDebugDraw.h"
 #include "NavMeshTesterTool.h"
 #include "NavMeshPruneTool.h"
@@ -174,6 +175,7 @@ public:
 
 Sample_TileMesh::Sample_TileMesh() :
 	m_keepInterResults(false),
+	m_cacheCompactFields(false),
 	m_buildAll(true),
 	m_totalBuildTimeMs(0),
 	m_triareas(0),
@@ -189,11 +191,16 @@ Sample_TileMesh::Sample_TileMesh() :
 	m_tileCol(duRGBA(0,0,0,32)),
 	m_tileBuildTime(0),
 	m_tileMemUsage(0),
-	m_tileTriCount(0)
+	m_tileTriCount(0),
+	m_cachedTiles(0),
+	m_cachedTilesWidth(0),
+	m_cachedTilesHeight(0)
 {
 	resetCommonSettings();
 	memset(m_tileBmin, 0, sizeof(m_tileBmin));
 	memset(m_tileBmax, 0, sizeof(m_tileBmax));
+	memset(&m_navMeshSet, 0, sizeof(m_navMeshSet));
+	memset(&m_cachedCfg, 0, sizeof(m_cachedCfg));
 	
 	setTool(new NavMeshTileTool);
 }
@@ -201,8 +208,10 @@ Sample_TileMesh::Sample_TileMesh() :
 Sample_TileMesh::~Sample_TileMesh()
 {
 	cleanup();
+	freeTileCache();
 	dtFreeNavMesh(m_navMesh);
 	m_navMesh = 0;
+	dtUnmapNavMeshSet(&m_navMeshSet);
 }
 
 void Sample_TileMesh::cleanup()
@@ -221,112 +230,104 @@ void Sample_TileMesh::cleanup()
 	m_dmesh = 0;
 }
 
-
-static const int NAVMESHSET_MAGIC = 'M'<<24 | 'S'<<16 | 'E'<<8 | 'T'; //'MSET';
-static const int NAVMESHSET_VERSION = 1;
-
-struct NavMeshSetHeader
+void Sample_TileMesh::freeTileCache()
 {
-	int magic;
-	int version;
-	int numTiles;
-	dtNavMeshParams params;
-};
+	for (int i = 0; i < m_cachedTilesWidth*m_cachedTilesHeight; ++i)
+		rcFreeCompactHeightfield(m_cachedTiles[i].chf);
+	delete [] m_cachedTiles;
+	m_cachedTiles = 0;
+	m_cachedTilesWidth = 0;
+	m_cachedTilesHeight = 0;
+}
 
-struct NavMeshTileHeader
+/// Returns the cache entry of a tile, or null if the tile is outside of the input mesh.
+/// The cache is emptied when the settings used to build the compact heightfields change.
+Sample_TileMesh::CachedTile* Sample_TileMesh::getCachedTile(const int tx, const int ty)
 {
-	dtTileRef tileRef;
-	int dataSize;
-};
+	const rcConfig& a = m_cfg;
+	const rcConfig& b = m_cachedCfg;
+	if (a.cs != b.cs || a.ch != b.ch || a.walkableSlopeAngle != b.walkableSlopeAngle ||
+		a.walkableHeight != b.walkableHeight || a.walkableClimb != b.walkableClimb ||
+		a.walkableRadius != b.walkableRadius || a.tileSize != b.tileSize || a.borderSize != b.borderSize)
+	{
+		freeTileCache();
+		m_cachedCfg = m_cfg;
+	}
+	
+	if (!m_cachedTiles)
+	{
+		int gw = 0, gh = 0;
+		rcCalcGridSize(m_geom->getMeshBoundsMin(), m_geom->getMeshBoundsMax(), m_cfg.cs, &gw, &gh);
+		const int tw = (gw + m_cfg.tileSize-1) / m_cfg.tileSize;
+		const int th = (gh + m_cfg.tileSize-1) / m_cfg.tileSize;
+		m_cachedTiles = new CachedTile[tw*th];
+		memset(m_cachedTiles, 0, sizeof(CachedTile)*tw*th);
+		m_cachedTilesWidth = tw;
+		m_cachedTilesHeight = th;
+	}
+	
+	if (tx < 0 || ty < 0 || tx >= m_cachedTilesWidth || ty >= m_cachedTilesHeight)
+		return 0;
+	return &m_cachedTiles[tx + ty*m_cachedTilesWidth];
+}
+
 
 void Sample_TileMesh::saveAll(const char* path, const dtNavMesh* mesh)
 {
 	if (!mesh) return;
 	
-	FILE* fp = fopen(path, "wb");
-	if (!fp)
+	const int dataSize = dtGetNavMeshSetSize(mesh);
+	unsigned char* data = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_TEMP);
+	if (!data)
 		return;
-	
-	// Store header.
-	NavMeshSetHeader header;
-	header.magic = NAVMESHSET_MAGIC;
-	header.version = NAVMESHSET_VERSION;
-	header.numTiles = 0;
-	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	if (dtStatusFailed(dtStoreNavMeshSet(mesh, data, dataSize)))
 	{
-		const dtMeshTile* tile = mesh->getTile(i);
-		if (!tile || !tile->header || !tile->dataSize) continue;
-		header.numTiles++;
+		dtFree(data);
+		return;
 	}
-	memcpy(&header.params, mesh->getParams(), sizeof(dtNavMeshParams));
-	fwrite(&header, sizeof(NavMeshSetHeader), 1, fp);
-
-	// Store tiles.
-	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	
+	// The tiles of the loaded mesh may point into a mapping of the file, so it must not be
+	// rewritten in place: the set is written next to it, then replaces it.
+	char tmpPath[1024];
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+	
+	FILE* fp = fopen(tmpPath, "wb");
+	if (fp)
 	{
-		const dtMeshTile* tile = mesh->getTile(i);
-		if (!tile || !tile->header || !tile->dataSize) continue;
-
-		NavMeshTileHeader tileHeader;
-		tileHeader.tileRef = mesh->getTileRef(tile);
-		tileHeader.dataSize = tile->dataSize;
-		fwrite(&tileHeader, sizeof(tileHeader), 1, fp);
-
-		fwrite(tile->data, tile->dataSize, 1, fp);
+		const bool written = fwrite(data, dataSize, 1, fp) == 1;
+		if (fclose(fp) == 0 && written)
+		{
+#ifdef WIN32
+			// Windows cannot rename over an existing file. A mapped file cannot be removed,
+			// in which case the rename fails and the loaded set is kept.
+			remove(path);
+#endif
+			if (rename(tmpPath, path) != 0)
+				remove(tmpPath);
+		}
+		else
+			remove(tmpPath);
 	}
-
-	fclose(fp);
+	
+	dtFree(data);
 }
 
 dtNavMesh* Sample_TileMesh::loadAll(const char* path)
 {
-	FILE* fp = fopen(path, "rb");
-	if (!fp) return 0;
-	
-	// Read header.
-	NavMeshSetHeader header;
-	fread(&header, sizeof(NavMeshSetHeader), 1, fp);
-	if (header.magic != NAVMESHSET_MAGIC)
-	{
-		fclose(fp);
-		return 0;
-	}
-	if (header.version != NAVMESHSET_VERSION)
-	{
-		fclose(fp);
+	// The tiles point into the mapping, so release it only once the previous mesh is gone.
+	dtUnmapNavMeshSet(&m_navMeshSet);
+	if (dtStatusFailed(dtMapNavMeshSet(path, &m_navMeshSet)))
 		return 0;
-	}
 	
 	dtNavMesh* mesh = dtAllocNavMesh();
 	if (!mesh)
-	{
-		fclose(fp);
 		return 0;
-	}
-	dtStatus status = mesh->init(&header.params);
+	dtStatus status = dtInitNavMeshFromSet(mesh, m_navMeshSet.data, m_navMeshSet.dataSize);
 	if (dtStatusFailed(status))
 	{
-		fclose(fp);
+		dtFreeNavMesh(mesh);
 		return 0;
 	}
-		
-	// Read tiles.
-	for (int i = 0; i < header.numTiles; ++i)
-	{
-		NavMeshTileHeader tileHeader;
-		fread(&tileHeader, sizeof(tileHeader), 1, fp);
-		if (!tileHeader.tileRef || !tileHeader.dataSize)
-			break;
-
-		unsigned char* data = (unsigned char*)dtAlloc(tileHeader.dataSize, DT_ALLOC_PERM);
-		if (!data) break;
-		memset(data, 0, tileHeader.dataSize);
-		fread(data, tileHeader.dataSize, 1, fp);
-		
-		mesh->addTile(data, tileHeader.dataSize, DT_TILE_FREE_DATA, tileHeader.tileRef, 0);
-	}
-	
-	fclose(fp);
 	
 	return mesh;
 }
@@ -338,6 +339,13 @@ void Sample_TileMesh::handleSettings()
 	if (imguiCheck("Keep Itermediate Results", m_keepInterResults))
 		m_keepInterResults = !m_keepInterResults;
 
+	if (imguiCheck("Cache Compact Heightfields", m_cacheCompactFields))
+	{
+		m_cacheCompactFields = !m_cacheCompactFields;
+		if (!m_cacheCompactFields)
+			freeTileCache();
+	}
+
 	if (imguiCheck("Build All Tiles", m_buildAll))
 		m_buildAll = !m_buildAll;
 	
@@ -679,6 +687,7 @@ void Sample_TileMesh::handleMeshChanged(class InputGeom* geom)
 	Sample::handleMeshChanged(geom);
 
 	cleanup();
+	freeTileCache();
 
 	dtFreeNavMesh(m_navMesh);
 	m_navMesh = 0;
@@ -887,72 +896,24 @@ void Sample_TileMesh::removeAllTiles()
 }
 
 
-unsigned char* Sample_TileMesh::buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize)
+/// Voxelizes the input triangles overlapping the tile, and builds the eroded compact heightfield of the tile.
+bool Sample_TileMesh::buildTileCompactHeightfield()
 {
-	if (!m_geom || !m_geom->getMesh() || !m_geom->getChunkyMesh())
-	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Input mesh is not specified.");
-		return 0;
-	}
-	
-	m_tileMemUsage = 0;
-	m_tileBuildTime = 0;
-	
-	cleanup();
-	
 	const float* verts = m_geom->getMesh()->getVerts();
 	const int nverts = m_geom->getMesh()->getVertCount();
-	const int ntris = m_geom->getMesh()->getTriCount();
 	const rcChunkyTriMesh* chunkyMesh = m_geom->getChunkyMesh();
-		
-	// Init build configuration from GUI
-	memset(&m_cfg, 0, sizeof(m_cfg));
-	m_cfg.cs = m_cellSize;
-	m_cfg.ch = m_cellHeight;
-	m_cfg.walkableSlopeAngle = m_agentMaxSlope;
-	m_cfg.walkableHeight = (int)ceilf(m_agentHeight / m_cfg.ch);
-	m_cfg.walkableClimb = (int)floorf(m_agentMaxClimb / m_cfg.ch);
-	m_cfg.walkableRadius = (int)ceilf(m_agentRadius / m_cfg.cs);
-	m_cfg.maxEdgeLen = (int)(m_edgeMaxLen / m_cellSize);
-	m_cfg.maxSimplificationError = m_edgeMaxError;
-	m_cfg.minRegionArea = (int)rcSqr(m_regionMinSize);		// Note: area = size*size
-	m_cfg.mergeRegionArea = (int)rcSqr(m_regionMergeSize);	// Note: area = size*size
-	m_cfg.maxVertsPerPoly = (int)m_vertsPerPoly;
-	m_cfg.tileSize = (int)m_tileSize;
-	m_cfg.borderSize = m_cfg.walkableRadius + 3; // Reserve enough padding.
-	m_cfg.width = m_cfg.tileSize + m_cfg.borderSize*2;
-	m_cfg.height = m_cfg.tileSize + m_cfg.borderSize*2;
-	m_cfg.detailSampleDist = m_detailSampleDist < 0.9f ? 0 : m_cellSize * m_detailSampleDist;
-	m_cfg.detailSampleMaxError = m_cellHeight * m_detailSampleMaxError;
-	
-	rcVcopy(m_cfg.bmin, bmin);
-	rcVcopy(m_cfg.bmax, bmax);
-	m_cfg.bmin[0] -= m_cfg.borderSize*m_cfg.cs;
-	m_cfg.bmin[2] -= m_cfg.borderSize*m_cfg.cs;
-	m_cfg.bmax[0] += m_cfg.borderSize*m_cfg.cs;
-	m_cfg.bmax[2] += m_cfg.borderSize*m_cfg.cs;
-	
-	// Reset build times gathering.
-	m_ctx->resetTimers();
-	
-	// Start the build process.
-	m_ctx->startTimer(RC_TIMER_TOTAL);
-	
-	m_ctx->log(RC_LOG_PROGRESS, "Building navigation:");
-	m_ctx->log(RC_LOG_PROGRESS, " - %d x %d cells", m_cfg.width, m_cfg.height);
-	m_ctx->log(RC_LOG_PROGRESS, " - %.1fK verts, %.1fK tris", nverts/1000.0f, ntris/1000.0f);
 	
 	// Allocate voxel heightfield where we rasterize our input data to.
 	m_solid = rcAllocHeightfield();
 	if (!m_solid)
 	{
 		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'solid'.");
-		return 0;
+		return false;
 	}
 	if (!rcCreateHeightfield(m_ctx, *m_solid, m_cfg.width, m_cfg.height, m_cfg.bmin, m_cfg.bmax, m_cfg.cs, m_cfg.ch))
 	{
 		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not create solid heightfield.");
-		return 0;
+		return false;
 	}
 	
 	// Allocate array that can hold triangle flags.
@@ -962,7 +923,7 @@ unsigned char* Sample_TileMesh::buildTileMesh(const int tx, const int ty, const
 	if (!m_triareas)
 	{
 		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", chunkyMesh->maxTrisPerChunk);
-		return 0;
+		return false;
 	}
 	
 	float tbmin[2], tbmax[2];
@@ -973,7 +934,7 @@ unsigned char* Sample_TileMesh::buildTileMesh(const int tx, const int ty, const
 	int cid[512];// TODO: Make grow when returning too many items.
 	const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
 	if (!ncid)
-		return 0;
+		return false;
 	
 	m_tileTriCount = 0;
 	
@@ -1012,12 +973,12 @@ unsigned char* Sample_TileMesh::buildTileMesh(const int tx, const int ty, const
 	if (!m_chf)
 	{
 		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'chf'.");
-		return 0;
+		return false;
 	}
 	if (!rcBuildCompactHeightfield(m_ctx, m_cfg.walkableHeight, m_cfg.walkableClimb, *m_solid, *m_chf))
 	{
 		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not build compact data.");
-		return 0;
+		return false;
 	}
 	
 	if (!m_keepInterResults)
@@ -1030,8 +991,97 @@ unsigned char* Sample_TileMesh::buildTileMesh(const int tx, const int ty, const
 	if (!rcErodeWalkableArea(m_ctx, m_cfg.walkableRadius, *m_chf))
 	{
 		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not erode.");
+		return false;
+	}
+	
+	return true;
+}
+
+unsigned char* Sample_TileMesh::buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize)
+{
+	if (!m_geom || !m_geom->getMesh() || !m_geom->getChunkyMesh())
+	{
+		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Input mesh is not specified.");
 		return 0;
 	}
+	
+	m_tileMemUsage = 0;
+	m_tileBuildTime = 0;
+	
+	cleanup();
+	
+	const int nverts = m_geom->getMesh()->getVertCount();
+	const int ntris = m_geom->getMesh()->getTriCount();
+		
+	// Init build configuration from GUI
+	memset(&m_cfg, 0, sizeof(m_cfg));
+	m_cfg.cs = m_cellSize;
+	m_cfg.ch = m_cellHeight;
+	m_cfg.walkableSlopeAngle = m_agentMaxSlope;
+	m_cfg.walkableHeight = (int)ceilf(m_agentHeight / m_cfg.ch);
+	m_cfg.walkableClimb = (int)floorf(m_agentMaxClimb / m_cfg.ch);
+	m_cfg.walkableRadius = (int)ceilf(m_agentRadius / m_cfg.cs);
+	m_cfg.maxEdgeLen = (int)(m_edgeMaxLen / m_cellSize);
+	m_cfg.maxSimplificationError = m_edgeMaxError;
+	m_cfg.minRegionArea = (int)rcSqr(m_regionMinSize);		// Note: area = size*size
+	m_cfg.mergeRegionArea = (int)rcSqr(m_regionMergeSize);	// Note: area = size*size
+	m_cfg.maxVertsPerPoly = (int)m_vertsPerPoly;
+	m_cfg.tileSize = (int)m_tileSize;
+	m_cfg.borderSize = m_cfg.walkableRadius + 3; // Reserve enough padding.
+	m_cfg.width = m_cfg.tileSize + m_cfg.borderSize*2;
+	m_cfg.height = m_cfg.tileSize + m_cfg.borderSize*2;
+	m_cfg.detailSampleDist = m_detailSampleDist < 0.9f ? 0 : m_cellSize * m_detailSampleDist;
+	m_cfg.detailSampleMaxError = m_cellHeight * m_detailSampleMaxError;
+	
+	rcVcopy(m_cfg.bmin, bmin);
+	rcVcopy(m_cfg.bmax, bmax);
+	m_cfg.bmin[0] -= m_cfg.borderSize*m_cfg.cs;
+	m_cfg.bmin[2] -= m_cfg.borderSize*m_cfg.cs;
+	m_cfg.bmax[0] += m_cfg.borderSize*m_cfg.cs;
+	m_cfg.bmax[2] += m_cfg.borderSize*m_cfg.cs;
+	
+	// Reset build times gathering.
+	m_ctx->resetTimers();
+	
+	// Start the build process.
+	m_ctx->startTimer(RC_TIMER_TOTAL);
+	
+	m_ctx->log(RC_LOG_PROGRESS, "Building navigation:");
+	m_ctx->log(RC_LOG_PROGRESS, " - %d x %d cells", m_cfg.width, m_cfg.height);
+	m_ctx->log(RC_LOG_PROGRESS, " - %.1fK verts, %.1fK tris", nverts/1000.0f, ntris/1000.0f);
+	
+	CachedTile* cached = m_cacheCompactFields ? getCachedTile(tx, ty) : 0;
+	if (cached && cached->chf)
+	{
+		// Only the marked areas can have changed since the tile was voxelized.
+		m_tileTriCount = cached->triCount;
+		m_chf = rcAllocCompactHeightfield();
+		if (!m_chf)
+		{
+			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'chf'.");
+			return 0;
+		}
+		if (!rcCopyCompactHeightfield(m_ctx, *cached->chf, *m_chf))
+		{
+			m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not copy cached compact data.");
+			return 0;
+		}
+	}
+	else
+	{
+		if (!buildTileCompactHeightfield())
+			return 0;
+		if (cached)
+		{
+			cached->chf = rcAllocCompactHeightfield();
+			if (!cached->chf || !rcCopyCompactHeightfield(m_ctx, *m_chf, *cached->chf))
+			{
+				rcFreeCompactHeightfield(cached->chf);
+				cached->chf = 0;
+			}
+			cached->triCount = m_tileTriCount;
+		}
+	}
 
 	// (Optional) Mark areas.
 	const ConvexVolume* vols = m_geom->getConvexVolumes();